@@ -35,6 +35,10 @@ int cli_system_no_set_led(char* sLedName);
 
 int cli_system_get_led();
 
+int cli_system_get_led_summary();
+
+int cli_system_get_led_subsystem(const char* sSubsysName);
+
 int cli_system_set_led(char* sLedName,char* sLedState);
 
 void cli_pri_init(void);
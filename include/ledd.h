@@ -64,13 +64,79 @@
  *
  *     Other options:
  *          --unixctl=SOCKET        override default control socket name
+ *          --led-table=FILE        publish LED states in FILE
+ *                                  (default: /run/ops-ledd/led-table)
+ *          --no-led-table          do not publish the LED state table
+ *          --stall-threshold=MS    log main loop phases longer than MS
+ *                                  (default: 500, 0 to disable)
+ *          --hw-sim[=DELAY_US]     simulate LED hardware (for testing)
+ *          --breaker-threshold=N   consecutive hardware errors that open a
+ *                                  device or bus breaker (default: 3,
+ *                                  0 to disable)
+ *          --breaker-retry=MS      first probe of an open breaker after MS
+ *                                  (default: 1000)
+ *          --led-class-root=DIR    directory of the LED-class LEDs
+ *                                  (default: /sys/class/leds)
+ *          --reconfigure-budget=MS  split reconfigure passes in slices
+ *                                  of MS (default: 50, 0 for no limit),
+ *                                  also bounds each run of the LED write
+ *                                  scheduler
+ *          --lazy-activation       defer the device setup and LED writes
+ *                                  of a subsystem until one of its LEDs
+ *                                  is not off
+ *          --shard=NAME            run as shard NAME, next to other
+ *                                  shards (lock ops_ledd_NAME, daemon
+ *                                  row ops-ledd-NAME)
+ *          --shard-subsystems=LIST  comma-separated subsystems owned by
+ *                                  the shard
+ *          --shards=LIST           comma-separated names of all the
+ *                                  shards; the last one through sets
+ *                                  cur_hw in the daemon row ops-ledd
+ *          --record=FILE           record a trace for ops-ledd-replay
+ *          --no-static-tables      parse the hardware description files
+ *                                  even if static tables match them
+ *          --rules=FILE            evaluate the fault-LED rules of FILE
+ *          --bus-lock-dir=DIR      take the platform bus locks in DIR
+ *                                  (default: /run/ops-platform/bus, not
+ *                                  taken with --hw-sim unless given)
+ *          --no-bus-lock           do not take the platform bus locks
+ *          --subscribe-socket=FILE  stream LED changes to the clients of
+ *                                  the unix socket FILE
+ *          --hw-proxy[=SOCKET]     access the LED registers through
+ *                                  ops-ledd-hwproxy (default:
+ *                                  /run/ops-ledd/hwproxy.sock), which
+ *                                  takes the platform bus locks
  *          -h, --help              display this help message
  *          -V, --version           display version information
  *
  *
  * ovs-apptcl options:
  *
- *      Support dump: ovs-appctl -t ops-ledd ops-ledd/dump
+ *      Support dump: ovs-appctl -t ops-ledd ops-ledd/dump [--json]
+ *                                                [subsystem] [led-glob]
+ *      Statistics:   ovs-appctl -t ops-ledd ops-ledd/stats
+ *      Profile:      ovs-appctl -t ops-ledd ops-ledd/profile [reset]
+ *      Stall log:    ovs-appctl -t ops-ledd ops-ledd/stall-threshold MS
+ *      Sim failure:  ovs-appctl -t ops-ledd ops-ledd/hw-sim-fail
+ *                                                SUBSYSTEM DEVICE [off]
+ *      Direct set:   ovs-appctl -t ops-ledd ops-ledd/set LED STATE
+ *                                                [DURATION]
+ *                    ovs-appctl -t ops-ledd ops-ledd/set-many
+ *                                   [--duration=S] LED=STATE...
+ *      Arbitration:  ovs-appctl -t ops-ledd ops-ledd/request
+ *                                                LED SOURCE PRIORITY STATE
+ *                    ovs-appctl -t ops-ledd ops-ledd/release LED SOURCE
+ *                    ovs-appctl -t ops-ledd ops-ledd/requests [led-glob]
+ *      Breakers:     ovs-appctl -t ops-ledd ops-ledd/breakers
+ *      Memory:       ovs-appctl -t ops-ledd ops-ledd/memory [subsystem]
+ *      Recording:    ovs-appctl -t ops-ledd ops-ledd/record FILE|off
+ *      Rules:        ovs-appctl -t ops-ledd ops-ledd/rules
+ *      Changes:      ovs-appctl -t ops-ledd ops-ledd/changes [EPOCH SEQ]
+ *      Dimming:      ovs-appctl -t ops-ledd ops-ledd/brightness
+ *                                                LED LEVEL [FADE_MS]
+ *                    ovs-appctl -t ops-ledd ops-ledd/color
+ *                                                LED COLOR|default
+ *                    ovs-appctl -t ops-ledd memory/show
  *
  *
  * OVSDB elements usage
@@ -83,19 +149,103 @@
  *
  *     Written: The following cols are written by ops-ledd
  *              led:status
- *              daemon["ops-ledd"]:cur_hw
+ *              led:state (after an ops-ledd/set without duration)
+ *              daemon["ops-ledd"]:cur_hw (for shard NAME, once all the
+ *                                         --shards have set theirs)
+ *              daemon["ops-ledd-NAME"]:cur_hw (shard NAME, row created
+ *                                              if missing)
  *              subsystem:leds
+ *              subsystem:other_info (leds_<state>, leds_<status> and
+ *                                    leds_total keys: LED summary counts)
  *
  *     Read: The following cols are read by ops-ledd
  *           led:state
  *           subsystem:name
  *           subsystem:hw_desc_dir
+ *           subsystem:other_info (parent_subsystem key: the state of an
+ *                                 LED is fanned out to the same LED of
+ *                                 the child subsystems)
+ *           fan:status, power_supply:status, temp_sensor:status,
+ *           temp_sensor:fan_state (only the columns that --rules use)
+ *
+ * Hardware description:
+ *
+ *     Besides the config-yaml files, ops-ledd reads an optional
+ *     <hw_desc_dir>/led-class.conf that lists the LEDs driven through the
+ *     Linux LED class (sysfs) instead of i2c, one per line:
+ *           <led name> <LED-class name> [<delay_on ms> <delay_off ms>]
+ *     Flashing uses the kernel "timer" trigger with these delays.
+ *
+ *     An optional <hw_desc_dir>/led-dim.conf lists the i2c LEDs that are
+ *     PWM-dimmable or have several colors, one setting per line:
+ *           <led name> pwm <max level> [<fade ms>]
+ *           <led name> colors <name>=<value>[,<name>=<value>...]
+ *     The register field of a pwm LED holds a level from 0 to <max level>:
+ *     "on" lights it at its brightness (ops-ledd/brightness, full by
+ *     default) through a gamma table, and changes fade in <fade ms>. A
+ *     colors LED lights "on" with the value of the color chosen by
+ *     ops-ledd/color (the type setting by default). An LED is pwm or
+ *     colors, not both, and LED-class LEDs are not dimmed here.
+ *
+ * Fault-LED rules:
+ *
+ *     With --rules=FILE, ops-ledd sets LEDs from the fan, power supply and
+ *     temperature sensor rows itself, one rule per line of FILE:
+ *           <name> <led> <state> any|all <table>:<column> <value>[,...]
+ *                 [<priority>]
+ *     e.g.  fan-fault base-fan flashing any fan:status fault
+ *     While any (all) rows of the table have one of the values in the
+ *     column, the rule requests the state for the LED, as source
+ *     "rule:<name>" with the priority (default: LEDD_RULE_PRIORITY). A
+ *     rule is evaluated again only when a row of its column changes. A
+ *     '#' starts a comment; a line with more fields is refused.
+ *
+ * Change stream:
+ *
+ *     Every change of the (effective) state or status of an LED gets a
+ *     sequence number, and the last LEDD_CHANGES_CAPACITY_DEFAULT changes
+ *     are kept in a ring (see ledd_changes.h). A client of
+ *     --subscribe-socket sends one line, and then reads lines:
+ *           SUBSCRIBE [<epoch> <seq>]
+ *     If <seq> (the last change the client saw) of <epoch> is still in the
+ *     ring, ops-ledd answers "RESUME <epoch> <seq>" and sends the changes
+ *     after it. Else (or without a cursor) it sends a snapshot:
+ *           SNAPSHOT <epoch> <seq>
+ *           LED <id> <state> <status> <last change wall ms>   (each LED)
+ *           END
+ *     The changes follow, one per line:
+ *           CHANGE <seq> <id> <state> <status> <wall ms>
+ *           REMOVE <seq> <id> <wall ms>
+ *     A client that reads too slowly gets a new snapshot once the ring
+ *     has moved past it. ops-ledd/changes answers the same way over
+ *     unixctl, for clients that poll.
+ *
+ * Register access proxy:
+ *
+ *     With --hw-proxy, ops-ledd sends its register operations to
+ *     ops-ledd-hwproxy over a unix socket (see ledd_proxy.h), e.g. when it
+ *     runs in a container without the i2c devices. The proxy reads the
+ *     hardware description of each subsystem it serves:
+ *           ops-ledd-hwproxy --hw-desc=base:/etc/openswitch/hwdesc [SOCKET]
+ *     The LED writes of a scheduler run (or of an ops-ledd/set) are sent
+ *     together and answered in one round trip; their results are known,
+ *     and the statuses set, when the batch is committed. A read is sent
+ *     after the staged writes. The proxy takes the platform bus locks, so
+ *     ops-ledd does not. The round trips are counted in ops-ledd/stats.
  *
  * Linux Files:
  *
  *     The following files are written by ops-ledd
  *           /var/run/openvswitch/ops-ledd.pid: Process ID for the ops-ledd daemon
  *           /var/run/openvswitch/ops-ledd.<pid>.ctl: unixctl socket for the ops-ledd daemon
+ *           /run/ops-ledd/led-table: shared-memory LED state table, read
+ *                                    with ops-ledd-table (see ledd_shm.h)
+ *                                    (led-table.NAME for shard NAME)
+ *           /run/ops-platform/bus/<bus>.lock: platform bus locks, shared
+ *                                    with the other platform daemons (see
+ *                                    ledd_buslock.h)
+ *           /run/ops-ledd/hwproxy.sock: socket of ops-ledd-hwproxy
+ *                                    (--hw-proxy)
  *
  * @}
  ***************************************************************************/
@@ -105,28 +255,85 @@
 #define _LEDD_H_
 
 #include <stdbool.h>
+#include "dynamic-string.h"
 #include "shash.h"
+#include "sset.h"
 #include "config-yaml.h"
+#include "ledd_buslock.h"
+#include "ledd_changes.h"
+#include "ledd_proxy.h"
+#include "ledd_tables.h"
+#include "ledd_ramp.h"
+#include "ledd_rules.h"
+#include "ledd_types.h"
 
 /* **************** DEFINES ************* */
 
 #define NAME_IN_DAEMON_TABLE "ops-ledd" /*!< Name identifier for this daemon in the OVSDB daemon table */
 
-#define LEDD_LED_TYPE_LOC       "loc" /*!< Name identifier for LED type loc */
+#define LEDD_LED_TABLE_MIN_SIZE 256   /*!< Initial slots in the LED table */
+
+#define LEDD_LED_CLASS_FILE     "led-class.conf" /*!< File in hw_desc_dir
+                                                     listing the LEDs driven
+                                                     through the LED class */
+#define LEDD_LED_DIM_FILE       "led-dim.conf" /*!< File in hw_desc_dir
+                                                   listing the dimmable and
+                                                   multicolor LEDs */
+
+#define LEDD_STALL_THRESHOLD_DEFAULT 500 /*!< Default stall threshold (ms) */
+
+#define LEDD_SUBSCRIBERS_MAX    16    /*!< Subscribers of the change stream */
+#define LEDD_SUBSCRIBER_BACKLOG 65536 /*!< Max bytes queued for one
+                                           subscriber, the rest waits in the
+                                           change ring */
+#define LEDD_SUBSCRIBER_HELLO_LEN 64  /*!< Max length of a SUBSCRIBE line */
+
+#define LEDD_SUMMARY_INTERVAL_MS 1000 /*!< Min time between LED summary
+                                           publishes in subsystem:other_info */
+
+#define LEDD_DB_SOURCE          "db"  /*!< Requester name of led:state */
+#define LEDD_DB_PRIORITY        100   /*!< Priority of led:state requests */
+#define LEDD_PARENT_KEY         "parent_subsystem" /*!< Key of
+                                           subsystem:other_info naming the
+                                           parent subsystem */
+#define LEDD_SET_SOURCE         "set" /*!< Requester name of timed
+                                           ops-ledd/set requests */
+#define LEDD_SET_PRIORITY       101   /*!< Priority of timed ops-ledd/set
+                                           requests (above led:state) */
+#define LEDD_RULE_PRIORITY      110   /*!< Default priority of the requests
+                                           of the fault-LED rules */
+
+#define LEDD_BREAKER_THRESHOLD_DEFAULT 3 /*!< Consecutive errors that open
+                                              a breaker, 0 = never open */
+#define LEDD_BREAKER_RETRY_DEFAULT 1000 /*!< First probe delay (ms) */
+#define LEDD_BREAKER_RETRY_MAX  60000 /*!< Max probe delay (ms), the delay
+                                           doubles after each failed probe */
+
+#define LEDD_RECONFIGURE_BUDGET_DEFAULT 50 /*!< Max length (ms) of a slice
+                                                of a reconfigure pass */
+
+#define LEDD_SCHED_STARVE_LIMIT 8     /*!< Writes a non-empty write class
+                                           may be passed over before it is
+                                           served anyway */
+
+#define LEDD_TRACE_FLUSH_MS 1000      /*!< Flush interval of the trace */
+
+#define LEDD_SCHED_COMPACT_MIN 1024   /*!< Entries a drained write queue
+                                           keeps, a larger array (left by
+                                           a burst) is released */
+
+#define LEDD_N_LED_STATES       3     /*!< Entries in led_state_strings */
+#define LEDD_N_LED_STATUSES     3     /*!< Entries in led_status_strings */
 
 VLOG_DEFINE_THIS_MODULE(ops_ledd);
 COVERAGE_DEFINE(ledd_reconfigure);
+COVERAGE_DEFINE(ledd_hw_read);
+COVERAGE_DEFINE(ledd_hw_write);
+COVERAGE_DEFINE(ledd_hw_write_skipped);
+COVERAGE_DEFINE(ledd_hw_breaker_skipped);
 
 /* **************** TYPEDEFS  ************* */
 
-/************************************************************************//**
- * char array containing the string name for supported led types. These
- * are defined in this header file.
- ***************************************************************************/
-const char *led_type_strings[] = {
-    LEDD_LED_TYPE_LOC     /*!< LED type "loc" */
-};
-
 /************************************************************************//**
  * char array containing the string name for supported led states. These
  * are defined in the OVS schema for the LED table.
@@ -147,12 +354,151 @@ const char *led_status_strings[] = {
     OVSREC_LED_STATUS_UNINITIALIZED     /*!< LED status "uninitialized" */
 };
 
+/************************************************************************//**
+ * ENUM for the phases of the main loop timed by the profiler.
+ ***************************************************************************/
+enum ledd_phase {
+    LEDD_PHASE_RUN,                     /*!< ledd_run() */
+    LEDD_PHASE_UNIXCTL,                 /*!< unixctl_server_run() */
+    LEDD_PHASE_POLL,                    /*!< poll_block(), i.e. idle */
+    LEDD_N_PHASES
+};
+
+/************************************************************************//**
+ * char array containing the string name for the main loop phases.
+ ***************************************************************************/
+const char *ledd_phase_strings[] = {
+    "ledd_run",                         /*!< LEDD_PHASE_RUN */
+    "unixctl_server_run",               /*!< LEDD_PHASE_UNIXCTL */
+    "poll_block"                        /*!< LEDD_PHASE_POLL */
+};
+
+/************************************************************************//**
+ * ENUM for the source a main loop wakeup is attributed to.
+ ***************************************************************************/
+enum ledd_wakeup {
+    LEDD_WAKEUP_IDL,                    /*!< The db changed */
+    LEDD_WAKEUP_UNIXCTL,                /*!< An ops-ledd command was run */
+    LEDD_WAKEUP_TIMER,                  /*!< An ops-ledd timer expired */
+    LEDD_WAKEUP_OTHER,                  /*!< Anything else */
+    LEDD_N_WAKEUPS
+};
+
+/************************************************************************//**
+ * char array containing the string name for the wakeup sources.
+ ***************************************************************************/
+const char *ledd_wakeup_strings[] = {
+    "idl",                              /*!< LEDD_WAKEUP_IDL */
+    "unixctl",                          /*!< LEDD_WAKEUP_UNIXCTL */
+    "timer",                            /*!< LEDD_WAKEUP_TIMER */
+    "other"                             /*!< LEDD_WAKEUP_OTHER */
+};
+
+/************************************************************************//**
+ * ENUM for the priority classes of the LED write scheduler, highest
+ * priority first.
+ ***************************************************************************/
+enum ledd_write_class {
+    LEDD_WRITE_INTERACTIVE,             /*!< led:state changes (operator) */
+    LEDD_WRITE_FAULT,                   /*!< Requests (fault indication) */
+    LEDD_WRITE_BULK,                    /*!< Initial programming, recovery */
+    LEDD_N_WRITE_CLASSES
+};
+
+/************************************************************************//**
+ * char array containing the string name for the write classes.
+ ***************************************************************************/
+const char *ledd_write_class_strings[] = {
+    "interactive",                      /*!< LEDD_WRITE_INTERACTIVE */
+    "fault",                            /*!< LEDD_WRITE_FAULT */
+    "bulk"                              /*!< LEDD_WRITE_BULK */
+};
+
+/************************************************************************//**
+ * ENUM for the scope of a circuit breaker. Every LED is behind one breaker
+ * for its device and one for the bus of that device.
+ ***************************************************************************/
+enum ledd_breaker_scope {
+    LEDD_BREAKER_DEVICE,                /*!< One device on a bus */
+    LEDD_BREAKER_BUS,                   /*!< Every device on a bus */
+    LEDD_N_BREAKER_SCOPES
+};
+
+/************************************************************************//**
+ * ENUM for the state of a circuit breaker.
+ ***************************************************************************/
+enum ledd_breaker_state {
+    LEDD_BREAKER_CLOSED,                /*!< Accesses go to the hardware */
+    LEDD_BREAKER_OPEN,                  /*!< Accesses are skipped */
+    LEDD_BREAKER_HALF_OPEN,             /*!< One probe access is allowed */
+    LEDD_N_BREAKER_STATES
+};
+
+/************************************************************************//**
+ * char array containing the string name for the breaker states.
+ ***************************************************************************/
+const char *ledd_breaker_state_strings[] = {
+    "closed",                           /*!< LEDD_BREAKER_CLOSED */
+    "open",                             /*!< LEDD_BREAKER_OPEN */
+    "half-open"                         /*!< LEDD_BREAKER_HALF_OPEN */
+};
+
+/************************************************************************//**
+ * STRUCT used to track the hardware errors of a device or of a bus. After
+ * "threshold" consecutive errors the breaker opens: its LEDs are set to
+ * fault and their accesses are skipped until a probe access succeeds.
+ ***************************************************************************/
+struct ledd_breaker {
+    char *name;                         /*!< "subsys/device" or
+                                             "subsys/bus:BUS" */
+    enum ledd_breaker_scope scope;      /*!< Device or bus */
+    enum ledd_breaker_state state;      /*!< Closed, open or half-open */
+    unsigned int n_leds;                /*!< LEDs behind the breaker */
+    unsigned int errors;                /*!< Consecutive errors */
+    unsigned long long total_errors;    /*!< All errors */
+    unsigned long long skipped;         /*!< Accesses skipped while open */
+    unsigned int trips;                 /*!< Times the breaker opened */
+    long long int retry_ms;             /*!< Current probe delay */
+    long long int retry_at;             /*!< Monotonic ms of next probe */
+    long long int opened;               /*!< Wall ms of the last trip */
+};
+
+/************************************************************************//**
+ * STRUCT for a platform bus of LEDs, with its cooperative lock (see
+ * ledd_buslock.h). The lock is taken by the first access of a batch of
+ * LED writes and released at the end of the batch.
+ ***************************************************************************/
+struct ledd_bus {
+    char *name;                         /*!< Bus name (devices.yaml) */
+    unsigned int n_leds;                /*!< LEDs on the bus */
+    bool timed_out;                     /*!< The wait of this batch timed
+                                             out, do not wait again */
+    struct ledd_buslock lock;           /*!< Lock of the bus */
+};
+
+/************************************************************************//**
+ * STRUCT for a client of the change stream (see --subscribe-socket). The
+ * output queue is filled from the change ring only while it is shorter
+ * than LEDD_SUBSCRIBER_BACKLOG, so a slow client costs no more memory: its
+ * cursor stays behind, and it gets a snapshot if the ring moves past it.
+ ***************************************************************************/
+struct ledd_subscriber {
+    struct stream *stream;              /*!< Connection of the client */
+    char hello[LEDD_SUBSCRIBER_HELLO_LEN]; /*!< SUBSCRIBE line so far */
+    size_t hello_len;                   /*!< Bytes in hello */
+    bool subscribed;                    /*!< SUBSCRIBE line received */
+    uint64_t cursor;                    /*!< Last change queued */
+    struct ds out;                      /*!< Output not yet sent */
+    size_t out_ofs;                     /*!< Bytes of out already sent */
+};
+
 /************************************************************************//**
  * ENUM to indicate if the subsystem is valid (OK), or not (IGNORE).
  ***************************************************************************/
 enum subsysstatus {
     LEDD_SUBSYS_STATUS_OK,              /*!< Subsystem is ok, process */
-    LEDD_SUBSYS_STATUS_IGNORE           /*!< Subsystem not ok, don't process */
+    LEDD_SUBSYS_STATUS_IGNORE,          /*!< Subsystem not ok, don't process */
+    LEDD_SUBSYS_STATUS_ADDING           /*!< LEDs being added, in slices */
 };
 
 /************************************************************************//**
@@ -163,11 +509,87 @@ struct locl_subsystem {
     char *name;                         /*!< Name of the subsystem */
     bool marked;                        /*!< True if subsystem exists*/
     struct locl_subsystem *parent_subsystem; /*!< parent subsystem */
+    bool has_children;                  /*!< True if a subsystem has this
+                                             one as parent */
     int num_leds;                       /*!< Number of LEDs in subsystem */
+    int next_led;                       /*!< While ADDING: next LED to add */
     int num_types;                      /*!< Number of LED types in subsystem */
     struct shash subsystem_leds;        /*!< shash of locl_led structs*/
     struct shash subsystem_types;       /*!< shash of YamlLedType structs */
     enum subsysstatus subsys_status;    /*!< status {OK, IGNORE} */
+    uint32_t digest;                    /*!< XOR of the LED digests */
+    int state_count[LEDD_N_LED_STATES]; /*!< # of LEDs in each state */
+    int status_count[LEDD_N_LED_STATUSES]; /*!< # of LEDs in each status */
+    bool summary_dirty;                 /*!< Counts changed since publish */
+    bool summary_pushing;               /*!< Counts in the summary
+                                             transaction in flight */
+    struct shash led_class;             /*!< shash of ledd_led_class structs
+                                             (by LED name) */
+    struct shash led_dim;               /*!< shash of ledd_led_dim structs
+                                             (by LED name) */
+    bool lazy;                          /*!< Devices not parsed and no LED
+                                             written yet (lazy activation) */
+    bool devices_failed;                /*!< Lazy activation could not
+                                             parse the devices file */
+    struct shash type_values;           /*!< ledd_led_type structs of the
+                                             known LED types, by type */
+    const struct ledd_static_subsys *tables; /*!< Static tables used instead
+                                                  of the LED file, or NULL */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep one line of the LEDD_LED_CLASS_FILE of a subsystem:
+ * the LED is driven through the Linux LED class (sysfs) instead of i2c.
+ ***************************************************************************/
+struct ledd_led_class {
+    char *name;                         /*!< LED-class name of the LED */
+    unsigned int delay_on;              /*!< Flashing on time (ms) */
+    unsigned int delay_off;             /*!< Flashing off time (ms) */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep the LEDD_LED_DIM_FILE settings of one LED: either a
+ * PWM level field (pwm_max > 0), or named color values (n_colors > 0).
+ ***************************************************************************/
+struct ledd_led_dim {
+    uint32_t pwm_max;                   /*!< Highest PWM level, 0 if none */
+    long long int fade_ms;              /*!< Length of a brightness fade */
+    size_t n_colors;                    /*!< Number of colors */
+    char **colors;                      /*!< Color names */
+    uint32_t *color_values;             /*!< Register value of each color */
+};
+
+/************************************************************************//**
+ * STRUCT for a column that the fault-LED rules can watch. The rules, and
+ * the value of the column in each row, are kept by ledd_rules.h with the
+ * same index.
+ ***************************************************************************/
+struct ledd_rule_column {
+    const char *name;                   /*!< "<table>:<column>" in rules */
+    const struct ovsdb_idl_table_class *table; /*!< Table of the column */
+    const struct ovsdb_idl_column *column; /*!< String column */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep one request for the state of an LED. Each requester
+ * (source) has at most one request per LED; the led:state column is the
+ * request of source "db".
+ ***************************************************************************/
+struct ledd_request {
+    char *source;                       /*!< Name of the requester */
+    int priority;                       /*!< Higher priority wins */
+    enum ovsrec_led_state_e state;      /*!< Requested state */
+    long long int posted;               /*!< Wall ms of the request */
+};
+
+/************************************************************************//**
+ * STRUCT for an LED type of a subsystem: its driver (see ledd_types.h) and
+ * the register value of each state, computed when the type is loaded.
+ ***************************************************************************/
+struct ledd_led_type {
+    unsigned int type_id;               /*!< Index in ledd_type_drivers */
+    uint32_t values[LEDD_N_LED_STATES]; /*!< Register value of each state
+                                             (by enum ovsrec_led_state_e) */
 };
 
 /************************************************************************//**
@@ -177,9 +599,212 @@ struct locl_led {
     char *name;                         /*!< LED name */
     struct locl_subsystem *subsystem;   /*!< Subsystem this LED is in */
     const YamlLed *yaml_led;            /*!< YamlLed struct for this LED */
-    YamlLedTypeSettings *settings;      /*!< Settings for this LED */
+    const uint32_t *values;             /*!< Register value of each state
+                                             (by enum ovsrec_led_state_e),
+                                             NULL if the type is unknown */
+    unsigned int type_id;               /*!< Driver of the type (see
+                                             ledd_types.h), if values */
     enum ovsrec_led_state_e state;      /*!< Last state in OVSDB */
+    enum ovsrec_led_state_e effective_state; /*!< State of the winning
+                                                  request */
+    struct ledd_request *requests;      /*!< Requests, winner first */
+    size_t n_requests;                  /*!< Number of requests */
+    size_t allocated_requests;          /*!< Allocated requests */
     enum ovsrec_led_status_e status;    /*!< Last status in OVSDB */
+    bool status_dirty;                  /*!< Status to push to OVSDB */
+    enum ovsrec_led_state_e hw_state;   /*!< Last state set in hardware */
+    bool hw_valid;                      /*!< True if hw_state is known */
+    int shm_slot;                       /*!< Slot in the LED table, or -1 */
+    uint32_t digest;                    /*!< Hash of id, state and status */
+    unsigned int write_count;           /*!< Number of hardware writes */
+    unsigned int write_failures;        /*!< Number of failed writes */
+    long long int last_change;          /*!< Wall ms of last state/status
+                                             change, 0 if never */
+    bool counted;                       /*!< True if in the summary counts */
+    enum ovsrec_led_state_e counted_state; /*!< State in the counts */
+    enum ovsrec_led_status_e counted_status; /*!< Status in the counts */
+    struct ledd_bus *bus;               /*!< Bus of the LED, NULL if the
+                                             bus lock is not taken */
+    struct ledd_breaker *breakers[LEDD_N_BREAKER_SCOPES]; /*!< Device and
+                                                               bus breakers */
+    bool sched_queued;                  /*!< True if a write is queued */
+    enum ledd_write_class sched_class;  /*!< Class of the queued write */
+    unsigned int sched_gen;             /*!< Generation of the queued write,
+                                             older queue entries are stale */
+    bool sched_sync;                    /*!< Read the register first, and
+                                             only write if it differs */
+    const struct ledd_led_class *led_class; /*!< LED-class settings, NULL
+                                                 for an i2c LED */
+    struct ledd_sysfs_led *sysfs;       /*!< Open LED-class LED, or NULL */
+    bool state_dirty;                   /*!< State set by ops-ledd/set, to
+                                             write back to OVSDB */
+    bool status_pushing;                /*!< Status in the write-back
+                                             transaction in flight */
+    bool state_pushing;                 /*!< State in the write-back
+                                             transaction in flight */
+    enum ovsrec_led_state_e state_verified; /*!< led:state in OVSDB when
+                                                 the write-back started */
+    long long int set_expires;          /*!< time_msec() end of a timed
+                                             ops-ledd/set, 0 if none */
+    const struct ledd_led_dim *dim;     /*!< Dimming/color settings, or NULL */
+    uint8_t brightness;                 /*!< Brightness when "on" */
+    uint8_t output;                     /*!< Brightness in hardware, moved
+                                             by the ramp */
+    int color;                          /*!< Index in dim->colors, or -1 */
+    bool ramping;                       /*!< True while in the ramps */
+    struct ledd_ramp ramp;              /*!< Current ramp, if ramping */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep one entry of a write queue. Entries are not removed
+ * when an LED moves to another class: an entry whose generation no longer
+ * matches the LED is stale and skipped.
+ ***************************************************************************/
+struct ledd_queued_write {
+    struct locl_led *led;               /*!< LED to write, NULL if removed */
+    unsigned int gen;                   /*!< led->sched_gen when queued */
+    long long int queued_us;            /*!< time_usec() when queued */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep the FIFO queue and the counters of one write class.
+ ***************************************************************************/
+struct ledd_write_queue {
+    struct ledd_queued_write *entries;  /*!< Entries [head, n) are queued */
+    size_t head;                        /*!< First queued entry */
+    size_t n;                           /*!< End of the queued entries */
+    size_t allocated;                   /*!< Allocated entries */
+    unsigned int depth;                 /*!< LEDs queued in this class */
+    unsigned int max_depth;             /*!< Largest depth seen */
+    unsigned long long enqueued;        /*!< Writes queued */
+    unsigned long long coalesced;       /*!< Writes merged with a queued one */
+    unsigned long long written;         /*!< Writes done */
+    long long int wait_total_us;        /*!< Sum of queue waits */
+    long long int wait_max_us;          /*!< Longest queue wait */
+    unsigned int bypassed;              /*!< Writes of higher classes done
+                                             since this class was served */
+    unsigned long long promoted;        /*!< Writes done by starvation
+                                             protection */
+};
+
+/************************************************************************//**
+ * STRUCT with the functions used to access LED registers. The backend is
+ * chosen at startup: i2c through config-yaml, simulated registers
+ * (--hw-sim) for testing without hardware, or ops-ledd-hwproxy
+ * (--hw-proxy) when the devices are not reachable from ops-ledd. All
+ * return 0 on success, else an error code. Through the proxy, the LED
+ * writes are staged and sent in one round trip per batch instead, see
+ * ledd_hw_commit().
+ ***************************************************************************/
+struct ledd_hw_backend {
+    const char *name;                   /*!< Backend name */
+    int (*reg_read)(const char *subsys, const i2c_bit_op *reg_op,
+                    uint32_t *value);   /*!< Read the masked register */
+    int (*reg_write)(const char *subsys, const i2c_bit_op *reg_op,
+                     uint32_t value);   /*!< Write the masked register */
+};
+
+/************************************************************************//**
+ * STRUCT used to cache the contents of an LED register while a subsystem
+ * is being (re)synchronized, so that shared registers are read only once.
+ ***************************************************************************/
+struct ledd_reg_cache_entry {
+    bool valid;                         /*!< True if the read succeeded */
+    uint32_t value;                     /*!< Full register contents */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep the counters reported by ops-ledd/stats.
+ ***************************************************************************/
+struct ledd_stats {
+    unsigned int hw_writes;             /*!< Successful LED writes */
+    unsigned int resyncs;               /*!< Resyncs after a reconnect */
+    long long int resync_last_us;       /*!< Duration of the last resync */
+    long long int resync_max_us;        /*!< Longest resync */
+    long long int resync_total_us;      /*!< Sum of all resync durations */
+    unsigned int resync_subsys_clean;   /*!< Subsystems found in sync */
+    unsigned int resync_subsys_diverged; /*!< Subsystems that diverged */
+    unsigned int resync_leds_diverged;  /*!< LED rows fixed by a resync */
+    unsigned int breaker_trips;         /*!< Breakers opened */
+    unsigned long long breaker_skipped; /*!< Accesses skipped by breakers */
+    unsigned int breaker_probes;        /*!< Half-open probe accesses */
+    unsigned int reconfigure_passes;    /*!< Completed reconfigure passes */
+    unsigned int reconfigure_slices;    /*!< Slices cut by the budget */
+    unsigned int compactions;           /*!< Arrays and settings released */
+    unsigned long long compacted_bytes; /*!< Bytes released by them */
+    unsigned int lazy_deferred;         /*!< Subsystems added lazily */
+    unsigned int lazy_activated;        /*!< Lazy subsystems activated */
+    unsigned int static_tables;         /*!< Subsystems added from static
+                                             tables */
+    unsigned int static_mismatches;     /*!< Static tables not used, the
+                                             files changed since the build */
+    unsigned long long direct_sets;     /*!< LEDs set by ops-ledd/set(-many) */
+    unsigned long long direct_timed;    /*!< Of which with a duration */
+    unsigned long long written_back;    /*!< States written back to OVSDB */
+    unsigned long long writeback_retries; /*!< Write-back transactions
+                                               that failed, to retry */
+    unsigned long long writeback_superseded; /*!< States not written back,
+                                                  newer in OVSDB */
+    unsigned long long fan_out;         /*!< LEDs set through a parent */
+    unsigned long long rule_runs;       /*!< Rule evaluations with changes */
+    unsigned long long rule_rows;       /*!< Input row changes seen */
+    unsigned long long rule_changes;    /*!< Rules that became active or
+                                             inactive */
+    unsigned long long rule_eval_us;    /*!< Total time of the evaluations */
+    unsigned long long rule_eval_max_us; /*!< Longest evaluation */
+    unsigned int rule_resyncs;          /*!< Full evaluations (start and
+                                             reconnect) */
+    unsigned long long ramp_ticks;      /*!< Ramp ticks run */
+    unsigned long long ramp_steps;      /*!< Ramp steps that changed a PWM
+                                             level, and were written */
+    unsigned long long ramp_tick_us;    /*!< Total time of the ticks */
+    unsigned long long ramp_tick_max_us; /*!< Longest tick */
+    unsigned int subscribers;           /*!< Subscribers accepted */
+    unsigned int subscribers_refused;   /*!< Refused, too many */
+    unsigned long long subscribe_resumes; /*!< Subscribers that resumed
+                                               from their cursor */
+    unsigned long long subscribe_snapshots; /*!< Snapshots sent */
+    unsigned long long subscribe_behind; /*!< Of which because the ring
+                                              moved past the subscriber */
+    unsigned long long subscribe_bytes; /*!< Bytes sent to subscribers */
+};
+
+/************************************************************************//**
+ * STRUCT used to report the memory used by one subsystem (ops-ledd/memory).
+ * The config-yaml data is owned by config-yaml, its size is estimated
+ * from the structures that ops-ledd references.
+ ***************************************************************************/
+struct ledd_subsys_memory {
+    size_t leds;                        /*!< locl_subsystem, locl_led structs,
+                                             names and hash nodes */
+    size_t requests;                    /*!< Arbitration requests */
+    size_t led_class;                   /*!< LED-class settings and open
+                                             LED-class LEDs */
+    size_t hw_desc;                     /*!< config-yaml LEDs and types
+                                             (estimate) */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep the time spent in one main loop phase.
+ ***************************************************************************/
+struct ledd_phase_stats {
+    unsigned long long count;           /*!< Times the phase ran */
+    long long int total_us;             /*!< Total time in the phase */
+    long long int max_us;               /*!< Longest run of the phase */
+    unsigned int stalls;                /*!< Runs over the stall threshold */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep the main loop profile reported by ops-ledd/profile.
+ ***************************************************************************/
+struct ledd_profile {
+    struct ledd_phase_stats phases[LEDD_N_PHASES]; /*!< Per-phase times */
+    unsigned long long wakeups[LEDD_N_WAKEUPS]; /*!< Wakeups per source */
+    enum ledd_wakeup last_wakeup;       /*!< Source of the last wakeup */
+    long long int start_us;             /*!< Time of the last reset */
+    long long int stall_threshold_ms;   /*!< Stall threshold, 0 = off */
+    long long int timer_deadline;       /*!< Earliest timer armed (ms) */
+    unsigned int unixctl_calls;         /*!< ops-ledd commands handled */
 };
 
 #endif /* _LEDD_H_ */
@@ -0,0 +1,80 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the cooperative platform bus lock
+ *
+ * The platform daemons (ops-ledd, ops-sensord, ops-fand, ops-powerd)
+ * share the i2c buses. To keep their accesses (and the mux switches they
+ * cause) from interleaving, a daemon takes the lock of a bus around a
+ * batch of accesses. The lock of bus BUS (the "bus" of devices.yaml) is
+ * an exclusive flock() on the file <dir>/<BUS>.lock, any '/' in BUS
+ * being replaced by '_'. The kernel releases the lock of a process that
+ * dies, so a crash does not leave a bus locked.
+ *
+ * The lock is cooperative: a process that does not take it is not kept
+ * off the bus. A wait is bounded, so a process that holds a lock for too
+ * long delays the others but does not stop them.
+ *
+ * This module does not depend on OVS so that it can be tested alone.
+ ***************************************************************************/
+
+#ifndef _LEDD_BUSLOCK_H_
+#define _LEDD_BUSLOCK_H_
+
+#include <stdbool.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_BUSLOCK_DEFAULT_DIR "/run/ops-platform/bus" /*!< Default
+                                                             directory of
+                                                             the lock files */
+#define LEDD_BUSLOCK_TIMEOUT_DEFAULT 100 /*!< Default max wait (ms) */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * STRUCT for the lock of one bus, with the times it was waited for and
+ * held.
+ ***************************************************************************/
+struct ledd_buslock {
+    char *path;                         /*!< Lock file */
+    int fd;                             /*!< Open lock file, or -1 */
+    bool held;                          /*!< True while the lock is held */
+    long long int acquired_us;          /*!< Monotonic us of the acquire */
+    unsigned long long acquisitions;    /*!< Times the lock was taken */
+    unsigned long long contended;       /*!< Of which after a wait */
+    unsigned long long timeouts;        /*!< Waits given up */
+    unsigned long long accesses;        /*!< Accesses done under the lock
+                                             (counted by the user) */
+    unsigned long long wait_total_us;   /*!< Time waited for the lock */
+    unsigned long long wait_max_us;     /*!< Longest wait */
+    unsigned long long hold_total_us;   /*!< Time the lock was held */
+    unsigned long long hold_max_us;     /*!< Longest hold */
+};
+
+/* **************** FUNCTIONS ************* */
+
+int ledd_buslock_init(struct ledd_buslock *lock, const char *dir,
+                      const char *bus);
+int ledd_buslock_acquire(struct ledd_buslock *lock, long long int timeout_ms);
+void ledd_buslock_release(struct ledd_buslock *lock);
+void ledd_buslock_destroy(struct ledd_buslock *lock);
+
+#endif /* _LEDD_BUSLOCK_H_ */
@@ -0,0 +1,91 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the ring buffer of LED changes
+ *
+ * Every change of the state or status of an LED gets a sequence number,
+ * one more than the previous change, and is kept in a ring of the last
+ * "capacity" changes. A subscriber remembers the sequence number of the
+ * last change it has seen (its cursor): the changes it missed are the
+ * ones after its cursor, and they can be replayed as long as they are
+ * still in the ring. A subscriber that fell further behind needs a
+ * snapshot of all LEDs instead.
+ *
+ * The sequence numbers restart with the daemon, so they come with an
+ * epoch that is different for each instance of the ring: a cursor of
+ * another epoch is always too old.
+ *
+ * This module does not depend on OVS so that it can be tested alone.
+ ***************************************************************************/
+
+#ifndef _LEDD_CHANGES_H_
+#define _LEDD_CHANGES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_CHANGES_CAPACITY_DEFAULT 4096 /*!< Default changes kept */
+#define LEDD_CHANGES_ID_LEN     64    /*!< Max LED id length, with NUL */
+#define LEDD_CHANGES_STATE_LEN  16    /*!< Max state/status length */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * STRUCT for one change of an LED.
+ ***************************************************************************/
+struct ledd_change {
+    uint64_t seq;                       /*!< Sequence number, from 1 */
+    int64_t time_ms;                    /*!< Wall ms of the change */
+    bool removed;                       /*!< True if the LED was removed */
+    char id[LEDD_CHANGES_ID_LEN];       /*!< LED id, as in the LED table */
+    char state[LEDD_CHANGES_STATE_LEN]; /*!< Effective state */
+    char status[LEDD_CHANGES_STATE_LEN]; /*!< Status */
+};
+
+/************************************************************************//**
+ * STRUCT for the ring of the last changes.
+ ***************************************************************************/
+struct ledd_changes {
+    struct ledd_change *ring;           /*!< Change seq is at
+                                             ring[seq % capacity] */
+    size_t capacity;                    /*!< Changes kept */
+    uint64_t epoch;                     /*!< Instance of the numbering */
+    uint64_t last_seq;                  /*!< Last change, 0 if none */
+};
+
+/* **************** FUNCTIONS ************* */
+
+int ledd_changes_init(struct ledd_changes *changes, size_t capacity,
+                      uint64_t epoch);
+void ledd_changes_destroy(struct ledd_changes *changes);
+uint64_t ledd_changes_add(struct ledd_changes *changes, const char *id,
+                          const char *state, const char *status,
+                          int64_t time_ms);
+uint64_t ledd_changes_remove(struct ledd_changes *changes, const char *id,
+                             int64_t time_ms);
+bool ledd_changes_can_resume(const struct ledd_changes *changes,
+                             uint64_t epoch, uint64_t cursor);
+const struct ledd_change *ledd_changes_get(const struct ledd_changes *changes,
+                                           uint64_t seq);
+
+#endif /* _LEDD_CHANGES_H_ */
@@ -0,0 +1,163 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the LED register access proxy
+ *
+ * An ops-ledd without access to the i2c devices (e.g. in a container)
+ * sends its register operations to ops-ledd-hwproxy over a Unix socket.
+ * The requests and responses are fixed-size frames in host byte order
+ * (both ends are on the same host). Requests are pipelined: the client
+ * stages the writes of a batch and sends them together, and the proxy
+ * answers every request it has received before waiting for more, so a
+ * batch of writes costs one round trip. Responses come in the order of
+ * the requests.
+ *
+ * A read is sent with the staged writes, after them, so that it sees
+ * their result. A commit ends with an LEDD_PROXY_END request, so that the
+ * proxy knows where a batch of the client ends (it may span several round
+ * trips, with reads in between) and can hold the bus locks for the whole
+ * batch. A client that keeps a batch open longer than
+ * LEDD_PROXY_BATCH_TIMEOUT_MS (e.g. it hangs between two round trips) is
+ * disconnected, so that the locks are not held for ever.
+ *
+ * This module does not depend on OVS so that it can be tested alone.
+ ***************************************************************************/
+
+#ifndef _LEDD_PROXY_H_
+#define _LEDD_PROXY_H_
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_PROXY_DEFAULT_PATH "/run/ops-ledd/hwproxy.sock" /*!< Default
+                                           socket of the proxy */
+#define LEDD_PROXY_NAME_LEN     32    /*!< Max subsystem/device name, with
+                                           NUL */
+#define LEDD_PROXY_TIMEOUT_MS   1000  /*!< Max wait for the responses */
+#define LEDD_PROXY_BATCH_TIMEOUT_MS 1000 /*!< Max time a client may keep
+                                           a batch open */
+#define LEDD_PROXY_MAX_CLIENTS  8     /*!< Clients served by a proxy */
+#define LEDD_PROXY_BATCH_MAX    256   /*!< Requests handled per recv() */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * ENUM for the operation of a request.
+ ***************************************************************************/
+enum ledd_proxy_opcode {
+    LEDD_PROXY_READ = 1,                /*!< Read the masked register */
+    LEDD_PROXY_WRITE = 2,               /*!< Write the masked register */
+    LEDD_PROXY_END = 3,                 /*!< End of the client's batch */
+};
+
+/************************************************************************//**
+ * STRUCT for a request frame. The fields of the register operation are
+ * those of i2c_bit_op in config-yaml.
+ ***************************************************************************/
+struct ledd_proxy_req {
+    uint32_t seq;                       /*!< Echoed in the response */
+    uint16_t op;                        /*!< enum ledd_proxy_opcode */
+    uint16_t register_size;             /*!< Register size (bytes) */
+    uint32_t register_address;          /*!< Register address */
+    uint32_t bit_mask;                  /*!< Bits of the operation */
+    uint32_t value;                     /*!< Value to write */
+    char subsys[LEDD_PROXY_NAME_LEN];   /*!< Subsystem of the device */
+    char device[LEDD_PROXY_NAME_LEN];   /*!< Device (devices.yaml) */
+};
+
+/************************************************************************//**
+ * STRUCT for a response frame.
+ ***************************************************************************/
+struct ledd_proxy_rsp {
+    uint32_t seq;                       /*!< seq of the request */
+    int32_t error;                      /*!< 0, or an errno value */
+    uint32_t value;                     /*!< Value read */
+    uint32_t pad;                       /*!< Keeps the frame 8-byte sized */
+};
+
+/* called with the result of each staged write, see ledd_proxy_commit() */
+typedef void ledd_proxy_done_cb(void *aux, int error);
+
+/************************************************************************//**
+ * STRUCT for the client end: the connection, the staged requests and the
+ * counters of the round trips.
+ ***************************************************************************/
+struct ledd_proxy_client {
+    char *path;                         /*!< Socket of the proxy */
+    int fd;                             /*!< Connection, or -1 */
+    uint32_t next_seq;                  /*!< seq of the next request */
+    ledd_proxy_done_cb *done;           /*!< Result of the staged writes */
+    struct ledd_proxy_req *reqs;        /*!< Staged requests */
+    void **aux;                         /*!< aux of each staged request */
+    struct ledd_proxy_rsp *rsps;        /*!< Responses of a round trip */
+    size_t n_reqs;                      /*!< Number of staged requests */
+    size_t allocated;                   /*!< Allocated requests */
+    bool batch_open;                    /*!< A read started a batch that
+                                             is not committed yet */
+    unsigned long long requests;        /*!< Requests sent */
+    unsigned long long round_trips;     /*!< Round trips */
+    unsigned long long failures;        /*!< Requests that failed */
+    unsigned long long reconnects;      /*!< Connections made */
+    size_t batch_max;                   /*!< Largest round trip */
+    unsigned long long rtt_total_us;    /*!< Time of the round trips */
+    unsigned long long rtt_max_us;      /*!< Longest round trip */
+};
+
+/************************************************************************//**
+ * STRUCT with the functions that do the register operations of a proxy.
+ * batch_end (may be NULL) is called at the end of a batch (the END
+ * request of a client, or the disconnection of a client in a batch) once
+ * no other client is in a batch, before the responses are sent, e.g. to
+ * release the bus locks. batch_timeout (may be NULL) is called when the
+ * batch of a client is aborted after LEDD_PROXY_BATCH_TIMEOUT_MS, before
+ * the client is disconnected and its batch ends.
+ ***************************************************************************/
+struct ledd_proxy_handler {
+    int (*op)(void *aux, const struct ledd_proxy_req *req,
+              uint32_t *value);         /*!< Returns 0 or an errno value */
+    void (*batch_end)(void *aux);       /*!< End of a batch, or NULL */
+    void (*batch_timeout)(void *aux, long long int held_ms);
+                                        /*!< Batch aborted, or NULL */
+    void *aux;                          /*!< Passed to the functions */
+};
+
+/* **************** FUNCTIONS ************* */
+
+/* client */
+void ledd_proxy_client_init(struct ledd_proxy_client *client,
+                            const char *path, ledd_proxy_done_cb *done);
+void ledd_proxy_client_destroy(struct ledd_proxy_client *client);
+int ledd_proxy_write(struct ledd_proxy_client *client, const char *subsys,
+                     const struct ledd_proxy_req *op, uint32_t value,
+                     void *aux);
+int ledd_proxy_read(struct ledd_proxy_client *client, const char *subsys,
+                    const struct ledd_proxy_req *op, uint32_t *value);
+int ledd_proxy_commit(struct ledd_proxy_client *client);
+
+/* proxy */
+int ledd_proxy_listen(const char *path);
+int ledd_proxy_serve(int listen_fd, const struct ledd_proxy_handler *handler,
+                     volatile sig_atomic_t *stop);
+
+#endif /* _LEDD_PROXY_H_ */
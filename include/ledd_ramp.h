@@ -0,0 +1,74 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the brightness ramps of PWM-dimmable LEDs
+ *
+ * The brightness of a dimmable LED goes from 0 to LEDD_RAMP_MAX (as
+ * perceived). It is turned into a PWM level through a gamma table
+ * computed at build time (gamma 2.2), so that a linear ramp of the
+ * brightness looks linear to the eye, and then placed in the register
+ * field of the LED.
+ *
+ * A ramp moves the brightness from one value to another in a given time.
+ * The ramps of all LEDs are advanced together on a shared tick of
+ * LEDD_RAMP_TICK_MS; the position of a ramp is computed from the time, so
+ * a late tick does not slow it down.
+ *
+ * This module does not depend on OVS so that it can be tested alone.
+ ***************************************************************************/
+
+#ifndef _LEDD_RAMP_H_
+#define _LEDD_RAMP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_RAMP_MAX           255   /*!< Full brightness */
+#define LEDD_RAMP_TICK_MS       20    /*!< Period of the shared ramp tick */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * STRUCT for a brightness ramp.
+ ***************************************************************************/
+struct ledd_ramp {
+    uint8_t from;                       /*!< Brightness at the start */
+    uint8_t to;                         /*!< Brightness at the end */
+    long long int start_ms;             /*!< Monotonic ms of the start */
+    long long int duration_ms;          /*!< Length of the ramp */
+};
+
+/* **************** GLOBALS ************* */
+
+extern const uint16_t ledd_gamma[LEDD_RAMP_MAX + 1];
+
+/* **************** FUNCTIONS ************* */
+
+uint32_t ledd_ramp_level(unsigned int brightness, uint32_t max_level);
+uint32_t ledd_ramp_field(uint32_t level, uint32_t bit_mask);
+void ledd_ramp_start(struct ledd_ramp *ramp, unsigned int from,
+                     unsigned int to, long long int now_ms,
+                     long long int duration_ms);
+unsigned int ledd_ramp_at(const struct ledd_ramp *ramp, long long int now_ms,
+                          bool *donep);
+
+#endif /* _LEDD_RAMP_H_ */
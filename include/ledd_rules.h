@@ -0,0 +1,120 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the parsing and matching of the fault-LED rules
+ *
+ * A rule is one line of the --rules file:
+ *     <name> <led> <state> any|all <input> <value>[,...] [<priority>]
+ * While any (or all) rows of the input have one of the values, the rule
+ * requests the state for the LED. The inputs (e.g. "fan:status") and the
+ * state names are given by the caller, which reads the rows from OVSDB and
+ * posts the requests.
+ *
+ * Each input keeps the value of each of its rows, by row key, and each
+ * rule keeps the number of rows that match it. A row that changes only
+ * updates the counts of the rules of its input, so a rule is not
+ * evaluated over the whole table. After a reconnect the rows of an input
+ * are counted again from scratch (ledd_rules_resync()).
+ *
+ * This module does not depend on OVS so that it can be tested alone.
+ ***************************************************************************/
+
+#ifndef _LEDD_RULES_H_
+#define _LEDD_RULES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_RULES_ERROR_LEN    128   /*!< Room for a parse error message */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * STRUCT for the value of one row of an input.
+ ***************************************************************************/
+struct ledd_rules_row {
+    struct ledd_rules_row *next;        /*!< Next row of the bucket */
+    char *key;                          /*!< Row key (e.g. its UUID) */
+    char *value;                        /*!< Value of the column */
+};
+
+/************************************************************************//**
+ * STRUCT for a column that the rules can watch, with the value of the
+ * column in each row of its table. A row without a value is not kept.
+ ***************************************************************************/
+struct ledd_rules_input {
+    const char *name;                   /*!< "<table>:<column>" in rules */
+    bool used;                          /*!< True if a rule watches it */
+    struct ledd_rules_row **buckets;    /*!< Rows, by hash of their key */
+    size_t n_buckets;                   /*!< Power of 2, or 0 */
+    size_t n_rows;                      /*!< Rows with a value */
+};
+
+/************************************************************************//**
+ * STRUCT for one fault-LED rule: while "any" (or all) rows of the input
+ * have one of the values, the rule requests "state" for the LED.
+ ***************************************************************************/
+struct ledd_rule {
+    char *name;                         /*!< Rule name */
+    char *source;                       /*!< Request source, "rule:<name>" */
+    char *led;                          /*!< LED id */
+    unsigned int state;                 /*!< State requested (index in the
+                                             states of ledd_rules_init()) */
+    int priority;                       /*!< Priority of the request */
+    bool all;                           /*!< All rows must match, else any */
+    size_t input;                       /*!< Index of the column watched */
+    char **values;                      /*!< Values that match */
+    size_t n_values;                    /*!< Number of values */
+    size_t n_match;                     /*!< Rows that match */
+    bool active;                        /*!< True if the request is posted */
+    bool dirty;                         /*!< n_match changed */
+    unsigned int fired;                 /*!< Times the rule became active */
+};
+
+/************************************************************************//**
+ * STRUCT for the rules and the inputs they watch.
+ ***************************************************************************/
+struct ledd_rules {
+    struct ledd_rules_input *inputs;    /*!< Columns that can be watched */
+    size_t n_inputs;                    /*!< Number of inputs */
+    const char *const *states;          /*!< State names */
+    size_t n_states;                    /*!< Number of states */
+    struct ledd_rule *rules;            /*!< Rules, in file order */
+    size_t n_rules;                     /*!< Number of rules */
+    size_t allocated_rules;             /*!< Room in rules */
+};
+
+/* **************** FUNCTIONS ************* */
+
+int ledd_rules_init(struct ledd_rules *rules, const char *const *inputs,
+                    size_t n_inputs, const char *const *states,
+                    size_t n_states);
+void ledd_rules_destroy(struct ledd_rules *rules);
+int ledd_rules_parse(struct ledd_rules *rules, const char *line,
+                     int default_priority, char *error, size_t error_size);
+int ledd_rules_set_row(struct ledd_rules *rules, size_t input,
+                       const char *key, const char *value);
+void ledd_rules_resync(struct ledd_rules *rules, size_t input);
+struct ledd_rule *ledd_rules_next_change(struct ledd_rules *rules,
+                                         size_t *pos);
+
+#endif /* _LEDD_RULES_H_ */
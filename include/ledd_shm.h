@@ -0,0 +1,122 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the shared-memory LED state table
+ *
+ * ops-ledd publishes the state of every LED it manages in a memory-mapped
+ * file (default: /run/ops-ledd/led-table). The table is written in place by
+ * ops-ledd only, and is protected by a sequence lock: the writer makes the
+ * sequence number odd while it updates the table and even again when it is
+ * done. A reader copies the entries it wants and retries if the sequence
+ * number was odd or changed meanwhile, so taking a consistent snapshot needs
+ * no system call and no IPC with ops-ledd.
+ *
+ * When the table has to grow, ops-ledd writes a new file, renames it over
+ * the old one and sets "superseded" in the old mapping. Readers then get
+ * ESTALE from ledd_shm_snapshot() and must reopen the table.
+ *
+ * This module does not depend on OVS so that external readers can use it.
+ ***************************************************************************/
+
+#ifndef _LEDD_SHM_H_
+#define _LEDD_SHM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_SHM_DEFAULT_PATH   "/run/ops-ledd/led-table" /*!< Default table */
+#define LEDD_SHM_MAGIC          0x4c454454  /*!< "LEDT" */
+#define LEDD_SHM_VERSION        1           /*!< Layout version */
+#define LEDD_SHM_ID_LEN         64          /*!< Max LED id length, with NUL */
+#define LEDD_SHM_STATE_LEN      16          /*!< Max state/status length */
+#define LEDD_SHM_MAX_TRIES      1000        /*!< Snapshot attempts before
+                                                 giving up with EAGAIN */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * STRUCT for one LED in the shared table. The layout is part of the file
+ * format, so only append fields and bump LEDD_SHM_VERSION.
+ ***************************************************************************/
+struct ledd_shm_entry {
+    char id[LEDD_SHM_ID_LEN];           /*!< LED id, as in the LED table */
+    char state[LEDD_SHM_STATE_LEN];     /*!< Effective (arbitrated) state */
+    char hw_state[LEDD_SHM_STATE_LEN];  /*!< State last written to hw */
+    char status[LEDD_SHM_STATE_LEN];    /*!< Status (led:status) */
+    int64_t last_change;                /*!< Wall ms of last change */
+    uint32_t in_use;                    /*!< Non-zero if the slot is used */
+    uint32_t pad;                       /*!< Keeps the entry 8-byte sized */
+};
+
+/************************************************************************//**
+ * STRUCT at the start of the shared table, followed by "capacity" entries.
+ ***************************************************************************/
+struct ledd_shm_header {
+    uint32_t magic;                     /*!< LEDD_SHM_MAGIC */
+    uint32_t version;                   /*!< LEDD_SHM_VERSION */
+    uint32_t entry_size;                /*!< sizeof(struct ledd_shm_entry) */
+    uint32_t capacity;                  /*!< Number of entry slots */
+    uint32_t n_entries;                 /*!< Slots ever used (high water) */
+    uint32_t superseded;                /*!< Non-zero once replaced */
+    int32_t writer_pid;                 /*!< Process id of the writer */
+    uint32_t seq;                       /*!< Sequence lock, odd = writing */
+};
+
+/************************************************************************//**
+ * STRUCT describing a mapping of the shared table, for the writer (ledd)
+ * or for a reader.
+ ***************************************************************************/
+struct ledd_shm {
+    char *path;                         /*!< Path of the table file */
+    size_t size;                        /*!< Size of the mapping */
+    uint32_t capacity;                  /*!< Slots covered by the mapping */
+    struct ledd_shm_header *header;     /*!< Start of the mapping */
+    struct ledd_shm_entry *entries;     /*!< First entry slot */
+    bool writable;                      /*!< True for the writer */
+    int depth;                          /*!< Writer batch nesting depth */
+    uint32_t *free_slots;               /*!< Writer: released slots */
+    size_t n_free;                      /*!< Writer: # of released slots */
+};
+
+/* **************** WRITER ************* */
+
+int ledd_shm_create(struct ledd_shm *shm, const char *path, uint32_t capacity);
+int ledd_shm_grow(struct ledd_shm *shm, uint32_t capacity);
+int ledd_shm_alloc(struct ledd_shm *shm);
+void ledd_shm_free(struct ledd_shm *shm, int slot);
+void ledd_shm_write_begin(struct ledd_shm *shm);
+void ledd_shm_write_end(struct ledd_shm *shm);
+void ledd_shm_set(struct ledd_shm *shm, int slot, const char *id,
+                  const char *state, const char *hw_state,
+                  const char *status, int64_t last_change);
+
+/* **************** READER ************* */
+
+int ledd_shm_open(struct ledd_shm *shm, const char *path);
+int ledd_shm_snapshot(const struct ledd_shm *shm,
+                      struct ledd_shm_entry *entries, uint32_t max,
+                      uint32_t *n);
+
+void ledd_shm_close(struct ledd_shm *shm);
+
+#endif /* _LEDD_SHM_H_ */
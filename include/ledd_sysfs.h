@@ -0,0 +1,116 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the Linux LED-class (sysfs) LED backend
+ *
+ * An LED-class LED is a directory (default: /sys/class/leds/<name>) with
+ * "brightness", "max_brightness" and "trigger" attributes. Selecting the
+ * kernel "timer" trigger adds "delay_on" and "delay_off", and the kernel
+ * then flashes the LED by itself.
+ *
+ * The attribute files are opened once and kept open. Changes are staged
+ * in a batch and written when the batch is committed. Only the attributes
+ * whose value differs from the last value written (or read when the LED
+ * was opened) are written, so an LED staged many times in a burst costs
+ * at most one write per attribute.
+ *
+ * The files may be regular files (a fake tree for tests): they are then
+ * truncated after each write.
+ *
+ * This module does not depend on OVS so that it can be tested alone.
+ ***************************************************************************/
+
+#ifndef _LEDD_SYSFS_H_
+#define _LEDD_SYSFS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_SYSFS_DEFAULT_ROOT "/sys/class/leds" /*!< Default LED class */
+#define LEDD_SYSFS_DELAY_DEFAULT 500    /*!< Default flash half period (ms) */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * ENUM for the modes of an LED-class LED.
+ ***************************************************************************/
+enum ledd_sysfs_mode {
+    LEDD_SYSFS_OFF,                     /*!< No trigger, brightness 0 */
+    LEDD_SYSFS_ON,                      /*!< No trigger, max brightness */
+    LEDD_SYSFS_FLASH                    /*!< "timer" trigger */
+};
+
+/************************************************************************//**
+ * STRUCT describing one open LED-class LED.
+ ***************************************************************************/
+struct ledd_sysfs_led {
+    char *dir;                          /*!< Directory of the LED */
+    int brightness_fd;                  /*!< "brightness" */
+    int trigger_fd;                     /*!< "trigger" */
+    int delay_on_fd;                    /*!< "delay_on", or -1 */
+    int delay_off_fd;                   /*!< "delay_off", or -1 */
+    bool regular;                       /*!< Regular files (fake tree) */
+    unsigned int max_brightness;        /*!< Brightness when on */
+
+    bool valid;                         /*!< True if the fields below are
+                                             known to match the LED */
+    enum ledd_sysfs_mode mode;          /*!< Mode written (or read) */
+    unsigned int delay_on;              /*!< delay_on written (FLASH) */
+    unsigned int delay_off;             /*!< delay_off written (FLASH) */
+
+    bool staged;                        /*!< True if in a batch */
+    enum ledd_sysfs_mode staged_mode;   /*!< Mode to write */
+    unsigned int staged_on;             /*!< delay_on to write */
+    unsigned int staged_off;            /*!< delay_off to write */
+
+    int error;                          /*!< errno of the last commit */
+    bool written;                       /*!< True if the last commit wrote
+                                             an attribute */
+    unsigned long long writes;          /*!< Attribute writes done */
+    void *aux;                          /*!< Owner's data */
+};
+
+/************************************************************************//**
+ * STRUCT used to collect the LEDs changed by a burst of writes.
+ ***************************************************************************/
+struct ledd_sysfs_batch {
+    struct ledd_sysfs_led **leds;       /*!< Staged LEDs */
+    size_t n;                           /*!< Number of staged LEDs */
+    size_t allocated;                   /*!< Allocated slots */
+};
+
+/* **************** LEDS ************* */
+
+int ledd_sysfs_open(const char *root, const char *name,
+                    struct ledd_sysfs_led **ledp);
+void ledd_sysfs_close(struct ledd_sysfs_led *led);
+
+/* **************** BATCHES ************* */
+
+int ledd_sysfs_stage(struct ledd_sysfs_batch *batch,
+                     struct ledd_sysfs_led *led, enum ledd_sysfs_mode mode,
+                     unsigned int delay_on, unsigned int delay_off);
+size_t ledd_sysfs_commit(struct ledd_sysfs_batch *batch,
+                         void (*done)(struct ledd_sysfs_led *led));
+void ledd_sysfs_batch_destroy(struct ledd_sysfs_batch *batch);
+
+#endif /* _LEDD_SYSFS_H_ */
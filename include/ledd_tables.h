@@ -0,0 +1,79 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the static LED tables of ops-ledd
+ *
+ * For a fixed platform, the hardware description files of its subsystems
+ * can be compiled into C tables at build time (cmake
+ * -DLEDD_STATIC_TABLES="NAME=DIR;..."): tools/ledd_gen_tables.py generates
+ * the LEDs with their register operations, the LED types with the register
+ * value of each state, and the devices with their bus. When a subsystem is
+ * added with the name and hw_desc_dir of a table, and the digest of its
+ * files still matches, ops-ledd uses the table instead of parsing the LED
+ * file. Without LEDD_STATIC_TABLES, src/ledd_tables.c provides no table.
+ ***************************************************************************/
+
+#ifndef _LEDD_TABLES_H_
+#define _LEDD_TABLES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config-yaml.h"
+
+/* **************** DEFINES ************* */
+
+#define LEDD_TABLES_N_STATES    3     /*!< Values of an LED type, indexed by
+                                           enum ovsrec_led_state_e */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * STRUCT used to keep the bus of a device of a static table.
+ ***************************************************************************/
+struct ledd_static_device {
+    const char *name;                   /*!< Device name */
+    const char *bus;                    /*!< Bus of the device, or NULL */
+};
+
+/************************************************************************//**
+ * STRUCT used to keep the static table of one subsystem.
+ ***************************************************************************/
+struct ledd_static_subsys {
+    const char *name;                   /*!< Subsystem name */
+    const char *hw_desc_dir;            /*!< hw_desc_dir of the subsystem */
+    uint32_t digest;                    /*!< FNV-1a of devices.yaml and
+                                             led.yaml, see
+                                             ledd_hw_desc_digest() */
+    int n_leds;                         /*!< Number of LEDs */
+    YamlLed *leds;                      /*!< LEDs, in led.yaml order */
+    int n_types;                        /*!< Number of LED types */
+    YamlLedType *types;                 /*!< LED types */
+    const uint32_t (*values)[LEDD_TABLES_N_STATES]; /*!< Register value of
+                                             each state, for each type */
+    int n_devices;                      /*!< Number of devices */
+    const struct ledd_static_device *devices; /*!< Devices, sorted by name */
+};
+
+/* **************** TABLES ************* */
+
+extern const struct ledd_static_subsys *const ledd_static_tables;
+extern const size_t ledd_n_static_tables;
+
+#endif /* _LEDD_TABLES_H_ */
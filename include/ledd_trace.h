@@ -0,0 +1,145 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the ops-ledd trace (record and replay)
+ *
+ * With --record=FILE, ops-ledd writes a binary trace of what it observes
+ * and does: the Subsystem rows it adds and removes, the LED states it
+ * reads from the db, every LED write with its value, result and latency,
+ * and every transaction commit. ops-ledd-replay feeds the observed changes
+ * of a trace back into a db served to an ops-ledd running with --hw-sim,
+ * and prints the statistics of a trace.
+ *
+ * The file starts with a struct ledd_trace_header, followed by records.
+ * Each record is a struct ledd_trace_record_header followed by "len" bytes
+ * of payload: strings are a length byte and the bytes (no NUL), integers
+ * are in host byte order. A trace cut by a crash ends with a truncated
+ * record, which the reader reports as the end of the trace.
+ *
+ * This module does not depend on OVS so that it can be tested alone.
+ ***************************************************************************/
+
+#ifndef _LEDD_TRACE_H_
+#define _LEDD_TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_TRACE_MAGIC        0x4c454452  /*!< "LEDR" */
+#define LEDD_TRACE_VERSION      1           /*!< Format version */
+#define LEDD_TRACE_STR_MAX      255         /*!< Longer strings are cut */
+#define LEDD_TRACE_PAYLOAD_MAX  1024        /*!< Largest record payload */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * ENUM for the record types.
+ ***************************************************************************/
+enum ledd_trace_type {
+    LEDD_TRACE_SUBSYS_ADD = 1,          /*!< Subsystem row seen:
+                                             name, hw_desc_dir */
+    LEDD_TRACE_SUBSYS_DEL,              /*!< Subsystem row gone: name */
+    LEDD_TRACE_LED_STATE,               /*!< LED state read from the db:
+                                             id, state */
+    LEDD_TRACE_HW_WRITE,                /*!< LED write: id, value, error,
+                                             latency */
+    LEDD_TRACE_COMMIT,                  /*!< Transaction commit: status,
+                                             latency */
+    LEDD_TRACE_N_TYPES
+};
+
+/************************************************************************//**
+ * STRUCT at the start of a trace file.
+ ***************************************************************************/
+struct ledd_trace_header {
+    uint32_t magic;                     /*!< LEDD_TRACE_MAGIC */
+    uint16_t version;                   /*!< LEDD_TRACE_VERSION */
+    uint16_t reserved;                  /*!< 0 */
+    int64_t start;                      /*!< Wall ms of the first record */
+};
+
+/************************************************************************//**
+ * STRUCT at the start of each record.
+ ***************************************************************************/
+struct ledd_trace_record_header {
+    uint32_t delta_us;                  /*!< Time since the previous record
+                                             (saturates at UINT32_MAX) */
+    uint8_t type;                       /*!< enum ledd_trace_type */
+    uint8_t reserved;                   /*!< 0 */
+    uint16_t len;                       /*!< Bytes of payload */
+};
+
+/************************************************************************//**
+ * STRUCT for one decoded record. The strings point into the reader's
+ * buffer and are valid until the next record is read.
+ ***************************************************************************/
+struct ledd_trace_record {
+    enum ledd_trace_type type;          /*!< Record type */
+    long long int time_us;              /*!< Time since the trace start */
+    const char *name;                   /*!< Subsystem name or LED id */
+    const char *text;                   /*!< hw_desc_dir or state */
+    uint32_t value;                     /*!< HW_WRITE: value written */
+    int32_t error;                      /*!< HW_WRITE: errno, 0 on success;
+                                             COMMIT: transaction status */
+    uint32_t latency_us;                /*!< HW_WRITE, COMMIT: duration */
+};
+
+/************************************************************************//**
+ * STRUCT for an open trace, for writing or for reading.
+ ***************************************************************************/
+struct ledd_trace {
+    FILE *file;                         /*!< Trace file */
+    bool writer;                        /*!< True if open for writing */
+    long long int last_us;              /*!< Writer: time of the last
+                                             record; reader: its offset */
+    unsigned long long records;         /*!< Records written or read */
+    int error;                          /*!< First write error, or 0 */
+    char buf[LEDD_TRACE_PAYLOAD_MAX + 2]; /*!< Reader: decoded strings */
+};
+
+/* **************** WRITER ************* */
+
+int ledd_trace_create(struct ledd_trace *trace, const char *path,
+                      long long int now_us, long long int wall_ms);
+void ledd_trace_subsys(struct ledd_trace *trace, long long int now_us,
+                       bool add, const char *name, const char *dir);
+void ledd_trace_led_state(struct ledd_trace *trace, long long int now_us,
+                          const char *id, const char *state);
+void ledd_trace_hw_write(struct ledd_trace *trace, long long int now_us,
+                         const char *id, uint32_t value, int error,
+                         long long int latency_us);
+void ledd_trace_commit(struct ledd_trace *trace, long long int now_us,
+                       int status, long long int latency_us);
+int ledd_trace_flush(struct ledd_trace *trace);
+
+/* **************** READER ************* */
+
+int ledd_trace_open(struct ledd_trace *trace, const char *path,
+                    long long int *startp);
+int ledd_trace_read(struct ledd_trace *trace,
+                    struct ledd_trace_record *record);
+
+void ledd_trace_close(struct ledd_trace *trace);
+
+#endif /* _LEDD_TRACE_H_ */
@@ -0,0 +1,125 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Header for the ops-ledd LED type registry
+ *
+ * Each LED type ("loc", "status", ...) has a driver: the set of states an
+ * LED of the type takes, a function that computes the register value of
+ * each state from the type settings of the hardware description, and a
+ * function that returns the value of a state when an LED is written.
+ *
+ * Drivers are registered in a table and known by their index, the type
+ * id. A type name is looked up once, when the type of a subsystem is
+ * loaded; an LED keeps the type id and the values of its type, so that a
+ * write is a call through the table and no string is compared.
+ *
+ * States are indexed as enum ovsrec_led_state_e (ops-ledd checks it at
+ * build time). This module does not depend on OVS so that it can be
+ * tested alone.
+ ***************************************************************************/
+
+#ifndef _LEDD_TYPES_H_
+#define _LEDD_TYPES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* **************** DEFINES ************* */
+
+#define LEDD_TYPE_N_STATES      3     /*!< LED states */
+#define LEDD_TYPE_MAX           32    /*!< Max registered drivers */
+
+#define LEDD_TYPE_STATE_BIT(state) (1u << (state)) /*!< Bit of a state in
+                                                       a state set */
+
+/* **************** TYPEDEFS  ************* */
+
+/************************************************************************//**
+ * ENUM for the LED states, in the order of enum ovsrec_led_state_e.
+ ***************************************************************************/
+enum ledd_type_state {
+    LEDD_TYPE_FLASHING,                 /*!< "flashing" */
+    LEDD_TYPE_OFF,                      /*!< "off" */
+    LEDD_TYPE_ON                        /*!< "on" */
+};
+
+/************************************************************************//**
+ * STRUCT for an LED type driver.
+ ***************************************************************************/
+struct ledd_type_driver {
+    const char *name;                   /*!< Type name in led.yaml */
+    unsigned int states;                /*!< Set of the states taken
+                                             (LEDD_TYPE_STATE_BIT) */
+    int (*compute)(const struct ledd_type_driver *driver,
+                   const uint32_t settings[LEDD_TYPE_N_STATES],
+                   uint32_t values[LEDD_TYPE_N_STATES]);
+                                        /*!< Computes the value of each
+                                             state from the settings,
+                                             returns 0 or an errno value */
+    bool (*value)(const struct ledd_type_driver *driver,
+                  const uint32_t values[LEDD_TYPE_N_STATES],
+                  unsigned int state, uint32_t *valuep);
+                                        /*!< Value of a state, false if
+                                             the type does not take it */
+};
+
+/* **************** GLOBALS ************* */
+
+extern const struct ledd_type_driver *ledd_type_drivers[LEDD_TYPE_MAX];
+extern unsigned int ledd_n_type_drivers;
+
+/* **************** FUNCTIONS ************* */
+
+int ledd_type_register(const struct ledd_type_driver *driver);
+int ledd_type_find(const char *name);
+int ledd_type_compute(unsigned int type_id,
+                      const uint32_t settings[LEDD_TYPE_N_STATES],
+                      uint32_t values[LEDD_TYPE_N_STATES]);
+
+/* the generic functions of a driver, for drivers registered elsewhere */
+int ledd_type_compute_settings(const struct ledd_type_driver *driver,
+                               const uint32_t settings[LEDD_TYPE_N_STATES],
+                               uint32_t values[LEDD_TYPE_N_STATES]);
+bool ledd_type_value_table(const struct ledd_type_driver *driver,
+                           const uint32_t values[LEDD_TYPE_N_STATES],
+                           unsigned int state, uint32_t *valuep);
+
+/* True if LEDs of type type_id take the state */
+static inline bool
+ledd_type_takes(unsigned int type_id, unsigned int state)
+{
+    return(state < LEDD_TYPE_N_STATES &&
+           (ledd_type_drivers[type_id]->states &
+            LEDD_TYPE_STATE_BIT(state)) != 0);
+}
+
+/* Register value of a state for an LED of type type_id, false if the type
+   does not take the state */
+static inline bool
+ledd_type_value(unsigned int type_id,
+                const uint32_t values[LEDD_TYPE_N_STATES], unsigned int state,
+                uint32_t *valuep)
+{
+    const struct ledd_type_driver *driver = ledd_type_drivers[type_id];
+
+    return(driver->value(driver, values, state, valuep));
+}
+
+#endif /* _LEDD_TYPES_H_ */
@@ -31,6 +31,8 @@ TOPOLOGY = """
 def init_led_table(sw1):
     # Add dummy data for LED in subsystem and led table for simulation.
     # Assume there would be only one entry in subsystem table
+    subsystem = None
+    uuid = None
     output = sw1('list subsystem', shell='vsctl')
     lines = output.split('\n')
     for line in lines:
@@ -41,6 +43,9 @@ def init_led_table(sw1):
                 ' leds=@led1 -- --id=@led1 create led '
                 ' id=base1 state=flashing status=ok'.format(uuid),
                 shell='bash')
+        elif line.startswith('name'):
+            subsystem = line.split(':')[1].strip().strip('"')
+    return subsystem, uuid
 
 
 def led_on(sw1):
@@ -78,6 +83,60 @@ def show_led(sw1):
     assert led_config_present is True
 
 
+def led_summary_counts(sw1):
+    # Map each row of the summary (subsystem or Total) to its counts, by
+    # column name
+    output = sw1('show system led summary')
+    lines = output.split('\n')
+    assert 'Subsystem' in lines[0]
+    columns = lines[0].split()[1:]
+    rows = {}
+    for line in lines[2:]:
+        fields = line.split()
+        if len(fields) == len(columns) + 1:
+            rows[fields[0]] = dict(zip(columns, map(int, fields[1:])))
+    assert 'Total' in rows
+    return rows
+
+
+def show_led_summary(sw1, subsystem, uuid):
+    # base1 is the only LED, and led_on() set it on; its status is ok
+    expected = {'Total': 1, 'flashing': 0, 'off': 0, 'on': 1,
+                'fault': 0, 'ok': 1, 'uninitialized': 0}
+    rows = led_summary_counts(sw1)
+    assert rows[subsystem] == expected
+    assert rows['Total'] == expected
+
+    # counts published by ops-ledd in subsystem:other_info take precedence
+    # over the LED rows
+    published = {'Total': 6, 'flashing': 1, 'off': 2, 'on': 3,
+                 'fault': 1, 'ok': 4, 'uninitialized': 1}
+    keys = ['leds_total' if name == 'Total' else 'leds_' + name
+            for name in published]
+    sw1('ovs-vsctl set Subsystem {} {}'.format(
+        uuid, ' '.join('other_info:{}={}'.format(key, published[name])
+                       for key, name in zip(keys, published))),
+        shell='bash')
+    rows = led_summary_counts(sw1)
+    assert rows[subsystem] == published
+    assert rows['Total'] == published
+    sw1('ovs-vsctl remove Subsystem {} other_info {}'.format(
+        uuid, ' '.join(keys)), shell='bash')
+
+
+def show_led_subsystem(sw1, subsystem):
+    led_present = False
+    output = sw1('show system led subsystem {}'.format(subsystem))
+    lines = output.split('\n')
+    for line in lines:
+        if 'base1' in line:
+            led_present = True
+            break
+    assert led_present is True
+    output = sw1('show system led subsystem no_such_subsystem')
+    assert 'Cannot find subsystem' in output
+
+
 def led_off(sw1):
     led_state_off = False
     output = sw1('configure terminal')
@@ -110,13 +169,19 @@ def running_config_led(sw1):
 def test_led_ct_led(topology, step):
     # Initialize the led table with dummy value
     sw1 = topology.get("sw1")
-    init_led_table(sw1)
+    subsystem, uuid = init_led_table(sw1)
     # led <led name> on|off|flashing test.
     step('Test to verify \'led\' command')
     led_on(sw1)
     # show system led test.
     step('Test to verify \'show system led\' command')
     show_led(sw1)
+    # show system led summary test.
+    step('Test to verify \'show system led summary\' command')
+    show_led_summary(sw1, subsystem, uuid)
+    # show system led subsystem <name> test.
+    step('Test to verify \'show system led subsystem\' command')
+    show_led_subsystem(sw1, subsystem)
     # no led <led name> test
     step('Test to verify \'no led\' command')
     led_off(sw1)
@@ -30,6 +30,8 @@
 #include "vswitch-idl.h"
 #include "ovsdb-idl.h"
 #include "smap.h"
+#include "util.h"
+#include "dynamic-string.h"
 #include "memory.h"
 #include "openvswitch/vlog.h"
 #include "openswitch-idl.h"
@@ -47,6 +49,15 @@ const char *led_state_strings[] = {
     OVSREC_LED_STATE_ON                 /*!< LED state "on" */
 };
 
+const char *led_status_strings[] = {
+    OVSREC_LED_STATUS_FAULT,            /*!< LED status "fault" */
+    OVSREC_LED_STATUS_OK,               /*!< LED status "ok" */
+    OVSREC_LED_STATUS_UNINITIALIZED     /*!< LED status "uninitialized" */
+};
+
+#define N_LED_STATES   (sizeof(led_state_strings) / sizeof(const char *))
+#define N_LED_STATUSES (sizeof(led_status_strings) / sizeof(const char *))
+
 /*
  * Function    : lookup_led
  * Resposibility  : Lookup for led using name
@@ -68,6 +79,51 @@ lookup_led (const char *name)
     return (NULL);
 }
 
+/*
+ * Function        : compare_led_id
+ * Resposibility      : qsort helper, orders led rows by id
+ */
+static int
+compare_led_id (const void *a_, const void *b_)
+{
+    const struct ovsrec_led *const *a = a_;
+    const struct ovsrec_led *const *b = b_;
+
+    return strcmp((*a)->id, (*b)->id);
+}
+
+/*
+ * Function        : print_leds
+ * Resposibility      : Print led rows sorted by id, in one vty_out
+ * Parameters
+ *  pLeds: Array of led rows (sorted in place)
+ *  nLeds: Number of led rows
+ */
+static void
+print_leds (const struct ovsrec_led **pLeds, size_t nLeds)
+{
+    struct ds out = DS_EMPTY_INITIALIZER;
+    size_t i;
+
+    qsort(pLeds, nLeds, sizeof *pLeds, compare_led_id);
+
+    ds_put_format(&out, "%-15s%-10s%-10s%s", "Name", "State", "Status",
+                  VTY_NEWLINE);
+    ds_put_format(&out, "%s%s", "-----------------------------------",
+                  VTY_NEWLINE);
+
+    for (i = 0; i < nLeds; i++)
+    {
+        ds_put_format(&out, "%-15s%-10s%-10s%s", pLeds[i]->id,
+                      pLeds[i]->state ? pLeds[i]->state : "",
+                      pLeds[i]->status ? pLeds[i]->status : "",
+                      VTY_NEWLINE);
+    }
+
+    vty_out(vty, "%s", ds_cstr(&out));
+    ds_destroy(&out);
+}
+
 /*
  * Function        : cli_system_get_led
  * Resposibility      : Get system led information from idl
@@ -78,26 +134,166 @@ int
 cli_system_get_led ()
 {
     const struct ovsrec_led* pLed = NULL;
+    const struct ovsrec_led** pLeds = NULL;
+    size_t nLeds = 0;
+    size_t allocated = 0;
+
+    OVSREC_LED_FOR_EACH (pLed,idl)
+    {
+        if (nLeds >= allocated)
+        {
+            pLeds = x2nrealloc(pLeds, &allocated, sizeof *pLeds);
+        }
+        pLeds[nLeds++] = pLed;
+    }
+
+    print_leds(pLeds, nLeds);
+    free(pLeds);
+
+    return CMD_SUCCESS;
+}
+
+/*
+ * Function        : cli_system_get_led_subsystem
+ * Resposibility      : Get led information of one subsystem from idl
+ * Parameters
+ *  sSubsysName: Pointer to subsystem name string
+ * Return      : 0 on success 1 otherwise
+ */
+
+int
+cli_system_get_led_subsystem (const char* sSubsysName)
+{
     const struct ovsrec_subsystem* pSys = NULL;
+    const struct ovsrec_led** pLeds = NULL;
 
-    pSys = ovsrec_subsystem_first (idl);
+    OVSREC_SUBSYSTEM_FOR_EACH (pSys,idl)
+    {
+        if (strcmp(pSys->name, sSubsysName) == 0)
+        {
+            break;
+        }
+    }
 
-    vty_out(vty,"%-15s%-10s%-10s%s","Name","State","Status",VTY_NEWLINE);
-	vty_out(vty,"%s%s","-----------------------------------",VTY_NEWLINE);
+    if (pSys == NULL)
+    {
+        vty_out(vty,"Cannot find subsystem%s",VTY_NEWLINE);
+        return CMD_SUCCESS;
+    }
+
+    pLeds = xmemdup(pSys->leds, pSys->n_leds * sizeof *pLeds);
+    print_leds(pLeds, pSys->n_leds);
+    free(pLeds);
 
-    if (pSys->n_leds)
+    return CMD_SUCCESS;
+}
+
+/*
+ * Function        : cli_system_get_led_summary
+ * Resposibility      : Print per-subsystem led counts by state and status.
+ *                   ops-ledd keeps these counts in subsystem:other_info
+ *                   (leds_<state>, leds_<status>, leds_total), so the led
+ *                   rows are only walked for a subsystem without them.
+ * Return      : 0 on success 1 otherwise
+ */
+
+int
+cli_system_get_led_summary ()
+{
+    const struct ovsrec_subsystem* pSys = NULL;
+    struct ds out = DS_EMPTY_INITIALIZER;
+    int total[1 + N_LED_STATES + N_LED_STATUSES] = { 0 };
+    int count[1 + N_LED_STATES + N_LED_STATUSES];
+    size_t i, j;
+
+    ds_put_format(&out, "%-15s%-7s", "Subsystem", "Total");
+    for (i = 0; i < N_LED_STATES; i++)
     {
-        OVSREC_LED_FOR_EACH (pLed,idl)
+        ds_put_format(&out, "%-10s", led_state_strings[i]);
+    }
+    for (i = 0; i < N_LED_STATUSES; i++)
+    {
+        ds_put_format(&out, "%-15s", led_status_strings[i]);
+    }
+    ds_put_format(&out, "%s%s%s", VTY_NEWLINE,
+                  "------------------------------------------------------"
+                  "-----------------------------------", VTY_NEWLINE);
+
+    OVSREC_SUBSYSTEM_FOR_EACH (pSys,idl)
+    {
+        memset(count, 0, sizeof count);
+
+        if (smap_get(&pSys->other_info, "leds_total"))
+        {
+            char key[32];
+
+            count[0] = smap_get_int(&pSys->other_info, "leds_total", 0);
+            for (i = 0; i < N_LED_STATES; i++)
+            {
+                snprintf(key, sizeof key, "leds_%s", led_state_strings[i]);
+                count[1 + i] = smap_get_int(&pSys->other_info, key, 0);
+            }
+            for (i = 0; i < N_LED_STATUSES; i++)
+            {
+                snprintf(key, sizeof key, "leds_%s", led_status_strings[i]);
+                count[1 + N_LED_STATES + i] =
+                    smap_get_int(&pSys->other_info, key, 0);
+            }
+        }
+        else
         {
-            if (pLed)
+            for (j = 0; j < pSys->n_leds; j++)
             {
-                vty_out(vty,"%-15s",pLed->id);
-                vty_out(vty,"%-10s",pLed->state);
-                vty_out(vty,"%-10s",pLed->status);
+                const struct ovsrec_led* pLed = pSys->leds[j];
+
+                count[0]++;
+                for (i = 0; i < N_LED_STATES; i++)
+                {
+                    if (pLed->state &&
+                        strcmp(pLed->state, led_state_strings[i]) == 0)
+                    {
+                        count[1 + i]++;
+                    }
+                }
+                for (i = 0; i < N_LED_STATUSES; i++)
+                {
+                    if (pLed->status &&
+                        strcmp(pLed->status, led_status_strings[i]) == 0)
+                    {
+                        count[1 + N_LED_STATES + i]++;
+                    }
+                }
             }
-            vty_out(vty,"%s",VTY_NEWLINE);
         }
+
+        if (count[0] == 0)
+        {
+            continue;
+        }
+
+        ds_put_format(&out, "%-15s%-7d", pSys->name, count[0]);
+        for (i = 1; i < ARRAY_SIZE(count); i++)
+        {
+            ds_put_format(&out, i <= N_LED_STATES ? "%-10d" : "%-15d",
+                          count[i]);
+        }
+        ds_put_cstr(&out, VTY_NEWLINE);
+
+        for (i = 0; i < ARRAY_SIZE(count); i++)
+        {
+            total[i] += count[i];
+        }
+    }
+
+    ds_put_format(&out, "%-15s%-7d", "Total", total[0]);
+    for (i = 1; i < ARRAY_SIZE(total); i++)
+    {
+        ds_put_format(&out, i <= N_LED_STATES ? "%-10d" : "%-15d", total[i]);
     }
+    ds_put_cstr(&out, VTY_NEWLINE);
+
+    vty_out(vty, "%s", ds_cstr(&out));
+    ds_destroy(&out);
 
     return CMD_SUCCESS;
 }
@@ -215,6 +411,29 @@ DEFUN (cli_platform_show_led,
     return cli_system_get_led();
 }
 
+DEFUN (cli_platform_show_led_summary,
+        cli_platform_show_led_summary_cmd,
+        "show system led summary",
+        SHOW_STR
+        SYS_STR
+        LED_STR
+        "Number of LEDs in each state and status, per subsystem\n")
+{
+    return cli_system_get_led_summary();
+}
+
+DEFUN (cli_platform_show_led_subsystem,
+        cli_platform_show_led_subsystem_cmd,
+        "show system led subsystem WORD",
+        SHOW_STR
+        SYS_STR
+        LED_STR
+        "Show the LEDs of one subsystem\n"
+        "Name of subsystem e.g. <base>\n")
+{
+    return cli_system_get_led_subsystem(argv[0]);
+}
+
 DEFUN (cli_platform_set_led,
         cli_platform_set_led_cmd,
         "led WORD (on|off|flashing)",
@@ -257,6 +476,10 @@ void cli_post_init(void)
 
     install_element (ENABLE_NODE, &cli_platform_show_led_cmd);
     install_element (VIEW_NODE, &cli_platform_show_led_cmd);
+    install_element (ENABLE_NODE, &cli_platform_show_led_summary_cmd);
+    install_element (VIEW_NODE, &cli_platform_show_led_summary_cmd);
+    install_element (ENABLE_NODE, &cli_platform_show_led_subsystem_cmd);
+    install_element (VIEW_NODE, &cli_platform_show_led_subsystem_cmd);
     install_element (CONFIG_NODE, &cli_platform_set_led_cmd);
     install_element (CONFIG_NODE, &no_cli_platform_set_led_cmd);
 
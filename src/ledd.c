@@ -26,11 +26,15 @@
 
 #define _GNU_SOURCE
 #include <errno.h>
+#include <fnmatch.h>
 #include <getopt.h>
 #include <limits.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <dynamic-string.h>
 
 #include "config.h"
@@ -40,15 +44,22 @@
 #include "dirs.h"
 #include "dummy.h"
 #include "fatal-signal.h"
+#include "hash.h"
+#include "json.h"
+#include "memory.h"
+#include "ovsdb-data.h"
 #include "ovsdb-idl.h"
 #include "poll-loop.h"
 #include "simap.h"
+#include "smap.h"
+#include "sset.h"
 #include "stream-ssl.h"
 #include "stream.h"
 #include "svec.h"
 #include "timeval.h"
 #include "unixctl.h"
 #include "util.h"
+#include "uuid.h"
 #include "openvswitch/vconn.h"
 #include "openvswitch/vlog.h"
 #include "vswitch-idl.h"
@@ -57,6 +68,12 @@
 #include "config-yaml.h"
 
 #include "ledd.h"
+#include "ledd_buslock.h"
+#include "ledd_changes.h"
+#include "ledd_shm.h"
+#include "ledd_sysfs.h"
+#include "ledd_tables.h"
+#include "ledd_trace.h"
 #include "eventlog.h"
 
 /* ********* GLOBALS **************** */
@@ -69,43 +86,634 @@ YamlConfigHandle yaml_handle;
 /* define a shash (string hash) to hold the subsystems (by name) */
 struct shash subsystem_data;
 
+/* define a shash to hold all of the locl_led structs (by LED id) */
+struct shash led_data;
+
 static struct ovsdb_idl *idl;
 
 static unsigned int idl_seqno;
 
 static unixctl_cb_func ledd_unixctl_dump;
+static unixctl_cb_func ledd_unixctl_stats;
+static unixctl_cb_func ledd_unixctl_profile;
+static unixctl_cb_func ledd_unixctl_stall_threshold;
+static unixctl_cb_func ledd_unixctl_hw_sim_fail;
+static unixctl_cb_func ledd_unixctl_request;
+static unixctl_cb_func ledd_unixctl_release;
+static unixctl_cb_func ledd_unixctl_requests;
+static unixctl_cb_func ledd_unixctl_breakers;
+static unixctl_cb_func ledd_unixctl_memory;
+static unixctl_cb_func ledd_unixctl_record;
+static unixctl_cb_func ledd_unixctl_set;
+static unixctl_cb_func ledd_unixctl_set_many;
+
+static void ledd_led_free_requests(struct locl_led *led);
+static void ledd_led_detach_breakers(struct locl_led *led);
+static void ledd_sched_cancel(struct locl_led *led);
+static void ledd_sched_compact(void);
+static bool ledd_subsys_activate(struct locl_subsystem *subsys);
 
 static bool cur_hw_set = false; /*!< True if have updated cur_hw_set in db */
 
+static bool resync_pending = false; /*!< True if db must be resynchronized */
+
+/* With --record (or ops-ledd/record), what ops-ledd observes and does is
+   recorded in a trace for ops-ledd-replay. */
+static struct ledd_trace trace;
+static bool trace_enabled = false;
+static long long int trace_next_flush; /*!< time_msec() of the next flush */
+static const char *record_path = NULL; /*!< --record file */
+
+static bool lazy_activation = false; /*!< True to defer the setup of a
+                                          subsystem until an LED is on */
+
+/* the static LED tables generated at build time (see ledd_tables.h) are
+   used unless --no-static-tables */
+static bool static_tables_enabled = true;
+
+/* the fault-LED rules of --rules; they are counted again from all rows
+   at the start and after a reconnect */
+static const char *rules_path = NULL;
+static struct ledd_rules rules;
+static bool rules_resync = true;
+
+BUILD_ASSERT_DECL(LEDD_TABLES_N_STATES == LEDD_N_LED_STATES);
+BUILD_ASSERT_DECL(LEDD_TYPE_N_STATES == LEDD_N_LED_STATES);
+BUILD_ASSERT_DECL((int) LEDD_TYPE_FLASHING == (int) LED_STATE_FLASHING);
+BUILD_ASSERT_DECL((int) LEDD_TYPE_OFF == (int) LED_STATE_OFF);
+BUILD_ASSERT_DECL((int) LEDD_TYPE_ON == (int) LED_STATE_ON);
+
+/* With --shard, several instances run at once, each one owning the
+   subsystems listed by --shard-subsystems, under its own lock. */
+static char *shard_name = NULL;     /*!< Name of the shard, NULL if none */
+static struct sset shard_subsystems = SSET_INITIALIZER(&shard_subsystems);
+/* all the shards, from --shards, own one included */
+static struct sset shard_peers = SSET_INITIALIZER(&shard_peers);
+static const char *daemon_name = NAME_IN_DAEMON_TABLE; /*!< Daemon row to set */
+
+/* A reconfigure pass runs in slices of at most reconfigure_budget_ms, the
+   rest of the pass resumes on the next main loop iteration. */
+static long long int reconfigure_budget_ms = LEDD_RECONFIGURE_BUDGET_DEFAULT;
+static long long int slice_deadline; /*!< time_usec() end of the slice */
+static bool pass_active = false;    /*!< True if a pass is unfinished */
+static unsigned int pass_seqno;     /*!< IDL seqno when the pass started */
+static bool pass_resync = false;    /*!< True if the pass is a resync */
+static long long int pass_resync_start; /*!< time_usec() of resync start */
+static struct sset pass_done = SSET_INITIALIZER(&pass_done); /*!< Subsystems
+                                            finished in the current pass */
+
+static struct ledd_stats ledd_stats; /*!< Counters for ops-ledd/stats */
+
+static struct ledd_profile ledd_profile; /*!< Main loop profile */
+
+static bool summary_dirty = false; /*!< True if a LED summary changed */
+static bool status_dirty = false; /*!< True if a LED status must be pushed */
+static bool state_dirty = false; /*!< True if a LED state set by
+                                      ops-ledd/set must be written back */
+
+/* write-back of ledd_push_statuses(), committed without blocking across
+   main loop iterations; the IDL has a single transaction at a time, so
+   the passes that write to the db wait until it completes */
+static struct ovsdb_idl_txn *status_txn = NULL;
+static long long int status_txn_start; /*!< time_usec() of its start */
+
+/* publish of ledd_publish_summaries(), committed the same way; it never
+   runs at the same time as status_txn */
+static struct ovsdb_idl_txn *summary_txn = NULL;
+static long long int summary_txn_start; /*!< time_usec() of its start */
+
+/* LEDs with a timed ops-ledd/set request, by LED id */
+static struct shash timed_sets = SHASH_INITIALIZER(&timed_sets);
+static long long int summary_next_publish = 0; /*!< Earliest next publish */
+
+BUILD_ASSERT_DECL(ARRAY_SIZE(led_state_strings) == LEDD_N_LED_STATES);
+BUILD_ASSERT_DECL(ARRAY_SIZE(led_status_strings) == LEDD_N_LED_STATUSES);
+
+/* register access backends */
+static int ledd_i2c_reg_read(const char *, const i2c_bit_op *, uint32_t *);
+static int ledd_i2c_reg_write(const char *, const i2c_bit_op *, uint32_t);
+static int ledd_sim_reg_read(const char *, const i2c_bit_op *, uint32_t *);
+static int ledd_sim_reg_write(const char *, const i2c_bit_op *, uint32_t);
+static int ledd_proxy_reg_read(const char *, const i2c_bit_op *, uint32_t *);
+static int ledd_proxy_reg_write(const char *, const i2c_bit_op *, uint32_t);
+
+static const struct ledd_hw_backend ledd_i2c_backend = {
+    "i2c", ledd_i2c_reg_read, ledd_i2c_reg_write
+};
+
+static const struct ledd_hw_backend ledd_sim_backend = {
+    "sim", ledd_sim_reg_read, ledd_sim_reg_write
+};
+
+static const struct ledd_hw_backend ledd_proxy_backend = {
+    "proxy", ledd_proxy_reg_read, ledd_proxy_reg_write
+};
+
+static const struct ledd_hw_backend *hw_backend = &ledd_i2c_backend;
+
+/* register access proxy (--hw-proxy), see ledd_proxy.h: the LED writes
+   are staged and committed with the batch, see ledd_hw_commit() */
+static const char *hw_proxy_path = NULL;
+static struct ledd_proxy_client hw_proxy;
+static int hw_proxy_sync_error; /*!< Result of ledd_proxy_reg_write() */
+
+/* simulated hardware: registers by "subsystem/device@address", failing
+   devices by "subsystem/device" and the delay of each access */
+static struct shash hw_sim_regs = SHASH_INITIALIZER(&hw_sim_regs);
+static struct sset hw_sim_fail = SSET_INITIALIZER(&hw_sim_fail);
+static unsigned int hw_sim_delay_us;
+
+/* LED write scheduler, one queue per class */
+static struct ledd_write_queue write_queues[LEDD_N_WRITE_CLASSES];
+
+BUILD_ASSERT_DECL(ARRAY_SIZE(ledd_write_class_strings) ==
+                  LEDD_N_WRITE_CLASSES);
+
+/* circuit breakers by name, see struct ledd_breaker */
+static struct shash breakers = SHASH_INITIALIZER(&breakers);
+static unsigned int breaker_threshold = LEDD_BREAKER_THRESHOLD_DEFAULT;
+static long long int breaker_retry_ms = LEDD_BREAKER_RETRY_DEFAULT;
+static bool breaker_probe_pending = false; /*!< True if a breaker is open */
+
+/* platform buses by name, see struct ledd_bus; the locks are taken
+   unless --no-bus-lock (or --hw-sim without --bus-lock-dir) */
+static struct shash buses = SHASH_INITIALIZER(&buses);
+static const char *bus_lock_dir = NULL;
+static bool bus_lock_enabled = true;
+
+/* hardware errors are only logged at this rate, breakers summarize them */
+static struct vlog_rate_limit hw_rl = VLOG_RATE_LIMIT_INIT(5, 20);
+
+/* LED-class (sysfs) LEDs, see ledd_sysfs.h: their writes are staged in
+   led_class_batch and committed at the end of each scheduler run */
+static const char *led_class_root = LEDD_SYSFS_DEFAULT_ROOT;
+static struct ledd_sysfs_batch led_class_batch;
+
+/* PWM-dimmable LEDs whose brightness is ramping, by LED id: they are
+   advanced together on the shared tick, see ledd_ramp_run() */
+static struct shash ramps = SHASH_INITIALIZER(&ramps);
+static long long int ramp_next_tick = 0; /*!< time_msec() of the next tick */
+
+/* ring of the last LED changes, and the clients of the change stream
+   (--subscribe-socket), see ledd_changes.h */
+static struct ledd_changes changes;
+static const char *subscribe_path = NULL;
+static struct pstream *subscribe_listener = NULL;
+static struct ledd_subscriber *subscribers[LEDD_SUBSCRIBERS_MAX];
+static size_t n_subscribers;
+
+/* shared-memory LED state table, see ledd_shm.h */
+static const char *led_table_path = LEDD_SHM_DEFAULT_PATH;
+static struct ledd_shm led_table;
+static bool led_table_enabled = false;
+
 /*  ********* UTILITIES **************** */
 
-YamlLedTypeValue
-ledd_led_type_string_to_enum(char *type_string)
+/* free the dimming settings of an LED, see ledd_load_led_dim() */
+static void
+ledd_led_dim_free(struct ledd_led_dim *dim)
+{
+    size_t i;
+
+    for (i = 0; i < dim->n_colors; i++) {
+        free(dim->colors[i]);
+    }
+    free(dim->colors);
+    free(dim->color_values);
+    free(dim);
+} /* ledd_led_dim_free() */
+
+/* the LED of a subsystem at index idx of its LED file (or static table) */
+static const YamlLed *
+ledd_subsys_led(const struct locl_subsystem *subsys, int idx)
 {
-    if (strcmp(type_string, "loc") == 0) {
-        return (LED_LOC);
+    if (subsys->tables) {
+        return(&subsys->tables->leds[idx]);
     }
 
-    return (LED_UNKNOWN);
-} /* ledd_led_type_string_to_enum() */
+    return(yaml_get_led(yaml_handle, subsys->name, idx));
+} /* ledd_subsys_led() */
 
-YamlLedType *
-ledd_get_led_type(struct locl_subsystem *subsys, char *value)
+static int
+ledd_static_device_cmp(const void *key, const void *device_)
 {
-    struct shash_node *node;
-    YamlLedType *type;
+    const struct ledd_static_device *device = device_;
+
+    return(strcmp(key, device->name));
+} /* ledd_static_device_cmp() */
+
+/* the bus of a device of a subsystem, NULL if it is not known */
+static const char *
+ledd_device_bus(const struct locl_subsystem *subsys, const char *name)
+{
+    if (subsys->tables) {
+        const struct ledd_static_device *device;
+
+        device = bsearch(name, subsys->tables->devices,
+                         subsys->tables->n_devices, sizeof *device,
+                         ledd_static_device_cmp);
+        return(device ? device->bus : NULL);
+    } else {
+        const YamlDevice *device;
+
+        device = yaml_find_device(yaml_handle, subsys->name, name);
+        return(device ? device->bus : NULL);
+    }
+} /* ledd_device_bus() */
+
+/************************************************************************//**
+ * Function that computes the digest of the hardware description files of
+ * a subsystem, as tools/ledd_gen_tables.py does: FNV-1a (32 bits) of the
+ * contents of the devices file followed by the LED file. A missing file
+ * adds nothing.
+ *
+ * Returns: the digest
+ ***************************************************************************/
+static uint32_t
+ledd_hw_desc_digest(const char *dir)
+{
+    static const char *files[] = { "devices.yaml", "led.yaml" };
+    uint32_t digest = 0x811c9dc5;
+    uint8_t buf[4096];
+    size_t i, j, n;
+
+    for (i = 0; i < ARRAY_SIZE(files); i++) {
+        char *path = xasprintf("%s/%s", dir, files[i]);
+        FILE *file = fopen(path, "r");
+
+        free(path);
+        if (file == NULL) {
+            continue;
+        }
+        while ((n = fread(buf, 1, sizeof buf, file)) > 0) {
+            for (j = 0; j < n; j++) {
+                digest = (digest ^ buf[j]) * 0x01000193;
+            }
+        }
+        fclose(file);
+    }
+
+    return(digest);
+} /* ledd_hw_desc_digest() */
+
+/************************************************************************//**
+ * Function that finds the static table of a subsystem: a table generated
+ * for the same subsystem name and hw_desc_dir, from files that have not
+ * changed since (their digest matches).
+ *
+ * Returns: the table, or NULL if the files must be parsed
+ ***************************************************************************/
+static const struct ledd_static_subsys *
+ledd_static_tables_find(const char *name, const char *dir)
+{
+    size_t i;
+
+    if (!static_tables_enabled) {
+        return(NULL);
+    }
+
+    for (i = 0; i < ledd_n_static_tables; i++) {
+        const struct ledd_static_subsys *tables = &ledd_static_tables[i];
+
+        if (strcmp(tables->name, name) || strcmp(tables->hw_desc_dir, dir)) {
+            continue;
+        }
+        if (ledd_hw_desc_digest(dir) != tables->digest) {
+            VLOG_WARN("subsystem %s: the files in %s changed since the "
+                      "build, parsing them", name, dir);
+            ledd_stats.static_mismatches++;
+            return(NULL);
+        }
+        return(tables);
+    }
+
+    return(NULL);
+} /* ledd_static_tables_find() */
+
+/************************************************************************//**
+ * Function that adds an LED type to a subsystem, if a driver of that name
+ * is registered (see ledd_types.h), with the register value of each LED
+ * state computed by the driver from the settings: "settings" comes from a
+ * static table, or is NULL to take the settings of the type. LEDs look up
+ * their type once, when they are added, so that writes do not look it up.
+ ***************************************************************************/
+static void
+ledd_subsys_add_type(struct locl_subsystem *lsubsys,
+                     const YamlLedType *new_type, const uint32_t *settings,
+                     const char *dir)
+{
+    uint32_t yaml_settings[LEDD_N_LED_STATES];
+    struct ledd_led_type *type;
+    int type_id;
+    int error;
+
+    /* See if this is a type we know about. */
+    type_id = ledd_type_find(new_type->type);
+    if (type_id < 0 || shash_find(&lsubsys->type_values, new_type->type)) {
+        VLOG_DBG("unknown type %s specified in %s", new_type->type, dir);
+        return;
+    }
+
+    if (settings == NULL) {
+        yaml_settings[LED_STATE_OFF] = new_type->settings.off;
+        yaml_settings[LED_STATE_ON] = new_type->settings.on;
+        yaml_settings[LED_STATE_FLASHING] = new_type->settings.flashing;
+        settings = yaml_settings;
+    }
+
+    type = xmalloc(sizeof *type);
+    type->type_id = type_id;
+    error = ledd_type_compute(type_id, settings, type->values);
+    if (error) {
+        VLOG_WARN("LED type %s in %s: invalid settings (%s)",
+                  new_type->type, dir, ovs_strerror(error));
+        free(type);
+        return;
+    }
+
+    shash_add(&lsubsys->subsystem_types, new_type->type, (void *) new_type);
+    shash_add(&lsubsys->type_values, new_type->type, type);
+} /* ledd_subsys_add_type() */
+
+/************************************************************************//**
+ * Function that parses the devices file of a subsystem. With a static
+ * table, the breakers find the buses in the table, and the devices are
+ * only parsed for the i2c backend (config-yaml resolves the devices of
+ * the register accesses).
+ *
+ * Returns: 0 on success, else the config-yaml error
+ ***************************************************************************/
+static int
+ledd_subsys_parse_devices(struct locl_subsystem *subsys)
+{
+    int rc;
+
+    if (subsys->tables) {
+        if (hw_backend != &ledd_i2c_backend) {
+            return(0);
+        }
+        rc = yaml_add_subsystem(yaml_handle, subsys->name,
+                                subsys->tables->hw_desc_dir);
+        if (rc != 0) {
+            return(rc);
+        }
+    }
+
+    return(yaml_parse_devices(yaml_handle, subsys->name));
+} /* ledd_subsys_parse_devices() */
+
+/* hash of the values of an LED that are mirrored in the db */
+static uint32_t
+ledd_led_digest(const char *name, enum ovsrec_led_state_e state,
+                enum ovsrec_led_status_e status)
+{
+    return(hash_int(((uint32_t) state << 8) | (uint32_t) status,
+                    hash_string(name, 0)));
+} /* ledd_led_digest() */
+
+/************************************************************************//**
+ * Function that publishes an LED in the shared-memory LED state table,
+ * reserving a slot (and growing the table) the first time.
+ ***************************************************************************/
+static void
+ledd_publish_led(struct locl_led *led)
+{
+    if (!led_table_enabled) {
+        return;
+    }
+
+    if (led->shm_slot < 0) {
+        led->shm_slot = ledd_shm_alloc(&led_table);
+        if (led->shm_slot < 0) {
+            int error = ledd_shm_grow(&led_table, 2 * led_table.capacity);
+
+            if (error) {
+                VLOG_WARN("unable to grow LED table %s (%s)",
+                          led_table_path, ovs_strerror(error));
+                return;
+            }
+            led->shm_slot = ledd_shm_alloc(&led_table);
+        }
+    }
+
+    ledd_shm_set(&led_table, led->shm_slot, led->name,
+                 led_state_strings[led->effective_state],
+                 led->hw_valid ? led_state_strings[led->hw_state] : "unknown",
+                 led_status_strings[led->status], led->last_change);
+} /* ledd_publish_led() */
+
+/************************************************************************//**
+ * Function that moves an LED to its current (effective) state and status
+ * in the per-subsystem LED summary counts, and adds the change to the
+ * change ring.
+ ***************************************************************************/
+static void
+ledd_led_count(struct locl_led *led)
+{
+    struct locl_subsystem *subsys = led->subsystem;
+
+    if (led->counted) {
+        if (led->counted_state == led->effective_state &&
+            led->counted_status == led->status) {
+            return;
+        }
+        subsys->state_count[led->counted_state]--;
+        subsys->status_count[led->counted_status]--;
+    }
+
+    subsys->state_count[led->effective_state]++;
+    subsys->status_count[led->status]++;
+    led->counted_state = led->effective_state;
+    led->counted_status = led->status;
+    led->counted = true;
+
+    led->last_change = time_wall_msec();
+    ledd_changes_add(&changes, led->name,
+                     led_state_strings[led->effective_state],
+                     led_status_strings[led->status], led->last_change);
+    subsys->summary_dirty = true;
+    summary_dirty = true;
+} /* ledd_led_count() */
+
+/************************************************************************//**
+ * Function that refreshes the data derived from an LED's state and status
+ * after they may have changed: the digest, the summary counts, the last
+ * change time and the shared-memory LED table entry. The subsystem digest
+ * is the XOR of the digests of its LEDs, so it is updated incrementally.
+ ***************************************************************************/
+static void
+ledd_led_refresh(struct locl_led *led)
+{
+    struct locl_subsystem *subsys = led->subsystem;
+    uint32_t digest;
+
+    digest = ledd_led_digest(led->name, led->state, led->status);
+    if (digest != led->digest) {
+        subsys->digest ^= led->digest ^ digest;
+        led->digest = digest;
+        led->last_change = time_wall_msec();
+    }
+
+    /* the effective state may have changed even if the digest did not */
+    ledd_led_count(led);
+
+    ledd_publish_led(led);
+} /* ledd_led_refresh() */
+
+/* ************ TRACE ************ */
+
+/* record that a Subsystem row was added or removed */
+static void
+ledd_record_subsys(bool add, const char *name, const char *dir)
+{
+    if (trace_enabled) {
+        ledd_trace_subsys(&trace, time_usec(), add, name, dir);
+    }
+} /* ledd_record_subsys() */
+
+/* record an LED state read from the db */
+static void
+ledd_record_led_state(const char *id, const char *state)
+{
+    if (trace_enabled) {
+        ledd_trace_led_state(&trace, time_usec(), id, state);
+    }
+} /* ledd_record_led_state() */
+
+/* record in the trace a commit started at time_usec() "start" */
+static void
+ledd_record_commit(enum ovsdb_idl_txn_status status, long long int start)
+{
+    if (trace_enabled) {
+        long long int now = time_usec();
+
+        ledd_trace_commit(&trace, now, status, now - start);
+    }
+} /* ledd_record_commit() */
+
+/* ovsdb_idl_txn_commit_block(), recording the commit in the trace */
+static enum ovsdb_idl_txn_status
+ledd_commit_block(struct ovsdb_idl_txn *txn)
+{
+    long long int start = time_usec();
+    enum ovsdb_idl_txn_status status;
+
+    status = ovsdb_idl_txn_commit_block(txn);
+    ledd_record_commit(status, start);
+
+    return(status);
+} /* ledd_commit_block() */
+
+/* start recording in "path", after stopping the current trace */
+static int
+ledd_record_start(const char *path)
+{
+    int error;
+
+    if (trace_enabled) {
+        ledd_trace_close(&trace);
+        trace_enabled = false;
+    }
+
+    error = ledd_trace_create(&trace, path, time_usec(), time_wall_msec());
+    if (error) {
+        VLOG_WARN("unable to record in %s (%s)", path, ovs_strerror(error));
+        return(error);
+    }
+    trace_enabled = true;
+    trace_next_flush = time_msec() + LEDD_TRACE_FLUSH_MS;
+    VLOG_INFO("recording in %s", path);
+
+    return(0);
+} /* ledd_record_start() */
 
-    SHASH_FOR_EACH(node, &(subsys->subsystem_types)) {
-        type = (YamlLedType *)node->data;
+/* write the buffered records once in a while, and stop on an error */
+static void
+ledd_record_run(void)
+{
+    int error;
+
+    if (!trace_enabled || time_msec() < trace_next_flush) {
+        return;
+    }
+
+    trace_next_flush = time_msec() + LEDD_TRACE_FLUSH_MS;
+    error = ledd_trace_flush(&trace);
+    if (error) {
+        VLOG_ERR("recording stopped after %llu records (%s)",
+                 trace.records, ovs_strerror(error));
+        ledd_trace_close(&trace);
+        trace_enabled = false;
+    }
+} /* ledd_record_run() */
+
+/* ************ SHARDING ************ */
 
-        if (strcmp(type->type,value) == 0) {
-            return (type);
+/* true if this instance owns the subsystem */
+static bool
+ledd_shard_owns(const char *subsys)
+{
+    return(shard_name == NULL || sset_contains(&shard_subsystems, subsys));
+} /* ledd_shard_owns() */
+
+/************************************************************************//**
+ * Function that reports the end of the first full pass of a shard:
+ * cur_hw = 1 in the Daemon row of the shard, which is created if missing.
+ * The shared row daemon["ops-ledd"], that the platform waits on, is set
+ * once every shard of --shards has reported, by the shard that sees it
+ * last (each shard monitors the rows of the others).
+ *
+ * Returns: True if the transaction has changes
+ ***************************************************************************/
+static bool
+ledd_shard_report(struct ovsdb_idl_txn *txn)
+{
+    const struct ovsrec_daemon *ovs_daemon;
+    const struct ovsrec_daemon *shared = NULL;
+    const struct ovsrec_daemon *own = NULL;
+    size_t prefix_len = strlen(NAME_IN_DAEMON_TABLE);
+    size_t n_reported = 0;
+    bool changed = false;
+
+    OVSREC_DAEMON_FOR_EACH(ovs_daemon, idl) {
+        const char *name = ovs_daemon->name;
+
+        if (!strcmp(name, NAME_IN_DAEMON_TABLE)) {
+            shared = ovs_daemon;
+        } else if (!strcmp(name, daemon_name)) {
+            own = ovs_daemon;
+        } else if (!strncmp(name, NAME_IN_DAEMON_TABLE, prefix_len) &&
+                   name[prefix_len] == '-' &&
+                   sset_contains(&shard_peers, name + prefix_len + 1) &&
+                   ovs_daemon->cur_hw == 1) {
+            n_reported++;
         }
     }
 
-    return ((YamlLedType *) NULL);
+    if (!cur_hw_set) {
+        if (own == NULL) {
+            struct ovsrec_daemon *row = ovsrec_daemon_insert(txn);
+
+            ovsrec_daemon_set_name(row, daemon_name);
+            ovsrec_daemon_set_cur_hw(row, (int64_t) 1);
+        } else {
+            ovsrec_daemon_set_cur_hw(own, (int64_t) 1);
+        }
+        cur_hw_set = true;
+        changed = true;
+    }
+    n_reported++;
+
+    if (shared && shared->cur_hw != 1 &&
+        n_reported == sset_count(&shard_peers)) {
+        VLOG_INFO("all %"PRIuSIZE" shards reported, setting %s cur_hw",
+                  n_reported, NAME_IN_DAEMON_TABLE);
+        ovsrec_daemon_set_cur_hw(shared, (int64_t) 1);
+        changed = true;
+    }
 
-} /* ledd_get_led_type() */
+    return(changed);
+} /* ledd_shard_report() */
 
 /************************************************************************//**
  * Function that will remove the internal entry in the locl_subsystem hash
@@ -128,6 +736,7 @@ ledd_remove_unmarked_subsystems(void)
 
         if (subsystem->marked == false) {
             VLOG_DBG("removing subsystem %s", subsystem->name);
+            ledd_record_subsys(false, subsystem->name, NULL);
 
             /* delete all leds in the subsystem */
             SHASH_FOR_EACH_SAFE(led_node, led_next,
@@ -138,10 +747,38 @@ ledd_remove_unmarked_subsystems(void)
                 shash_delete(&subsystem->subsystem_leds, led_node);
 
                 /* free the allocated data */
+                if (led_table_enabled) {
+                    ledd_shm_free(&led_table, led->shm_slot);
+                }
+                shash_find_and_delete(&led_data, led->name);
+                shash_find_and_delete(&timed_sets, led->name);
+                shash_find_and_delete(&ramps, led->name);
+                ledd_changes_remove(&changes, led->name, time_wall_msec());
+                ledd_sched_cancel(led);
+                ledd_led_detach_breakers(led);
+                ledd_led_free_requests(led);
+                ledd_sysfs_close(led->sysfs);
                 free(led->name);
                 free(led);
             }
 
+            /* delete the LED-class settings */
+            SHASH_FOR_EACH_SAFE(type_node, type_next,
+                                &(subsystem->led_class)) {
+                struct ledd_led_class *led_class = type_node->data;
+
+                shash_delete(&subsystem->led_class, type_node);
+                free(led_class->name);
+                free(led_class);
+            }
+
+            /* delete the dimming settings */
+            SHASH_FOR_EACH_SAFE(type_node, type_next,
+                                &(subsystem->led_dim)) {
+                shash_delete(&subsystem->led_dim, type_node);
+                ledd_led_dim_free(type_node->data);
+            }
+
             /* delete all LED types in the subsystem */
             SHASH_FOR_EACH_SAFE(type_node, type_next,
                                 &(subsystem->subsystem_types)) {
@@ -149,6 +786,7 @@ ledd_remove_unmarked_subsystems(void)
                 /* delete the subsystem entry */
                 shash_delete(&subsystem->subsystem_types, type_node);
             }
+            shash_destroy_free_data(&subsystem->type_values);
             free(subsystem->name);
             free(subsystem);
 
@@ -160,188 +798,3129 @@ ledd_remove_unmarked_subsystems(void)
     }
 } /* ledd_remove_unmarked_subsystems() */
 
+/* ************ HARDWARE ACCESS ******** */
+
+static int
+ledd_i2c_reg_read(const char *subsys, const i2c_bit_op *reg_op,
+                  uint32_t *value)
+{
+    return(i2c_reg_read(yaml_handle, subsys, reg_op, value));
+} /* ledd_i2c_reg_read() */
+
+static int
+ledd_i2c_reg_write(const char *subsys, const i2c_bit_op *reg_op,
+                   uint32_t value)
+{
+    return(i2c_reg_write(yaml_handle, subsys, (i2c_bit_op *) reg_op, value));
+} /* ledd_i2c_reg_write() */
+
 /************************************************************************//**
- * Function that sets the LED to the value specified in ovsdb state variable.
- *
- * Logic:
- *     - Retrieves the LED type
- *     - Retrieves the i2c settings for the LED type
- *     - Retrieves the value to write to the LED to match ovsdb state variable
- *     - Retrieves the i2c device access information
- *     - Reads the current value of the LED register
- *     - Writes the new value of the LED register (bitwise OR)
+ * Function that finds the simulated register for a register operation.
  *
- * Returns: True on success, else False for any failure
+ * Returns: the register, or NULL if the device is set to fail
  ***************************************************************************/
-bool
-ledd_write_led(struct locl_subsystem *subsys, struct locl_led *led)
+static uint32_t *
+ledd_sim_reg(const char *subsys, const i2c_bit_op *reg_op)
 {
-    YamlLedTypeSettings *settings;
-    YamlLedType *type;
-    i2c_bit_op *reg_op;
-    uint32_t value;
-    int rc;
-    YamlLedTypeValue type_value;
+    uint32_t *reg;
+    char *key;
 
-    reg_op = led->yaml_led->led_access;
+    if (hw_sim_delay_us) {
+        usleep(hw_sim_delay_us);
+    }
+
+    key = xasprintf("%s/%s", subsys, reg_op->device);
+    if (sset_contains(&hw_sim_fail, key)) {
+        free(key);
+        return(NULL);
+    }
+    free(key);
+
+    key = xasprintf("%s/%s@%x", subsys, reg_op->device,
+                    reg_op->register_address);
+    reg = shash_find_data(&hw_sim_regs, key);
+    if (reg == NULL) {
+        reg = xzalloc(sizeof *reg);
+        shash_add_nocopy(&hw_sim_regs, key, reg);
+    } else {
+        free(key);
+    }
+
+    return(reg);
+} /* ledd_sim_reg() */
+
+static int
+ledd_sim_reg_read(const char *subsys, const i2c_bit_op *reg_op,
+                  uint32_t *value)
+{
+    uint32_t *reg = ledd_sim_reg(subsys, reg_op);
+
+    if (reg == NULL) {
+        return(EIO);
+    }
+    *value = *reg & reg_op->bit_mask;
+
+    return(0);
+} /* ledd_sim_reg_read() */
+
+static int
+ledd_sim_reg_write(const char *subsys, const i2c_bit_op *reg_op,
+                   uint32_t value)
+{
+    uint32_t *reg = ledd_sim_reg(subsys, reg_op);
+
+    if (reg == NULL) {
+        return(EIO);
+    }
+    *reg = (*reg & ~reg_op->bit_mask) | (value & reg_op->bit_mask);
+
+    return(0);
+} /* ledd_sim_reg_write() */
+
+/* fill a proxy request from a register operation */
+static int
+ledd_proxy_req_init(struct ledd_proxy_req *req, const i2c_bit_op *reg_op)
+{
+    memset(req, 0, sizeof *req);
+    if (reg_op->device == NULL ||
+        strlen(reg_op->device) >= sizeof req->device) {
+        return(ENAMETOOLONG);
+    }
+    strcpy(req->device, reg_op->device);
+    req->register_address = reg_op->register_address;
+    req->register_size = reg_op->register_size;
+    req->bit_mask = reg_op->bit_mask;
+
+    return(0);
+} /* ledd_proxy_req_init() */
+
+/* a read is sent after the staged writes, in the same round trip */
+static int
+ledd_proxy_reg_read(const char *subsys, const i2c_bit_op *reg_op,
+                    uint32_t *value)
+{
+    struct ledd_proxy_req req;
+    int error;
+
+    error = ledd_proxy_req_init(&req, reg_op);
+    if (!error) {
+        error = ledd_proxy_read(&hw_proxy, subsys, &req, value);
+    }
+
+    return(error);
+} /* ledd_proxy_reg_read() */
+
+/* a write outside of a batch: its own round trip (LED writes are staged by
+   ledd_write_led_reg() instead) */
+static int
+ledd_proxy_reg_write(const char *subsys, const i2c_bit_op *reg_op,
+                     uint32_t value)
+{
+    struct ledd_proxy_req req;
+    int error;
+
+    error = ledd_proxy_req_init(&req, reg_op);
+    if (!error) {
+        hw_proxy_sync_error = 0;
+        error = ledd_proxy_write(&hw_proxy, subsys, &req, value, NULL);
+    }
+    if (!error) {
+        ledd_proxy_commit(&hw_proxy);
+        error = hw_proxy_sync_error;
+    }
+
+    return(error);
+} /* ledd_proxy_reg_write() */
+
+/* ************ BUS LOCKS ************ */
+
+/* find or create the bus of an LED, with its lock; the LED is counted */
+static struct ledd_bus *
+ledd_bus_get(const char *name)
+{
+    struct ledd_bus *bus;
+    int error;
+
+    if (!bus_lock_enabled) {
+        return(NULL);
+    }
+
+    bus = shash_find_data(&buses, name);
+    if (bus == NULL) {
+        bus = xzalloc(sizeof *bus);
+        bus->name = xstrdup(name);
+        error = ledd_buslock_init(&bus->lock, bus_lock_dir, name);
+        if (error) {
+            VLOG_WARN_RL(&hw_rl, "bus %s: unable to create %s (%s)", name,
+                         bus_lock_dir, ovs_strerror(error));
+        }
+        shash_add(&buses, name, bus);
+    }
+    bus->n_leds++;
+
+    return(bus);
+} /* ledd_bus_get() */
+
+/************************************************************************//**
+ * Function that takes the lock of the bus of an LED before an access, if
+ * this batch does not hold it yet. A wait that times out (another daemon
+ * holds the bus for too long) is logged, and the batch goes on without
+ * the lock: LEDs are not held back by a stuck daemon.
+ ***************************************************************************/
+static void
+ledd_bus_take(struct locl_led *led)
+{
+    struct ledd_bus *bus = led->bus;
+    int error;
+
+    if (bus == NULL) {
+        return;
+    }
+    if (!bus->lock.held && !bus->timed_out) {
+        error = ledd_buslock_acquire(&bus->lock,
+                                     LEDD_BUSLOCK_TIMEOUT_DEFAULT);
+        if (error) {
+            VLOG_WARN_RL(&hw_rl, "bus %s: lock not taken (%s)", bus->name,
+                         ovs_strerror(error));
+            bus->timed_out = true;
+        }
+    }
+    if (bus->lock.held) {
+        bus->lock.accesses++;
+    }
+} /* ledd_bus_take() */
+
+/* end of a batch of LED accesses: release the bus locks */
+static void
+ledd_buses_release(void)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &buses) {
+        struct ledd_bus *bus = node->data;
+
+        ledd_buslock_release(&bus->lock);
+        bus->timed_out = false;
+    }
+} /* ledd_buses_release() */
+
+/* ************ CIRCUIT BREAKERS ************ */
+
+/* find or create the breaker "name" and count one more LED behind it */
+static struct ledd_breaker *
+ledd_breaker_get(char *name, enum ledd_breaker_scope scope)
+{
+    struct ledd_breaker *b = shash_find_data(&breakers, name);
+
+    if (b == NULL) {
+        b = xzalloc(sizeof *b);
+        b->name = name;
+        b->scope = scope;
+        b->state = LEDD_BREAKER_CLOSED;
+        b->retry_ms = breaker_retry_ms;
+        shash_add(&breakers, name, b);
+    } else {
+        free(name);
+    }
+    b->n_leds++;
+
+    return(b);
+} /* ledd_breaker_get() */
+
+/************************************************************************//**
+ * Function that puts an LED behind the breakers of its device and of the
+ * bus of that device. LED-class LEDs and LEDs without a register are not
+ * behind any breaker.
+ ***************************************************************************/
+static void
+ledd_led_attach_breakers(struct locl_subsystem *subsys, struct locl_led *led)
+{
+    const i2c_bit_op *reg_op = led->yaml_led->led_access;
+    const char *bus;
+
+    if (led->led_class || reg_op == NULL || reg_op->device == NULL) {
+        return;
+    }
+
+    bus = ledd_device_bus(subsys, reg_op->device);
+    if (bus) {
+        led->bus = ledd_bus_get(bus);
+    } else {
+        bus = reg_op->device;
+    }
+
+    led->breakers[LEDD_BREAKER_DEVICE] =
+        ledd_breaker_get(xasprintf("%s/%s", subsys->name, reg_op->device),
+                         LEDD_BREAKER_DEVICE);
+    led->breakers[LEDD_BREAKER_BUS] =
+        ledd_breaker_get(xasprintf("%s/bus:%s", subsys->name, bus),
+                         LEDD_BREAKER_BUS);
+} /* ledd_led_attach_breakers() */
+
+/* take an LED out of its breakers, freeing the breakers left empty */
+static void
+ledd_led_detach_breakers(struct locl_led *led)
+{
+    int i;
+
+    for (i = 0; i < LEDD_N_BREAKER_SCOPES; i++) {
+        struct ledd_breaker *b = led->breakers[i];
+
+        if (b && --b->n_leds == 0) {
+            shash_find_and_delete(&breakers, b->name);
+            free(b->name);
+            free(b);
+        }
+        led->breakers[i] = NULL;
+    }
+
+    if (led->bus && --led->bus->n_leds == 0) {
+        shash_find_and_delete(&buses, led->bus->name);
+        ledd_buslock_destroy(&led->bus->lock);
+        free(led->bus->name);
+        free(led->bus);
+    }
+    led->bus = NULL;
+} /* ledd_led_detach_breakers() */
+
+/************************************************************************//**
+ * Function that checks whether the hardware of an LED may be accessed.
+ *
+ * Returns: False if the device or bus breaker of the LED is open
+ ***************************************************************************/
+static bool
+ledd_breaker_allow(const struct locl_led *led)
+{
+    int i;
+
+    for (i = 0; i < LEDD_N_BREAKER_SCOPES; i++) {
+        struct ledd_breaker *b = led->breakers[i];
+
+        if (b && b->state == LEDD_BREAKER_OPEN) {
+            b->skipped++;
+            ledd_stats.breaker_skipped++;
+            COVERAGE_INC(ledd_hw_breaker_skipped);
+            return(false);
+        }
+    }
+
+    return(true);
+} /* ledd_breaker_allow() */
+
+/************************************************************************//**
+ * Function that opens a breaker and sets every LED behind it to fault.
+ * The statuses are pushed to the db in a single transaction by
+ * ledd_push_statuses(), and a single warning summarizes the errors.
+ ***************************************************************************/
+static void
+ledd_breaker_trip(struct ledd_breaker *b)
+{
+    struct shash_node *node;
+    unsigned int n_faulted = 0;
+
+    b->state = LEDD_BREAKER_OPEN;
+    b->trips++;
+    b->retry_ms = breaker_retry_ms;
+    b->retry_at = time_msec() + b->retry_ms;
+    b->opened = time_wall_msec();
+    ledd_stats.breaker_trips++;
+    breaker_probe_pending = true;
+
+    SHASH_FOR_EACH(node, &led_data) {
+        struct locl_led *led = node->data;
+
+        if (led->breakers[b->scope] != b) {
+            continue;
+        }
+        led->hw_valid = false;
+        if (led->status != LED_STATUS_FAULT) {
+            led->status = LED_STATUS_FAULT;
+            led->status_dirty = true;
+            status_dirty = true;
+            ledd_led_refresh(led);
+            n_faulted++;
+        }
+    }
+
+    VLOG_WARN("%s: %u consecutive hardware errors (%llu in total), "
+              "breaker open, %u of %u LEDs set to fault, next probe in "
+              "%lld ms", b->name, b->errors, b->total_errors, n_faulted,
+              b->n_leds, b->retry_ms);
+} /* ledd_breaker_trip() */
+
+/************************************************************************//**
+ * Function that records the result of a hardware access to an LED in its
+ * breakers.
+ *
+ * Logic:
+ *     - on success, reset the error count (a half-open breaker closes)
+ *     - on error, a half-open breaker opens again with twice the delay,
+ *       and a closed breaker opens after "threshold" consecutive errors
+ ***************************************************************************/
+static void
+ledd_breaker_record(const struct locl_led *led, bool ok)
+{
+    int i;
+
+    for (i = 0; i < LEDD_N_BREAKER_SCOPES; i++) {
+        struct ledd_breaker *b = led->breakers[i];
+
+        if (b == NULL) {
+            continue;
+        }
+
+        if (ok) {
+            b->errors = 0;
+            if (b->state != LEDD_BREAKER_CLOSED) {
+                VLOG_INFO("%s: hardware access succeeded, breaker closed "
+                          "after %lld ms", b->name,
+                          time_wall_msec() - b->opened);
+                b->state = LEDD_BREAKER_CLOSED;
+                b->retry_ms = breaker_retry_ms;
+            }
+            continue;
+        }
+
+        b->errors++;
+        b->total_errors++;
+        if (b->state == LEDD_BREAKER_HALF_OPEN) {
+            b->state = LEDD_BREAKER_OPEN;
+            b->retry_ms = MIN(2 * b->retry_ms, LEDD_BREAKER_RETRY_MAX);
+            b->retry_at = time_msec() + b->retry_ms;
+            VLOG_DBG("%s: probe failed, next probe in %lld ms",
+                     b->name, b->retry_ms);
+        } else if (b->state == LEDD_BREAKER_CLOSED && breaker_threshold &&
+                   b->errors >= breaker_threshold) {
+            ledd_breaker_trip(b);
+        }
+    }
+} /* ledd_breaker_record() */
+
+/************************************************************************//**
+ * Function that moves the brightness of a PWM-dimmable LED to "to" in
+ * duration_ms: the ramp is advanced by ledd_ramp_run(). Without a
+ * duration, the brightness is set at once and any ramp is dropped.
+ ***************************************************************************/
+static void
+ledd_led_ramp(struct locl_led *led, unsigned int to, long long int duration_ms)
+{
+    long long int now = time_msec();
+
+    if (duration_ms <= 0 || led->output == to) {
+        led->output = to;
+        if (led->ramping) {
+            shash_find_and_delete(&ramps, led->name);
+            led->ramping = false;
+        }
+        return;
+    }
+
+    ledd_ramp_start(&led->ramp, led->output, to, now, duration_ms);
+    if (!led->ramping) {
+        if (shash_is_empty(&ramps)) {
+            ramp_next_tick = now + LEDD_RAMP_TICK_MS;
+        }
+        shash_add(&ramps, led->name, led);
+        led->ramping = true;
+    }
+} /* ledd_led_ramp() */
+
+/************************************************************************//**
+ * Function that computes the register value of a PWM-dimmable LED that is
+ * on or off: the level of the brightness it is at, which may be on its
+ * way to the brightness of the state.
+ ***************************************************************************/
+static uint32_t
+ledd_led_pwm_value(struct locl_led *led)
+{
+    const struct ledd_led_dim *dim = led->dim;
+    unsigned int target;
+
+    target = led->effective_state == LED_STATE_ON ? led->brightness : 0;
+    if (target != (led->ramping ? led->ramp.to : led->output)) {
+        ledd_led_ramp(led, target, dim->fade_ms);
+    }
+
+    return(ledd_ramp_field(ledd_ramp_level(led->output, dim->pwm_max),
+                           led->yaml_led->led_access->bit_mask));
+} /* ledd_led_pwm_value() */
+
+/************************************************************************//**
+ * Function that computes the register value that puts the LED into its
+ * current desired state.
+ *
+ * Logic:
+ *     - a PWM-dimmable LED that is on or off gets the level of its
+ *       brightness (see ledd_led_pwm_value())
+ *     - a multicolor LED that is on gets the value of its color, if one
+ *       was chosen
+ *     - else calls the driver of the LED type, with the values of the type
+ *       looked up when the LED was added (see ledd_subsys_add_type())
+ *
+ * Returns: True on success (value is set), else False for any failure
+ ***************************************************************************/
+static bool
+ledd_led_value(struct locl_subsystem *subsys, struct locl_led *led,
+               uint32_t *value)
+{
+    if (led->values == NULL) {
+        VLOG_WARN("Unknown or no type %s for subsystem %s, LED %s",
+                  led->yaml_led->type, subsys->name, led->name);
+        return(false);
+    }
+
+    if (led->dim && led->dim->pwm_max &&
+        led->effective_state != LED_STATE_FLASHING) {
+        *value = ledd_led_pwm_value(led);
+        return(true);
+    }
+    if (led->dim && led->color >= 0 &&
+        led->effective_state == LED_STATE_ON) {
+        *value = led->dim->color_values[led->color];
+        return(true);
+    }
+
+    if (!ledd_type_value(led->type_id, led->values, led->effective_state,
+                         value)) {
+        VLOG_WARN_RL(&hw_rl, "Invalid state %s for subsystem %s, LED %s "
+                     "(type %s)", led_state_strings[led->effective_state],
+                     subsys->name, led->name, led->yaml_led->type);
+        return(false);
+    }
+
+    return(true);
+} /* ledd_led_value() */
+
+/* ************ ARBITRATION ************ */
+
+/************************************************************************//**
+ * Function that recomputes the effective state of an LED from its request
+ * stack. The stack is kept sorted (highest priority first, newest first
+ * for equal priorities), so the winner is always the first request.
+ *
+ * Returns: True if the effective state changed (the LED must be written)
+ ***************************************************************************/
+static bool
+ledd_led_arbitrate(struct locl_led *led)
+{
+    enum ovsrec_led_state_e state;
+
+    state = led->n_requests ? led->requests[0].state : LED_STATE_OFF;
+    if (state == led->effective_state) {
+        return(false);
+    }
+
+    led->effective_state = state;
+    return(true);
+} /* ledd_led_arbitrate() */
+
+/* remove the request of "source" from the stack, returns its index or -1 */
+static int
+ledd_led_remove_request(struct locl_led *led, const char *source)
+{
+    size_t i;
+
+    for (i = 0; i < led->n_requests; i++) {
+        if (strcmp(led->requests[i].source, source) == 0) {
+            free(led->requests[i].source);
+            memmove(&led->requests[i], &led->requests[i + 1],
+                    (led->n_requests - i - 1) * sizeof *led->requests);
+            led->n_requests--;
+            return((int) i);
+        }
+    }
+
+    return(-1);
+} /* ledd_led_remove_request() */
+
+/************************************************************************//**
+ * Function that posts (or replaces) the request of "source" for an LED.
+ *
+ * Logic:
+ *     - remove any earlier request of the source
+ *     - insert the request in front of the first request with the same or
+ *       a lower priority
+ *     - recompute the effective state only if the winner changed
+ *
+ * Returns: True if the effective state changed (the LED must be written)
+ ***************************************************************************/
+static bool
+ledd_led_post(struct locl_led *led, const char *source, int priority,
+              enum ovsrec_led_state_e state)
+{
+    struct ledd_request *req;
+    int old_idx;
+    size_t i;
+
+    old_idx = ledd_led_remove_request(led, source);
+
+    if (led->n_requests >= led->allocated_requests) {
+        led->requests = x2nrealloc(led->requests, &led->allocated_requests,
+                                   sizeof *led->requests);
+    }
+
+    for (i = 0; i < led->n_requests; i++) {
+        if (led->requests[i].priority <= priority) {
+            break;
+        }
+    }
+    memmove(&led->requests[i + 1], &led->requests[i],
+            (led->n_requests - i) * sizeof *led->requests);
+    led->n_requests++;
+
+    req = &led->requests[i];
+    req->source = xstrdup(source);
+    req->priority = priority;
+    req->state = state;
+    req->posted = time_wall_msec();
+
+    /* a request that neither is nor was the winner cannot change it */
+    if (i != 0 && old_idx != 0) {
+        return(false);
+    }
+
+    return(ledd_led_arbitrate(led));
+} /* ledd_led_post() */
+
+/************************************************************************//**
+ * Function that withdraws the request of "source" for an LED.
+ *
+ * Returns: True if the effective state changed (the LED must be written)
+ ***************************************************************************/
+static bool
+ledd_led_withdraw(struct locl_led *led, const char *source)
+{
+    if (ledd_led_remove_request(led, source) != 0) {
+        /* not found, or not the winner: the effective state is the same */
+        return(false);
+    }
+
+    return(ledd_led_arbitrate(led));
+} /* ledd_led_withdraw() */
+
+/* free the request stack of an LED */
+static void
+ledd_led_free_requests(struct locl_led *led)
+{
+    size_t i;
+
+    for (i = 0; i < led->n_requests; i++) {
+        free(led->requests[i].source);
+    }
+    free(led->requests);
+    led->requests = NULL;
+    led->n_requests = led->allocated_requests = 0;
+} /* ledd_led_free_requests() */
+
+/************************************************************************//**
+ * Function that stages the effective state of an LED-class LED in the
+ * LED-class batch. The LED is opened on its first write, and again after
+ * an open failed (the driver may be loaded later).
+ *
+ * Returns: 0 if the write is staged (its result is known when the batch
+ *          is committed, see ledd_led_class_done()), else an errno value;
+ *          *valuep is the mode staged
+ ***************************************************************************/
+static int
+ledd_write_led_class(struct locl_led *led, uint32_t *valuep)
+{
+    const struct ledd_led_class *led_class = led->led_class;
+    enum ledd_sysfs_mode mode;
+    int error;
+
+    if (led->sysfs == NULL) {
+        error = ledd_sysfs_open(led_class_root, led_class->name, &led->sysfs);
+        if (error) {
+            led->write_failures++;
+            VLOG_WARN_RL(&hw_rl, "LED %s: unable to open %s/%s (%s)",
+                         led->name, led_class_root, led_class->name,
+                         ovs_strerror(error));
+            return(error);
+        }
+        led->sysfs->aux = led;
+    }
+
+    switch (led->effective_state) {
+        case LED_STATE_ON:
+            mode = LEDD_SYSFS_ON;
+            break;
+        case LED_STATE_FLASHING:
+            mode = LEDD_SYSFS_FLASH;
+            break;
+        case LED_STATE_OFF:
+        default:
+            mode = LEDD_SYSFS_OFF;
+            break;
+    }
+
+    *valuep = mode;
+
+    return(ledd_sysfs_stage(&led_class_batch, led->sysfs, mode,
+                            led_class->delay_on, led_class->delay_off));
+} /* ledd_write_led_class() */
+
+/************************************************************************//**
+ * Function that writes the register of an i2c LED.
+ *
+ * Logic:
+ *     - Retrieves the value to write to the LED (ledd_led_value)
+ *     - Retrieves the i2c device access information
+ *     - Reads the current value of the LED register
+ *     - Writes the new value of the LED register (bitwise OR)
+ *
+ * Through the proxy (--hw-proxy), the write is staged instead, and its
+ * result is recorded when the batch is committed (see
+ * ledd_proxy_write_done()).
+ *
+ * Returns: 0 on success, else the backend's error (EINVAL if the LED has
+ *          no value for its state, EBUSY if its breaker is open);
+ *          *valuep is the value written
+ ***************************************************************************/
+static int
+ledd_write_led_reg(struct locl_subsystem *subsys, struct locl_led *led,
+                   uint32_t *valuep)
+{
+    struct ledd_proxy_req req;
+    i2c_bit_op *reg_op;
+    uint32_t value;
+    int rc;
+
+    reg_op = led->yaml_led->led_access;
+
+    if (!ledd_led_value(subsys, led, &value)) {
+        return(EINVAL);
+    }
+    *valuep = value;
+
+    if (!ledd_breaker_allow(led)) {
+        VLOG_DBG("LED %s not written, breaker open", led->name);
+        return(EBUSY);
+    }
+
+    ledd_bus_take(led);
+    if (hw_backend == &ledd_proxy_backend) {
+        rc = ledd_proxy_req_init(&req, reg_op);
+        if (!rc) {
+            rc = ledd_proxy_write(&hw_proxy, subsys->name, &req, value, led);
+        }
+        if (!rc) {
+            return(0);
+        }
+    } else {
+        rc = hw_backend->reg_write(subsys->name, reg_op, value);
+    }
+    ledd_breaker_record(led, rc == 0);
+
+    if (rc != 0) {
+        led->write_failures++;
+        VLOG_WARN_RL(&hw_rl, "subsystem %s: unable to set LED control "
+                     "register (%d)", subsys->name, rc);
+        return(rc);
+    }
+
+    led->write_count++;
+    ledd_stats.hw_writes++;
+    led->hw_state = led->effective_state;
+    led->hw_valid = true;
+    COVERAGE_INC(ledd_hw_write);
+
+    return(0);
+} /* ledd_write_led_reg() */
+
+/************************************************************************//**
+ * Function that sets the LED to the value specified in ovsdb state variable,
+ * through i2c or the LED class. The write is recorded in the trace (see
+ * --record) with its value, result and latency.
+ *
+ * Returns: True on success, else False for any failure
+ ***************************************************************************/
+bool
+ledd_write_led(struct locl_subsystem *subsys, struct locl_led *led)
+{
+    long long int start = trace_enabled ? time_usec() : 0;
+    uint32_t value = 0;
+    int error;
+
+    if (led->led_class) {
+        error = ledd_type_takes(led->type_id, led->effective_state)
+                ? ledd_write_led_class(led, &value) : EINVAL;
+    } else {
+        error = ledd_write_led_reg(subsys, led, &value);
+    }
+
+    if (trace_enabled) {
+        long long int now = time_usec();
+
+        ledd_trace_hw_write(&trace, now, led->name, value, error,
+                            now - start);
+    }
+
+    return(error == 0);
+} /* ledd_write_led() */
+
+/************************************************************************//**
+ * Function that reads the full contents of the register holding an LED,
+ * through a per-subsystem cache so that LEDs sharing a register cost a
+ * single bus read.
+ *
+ * Returns: True on success (raw is set), else False if the read failed
+ ***************************************************************************/
+static bool
+ledd_read_led_reg(struct locl_subsystem *subsys, const struct locl_led *led,
+                  struct shash *reg_cache, uint32_t *raw)
+{
+    const i2c_bit_op *reg_op = led->yaml_led->led_access;
+    struct ledd_reg_cache_entry *entry;
+    i2c_bit_op full_op;
+    char *key;
+
+    if (reg_op == NULL || reg_op->device == NULL) {
+        return(false);
+    }
+
+    key = xasprintf("%s/%s@%x", subsys->name, reg_op->device,
+                    reg_op->register_address);
+    entry = shash_find_data(reg_cache, key);
+
+    if (entry == NULL) {
+        entry = xzalloc(sizeof *entry);
+
+        /* read the whole register, not just this LED's bits */
+        full_op = *reg_op;
+        full_op.bit_mask = (reg_op->register_size >= 4) ? UINT32_MAX :
+                        ((1u << (8 * reg_op->register_size)) - 1);
+
+        if (ledd_breaker_allow(led)) {
+            ledd_bus_take(led);
+            entry->valid = (hw_backend->reg_read(subsys->name, &full_op,
+                                                 &entry->value) == 0);
+            ledd_breaker_record(led, entry->valid);
+            COVERAGE_INC(ledd_hw_read);
+        }
+        shash_add_nocopy(reg_cache, key, entry);
+    } else {
+        free(key);
+    }
+
+    *raw = entry->value;
+    return(entry->valid);
+} /* ledd_read_led_reg() */
+
+/* release a register cache built by ledd_read_led_reg() */
+static void
+ledd_reg_cache_destroy(struct shash *reg_cache)
+{
+    shash_destroy_free_data(reg_cache);
+} /* ledd_reg_cache_destroy() */
+
+/************************************************************************//**
+ * Function that brings the LED hardware to the desired state without
+ * glitching: the register is only written if the bits owned by the LED
+ * do not already hold the desired value.
+ *
+ * Returns: True if the LED is (now) in the desired state, else False
+ ***************************************************************************/
+static bool
+ledd_sync_led(struct locl_subsystem *subsys, struct locl_led *led,
+              struct shash *reg_cache)
+{
+    uint32_t value;
+    uint32_t raw;
+
+    /* LED-class LEDs read their mode when opened, and only the attributes
+       that differ are written */
+    if (led->led_class) {
+        return(ledd_write_led(subsys, led));
+    }
+
+    if (ledd_led_value(subsys, led, &value) &&
+        ledd_read_led_reg(subsys, led, reg_cache, &raw) &&
+        (raw & led->yaml_led->led_access->bit_mask) ==
+                        (value & led->yaml_led->led_access->bit_mask)) {
+        VLOG_DBG("LED %s already %s, not rewritten", led->name,
+                 led_state_strings[led->effective_state]);
+        COVERAGE_INC(ledd_hw_write_skipped);
+        led->hw_state = led->effective_state;
+        led->hw_valid = true;
+        return(true);
+    }
+
+    return(ledd_write_led(subsys, led));
+} /* ledd_sync_led() */
+
+/************************************************************************//**
+ * Function that writes the effective state of an LED to the hardware and
+ * computes the resulting status.
+ *
+ * Returns: the new status of the LED (not yet pushed to the db)
+ ***************************************************************************/
+static enum ovsrec_led_status_e
+ledd_led_apply(struct locl_subsystem *subsys, struct locl_led *led)
+{
+    /* If we have a valid type, write to the LED */
+    if (led->values == NULL) {
+        VLOG_WARN("Unable to write LED %s, led type %s unknown",
+                led->name, led->yaml_led->type);
+        return(LED_STATUS_FAULT);
+    }
+
+    if (ledd_write_led(subsys, led)) {
+        VLOG_DBG("ledd_write successful, %s",led->name);
+        return(LED_STATUS_OK);
+    }
+
+    VLOG_DBG("ledd_write failed, %s",led->name);
+    return(LED_STATUS_FAULT);
+} /* ledd_led_apply() */
+
+/* set the status of an LED written outside of ledd_reconfigure(), it is
+   pushed to the db by ledd_push_statuses() */
+static void
+ledd_led_set_status(struct locl_led *led, enum ovsrec_led_status_e status)
+{
+    if (status != led->status) {
+        led->status = status;
+        led->status_dirty = true;
+        status_dirty = true;
+    }
+    ledd_led_refresh(led);
+} /* ledd_led_set_status() */
+
+/* ************ MEMORY ACCOUNTING ************ */
+
+/* bytes of a shash node and its key */
+static size_t
+ledd_mem_node(const char *name)
+{
+    return(sizeof(struct shash_node) + strlen(name) + 1);
+} /* ledd_mem_node() */
+
+/* bytes of the bucket array of a shash */
+static size_t
+ledd_mem_buckets(const struct shash *sh)
+{
+    return(sh->map.mask ? (sh->map.mask + 1) * sizeof *sh->map.buckets : 0);
+} /* ledd_mem_buckets() */
+
+/************************************************************************//**
+ * Function that adds up the memory used by one subsystem. The sizes are
+ * those requested from malloc, without the allocator overhead.
+ *
+ * Returns:  void (*mem is filled)
+ ***************************************************************************/
+static void
+ledd_subsys_memory(const struct locl_subsystem *subsys,
+                   struct ledd_subsys_memory *mem)
+{
+    const struct shash_node *node;
+    size_t i;
+
+    memset(mem, 0, sizeof *mem);
+
+    mem->leds = sizeof *subsys + strlen(subsys->name) + 1 +
+                ledd_mem_node(subsys->name) +
+                ledd_mem_buckets(&subsys->subsystem_leds);
+
+    SHASH_FOR_EACH(node, &subsys->subsystem_leds) {
+        const struct locl_led *led = node->data;
+        const YamlLed *yaml_led = led->yaml_led;
+
+        /* the LED is in subsystem_leds and in led_data */
+        mem->leds += sizeof *led + strlen(led->name) + 1 +
+                     ledd_mem_node(node->name) + ledd_mem_node(led->name);
+
+        mem->requests += led->allocated_requests * sizeof *led->requests;
+        for (i = 0; i < led->n_requests; i++) {
+            mem->requests += strlen(led->requests[i].source) + 1;
+        }
+
+        if (led->sysfs) {
+            mem->led_class += sizeof *led->sysfs +
+                              strlen(led->sysfs->dir) + 1;
+        }
+
+        /* a static table is not allocated */
+        if (subsys->tables == NULL) {
+            mem->hw_desc += sizeof *yaml_led + strlen(yaml_led->name) + 1 +
+                            strlen(yaml_led->type) + 1 +
+                            sizeof *yaml_led->led_access;
+        }
+    }
+
+    mem->leds += ledd_mem_buckets(&subsys->type_values);
+    SHASH_FOR_EACH(node, &subsys->type_values) {
+        mem->leds += sizeof(struct ledd_led_type) +
+                     ledd_mem_node(node->name);
+    }
+
+    mem->led_class += ledd_mem_buckets(&subsys->led_class);
+    SHASH_FOR_EACH(node, &subsys->led_class) {
+        const struct ledd_led_class *led_class = node->data;
+
+        mem->led_class += sizeof *led_class + strlen(led_class->name) + 1 +
+                          ledd_mem_node(node->name);
+    }
+
+    mem->hw_desc += ledd_mem_buckets(&subsys->subsystem_types);
+    SHASH_FOR_EACH(node, &subsys->subsystem_types) {
+        mem->hw_desc += (subsys->tables ? 0 : sizeof(YamlLedType)) +
+                        ledd_mem_node(node->name);
+    }
+} /* ledd_subsys_memory() */
+
+/* bytes used by the breakers */
+static size_t
+ledd_breakers_memory(void)
+{
+    const struct shash_node *node;
+    size_t bytes = ledd_mem_buckets(&breakers);
+
+    SHASH_FOR_EACH(node, &breakers) {
+        const struct ledd_breaker *b = node->data;
+
+        bytes += sizeof *b + strlen(b->name) + 1 + ledd_mem_node(node->name);
+    }
+
+    return(bytes);
+} /* ledd_breakers_memory() */
+
+/* bytes used by the write queues */
+static size_t
+ledd_sched_memory(void)
+{
+    size_t bytes = led_class_batch.allocated * sizeof *led_class_batch.leds;
+    int c;
+
+    for (c = 0; c < LEDD_N_WRITE_CLASSES; c++) {
+        bytes += write_queues[c].allocated * sizeof *write_queues[c].entries;
+    }
+
+    return(bytes);
+} /* ledd_sched_memory() */
+
+/* bytes used by the simulated registers */
+static size_t
+ledd_sim_memory(void)
+{
+    const struct shash_node *node;
+    size_t bytes = ledd_mem_buckets(&hw_sim_regs);
+
+    SHASH_FOR_EACH(node, &hw_sim_regs) {
+        bytes += sizeof(uint32_t) + ledd_mem_node(node->name);
+    }
+
+    return(bytes);
+} /* ledd_sim_memory() */
+
+/************************************************************************//**
+ * Function that fills the usage reported by the OVS memory module (logged
+ * when the RSS grows, and shown by memory/show).
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_get_memory_usage(struct simap *usage)
+{
+    const struct ovsrec_led *ovs_led;
+    const struct shash_node *node;
+    unsigned int requests = 0;
+    unsigned int rows = 0;
+    size_t c;
+
+    SHASH_FOR_EACH(node, &led_data) {
+        const struct locl_led *led = node->data;
+
+        requests += led->n_requests;
+    }
+    OVSREC_LED_FOR_EACH(ovs_led, idl) {
+        rows++;
+    }
+
+    simap_increase(usage, "subsystems", shash_count(&subsystem_data));
+    simap_increase(usage, "leds", shash_count(&led_data));
+    simap_increase(usage, "led rows", rows);
+    simap_increase(usage, "requests", requests);
+    simap_increase(usage, "breakers", shash_count(&breakers));
+    for (c = 0; c < LEDD_N_WRITE_CLASSES; c++) {
+        simap_increase(usage, "write queue entries",
+                       write_queues[c].allocated);
+    }
+} /* ledd_get_memory_usage() */
+
+/* ************ WRITE SCHEDULER ************ */
+
+/* true if the current slice (of a reconfigure pass or of a run of the
+   write scheduler) has used up its time budget */
+static bool
+ledd_slice_expired(void)
+{
+    return(reconfigure_budget_ms && time_usec() >= slice_deadline);
+} /* ledd_slice_expired() */
+
+/************************************************************************//**
+ * Function that queues a write of an LED's effective state. The state is
+ * read when the write is done, so an LED is queued at most once: a write
+ * queued again in the same or a lower class is merged with the queued
+ * one, and a write queued in a higher class moves the LED to that class.
+ ***************************************************************************/
+static void
+ledd_led_schedule(struct locl_led *led, enum ledd_write_class class)
+{
+    struct ledd_write_queue *q = &write_queues[class];
+    struct ledd_queued_write *entry;
+
+    if (led->subsystem->lazy) {
+        /* the LEDs of a lazy subsystem are left off until one is not */
+        if (led->effective_state == LED_STATE_OFF ||
+            !ledd_subsys_activate(led->subsystem)) {
+            return;
+        }
+    }
+
+    if (led->sched_queued) {
+        if (class >= led->sched_class) {
+            write_queues[led->sched_class].coalesced++;
+            return;
+        }
+        /* the entry in the lower class becomes stale */
+        write_queues[led->sched_class].depth--;
+    }
+
+    if (q->n >= q->allocated) {
+        if (q->head > 0) {
+            /* reuse the space of the entries already done */
+            memmove(q->entries, &q->entries[q->head],
+                    (q->n - q->head) * sizeof *q->entries);
+            q->n -= q->head;
+            q->head = 0;
+        } else {
+            q->entries = x2nrealloc(q->entries, &q->allocated,
+                                    sizeof *q->entries);
+        }
+    }
+
+    led->sched_queued = true;
+    led->sched_class = class;
+    led->sched_gen++;
+
+    entry = &q->entries[q->n++];
+    entry->led = led;
+    entry->gen = led->sched_gen;
+    entry->queued_us = time_usec();
+
+    q->enqueued++;
+    q->depth++;
+    q->max_depth = MAX(q->max_depth, q->depth);
+} /* ledd_led_schedule() */
+
+/************************************************************************//**
+ * Function that activates a lazy subsystem (--lazy-activation) when one of
+ * its LEDs gets a state other than off: the subsystem is then set up as it
+ * would have been when it was added.
+ *
+ * Logic:
+ *     - parse the devices file of the subsystem
+ *     - put every LED behind its device and bus breakers
+ *     - queue a bulk write of every LED, which skips the LEDs whose
+ *       register already holds their state
+ *     - if the devices file cannot be parsed, set every LED to fault and
+ *       leave the subsystem inactive (no LED of it is ever written)
+ *
+ * Returns: True if the subsystem is active
+ ***************************************************************************/
+static bool
+ledd_subsys_activate(struct locl_subsystem *subsys)
+{
+    struct shash_node *node;
+
+    if (subsys->devices_failed) {
+        return(false);
+    }
+
+    if (ledd_subsys_parse_devices(subsys) != 0) {
+        VLOG_ERR("Unable to parse subsystem %s devices file, its LEDs "
+                 "will not be written", subsys->name);
+        subsys->devices_failed = true;
+        SHASH_FOR_EACH(node, &subsys->subsystem_leds) {
+            ledd_led_set_status(node->data, LED_STATUS_FAULT);
+        }
+        return(false);
+    }
+
+    subsys->lazy = false;
+    ledd_stats.lazy_activated++;
+
+    VLOG_INFO("activating subsystem %s (%"PRIuSIZE" LEDs)", subsys->name,
+              shash_count(&subsys->subsystem_leds));
+
+    SHASH_FOR_EACH(node, &subsys->subsystem_leds) {
+        struct locl_led *led = node->data;
+
+        ledd_led_attach_breakers(subsys, led);
+        led->sched_sync = true;
+        ledd_led_schedule(led, LEDD_WRITE_BULK);
+    }
+
+    return(true);
+} /* ledd_subsys_activate() */
+
+/* take the next live entry of a queue, NULL if the queue is empty */
+static struct ledd_queued_write *
+ledd_sched_pop(struct ledd_write_queue *q)
+{
+    while (q->head < q->n) {
+        struct ledd_queued_write *entry = &q->entries[q->head++];
+        struct locl_led *led = entry->led;
+
+        if (led && led->sched_queued && led->sched_gen == entry->gen) {
+            if (q->head == q->n) {
+                q->head = q->n = 0;
+            }
+            return(entry);
+        }
+    }
+    q->head = q->n = 0;
+
+    return(NULL);
+} /* ledd_sched_pop() */
+
+/* drop the queued write of an LED that is being freed */
+static void
+ledd_sched_cancel(struct locl_led *led)
+{
+    size_t c, i;
+
+    if (led->sched_queued) {
+        write_queues[led->sched_class].depth--;
+        led->sched_queued = false;
+    }
+
+    /* stale entries may point to the LED too */
+    for (c = 0; c < LEDD_N_WRITE_CLASSES; c++) {
+        struct ledd_write_queue *q = &write_queues[c];
+
+        for (i = q->head; i < q->n; i++) {
+            if (q->entries[i].led == led) {
+                q->entries[i].led = NULL;
+            }
+        }
+    }
+} /* ledd_sched_cancel() */
+
+/************************************************************************//**
+ * Function that chooses the class of the next write: the highest class
+ * with queued writes, unless a lower class was passed over
+ * LEDD_SCHED_STARVE_LIMIT times, in which case the lowest such class is
+ * served so that bulk work keeps progressing.
+ *
+ * Returns: the class, or LEDD_N_WRITE_CLASSES if nothing is queued
+ ***************************************************************************/
+static enum ledd_write_class
+ledd_sched_pick(void)
+{
+    int c, pick = LEDD_N_WRITE_CLASSES;
+    bool promoted = false;
+
+    for (c = 0; c < LEDD_N_WRITE_CLASSES; c++) {
+        if (write_queues[c].depth) {
+            pick = c;
+            break;
+        }
+    }
+
+    for (c = LEDD_N_WRITE_CLASSES - 1; c > pick; c--) {
+        if (write_queues[c].depth &&
+            write_queues[c].bypassed >= LEDD_SCHED_STARVE_LIMIT) {
+            pick = c;
+            promoted = true;
+            break;
+        }
+    }
+
+    if (pick == LEDD_N_WRITE_CLASSES) {
+        return(LEDD_N_WRITE_CLASSES);
+    }
+
+    for (c = 0; c < LEDD_N_WRITE_CLASSES; c++) {
+        if (c == pick) {
+            write_queues[c].bypassed = 0;
+        } else if (c > pick && write_queues[c].depth) {
+            write_queues[c].bypassed++;
+        }
+    }
+    if (promoted) {
+        write_queues[pick].promoted++;
+    }
+
+    return((enum ledd_write_class) pick);
+} /* ledd_sched_pick() */
+
+/* record the result of an LED-class write, once its batch is committed */
+static void
+ledd_led_class_done(struct ledd_sysfs_led *sysfs)
+{
+    struct locl_led *led = sysfs->aux;
+
+    if (sysfs->error) {
+        led->write_failures++;
+        VLOG_WARN_RL(&hw_rl, "LED %s: unable to write %s (%s)", led->name,
+                     sysfs->dir, ovs_strerror(sysfs->error));
+        ledd_led_set_status(led, LED_STATUS_FAULT);
+        return;
+    }
+
+    /* the LED may already have been in the mode staged */
+    if (sysfs->written) {
+        led->write_count++;
+        ledd_stats.hw_writes++;
+        COVERAGE_INC(ledd_hw_write);
+    } else {
+        COVERAGE_INC(ledd_hw_write_skipped);
+    }
+    led->hw_state = led->effective_state;
+    led->hw_valid = true;
+    ledd_led_set_status(led, LED_STATUS_OK);
+} /* ledd_led_class_done() */
+
+/* record the result of an LED write staged for the proxy, once its batch
+   is committed (aux is NULL for ledd_proxy_reg_write()) */
+static void
+ledd_proxy_write_done(void *aux, int error)
+{
+    struct locl_led *led = aux;
+
+    if (led == NULL) {
+        hw_proxy_sync_error = error;
+        return;
+    }
+
+    ledd_breaker_record(led, error == 0);
+    if (error) {
+        led->write_failures++;
+        VLOG_WARN_RL(&hw_rl, "LED %s: unable to set LED control register "
+                     "through the proxy (%s)", led->name,
+                     ovs_strerror(error));
+        ledd_led_set_status(led, LED_STATUS_FAULT);
+        return;
+    }
+
+    led->write_count++;
+    ledd_stats.hw_writes++;
+    led->hw_state = led->effective_state;
+    led->hw_valid = true;
+    COVERAGE_INC(ledd_hw_write);
+    ledd_led_set_status(led, LED_STATUS_OK);
+} /* ledd_proxy_write_done() */
+
+/* commit the staged LED writes: one round trip to the proxy, and the
+   LED-class batch */
+static void
+ledd_hw_commit(void)
+{
+    int error;
+
+    if (hw_backend == &ledd_proxy_backend) {
+        error = ledd_proxy_commit(&hw_proxy);
+        if (error) {
+            VLOG_WARN_RL(&hw_rl, "%s: register access proxy failed (%s)",
+                         hw_proxy_path, ovs_strerror(error));
+        }
+    }
+    ledd_sysfs_commit(&led_class_batch, ledd_led_class_done);
+} /* ledd_hw_commit() */
+
+/************************************************************************//**
+ * Function that does the queued LED writes, by class, until the queues
+ * are empty or the run has used its budget (at least one write is done).
+ * The writes of LED-class LEDs, and those through the proxy, are staged,
+ * and committed as one batch at the end of the run. The resulting
+ * statuses are pushed by ledd_push_statuses().
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_sched_run(void)
+{
+    enum ledd_write_class class;
+    struct shash reg_cache;
+    bool first = true;
+
+    shash_init(&reg_cache);
+    slice_deadline = time_usec() + reconfigure_budget_ms * 1000;
+
+    while ((class = ledd_sched_pick()) != LEDD_N_WRITE_CLASSES) {
+        struct ledd_write_queue *q = &write_queues[class];
+        struct ledd_queued_write *entry;
+        struct locl_led *led;
+        enum ovsrec_led_status_e status;
+        long long int wait;
+
+        if (!first && ledd_slice_expired()) {
+            break;
+        }
+        first = false;
+
+        entry = ledd_sched_pop(q);
+        if (entry == NULL) {
+            q->depth = 0;
+            continue;
+        }
+        led = entry->led;
+        led->sched_queued = false;
+        q->depth--;
+
+        wait = time_usec() - entry->queued_us;
+        q->wait_total_us += wait;
+        q->wait_max_us = MAX(q->wait_max_us, wait);
+        q->written++;
+
+        if (led->sched_sync) {
+            /* initial programming: skip LEDs already in their state */
+            led->sched_sync = false;
+            if (led->values == NULL) {
+                status = LED_STATUS_FAULT;
+            } else {
+                status = ledd_sync_led(led->subsystem, led, &reg_cache) ?
+                                    LED_STATUS_OK : LED_STATUS_FAULT;
+            }
+        } else {
+            status = ledd_led_apply(led->subsystem, led);
+        }
+        ledd_led_set_status(led, status);
+    }
+
+    ledd_reg_cache_destroy(&reg_cache);
+    ledd_buses_release();
+    ledd_hw_commit();
+    ledd_sched_compact();
+} /* ledd_sched_run() */
+
+/* release the array of a drained write queue that a burst (e.g. the bulk
+   writes of a new subsystem) grew past LEDD_SCHED_COMPACT_MIN entries */
+static void
+ledd_sched_compact(void)
+{
+    int c;
+
+    for (c = 0; c < LEDD_N_WRITE_CLASSES; c++) {
+        struct ledd_write_queue *q = &write_queues[c];
+
+        if (q->n == 0 && q->allocated > LEDD_SCHED_COMPACT_MIN) {
+            ledd_stats.compactions++;
+            ledd_stats.compacted_bytes += q->allocated * sizeof *q->entries;
+            free(q->entries);
+            q->entries = NULL;
+            q->allocated = 0;
+        }
+    }
+} /* ledd_sched_compact() */
+
+/* true if LED writes are queued */
+static bool
+ledd_sched_busy(void)
+{
+    int c;
+
+    for (c = 0; c < LEDD_N_WRITE_CLASSES; c++) {
+        if (write_queues[c].depth) {
+            return(true);
+        }
+    }
+
+    return(false);
+} /* ledd_sched_busy() */
+
+/* ************ DIRECT SET ************ */
+
+/************************************************************************//**
+ * Function that writes the effective state of an LED now, instead of
+ * queueing the write: a write already queued for the LED is dropped. The
+ * writes of LED-class LEDs (and through the proxy) are staged, the
+ * caller commits the batch. The status is pushed by ledd_push_statuses().
+ ***************************************************************************/
+static void
+ledd_led_write_now(struct locl_led *led)
+{
+    struct locl_subsystem *subsys = led->subsystem;
+
+    if (subsys->lazy) {
+        /* the LEDs of a lazy subsystem are left off until one is not */
+        if (led->effective_state == LED_STATE_OFF ||
+            !ledd_subsys_activate(subsys)) {
+            return;
+        }
+    }
+
+    if (led->sched_queued) {
+        /* the queue entry is skipped as stale */
+        write_queues[led->sched_class].depth--;
+        led->sched_queued = false;
+        led->sched_sync = false;
+    }
+
+    ledd_led_set_status(led, ledd_led_apply(subsys, led));
+} /* ledd_led_write_now() */
+
+static void ledd_led_fan_out(struct locl_led *led,
+                             enum ovsrec_led_state_e state,
+                             long long int duration_ms, bool now);
+
+/************************************************************************//**
+ * Function that sets an LED without a round trip through the db: for
+ * ops-ledd/set and ops-ledd/set-many, and for the fan-out of a state to
+ * the child subsystems.
+ *
+ * Logic:
+ *     - without a duration, the state is the new "db" request of the LED:
+ *       led:state is written back by ledd_push_statuses(), and until then
+ *       the state in the db is not taken (the db stays the source of truth
+ *       for the persistent state)
+ *     - with a duration, the state is a request of source "set" that is
+ *       withdrawn when the duration ends, and that is not written to the db
+ *     - if the effective state changed, or the hardware state is not
+ *       known, write the LED now ("now") or queue an interactive write
+ *     - fan the state out to the same LED of the child subsystems
+ ***************************************************************************/
+static void
+ledd_led_set(struct locl_led *led, enum ovsrec_led_state_e state,
+             long long int duration_ms, bool now)
+{
+    bool changed;
+
+    if (duration_ms) {
+        ledd_stats.direct_timed++;
+        changed = ledd_led_post(led, LEDD_SET_SOURCE, LEDD_SET_PRIORITY,
+                                state);
+        led->set_expires = time_msec() + duration_ms;
+        shash_replace(&timed_sets, led->name, led);
+    } else {
+        if (led->state != state) {
+            led->state = state;
+            led->state_dirty = true;
+            state_dirty = true;
+        }
+        changed = ledd_led_post(led, LEDD_DB_SOURCE, LEDD_DB_PRIORITY,
+                                state);
+        ledd_led_refresh(led);
+    }
+
+    if (changed || !led->hw_valid || led->hw_state != led->effective_state) {
+        if (now) {
+            ledd_led_write_now(led);
+        } else {
+            ledd_led_schedule(led, LEDD_WRITE_INTERACTIVE);
+        }
+    }
+
+    ledd_led_fan_out(led, state, duration_ms, now);
+} /* ledd_led_set() */
+
+/************************************************************************//**
+ * Function that fans the state set on an LED out to the LED of the same
+ * name in each child subsystem (see ledd_link_subsystems()), and on to
+ * their children. The children's writes are done in the same scheduler
+ * run (or directly, with "now") as the parent's, and their states and
+ * statuses are written back in one transaction by ledd_push_statuses().
+ ***************************************************************************/
+static void
+ledd_led_fan_out(struct locl_led *led, enum ovsrec_led_state_e state,
+                 long long int duration_ms, bool now)
+{
+    struct shash_node *node;
+
+    if (!led->subsystem->has_children) {
+        return;
+    }
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *child = node->data;
+        struct locl_led *child_led;
+
+        if (child->parent_subsystem != led->subsystem) {
+            continue;
+        }
+        child_led = shash_find_data(&child->subsystem_leds,
+                                    led->yaml_led->name);
+        if (child_led) {
+            ledd_stats.fan_out++;
+            ledd_led_set(child_led, state, duration_ms, now);
+        }
+    }
+} /* ledd_led_fan_out() */
+
+/* withdraw the timed ops-ledd/set requests that ended */
+static void
+ledd_set_run(void)
+{
+    struct shash_node *node, *next;
+    long long int now = time_msec();
+
+    SHASH_FOR_EACH_SAFE(node, next, &timed_sets) {
+        struct locl_led *led = node->data;
+
+        if (led->set_expires <= now) {
+            shash_delete(&timed_sets, node);
+            led->set_expires = 0;
+            if (ledd_led_withdraw(led, LEDD_SET_SOURCE)) {
+                ledd_led_schedule(led, LEDD_WRITE_INTERACTIVE);
+            }
+        }
+    }
+} /* ledd_set_run() */
+
+/* time_msec() when the next timed ops-ledd/set request ends */
+static long long int
+ledd_set_next_expiry(void)
+{
+    const struct shash_node *node;
+    long long int next = LLONG_MAX;
+
+    SHASH_FOR_EACH(node, &timed_sets) {
+        const struct locl_led *led = node->data;
+
+        next = MIN(next, led->set_expires);
+    }
+
+    return(next);
+} /* ledd_set_next_expiry() */
+
+/************************************************************************//**
+ * Function that advances the brightness ramps on the shared tick.
+ *
+ * Logic:
+ *     - the ramps of all LEDs move together, once per LEDD_RAMP_TICK_MS,
+ *       so that their writes go out in one scheduler run (and one bus lock
+ *       batch) instead of one wakeup per LED
+ *     - an LED is only written when its PWM level changes: a slow ramp or
+ *       a coarse PWM field skips the ticks where nothing would change
+ *     - the cost of a tick is one step per ramping LED, it is recorded in
+ *       the stats
+ ***************************************************************************/
+static void
+ledd_ramp_run(void)
+{
+    struct shash_node *node, *next;
+    long long int now = time_msec();
+    long long int start, elapsed;
+
+    if (shash_is_empty(&ramps) || now < ramp_next_tick) {
+        return;
+    }
+    ramp_next_tick = now + LEDD_RAMP_TICK_MS;
+
+    start = time_usec();
+    SHASH_FOR_EACH_SAFE(node, next, &ramps) {
+        struct locl_led *led = node->data;
+        uint32_t pwm_max = led->dim->pwm_max;
+        unsigned int output;
+        bool done;
+
+        output = ledd_ramp_at(&led->ramp, now, &done);
+        if (ledd_ramp_level(output, pwm_max) !=
+            ledd_ramp_level(led->output, pwm_max)) {
+            ledd_stats.ramp_steps++;
+            ledd_led_schedule(led, LEDD_WRITE_INTERACTIVE);
+        }
+        led->output = output;
+        if (done) {
+            shash_delete(&ramps, node);
+            led->ramping = false;
+        }
+    }
+
+    elapsed = time_usec() - start;
+    ledd_stats.ramp_ticks++;
+    ledd_stats.ramp_tick_us += elapsed;
+    if (elapsed > ledd_stats.ramp_tick_max_us) {
+        ledd_stats.ramp_tick_max_us = elapsed;
+    }
+} /* ledd_ramp_run() */
+
+/************************************************************************//**
+ * Function that probes the open breakers whose delay has expired.
+ *
+ * Logic:
+ *     for each open breaker due for a probe
+ *         make it half-open and rewrite one of its LEDs
+ *         if the write succeeded (the breaker closed)
+ *             queue bulk writes of the other LEDs behind the breaker
+ *         else if the probe could not be made (the other breaker of the
+ *                 LED is open)
+ *             keep the breaker open and try again later
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_breaker_run(void)
+{
+    struct shash_node *node, *led_node;
+    long long int now = time_msec();
+
+    if (!breaker_probe_pending) {
+        return;
+    }
+    breaker_probe_pending = false;
+
+    SHASH_FOR_EACH(node, &breakers) {
+        struct ledd_breaker *b = node->data;
+        struct locl_led *probe = NULL;
+
+        if (b->state != LEDD_BREAKER_OPEN) {
+            continue;
+        }
+        if (now < b->retry_at) {
+            breaker_probe_pending = true;
+            continue;
+        }
+
+        SHASH_FOR_EACH(led_node, &led_data) {
+            struct locl_led *led = led_node->data;
+
+            if (led->breakers[b->scope] == b) {
+                probe = led;
+                break;
+            }
+        }
+        if (probe == NULL) {
+            continue;
+        }
+
+        b->state = LEDD_BREAKER_HALF_OPEN;
+        ledd_stats.breaker_probes++;
+        ledd_led_set_status(probe, ledd_led_apply(probe->subsystem, probe));
+        ledd_hw_commit();
+
+        if (b->state == LEDD_BREAKER_CLOSED) {
+            SHASH_FOR_EACH(led_node, &led_data) {
+                struct locl_led *led = led_node->data;
+
+                if (led != probe && led->breakers[b->scope] == b) {
+                    ledd_led_schedule(led, LEDD_WRITE_BULK);
+                }
+            }
+        } else if (b->state == LEDD_BREAKER_HALF_OPEN) {
+            b->state = LEDD_BREAKER_OPEN;
+            b->retry_at = now + b->retry_ms;
+        }
+
+        if (b->state != LEDD_BREAKER_CLOSED) {
+            breaker_probe_pending = true;
+        }
+    }
+} /* ledd_breaker_run() */
+
+/* earliest probe of an open breaker, LLONG_MAX if none is open */
+static long long int
+ledd_breaker_next_probe(void)
+{
+    struct shash_node *node;
+    long long int next = LLONG_MAX;
+
+    SHASH_FOR_EACH(node, &breakers) {
+        struct ledd_breaker *b = node->data;
+
+        if (b->state == LEDD_BREAKER_OPEN) {
+            next = MIN(next, b->retry_at);
+        }
+    }
+
+    return(next);
+} /* ledd_breaker_next_probe() */
+
+/* initialize the subsystem data */
+static void
+init_subsystems(void)
+{
+    shash_init(&subsystem_data);
+    shash_init(&led_data);
+} /* init_subsystems() */
+
+enum ovsrec_led_status_e
+ledd_status_to_enum(char *status)
+{
+    size_t i;
+
+    if (status == NULL) {
+        return(LED_STATUS_UNINITIALIZED);
+    }
+
+    for (i = 0; i < sizeof(led_status_strings)/sizeof(const char *); i++) {
+        if (strcmp(led_status_strings[i], status) == 0) {
+            return( (enum ovsrec_led_status_e)i );
+        }
+    }
+
+    return(LED_STATUS_UNINITIALIZED);
+
+} /* ledd_status_to_enum() */
+
+enum ovsrec_led_state_e
+ledd_state_to_enum(char *state)
+{
+    size_t i;
+
+    if (state == NULL) {
+        return(LED_STATE_OFF);
+    }
+
+    for (i = 0; i < sizeof(led_state_strings)/sizeof(const char *); i++) {
+        if (strcmp(led_state_strings[i], state) == 0) {
+            return( (enum ovsrec_led_state_e)i );
+        }
+    }
+
+    return(LED_STATE_OFF);
+
+} /* ledd_state_to_enum() */
+
+static const char *
+ledd_state_to_string(enum ovsrec_led_state_e state)
+{
+    if ((unsigned int)state <
+                sizeof(led_state_strings)/sizeof(const char *)) {
+        return(led_state_strings[state]);
+    } else {
+        return(led_state_strings[LED_STATE_OFF]);
+    }
+} /* ledd_state_to_string() */
+
+static const char *
+ledd_status_to_string(enum ovsrec_led_status_e status)
+{
+    if ((unsigned int)status < sizeof(led_status_strings)/sizeof(const char *)){
+        return(led_status_strings[status]);
+    } else {
+        return(led_status_strings[LED_STATUS_UNINITIALIZED]);
+    }
+} /* ledd_status_to_string() */
+
+/* append one LED to a text dump */
+static void
+ledd_dump_led_text(struct ds *ds, const struct locl_led *led)
+{
+    ds_put_format(ds, "\tLED name: %s\n", led->name);
+    ds_put_format(ds, "\tLED type: %s\n", led->yaml_led->type);
+    if (led->led_class) {
+        ds_put_format(ds, "\tLED class: %s/%s\n", led_class_root,
+                      led->led_class->name);
+    }
+    if (led->dim && led->dim->pwm_max) {
+        ds_put_format(ds, "\tLED brightness: %u (output %u%s)\n",
+                      led->brightness, led->output,
+                      led->ramping ? ", ramping" : "");
+    } else if (led->dim) {
+        ds_put_format(ds, "\tLED color: %s\n", led->color >= 0
+                      ? led->dim->colors[led->color] : "default");
+    }
+    ds_put_format(ds, "\tLED state: %s\n",
+                                ledd_state_to_string(led->state));
+    ds_put_format(ds, "\tLED effective state: %s\n",
+                                ledd_state_to_string(led->effective_state));
+    ds_put_format(ds, "\tLED status: %s\n",
+                                ledd_status_to_string(led->status));
+    ds_put_format(ds, "\tLED writes: %u (%u failed)\n",
+                                led->write_count, led->write_failures);
+    if (led->last_change) {
+        char *when = xastrftime_msec("%Y-%m-%dT%H:%M:%S.###Z",
+                                     led->last_change, true);
+
+        ds_put_format(ds, "\tLED last change: %s\n", when);
+        free(when);
+    } else {
+        ds_put_cstr(ds, "\tLED last change: never\n");
+    }
+} /* ledd_dump_led_text() */
+
+/* build the json object for one LED */
+static struct json *
+ledd_dump_led_json(const struct locl_led *led)
+{
+    struct json *obj = json_object_create();
+
+    json_object_put_string(obj, "id", led->name);
+    json_object_put_string(obj, "type", led->yaml_led->type);
+    json_object_put_string(obj, "state", ledd_state_to_string(led->state));
+    json_object_put_string(obj, "effective_state",
+                           ledd_state_to_string(led->effective_state));
+    json_object_put_string(obj, "status",
+                           ledd_status_to_string(led->status));
+    json_object_put(obj, "writes", json_integer_create(led->write_count));
+    json_object_put(obj, "write_failures",
+                    json_integer_create(led->write_failures));
+    json_object_put(obj, "last_change_ms",
+                    json_integer_create(led->last_change));
+    if (led->dim && led->dim->pwm_max) {
+        json_object_put(obj, "brightness",
+                        json_integer_create(led->brightness));
+        json_object_put(obj, "output", json_integer_create(led->output));
+    } else if (led->dim) {
+        json_object_put_string(obj, "color", led->color >= 0
+                               ? led->dim->colors[led->color] : "default");
+    }
+
+    return(obj);
+} /* ledd_dump_led_json() */
+
+/************************************************************************//**
+ * Function that handles ops-ledd/dump [--json] [subsystem] [led-glob].
+ *
+ * Subsystems and LEDs are reported in name order so that the output is
+ * stable. The subsystem and led-glob arguments are shell wildcard patterns
+ * (fnmatch) matched against the subsystem name and the LED id.
+ ***************************************************************************/
+static void
+ledd_unixctl_dump(struct unixctl_conn *conn, int argc,
+                          const char *argv[], void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    const struct shash_node **subsystems;
+    const struct shash_node **leds;
+    const char *subsys_glob = NULL;
+    const char *led_glob = NULL;
+    struct json *json_subsystems = NULL;
+    bool json = false;
+    size_t i, j;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--json") == 0) {
+            json = true;
+        } else if (subsys_glob == NULL) {
+            subsys_glob = argv[arg];
+        } else {
+            led_glob = argv[arg];
+        }
+    }
+
+    if (json) {
+        json_subsystems = json_array_create_empty();
+    } else {
+        ds_put_cstr(&ds, "Support Dump for Platform LED Daemon (ops-ledd)\n");
+    }
+
+    subsystems = shash_sort(&subsystem_data);
+
+    for (i = 0; i < shash_count(&subsystem_data); i++) {
+        struct locl_subsystem *subsystem =
+                        (struct locl_subsystem *)subsystems[i]->data;
+        struct json *json_leds = NULL;
+
+        if (subsys_glob && fnmatch(subsys_glob, subsystem->name, 0) != 0) {
+            continue;
+        }
+
+        if (json) {
+            json_leds = json_array_create_empty();
+        } else {
+            ds_put_format(&ds, "\nSubsystem: %s%s\n", subsystem->name,
+                          subsystem->lazy ? " (not activated)" : "");
+            if (subsystem->parent_subsystem) {
+                ds_put_format(&ds, "Parent: %s\n",
+                              subsystem->parent_subsystem->name);
+            }
+        }
+
+        leds = shash_sort(&(subsystem->subsystem_leds));
+
+        for (j = 0; j < shash_count(&(subsystem->subsystem_leds)); j++) {
+            const struct locl_led *led =
+                        (const struct locl_led *)leds[j]->data;
+
+            if (led_glob && fnmatch(led_glob, led->name, 0) != 0) {
+                continue;
+            }
+
+            if (json) {
+                json_array_add(json_leds, ledd_dump_led_json(led));
+            } else {
+                ledd_dump_led_text(&ds, led);
+            }
+        }
+        free(leds);
+
+        if (json) {
+            struct json *obj = json_object_create();
+
+            json_object_put_string(obj, "name", subsystem->name);
+            if (subsystem->parent_subsystem) {
+                json_object_put_string(obj, "parent",
+                                       subsystem->parent_subsystem->name);
+            }
+            json_object_put(obj, "leds", json_leds);
+            json_array_add(json_subsystems, obj);
+        }
+    }
+    free(subsystems);
+
+    if (json) {
+        struct json *top = json_object_create();
+
+        json_object_put(top, "subsystems", json_subsystems);
+        json_to_ds(top, JSSF_SORT, &ds);
+        json_destroy(top);
+    }
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+} /* ledd_unixctl_dump() */
+
+static void
+ledd_unixctl_stats(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                   const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    struct shash_node *node;
+    size_t i;
+
+    ds_put_cstr(&ds, "Statistics for Platform LED Daemon (ops-ledd)\n");
+    if (shard_name) {
+        ds_put_format(&ds, "Shard: %s (%"PRIuSIZE" subsystems)\n",
+                      shard_name, sset_count(&shard_subsystems));
+    }
+
+    ds_put_format(&ds, "\nReconfigure:\n");
+    ds_put_format(&ds, "\tpasses: %u\n", ledd_stats.reconfigure_passes);
+    ds_put_format(&ds, "\tslices cut by the budget: %u\n",
+                  ledd_stats.reconfigure_slices);
+    ds_put_format(&ds, "\tbudget: %lld ms%s\n", reconfigure_budget_ms,
+                  pass_active ? " (pass in progress)" : "");
+
+    ds_put_format(&ds, "\nResync after reconnect:\n");
+    ds_put_format(&ds, "\tresyncs: %u\n", ledd_stats.resyncs);
+    ds_put_format(&ds, "\tlast duration: %lld us\n",
+                  ledd_stats.resync_last_us);
+    ds_put_format(&ds, "\tmax duration: %lld us\n",
+                  ledd_stats.resync_max_us);
+    ds_put_format(&ds, "\ttotal duration: %lld us\n",
+                  ledd_stats.resync_total_us);
+    ds_put_format(&ds, "\tsubsystems in sync: %u\n",
+                  ledd_stats.resync_subsys_clean);
+    ds_put_format(&ds, "\tsubsystems diverged: %u\n",
+                  ledd_stats.resync_subsys_diverged);
+    ds_put_format(&ds, "\tLEDs diverged: %u\n",
+                  ledd_stats.resync_leds_diverged);
+
+    ds_put_format(&ds, "\nWrite scheduler:\n");
+    for (i = 0; i < LEDD_N_WRITE_CLASSES; i++) {
+        const struct ledd_write_queue *q = &write_queues[i];
+
+        ds_put_format(&ds, "\t%s: depth %u (max %u), queued %llu, "
+                      "merged %llu, written %llu, wait avg %lld us "
+                      "max %lld us, starvation %llu\n",
+                      ledd_write_class_strings[i], q->depth, q->max_depth,
+                      q->enqueued, q->coalesced, q->written,
+                      q->written ? q->wait_total_us / (long long) q->written
+                                 : 0,
+                      q->wait_max_us, q->promoted);
+    }
+
+    ds_put_format(&ds, "\nLazy activation: %s\n",
+                  lazy_activation ? "enabled" : "disabled");
+    ds_put_format(&ds, "\tsubsystems deferred: %u\n",
+                  ledd_stats.lazy_deferred);
+    ds_put_format(&ds, "\tsubsystems activated: %u\n",
+                  ledd_stats.lazy_activated);
+
+    ds_put_format(&ds, "\nStatic tables: %"PRIuSIZE" built in (%s)\n",
+                  ledd_n_static_tables,
+                  static_tables_enabled ? "enabled" : "disabled");
+    ds_put_format(&ds, "\tsubsystems added from tables: %u\n",
+                  ledd_stats.static_tables);
+    ds_put_format(&ds, "\ttables not matching their files: %u\n",
+                  ledd_stats.static_mismatches);
+
+    ds_put_format(&ds, "\nDirect set:\n");
+    ds_put_format(&ds, "\tLEDs set: %llu (%llu with a duration, %"PRIuSIZE
+                  " active)\n", ledd_stats.direct_sets,
+                  ledd_stats.direct_timed, shash_count(&timed_sets));
+    ds_put_format(&ds, "\tstates written back: %llu%s, %llu superseded "
+                  "by a newer db state\n", ledd_stats.written_back,
+                  state_dirty || status_txn ? " (pending)" : "",
+                  ledd_stats.writeback_superseded);
+    ds_put_format(&ds, "\twrite-backs retried: %llu\n",
+                  ledd_stats.writeback_retries);
+    ds_put_format(&ds, "\tLEDs set by a parent subsystem: %llu\n",
+                  ledd_stats.fan_out);
+
+    ds_put_format(&ds, "\nFault-LED rules: %"PRIuSIZE"\n", rules.n_rules);
+    ds_put_format(&ds, "\tevaluations: %llu (%u full)\n",
+                  ledd_stats.rule_runs, ledd_stats.rule_resyncs);
+    ds_put_format(&ds, "\tinput rows changed: %llu\n", ledd_stats.rule_rows);
+    ds_put_format(&ds, "\trules changed: %llu\n", ledd_stats.rule_changes);
+    ds_put_format(&ds, "\tevaluation time: avg %llu us, max %llu us\n",
+                  ledd_stats.rule_runs ? ledd_stats.rule_eval_us /
+                                         ledd_stats.rule_runs : 0,
+                  ledd_stats.rule_eval_max_us);
+
+    ds_put_format(&ds, "\nRamps: %"PRIuSIZE" active\n", shash_count(&ramps));
+    ds_put_format(&ds, "\tticks: %llu\n", ledd_stats.ramp_ticks);
+    ds_put_format(&ds, "\tsteps written: %llu\n", ledd_stats.ramp_steps);
+    ds_put_format(&ds, "\ttick time: avg %llu us, max %llu us\n",
+                  ledd_stats.ramp_ticks ? ledd_stats.ramp_tick_us /
+                                          ledd_stats.ramp_ticks : 0,
+                  ledd_stats.ramp_tick_max_us);
+
+    ds_put_format(&ds, "\nChange stream: %s\n",
+                  subscribe_listener ? subscribe_path : "no socket");
+    ds_put_format(&ds, "\tchanges: %"PRIu64" (ring of %"PRIuSIZE", epoch %"
+                  PRIu64")\n", changes.last_seq, changes.capacity,
+                  changes.epoch);
+    ds_put_format(&ds, "\tsubscribers: %"PRIuSIZE" connected, %u accepted, "
+                  "%u refused\n", n_subscribers, ledd_stats.subscribers,
+                  ledd_stats.subscribers_refused);
+    ds_put_format(&ds, "\tresumed: %llu, snapshots: %llu (%llu after "
+                  "falling behind)\n", ledd_stats.subscribe_resumes,
+                  ledd_stats.subscribe_snapshots, ledd_stats.subscribe_behind);
+    ds_put_format(&ds, "\tbytes sent: %llu\n", ledd_stats.subscribe_bytes);
+
+    if (hw_backend == &ledd_proxy_backend) {
+        ds_put_format(&ds, "\nRegister access proxy: %s\n", hw_proxy_path);
+        ds_put_format(&ds, "\trequests: %llu in %llu round trips (max "
+                      "%"PRIuSIZE" per round trip), %llu failed\n",
+                      hw_proxy.requests, hw_proxy.round_trips,
+                      hw_proxy.batch_max, hw_proxy.failures);
+        ds_put_format(&ds, "\tround trip: avg %llu us, max %llu us\n",
+                      hw_proxy.round_trips ? hw_proxy.rtt_total_us /
+                                             hw_proxy.round_trips : 0,
+                      hw_proxy.rtt_max_us);
+        ds_put_format(&ds, "\tconnections: %llu\n", hw_proxy.reconnects);
+    }
+
+    ds_put_format(&ds, "\nBus locks: %s\n",
+                  bus_lock_enabled ? bus_lock_dir : "disabled");
+    SHASH_FOR_EACH(node, &buses) {
+        const struct ledd_bus *bus = node->data;
+        const struct ledd_buslock *lock = &bus->lock;
+
+        ds_put_format(&ds, "\t%s: %llu batches (%llu accesses), %llu "
+                      "contended, %llu timeouts\n", bus->name,
+                      lock->acquisitions, lock->accesses, lock->contended,
+                      lock->timeouts);
+        ds_put_format(&ds, "\t\twait: avg %llu us, max %llu us; hold: avg "
+                      "%llu us, max %llu us\n",
+                      lock->acquisitions ? lock->wait_total_us /
+                                           lock->acquisitions : 0,
+                      lock->wait_max_us,
+                      lock->acquisitions ? lock->hold_total_us /
+                                           lock->acquisitions : 0,
+                      lock->hold_max_us);
+    }
+
+    ds_put_format(&ds, "\nCircuit breakers:\n");
+    ds_put_format(&ds, "\ttrips: %u\n", ledd_stats.breaker_trips);
+    ds_put_format(&ds, "\tprobes: %u\n", ledd_stats.breaker_probes);
+    ds_put_format(&ds, "\taccesses skipped: %llu\n",
+                  ledd_stats.breaker_skipped);
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+} /* ledd_unixctl_stats() */
+
+/************************************************************************//**
+ * Main loop profiler.
+ *
+ * Each iteration of the main loop is split in phases (ledd_run,
+ * unixctl_server_run and poll_block) that are timed separately, so that
+ * busy time can be told from idle time. Each wakeup from poll_block is
+ * attributed to its source: the IDL if the db changed, unixctl if an
+ * ops-ledd command was handled, a timer if one armed with
+ * ledd_timer_wait_until() expired, or "other" (e.g. a lock or echo
+ * message from ovsdb-server, or an OVS library command).
+ ***************************************************************************/
+
+/* trampoline for unixctl commands, so that the profiler sees them */
+struct ledd_unixctl_cmd {
+    unixctl_cb_func *cb;                /*!< Real command handler */
+    void *aux;                          /*!< Real handler's aux data */
+};
+
+static void
+ledd_unixctl_trampoline(struct unixctl_conn *conn, int argc,
+                        const char *argv[], void *cmd_)
+{
+    struct ledd_unixctl_cmd *cmd = cmd_;
+
+    ledd_profile.unixctl_calls++;
+    cmd->cb(conn, argc, argv, cmd->aux);
+} /* ledd_unixctl_trampoline() */
+
+/* unixctl_command_register() for ops-ledd commands */
+static void
+ledd_unixctl_command_register(const char *name, const char *usage,
+                              int min_args, int max_args,
+                              unixctl_cb_func *cb, void *aux)
+{
+    struct ledd_unixctl_cmd *cmd = xmalloc(sizeof *cmd);
+
+    cmd->cb = cb;
+    cmd->aux = aux;
+    unixctl_command_register(name, usage, min_args, max_args,
+                             ledd_unixctl_trampoline, cmd);
+} /* ledd_unixctl_command_register() */
+
+/* poll_timer_wait_until() for ops-ledd timers, so that the profiler can
+   attribute the wakeup */
+static void
+ledd_timer_wait_until(long long int when)
+{
+    if (when < ledd_profile.timer_deadline) {
+        ledd_profile.timer_deadline = when;
+    }
+    poll_timer_wait_until(when);
+} /* ledd_timer_wait_until() */
+
+/* reset the profile counters */
+static void
+ledd_profile_reset(void)
+{
+    memset(ledd_profile.phases, 0, sizeof ledd_profile.phases);
+    memset(ledd_profile.wakeups, 0, sizeof ledd_profile.wakeups);
+    ledd_profile.start_us = time_usec();
+} /* ledd_profile_reset() */
+
+/************************************************************************//**
+ * Function that accounts for one main loop phase that started at "start"
+ * (in us) and logs it if it took longer than the stall threshold.
+ ***************************************************************************/
+static void
+ledd_profile_phase(enum ledd_phase phase, long long int start,
+                   unsigned int hw_writes_before)
+{
+    struct ledd_phase_stats *ps = &ledd_profile.phases[phase];
+    long long int elapsed = time_usec() - start;
+
+    ps->count++;
+    ps->total_us += elapsed;
+    if (elapsed > ps->max_us) {
+        ps->max_us = elapsed;
+    }
+
+    if (phase != LEDD_PHASE_POLL && ledd_profile.stall_threshold_ms > 0 &&
+        elapsed >= ledd_profile.stall_threshold_ms * 1000) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+        ps->stalls++;
+        VLOG_WARN_RL(&rl, "main loop stall: %s took %lld ms (threshold "
+                     "%lld ms), last wakeup %s, %u hw writes, "
+                     "%"PRIuSIZE" subsystems, idl seqno %u",
+                     ledd_phase_strings[phase], elapsed / 1000,
+                     ledd_profile.stall_threshold_ms,
+                     ledd_wakeup_strings[ledd_profile.last_wakeup],
+                     ledd_stats.hw_writes - hw_writes_before,
+                     shash_count(&subsystem_data), idl_seqno);
+    }
+} /* ledd_profile_phase() */
+
+static void
+ledd_unixctl_profile(struct unixctl_conn *conn, int argc,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    long long int elapsed = time_usec() - ledd_profile.start_us;
+    long long int busy = 0;
+    int i;
+
+    if (argc > 1) {
+        if (strcmp(argv[1], "reset") != 0) {
+            unixctl_command_reply_error(conn, "usage: [reset]");
+            return;
+        }
+        ledd_profile_reset();
+        unixctl_command_reply(conn, NULL);
+        return;
+    }
+
+    for (i = 0; i < LEDD_N_PHASES; i++) {
+        if (i != LEDD_PHASE_POLL) {
+            busy += ledd_profile.phases[i].total_us;
+        }
+    }
+
+    ds_put_cstr(&ds, "Main loop profile for Platform LED Daemon (ops-ledd)\n");
+    ds_put_format(&ds, "\nelapsed: %lld ms, busy: %lld ms (%.1f%%), "
+                  "idle: %lld ms\n", elapsed / 1000, busy / 1000,
+                  elapsed ? 100.0 * busy / elapsed : 0.0,
+                  ledd_profile.phases[LEDD_PHASE_POLL].total_us / 1000);
+
+    ds_put_format(&ds, "\n%-20s%12s%14s%12s%12s%8s\n", "phase", "count",
+                  "total (us)", "avg (us)", "max (us)", "stalls");
+    for (i = 0; i < LEDD_N_PHASES; i++) {
+        const struct ledd_phase_stats *ps = &ledd_profile.phases[i];
+
+        ds_put_format(&ds, "%-20s%12llu%14lld%12lld%12lld%8u\n",
+                      ledd_phase_strings[i], ps->count, ps->total_us,
+                      ps->count ? ps->total_us / (long long) ps->count : 0,
+                      ps->max_us, ps->stalls);
+    }
+
+    ds_put_cstr(&ds, "\nwakeups:");
+    for (i = 0; i < LEDD_N_WAKEUPS; i++) {
+        ds_put_format(&ds, " %s %llu", ledd_wakeup_strings[i],
+                      ledd_profile.wakeups[i]);
+    }
+    ds_put_format(&ds, "\nstall threshold: %lld ms\n",
+                  ledd_profile.stall_threshold_ms);
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+} /* ledd_unixctl_profile() */
+
+static void
+ledd_unixctl_stall_threshold(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                             const char *argv[], void *aux OVS_UNUSED)
+{
+    long long int ms;
+
+    if (!str_to_llong(argv[1], 10, &ms) || ms < 0) {
+        unixctl_command_reply_error(conn, "invalid threshold (ms)");
+        return;
+    }
+
+    ledd_profile.stall_threshold_ms = ms;
+    unixctl_command_reply(conn, NULL);
+} /* ledd_unixctl_stall_threshold() */
+
+/* ops-ledd/hw-sim-fail SUBSYSTEM DEVICE [off]: make a simulated device fail
+   (or work again) */
+static void
+ledd_unixctl_hw_sim_fail(struct unixctl_conn *conn, int argc,
+                         const char *argv[], void *aux OVS_UNUSED)
+{
+    char *key;
+
+    if (hw_backend != &ledd_sim_backend) {
+        unixctl_command_reply_error(conn, "hardware is not simulated");
+        return;
+    }
+
+    key = xasprintf("%s/%s", argv[1], argv[2]);
+    if (argc > 3 && !strcmp(argv[3], "off")) {
+        sset_find_and_delete(&hw_sim_fail, key);
+    } else {
+        sset_add(&hw_sim_fail, key);
+    }
+    free(key);
+
+    unixctl_command_reply(conn, NULL);
+} /* ledd_unixctl_hw_sim_fail() */
+
+/* finish a request change made through unixctl: queue a write of the LED
+   if its effective state changed */
+static void
+ledd_request_changed(struct locl_led *led, bool changed)
+{
+    if (changed) {
+        ledd_led_schedule(led, LEDD_WRITE_FAULT);
+    }
+} /* ledd_request_changed() */
+
+/* ops-ledd/request LED SOURCE PRIORITY STATE */
+static void
+ledd_unixctl_request(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    struct locl_led *led;
+    int priority;
+    size_t i;
+
+    led = shash_find_data(&led_data, argv[1]);
+    if (led == NULL) {
+        unixctl_command_reply_error(conn, "no such LED");
+        return;
+    }
+    if (!strcmp(argv[2], LEDD_DB_SOURCE)) {
+        unixctl_command_reply_error(conn, "source \"db\" is reserved");
+        return;
+    }
+    if (!str_to_int(argv[3], 10, &priority)) {
+        unixctl_command_reply_error(conn, "invalid priority");
+        return;
+    }
+    for (i = 0; i < LEDD_N_LED_STATES; i++) {
+        if (!strcmp(argv[4], led_state_strings[i])) {
+            break;
+        }
+    }
+    if (i == LEDD_N_LED_STATES) {
+        unixctl_command_reply_error(conn, "invalid state");
+        return;
+    }
+
+    ledd_request_changed(led, ledd_led_post(led, argv[2], priority,
+                                            (enum ovsrec_led_state_e) i));
+    unixctl_command_reply(conn, ledd_state_to_string(led->effective_state));
+} /* ledd_unixctl_request() */
+
+/* ops-ledd/release LED SOURCE */
+static void
+ledd_unixctl_release(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    struct locl_led *led;
+
+    led = shash_find_data(&led_data, argv[1]);
+    if (led == NULL) {
+        unixctl_command_reply_error(conn, "no such LED");
+        return;
+    }
+    if (!strcmp(argv[2], LEDD_DB_SOURCE)) {
+        unixctl_command_reply_error(conn, "source \"db\" is reserved");
+        return;
+    }
+
+    ledd_request_changed(led, ledd_led_withdraw(led, argv[2]));
+    unixctl_command_reply(conn, ledd_state_to_string(led->effective_state));
+} /* ledd_unixctl_release() */
+
+/* parse an LED state name, returns false if it is not one */
+static bool
+ledd_parse_state(const char *s, enum ovsrec_led_state_e *statep)
+{
+    size_t i;
+
+    for (i = 0; i < LEDD_N_LED_STATES; i++) {
+        if (!strcmp(s, led_state_strings[i])) {
+            *statep = (enum ovsrec_led_state_e) i;
+            return(true);
+        }
+    }
+
+    return(false);
+} /* ledd_parse_state() */
+
+/* parse the duration (seconds) of an ops-ledd/set, 0 for none */
+static bool
+ledd_parse_duration(const char *s, long long int *duration_msp)
+{
+    int seconds;
+
+    if (!str_to_int(s, 10, &seconds) || seconds < 0) {
+        return(false);
+    }
+    *duration_msp = seconds * 1000LL;
+
+    return(true);
+} /* ledd_parse_duration() */
+
+/************************************************************************//**
+ * Function that sets LEDs directly for ops-ledd/set and ops-ledd/set-many,
+ * and replies with the effective state and status of each LED. Every
+ * argument is checked before any LED is set.
+ ***************************************************************************/
+static void
+ledd_set_leds(struct unixctl_conn *conn, size_t n, const char *names[],
+              const enum ovsrec_led_state_e states[],
+              long long int duration_ms)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    struct locl_led **leds;
+    size_t i;
+
+    if (!ovsdb_idl_has_lock(idl)) {
+        unixctl_command_reply_error(conn, "not active (no db lock)");
+        return;
+    }
+
+    leds = xmalloc(n * sizeof *leds);
+    for (i = 0; i < n; i++) {
+        leds[i] = shash_find_data(&led_data, names[i]);
+        if (leds[i] == NULL) {
+            ds_put_format(&ds, "no such LED %s", names[i]);
+            unixctl_command_reply_error(conn, ds_cstr(&ds));
+            ds_destroy(&ds);
+            free(leds);
+            return;
+        }
+        if (leds[i]->values &&
+            !ledd_type_takes(leds[i]->type_id, states[i])) {
+            ds_put_format(&ds, "LED %s (type %s) has no state %s", names[i],
+                          leds[i]->yaml_led->type,
+                          ledd_state_to_string(states[i]));
+            unixctl_command_reply_error(conn, ds_cstr(&ds));
+            ds_destroy(&ds);
+            free(leds);
+            return;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        ledd_stats.direct_sets++;
+        ledd_led_set(leds[i], states[i], duration_ms, true);
+    }
+    ledd_buses_release();
+    ledd_hw_commit();
+
+    for (i = 0; i < n; i++) {
+        ds_put_format(&ds, "%s: %s (%s)\n", leds[i]->name,
+                      ledd_state_to_string(leds[i]->effective_state),
+                      ledd_status_to_string(leds[i]->status));
+    }
+    free(leds);
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+} /* ledd_set_leds() */
+
+/* ops-ledd/set LED STATE [DURATION] */
+static void
+ledd_unixctl_set(struct unixctl_conn *conn, int argc, const char *argv[],
+                 void *aux OVS_UNUSED)
+{
+    enum ovsrec_led_state_e state;
+    long long int duration_ms = 0;
+
+    if (!ledd_parse_state(argv[2], &state)) {
+        unixctl_command_reply_error(conn, "invalid state");
+        return;
+    }
+    if (argc > 3 && !ledd_parse_duration(argv[3], &duration_ms)) {
+        unixctl_command_reply_error(conn, "invalid duration");
+        return;
+    }
+
+    ledd_set_leds(conn, 1, &argv[1], &state, duration_ms);
+} /* ledd_unixctl_set() */
+
+/* ops-ledd/set-many [--duration=S] LED=STATE... */
+static void
+ledd_unixctl_set_many(struct unixctl_conn *conn, int argc,
+                      const char *argv[], void *aux OVS_UNUSED)
+{
+    enum ovsrec_led_state_e *states;
+    long long int duration_ms = 0;
+    const char **names;
+    size_t n = 0;
+    int i = 1;
+
+    if (!strncmp(argv[i], "--duration=", 11)) {
+        if (!ledd_parse_duration(argv[i] + 11, &duration_ms)) {
+            unixctl_command_reply_error(conn, "invalid duration");
+            return;
+        }
+        i++;
+    }
+
+    names = xmalloc(argc * sizeof *names);
+    states = xmalloc(argc * sizeof *states);
+    for (; i < argc; i++) {
+        const char *eq = strrchr(argv[i], '=');
+
+        if (eq == NULL || eq == argv[i] ||
+            !ledd_parse_state(eq + 1, &states[n])) {
+            struct ds ds = DS_EMPTY_INITIALIZER;
+
+            ds_put_format(&ds, "%s: expected LED=STATE", argv[i]);
+            unixctl_command_reply_error(conn, ds_cstr(&ds));
+            ds_destroy(&ds);
+            goto out;
+        }
+        names[n++] = xmemdup0(argv[i], eq - argv[i]);
+    }
+
+    if (n == 0) {
+        unixctl_command_reply_error(conn, "no LED");
+    } else {
+        ledd_set_leds(conn, n, names, states, duration_ms);
+    }
+
+out:
+    while (n > 0) {
+        free(CONST_CAST(char *, names[--n]));
+    }
+    free(names);
+    free(states);
+} /* ledd_unixctl_set_many() */
+
+/* the dimmable or multicolor LED of a command, NULL (with an error reply)
+   if there is none */
+static struct locl_led *
+ledd_unixctl_dim_led(struct unixctl_conn *conn, const char *name, bool pwm)
+{
+    struct locl_led *led;
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    if (!ovsdb_idl_has_lock(idl)) {
+        unixctl_command_reply_error(conn, "not active (no db lock)");
+        return(NULL);
+    }
+
+    led = shash_find_data(&led_data, name);
+    if (led == NULL) {
+        ds_put_format(&ds, "no such LED %s", name);
+    } else if (led->dim == NULL ||
+               (pwm ? !led->dim->pwm_max : !led->dim->n_colors)) {
+        ds_put_format(&ds, "LED %s has no %s in %s", name,
+                      pwm ? "pwm" : "colors", LEDD_LED_DIM_FILE);
+    } else {
+        return(led);
+    }
+
+    unixctl_command_reply_error(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+    return(NULL);
+} /* ledd_unixctl_dim_led() */
+
+/************************************************************************//**
+ * Function that handles ops-ledd/brightness LED LEVEL [FADE_MS]: sets the
+ * brightness (0 to LEDD_RAMP_MAX) of a PWM-dimmable LED when it is on.
+ * The LED fades to it in FADE_MS (default: the fade of led-dim.conf). The
+ * brightness is not kept in the db, and is lost on a restart.
+ ***************************************************************************/
+static void
+ledd_unixctl_brightness(struct unixctl_conn *conn, int argc,
+                        const char *argv[], void *aux OVS_UNUSED)
+{
+    struct locl_led *led;
+    int brightness;
+    int fade_ms;
+
+    led = ledd_unixctl_dim_led(conn, argv[1], true);
+    if (led == NULL) {
+        return;
+    }
+    if (!str_to_int(argv[2], 10, &brightness) || brightness < 0 ||
+        brightness > LEDD_RAMP_MAX) {
+        unixctl_command_reply_error(conn, "invalid level");
+        return;
+    }
+    fade_ms = led->dim->fade_ms;
+    if (argc > 3 && (!str_to_int(argv[3], 10, &fade_ms) || fade_ms < 0)) {
+        unixctl_command_reply_error(conn, "invalid fade");
+        return;
+    }
+
+    led->brightness = brightness;
+    if (led->effective_state == LED_STATE_ON) {
+        ledd_led_ramp(led, brightness, fade_ms);
+        if (!led->ramping) {
+            ledd_led_schedule(led, LEDD_WRITE_INTERACTIVE);
+        }
+    }
+
+    unixctl_command_reply(conn, NULL);
+} /* ledd_unixctl_brightness() */
+
+/* ops-ledd/color LED COLOR|default: the color of a multicolor LED when it
+   is on, "default" being the setting of its type */
+static void
+ledd_unixctl_color(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                   const char *argv[], void *aux OVS_UNUSED)
+{
+    struct locl_led *led;
+    int color = -1;
+    size_t i;
+
+    led = ledd_unixctl_dim_led(conn, argv[1], false);
+    if (led == NULL) {
+        return;
+    }
+    if (strcmp(argv[2], "default")) {
+        for (i = 0; i < led->dim->n_colors; i++) {
+            if (!strcmp(argv[2], led->dim->colors[i])) {
+                color = i;
+                break;
+            }
+        }
+        if (color < 0) {
+            unixctl_command_reply_error(conn, "invalid color");
+            return;
+        }
+    }
+
+    if (led->color != color) {
+        led->color = color;
+        if (led->effective_state == LED_STATE_ON) {
+            ledd_led_schedule(led, LEDD_WRITE_INTERACTIVE);
+        }
+    }
+
+    unixctl_command_reply(conn, NULL);
+} /* ledd_unixctl_color() */
+
+/* ************ CHANGE STREAM ************ */
+
+/* append a snapshot of all LEDs, returns the change it is current at */
+static uint64_t
+ledd_changes_put_snapshot(struct ds *ds)
+{
+    const struct shash_node *node;
+
+    ds_put_format(ds, "SNAPSHOT %"PRIu64" %"PRIu64"\n", changes.epoch,
+                  changes.last_seq);
+    SHASH_FOR_EACH(node, &led_data) {
+        const struct locl_led *led = node->data;
+
+        ds_put_format(ds, "LED %s %s %s %lld\n", led->name,
+                      led_state_strings[led->effective_state],
+                      led_status_strings[led->status], led->last_change);
+    }
+    ds_put_cstr(ds, "END\n");
+    ledd_stats.subscribe_snapshots++;
+
+    return(changes.last_seq);
+} /* ledd_changes_put_snapshot() */
+
+/* start a stream: resume after the cursor of the client ("resume") if
+   the ring still has the changes after it, else send a snapshot; returns
+   the cursor to continue from */
+static uint64_t
+ledd_changes_start(struct ds *ds, bool resume, uint64_t epoch,
+                   uint64_t cursor)
+{
+    if (resume && ledd_changes_can_resume(&changes, epoch, cursor)) {
+        ledd_stats.subscribe_resumes++;
+        ds_put_format(ds, "RESUME %"PRIu64" %"PRIu64"\n", epoch, cursor);
+        return(cursor);
+    }
+
+    return(ledd_changes_put_snapshot(ds));
+} /* ledd_changes_start() */
+
+/************************************************************************//**
+ * Function that appends the changes after "cursor" to ds, while ds is
+ * shorter than max. If the ring has moved past the cursor (the client is
+ * too slow), a snapshot is sent instead and the stream goes on from it.
+ *
+ * Returns: the new cursor
+ ***************************************************************************/
+static uint64_t
+ledd_changes_put(struct ds *ds, uint64_t cursor, size_t max)
+{
+    while (cursor < changes.last_seq && ds->length < max) {
+        const struct ledd_change *change;
+
+        if (!ledd_changes_can_resume(&changes, changes.epoch, cursor)) {
+            ledd_stats.subscribe_behind++;
+            cursor = ledd_changes_put_snapshot(ds);
+            continue;
+        }
+
+        change = ledd_changes_get(&changes, ++cursor);
+        if (change->removed) {
+            ds_put_format(ds, "REMOVE %"PRIu64" %s %"PRId64"\n", change->seq,
+                          change->id, change->time_ms);
+        } else {
+            ds_put_format(ds, "CHANGE %"PRIu64" %s %s %s %"PRId64"\n",
+                          change->seq, change->id, change->state,
+                          change->status, change->time_ms);
+        }
+    }
+
+    return(cursor);
+} /* ledd_changes_put() */
+
+/* parse the "<epoch> <seq>" cursor of a client */
+static bool
+ledd_parse_cursor(const char *epoch_s, const char *seq_s, uint64_t *epochp,
+                  uint64_t *seqp)
+{
+    unsigned long long int epoch, seq;
+
+    if (!str_to_ullong(epoch_s, 10, &epoch) ||
+        !str_to_ullong(seq_s, 10, &seq)) {
+        return(false);
+    }
+    *epochp = epoch;
+    *seqp = seq;
+
+    return(true);
+} /* ledd_parse_cursor() */
+
+/* handle the "SUBSCRIBE [<epoch> <seq>]" line of a subscriber */
+static bool
+ledd_subscriber_hello(struct ledd_subscriber *sub)
+{
+    char *save_ptr = NULL;
+    char *word, *epoch_s, *seq_s;
+    uint64_t epoch = 0, cursor = 0;
+
+    word = strtok_r(sub->hello, " \t\r\n", &save_ptr);
+    epoch_s = strtok_r(NULL, " \t\r\n", &save_ptr);
+    seq_s = strtok_r(NULL, " \t\r\n", &save_ptr);
+    if (word == NULL || strcmp(word, "SUBSCRIBE") ||
+        (epoch_s && !seq_s) || strtok_r(NULL, " \t\r\n", &save_ptr) ||
+        (epoch_s && !ledd_parse_cursor(epoch_s, seq_s, &epoch, &cursor))) {
+        return(false);
+    }
+
+    sub->cursor = ledd_changes_start(&sub->out, epoch_s != NULL, epoch,
+                                     cursor);
+    sub->subscribed = true;
+
+    return(true);
+} /* ledd_subscriber_hello() */
+
+/************************************************************************//**
+ * Function that serves one subscriber without blocking.
+ *
+ * Logic:
+ *     - read the SUBSCRIBE line, then only look for the end of the
+ *       connection (anything else the client sends is ignored)
+ *     - queue the changes after the cursor of the client, while less than
+ *       LEDD_SUBSCRIBER_BACKLOG bytes are waiting to be sent: the changes
+ *       of a slow client wait in the ring (or become a snapshot) instead
+ *       of in memory
+ *     - send what the socket takes
+ *
+ * Returns: False if the subscriber must be closed
+ ***************************************************************************/
+static bool
+ledd_subscriber_run(struct ledd_subscriber *sub)
+{
+    int retval;
+
+    stream_run(sub->stream);
+
+    if (!sub->subscribed) {
+        retval = stream_recv(sub->stream, sub->hello + sub->hello_len,
+                             sizeof sub->hello - 1 - sub->hello_len);
+        if (retval == -EAGAIN) {
+            return(true);
+        } else if (retval <= 0) {
+            return(false);
+        }
+        sub->hello_len += retval;
+        sub->hello[sub->hello_len] = '\0';
+
+        if (strchr(sub->hello, '\n') == NULL) {
+            /* wait for the rest of the line, if it can fit */
+            return(sub->hello_len < sizeof sub->hello - 1);
+        }
+        if (!ledd_subscriber_hello(sub)) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+            VLOG_WARN_RL(&rl, "%s: expected \"SUBSCRIBE [<epoch> <seq>]\"",
+                         stream_get_name(sub->stream));
+            return(false);
+        }
+    } else {
+        char buf[64];
+
+        retval = stream_recv(sub->stream, buf, sizeof buf);
+        if (retval != -EAGAIN && retval <= 0) {
+            return(false);
+        }
+    }
+
+    sub->cursor = ledd_changes_put(&sub->out, sub->cursor,
+                                   sub->out_ofs + LEDD_SUBSCRIBER_BACKLOG);
+
+    while (sub->out_ofs < sub->out.length) {
+        retval = stream_send(sub->stream, sub->out.string + sub->out_ofs,
+                             sub->out.length - sub->out_ofs);
+        if (retval == -EAGAIN) {
+            break;
+        } else if (retval < 0) {
+            return(false);
+        }
+        sub->out_ofs += retval;
+        ledd_stats.subscribe_bytes += retval;
+    }
+    if (sub->out_ofs == sub->out.length) {
+        ds_clear(&sub->out);
+        sub->out_ofs = 0;
+    }
+
+    return(true);
+} /* ledd_subscriber_run() */
+
+static void
+ledd_subscriber_close(struct ledd_subscriber *sub)
+{
+    stream_close(sub->stream);
+    ds_destroy(&sub->out);
+    free(sub);
+} /* ledd_subscriber_close() */
+
+/* accept the new subscribers and serve them all */
+static void
+ledd_subscribers_run(void)
+{
+    struct stream *stream;
+    size_t i;
+
+    while (subscribe_listener &&
+           !pstream_accept(subscribe_listener, &stream)) {
+        struct ledd_subscriber *sub;
+
+        if (n_subscribers >= LEDD_SUBSCRIBERS_MAX) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+            VLOG_WARN_RL(&rl, "%s: more than %d subscribers, connection "
+                         "refused", subscribe_path, LEDD_SUBSCRIBERS_MAX);
+            ledd_stats.subscribers_refused++;
+            stream_close(stream);
+            continue;
+        }
+
+        sub = xzalloc(sizeof *sub);
+        sub->stream = stream;
+        ds_init(&sub->out);
+        subscribers[n_subscribers++] = sub;
+        ledd_stats.subscribers++;
+    }
+
+    for (i = 0; i < n_subscribers; ) {
+        if (ledd_subscriber_run(subscribers[i])) {
+            i++;
+        } else {
+            ledd_subscriber_close(subscribers[i]);
+            subscribers[i] = subscribers[--n_subscribers];
+        }
+    }
+} /* ledd_subscribers_run() */
+
+static void
+ledd_subscribers_wait(void)
+{
+    size_t i;
 
-    /* Get the LED type */
-    type = ledd_get_led_type(subsys, led->yaml_led->type);
-    if (type == (YamlLedType *) NULL) {
-        VLOG_DBG("ledd_write: type is null");
-        return (false);
+    if (subscribe_listener) {
+        pstream_wait(subscribe_listener);
     }
 
-    settings = &(type->settings);
+    for (i = 0; i < n_subscribers; i++) {
+        struct ledd_subscriber *sub = subscribers[i];
 
-    if (settings == NULL) {
-        VLOG_WARN("No settings for subsystem %s, LED %s",
-                subsys->name, led->name);
-        return (false);
-    }
-
-    /* Get the value to set the LED to. */
-    if (type->type == (char *) NULL) {
-        VLOG_WARN("led type is NULL for subsystem %s, LED %s",
-                subsys->name, led->name);
-        return (false);
-    }
-
-    /* Get the settings for this type */
-    type_value = ledd_led_type_string_to_enum(type->type);
-    switch (type_value) {
-        case LED_LOC:
-            switch (led->state) {
-                case LED_STATE_FLASHING:
-                    value = settings->flashing;
-                    break;
-                case LED_STATE_OFF:
-                    value = settings->off;
-                    break;
-                case LED_STATE_ON:
-                    value = settings->on;
-                    break;
-                default:
-                    VLOG_WARN("Invalid state %d for subsystem %s, LED %s",
-                            led->state, subsys->name, led->name);
-                    return(false);
-            }
-            break;
-        case LED_UNKNOWN:
-            /* Fall through */
-        default:
-            VLOG_WARN("Unknown or no type %d for subsystem %s, LED %s",
-                            type_value, subsys->name, led->name);
-            return(false);
+        stream_run_wait(sub->stream);
+        stream_recv_wait(sub->stream);
+        if (sub->out_ofs < sub->out.length) {
+            stream_send_wait(sub->stream);
+        } else if (sub->subscribed && sub->cursor < changes.last_seq) {
+            poll_immediate_wake();
+        }
     }
+} /* ledd_subscribers_wait() */
 
-    rc = i2c_reg_write(yaml_handle, subsys->name, reg_op, value);
+/* ops-ledd/changes [EPOCH SEQ]: the change stream for the clients that
+   poll, the changes after the cursor or a snapshot */
+static void
+ledd_unixctl_changes(struct unixctl_conn *conn, int argc,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    uint64_t epoch = 0, cursor = 0;
 
-    if (rc != 0) {
-        VLOG_WARN("subsystem %s: unable to set LED control register (%d)",
-                    subsys->name, rc);
-        return(false);
+    if (argc == 2 ||
+        (argc > 2 && !ledd_parse_cursor(argv[1], argv[2], &epoch, &cursor))) {
+        unixctl_command_reply_error(conn, "expected EPOCH SEQ");
+        return;
     }
 
-    return(true);
-} /* ledd_write_led() */
+    cursor = ledd_changes_start(&ds, argc > 2, epoch, cursor);
+    ledd_changes_put(&ds, cursor, SIZE_MAX);
 
-/* initialize the subsystem data */
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+} /* ledd_unixctl_changes() */
+
+/* ops-ledd/requests [led-glob]: show the request stack of the LEDs */
 static void
-init_subsystems(void)
+ledd_unixctl_requests(struct unixctl_conn *conn, int argc,
+                      const char *argv[], void *aux OVS_UNUSED)
 {
-    shash_init(&subsystem_data);
-} /* init_subsystems() */
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    const struct shash_node **leds;
+    size_t i, j;
 
-enum ovsrec_led_status_e
-ledd_status_to_enum(char *status)
-{
-    size_t i;
+    leds = shash_sort(&led_data);
+    for (i = 0; i < shash_count(&led_data); i++) {
+        const struct locl_led *led = leds[i]->data;
 
-    if (status == NULL) {
-        return(LED_STATUS_UNINITIALIZED);
-    }
+        if (argc > 1 && fnmatch(argv[1], led->name, 0) != 0) {
+            continue;
+        }
 
-    for (i = 0; i < sizeof(led_status_strings)/sizeof(const char *); i++) {
-        if (strcmp(led_status_strings[i], status) == 0) {
-            return( (enum ovsrec_led_status_e)i );
+        ds_put_format(&ds, "%s: %s\n", led->name,
+                      ledd_state_to_string(led->effective_state));
+        for (j = 0; j < led->n_requests; j++) {
+            const struct ledd_request *req = &led->requests[j];
+            char *when = xastrftime_msec("%Y-%m-%dT%H:%M:%S.###Z",
+                                         req->posted, true);
+
+            ds_put_format(&ds, "\t%6d %-16s %-10s %s%s\n", req->priority,
+                          req->source, ledd_state_to_string(req->state),
+                          when, j == 0 ? " (winner)" : "");
+            free(when);
         }
     }
+    free(leds);
 
-    return(LED_STATUS_UNINITIALIZED);
-
-} /* ledd_status_to_enum() */
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+} /* ledd_unixctl_requests() */
 
-enum ovsrec_led_state_e
-ledd_state_to_enum(char *state)
+/* ops-ledd/breakers: show the device and bus breakers */
+static void
+ledd_unixctl_breakers(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                      const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
 {
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    const struct shash_node **nodes;
+    long long int now = time_msec();
     size_t i;
 
-    if (state == NULL) {
-        return(LED_STATE_OFF);
-    }
+    ds_put_format(&ds, "threshold: %u errors, first probe after %lld ms\n",
+                  breaker_threshold, breaker_retry_ms);
 
-    for (i = 0; i < sizeof(led_state_strings)/sizeof(const char *); i++) {
-        if (strcmp(led_state_strings[i], state) == 0) {
-            return( (enum ovsrec_led_state_e)i );
+    nodes = shash_sort(&breakers);
+    for (i = 0; i < shash_count(&breakers); i++) {
+        const struct ledd_breaker *b = nodes[i]->data;
+
+        ds_put_format(&ds, "%s: %s, %u LEDs, %u errors (%llu total), "
+                      "%u trips, %llu skipped", b->name,
+                      ledd_breaker_state_strings[b->state], b->n_leds,
+                      b->errors, b->total_errors, b->trips, b->skipped);
+        if (b->state == LEDD_BREAKER_OPEN) {
+            ds_put_format(&ds, ", probe in %lld ms",
+                          MAX(b->retry_at - now, 0));
         }
+        ds_put_char(&ds, '\n');
     }
+    free(nodes);
 
-    return(LED_STATE_OFF);
-
-} /* ledd_state_to_enum() */
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+} /* ledd_unixctl_breakers() */
 
-static const char *
-ledd_state_to_string(enum ovsrec_led_state_e state)
+/* current resident set size in kB, 0 if unknown */
+static unsigned long
+ledd_rss_kb(void)
 {
-    if ((unsigned int)state <
-                sizeof(led_state_strings)/sizeof(const char *)) {
-        return(led_state_strings[state]);
-    } else {
-        return(led_state_strings[LED_STATE_OFF]);
-    }
-} /* ledd_state_to_string() */
+    unsigned long pages = 0;
+    FILE *file;
 
-static const char *
-ledd_status_to_string(enum ovsrec_led_status_e status)
-{
-    if ((unsigned int)status < sizeof(led_status_strings)/sizeof(const char *)){
-        return(led_status_strings[status]);
-    } else {
-        return(led_status_strings[LED_STATUS_UNINITIALIZED]);
+    file = fopen("/proc/self/statm", "r");
+    if (file) {
+        if (fscanf(file, "%*lu %lu", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(file);
     }
-} /* ledd_status_to_string() */
 
+    return(pages * (getpagesize() / 1024));
+} /* ledd_rss_kb() */
+
+/************************************************************************//**
+ * Function that shows the memory used by each subsystem (or by the given
+ * one) and by the global structures, next to the resident set size, so
+ * that the RSS can be split between ops-ledd's own data, the config-yaml
+ * data and the rest (IDL replica, libraries).
+ *
+ * Returns:  void
+ ***************************************************************************/
 static void
-ledd_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
-                          const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+ledd_unixctl_memory(struct unixctl_conn *conn, int argc,
+                    const char *argv[], void *aux OVS_UNUSED)
 {
     struct ds ds = DS_EMPTY_INITIALIZER;
-    struct shash_node *snode;
-    struct shash_node *lnode;
-
-    ds_put_cstr(&ds, "Support Dump for Platform LED Daemon (ops-ledd)\n");
+    const struct shash_node **nodes;
+    struct ledd_subsys_memory mem;
+    struct rusage usage;
+    size_t total = 0;
+    size_t n_leds = 0;
+    size_t bytes;
+    size_t i;
 
-    SHASH_FOR_EACH(snode, &subsystem_data) {
-        struct locl_subsystem *subsystem = (struct locl_subsystem *)snode->data;
+    if (argc > 1 && !shash_find(&subsystem_data, argv[1])) {
+        unixctl_command_reply_error(conn, "no such subsystem");
+        return;
+    }
 
-        ds_put_format(&ds, "\nSubsystem: %s\n", subsystem->name);
+    ds_put_format(&ds, "%-16s %6s %10s %10s %10s %10s %10s\n", "subsystem",
+                  "LEDs", "leds", "requests", "LED class", "hw desc",
+                  "total");
 
-        SHASH_FOR_EACH(lnode, &(subsystem->subsystem_leds)) {
-            struct locl_led *led = (struct locl_led *)lnode->data;
+    nodes = shash_sort(&subsystem_data);
+    for (i = 0; i < shash_count(&subsystem_data); i++) {
+        const struct locl_subsystem *subsys = nodes[i]->data;
+        size_t sum;
 
-            ds_put_format(&ds, "\tLED name: %s\n", led->name);
-            ds_put_format(&ds, "\tLED type: %s\n", led->yaml_led->type);
-            ds_put_format(&ds, "\tLED state: %s\n",
-                                        ledd_state_to_string(led->state));
-            ds_put_format(&ds, "\tLED status: %s\n",
-                                        ledd_status_to_string(led->status));
+        if (argc > 1 && strcmp(subsys->name, argv[1])) {
+            continue;
         }
+        ledd_subsys_memory(subsys, &mem);
+        sum = mem.leds + mem.requests + mem.led_class + mem.hw_desc;
+        ds_put_format(&ds, "%-16s %6"PRIuSIZE" %10"PRIuSIZE" %10"PRIuSIZE
+                      " %10"PRIuSIZE" %10"PRIuSIZE" %10"PRIuSIZE"\n",
+                      subsys->name, shash_count(&subsys->subsystem_leds),
+                      mem.leds, mem.requests, mem.led_class, mem.hw_desc,
+                      sum);
+        total += sum;
+        n_leds += shash_count(&subsys->subsystem_leds);
+    }
+    free(nodes);
+
+    if (argc > 1) {
+        unixctl_command_reply(conn, ds_cstr(&ds));
+        ds_destroy(&ds);
+        return;
+    }
+
+    ds_put_cstr(&ds, "\nGlobal:\n");
+    bytes = ledd_mem_buckets(&subsystem_data) + ledd_mem_buckets(&led_data);
+    ds_put_format(&ds, "\tindexes: %"PRIuSIZE"\n", bytes);
+    total += bytes;
+    bytes = ledd_breakers_memory();
+    ds_put_format(&ds, "\tbreakers: %"PRIuSIZE"\n", bytes);
+    total += bytes;
+    bytes = ledd_sched_memory();
+    ds_put_format(&ds, "\twrite queues: %"PRIuSIZE"\n", bytes);
+    total += bytes;
+    if (hw_backend == &ledd_sim_backend) {
+        bytes = ledd_sim_memory();
+        ds_put_format(&ds, "\tsimulated registers: %"PRIuSIZE"\n", bytes);
+        total += bytes;
     }
+    ds_put_format(&ds, "\ttotal: %"PRIuSIZE, total);
+    if (n_leds) {
+        ds_put_format(&ds, " (%"PRIuSIZE" per 1000 LEDs)",
+                      total * 1000 / n_leds);
+    }
+    ds_put_char(&ds, '\n');
+    if (led_table_enabled) {
+        ds_put_format(&ds, "\tLED table mapping: %"PRIuSIZE"\n",
+                      led_table.size);
+    }
+    ds_put_format(&ds, "\treleased: %llu bytes in %u compactions\n",
+                  ledd_stats.compacted_bytes, ledd_stats.compactions);
+
+    getrusage(RUSAGE_SELF, &usage);
+    ds_put_format(&ds, "\nResident set size: %lu kB (peak %ld kB)\n",
+                  ledd_rss_kb(), usage.ru_maxrss);
 
     unixctl_command_reply(conn, ds_cstr(&ds));
     ds_destroy(&ds);
-} /* ledd_unixctl_dump() */
+} /* ledd_unixctl_memory() */
+
+/* ops-ledd/record FILE|off: start recording in FILE, or stop recording */
+static void
+ledd_unixctl_record(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                    const char *argv[], void *aux OVS_UNUSED)
+{
+    char *reply;
+    int error;
+
+    if (!strcmp(argv[1], "off")) {
+        if (!trace_enabled) {
+            unixctl_command_reply_error(conn, "not recording");
+            return;
+        }
+        ledd_trace_close(&trace);
+        trace_enabled = false;
+        reply = xasprintf("%llu records", trace.records);
+        unixctl_command_reply(conn, reply);
+        free(reply);
+        return;
+    }
+
+    error = ledd_record_start(argv[1]);
+    if (error) {
+        unixctl_command_reply_error(conn, ovs_strerror(error));
+        return;
+    }
+    unixctl_command_reply(conn, NULL);
+} /* ledd_unixctl_record() */
 
 static void
 usage(void)
@@ -356,8 +3935,52 @@ usage(void)
     vlog_usage();
     printf("\nOther options:\n"
            "  --unixctl=SOCKET        override default control socket name\n"
+           "  --led-table=FILE        publish LED states in FILE\n"
+           "                          (default: %s)\n"
+           "  --no-led-table          do not publish the LED state table\n"
+           "  --stall-threshold=MS    log main loop phases longer than MS\n"
+           "                          (default: %d, 0 to disable)\n"
+           "  --hw-sim[=DELAY_US]     simulate LED hardware (for testing)\n"
+           "  --breaker-threshold=N   consecutive hardware errors that open\n"
+           "                          a device or bus breaker\n"
+           "                          (default: %d, 0 to disable)\n"
+           "  --breaker-retry=MS      first probe of an open breaker after MS\n"
+           "                          (default: %d)\n"
+           "  --led-class-root=DIR    directory of the LED-class LEDs\n"
+           "                          (default: %s)\n"
+           "  --reconfigure-budget=MS  split reconfigure passes in slices\n"
+           "                          of MS (default: %d, 0 for no limit)\n"
+           "  --lazy-activation       defer the device setup and LED writes\n"
+           "                          of a subsystem until one of its LEDs\n"
+           "                          is not off\n"
+           "  --shard=NAME            run as shard NAME, next to other\n"
+           "                          shards (lock ops_ledd_NAME, daemon\n"
+           "                          row %s-NAME)\n"
+           "  --shard-subsystems=LIST  comma-separated subsystems owned by\n"
+           "                          the shard\n"
+           "  --shards=LIST           comma-separated names of all the\n"
+           "                          shards; the last one through sets\n"
+           "                          cur_hw in the daemon row %s\n"
+           "  --record=FILE           record a trace for ops-ledd-replay\n"
+           "  --no-static-tables      parse the hardware description files\n"
+           "                          even if static tables match them\n"
+           "  --rules=FILE            evaluate the fault-LED rules of FILE\n"
+           "  --bus-lock-dir=DIR      take the platform bus locks in DIR\n"
+           "                          (default: %s, not taken\n"
+           "                          with --hw-sim unless given)\n"
+           "  --no-bus-lock           do not take the platform bus locks\n"
+           "  --subscribe-socket=FILE  stream LED changes to the clients\n"
+           "                          of the unix socket FILE\n"
+           "  --hw-proxy[=SOCKET]     access the LED registers through\n"
+           "                          ops-ledd-hwproxy (default: %s)\n"
            "  -h, --help              display this help message\n"
-           "  -V, --version           display version information\n");
+           "  -V, --version           display version information\n",
+           LEDD_SHM_DEFAULT_PATH, LEDD_STALL_THRESHOLD_DEFAULT,
+           LEDD_BREAKER_THRESHOLD_DEFAULT, LEDD_BREAKER_RETRY_DEFAULT,
+           LEDD_SYSFS_DEFAULT_ROOT, LEDD_RECONFIGURE_BUDGET_DEFAULT,
+           NAME_IN_DAEMON_TABLE, NAME_IN_DAEMON_TABLE,
+           LEDD_BUSLOCK_DEFAULT_DIR,
+           LEDD_PROXY_DEFAULT_PATH);
     exit(EXIT_SUCCESS);
 } /* usage() */
 
@@ -367,6 +3990,25 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
     enum {
         OPT_PEER_CA_CERT = UCHAR_MAX + 1,
         OPT_UNIXCTL,
+        OPT_LED_TABLE,
+        OPT_NO_LED_TABLE,
+        OPT_STALL_THRESHOLD,
+        OPT_HW_SIM,
+        OPT_BREAKER_THRESHOLD,
+        OPT_BREAKER_RETRY,
+        OPT_RECONFIGURE_BUDGET,
+        OPT_LED_CLASS_ROOT,
+        OPT_LAZY_ACTIVATION,
+        OPT_SHARD,
+        OPT_SHARD_SUBSYSTEMS,
+        OPT_SHARDS,
+        OPT_RECORD,
+        OPT_NO_STATIC_TABLES,
+        OPT_RULES,
+        OPT_BUS_LOCK_DIR,
+        OPT_NO_BUS_LOCK,
+        OPT_SUBSCRIBE_SOCKET,
+        OPT_HW_PROXY,
         VLOG_OPTION_ENUMS,
         OPT_BOOTSTRAP_CA_CERT,
         OPT_ENABLE_DUMMY,
@@ -378,6 +4020,26 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
         {"help",        no_argument, NULL, 'h'},
         {"version",     no_argument, NULL, 'V'},
         {"unixctl",     required_argument, NULL, OPT_UNIXCTL},
+        {"led-table",   required_argument, NULL, OPT_LED_TABLE},
+        {"no-led-table", no_argument, NULL, OPT_NO_LED_TABLE},
+        {"stall-threshold", required_argument, NULL, OPT_STALL_THRESHOLD},
+        {"hw-sim",      optional_argument, NULL, OPT_HW_SIM},
+        {"breaker-threshold", required_argument, NULL, OPT_BREAKER_THRESHOLD},
+        {"breaker-retry", required_argument, NULL, OPT_BREAKER_RETRY},
+        {"reconfigure-budget", required_argument, NULL,
+                                                OPT_RECONFIGURE_BUDGET},
+        {"led-class-root", required_argument, NULL, OPT_LED_CLASS_ROOT},
+        {"lazy-activation", no_argument, NULL, OPT_LAZY_ACTIVATION},
+        {"shard", required_argument, NULL, OPT_SHARD},
+        {"shard-subsystems", required_argument, NULL, OPT_SHARD_SUBSYSTEMS},
+        {"shards", required_argument, NULL, OPT_SHARDS},
+        {"record", required_argument, NULL, OPT_RECORD},
+        {"no-static-tables", no_argument, NULL, OPT_NO_STATIC_TABLES},
+        {"rules",       required_argument, NULL, OPT_RULES},
+        {"bus-lock-dir", required_argument, NULL, OPT_BUS_LOCK_DIR},
+        {"no-bus-lock", no_argument, NULL, OPT_NO_BUS_LOCK},
+        {"subscribe-socket", required_argument, NULL, OPT_SUBSCRIBE_SOCKET},
+        {"hw-proxy", optional_argument, NULL, OPT_HW_PROXY},
         DAEMON_LONG_OPTIONS,
         VLOG_LONG_OPTIONS,
         STREAM_SSL_LONG_OPTIONS,
@@ -407,6 +4069,121 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
             *unixctl_pathp = optarg;
             break;
 
+        case OPT_LED_TABLE:
+            led_table_path = optarg;
+            break;
+
+        case OPT_NO_LED_TABLE:
+            led_table_path = NULL;
+            break;
+
+        case OPT_STALL_THRESHOLD:
+            if (!str_to_llong(optarg, 10, &ledd_profile.stall_threshold_ms)
+                || ledd_profile.stall_threshold_ms < 0) {
+                VLOG_FATAL("--stall-threshold: invalid value %s", optarg);
+            }
+            break;
+
+        case OPT_HW_SIM:
+            hw_backend = &ledd_sim_backend;
+            if (optarg && !str_to_uint(optarg, 10, &hw_sim_delay_us)) {
+                VLOG_FATAL("--hw-sim: invalid delay %s", optarg);
+            }
+            break;
+
+        case OPT_BREAKER_THRESHOLD:
+            if (!str_to_uint(optarg, 10, &breaker_threshold)) {
+                VLOG_FATAL("--breaker-threshold: invalid value %s", optarg);
+            }
+            break;
+
+        case OPT_BREAKER_RETRY:
+            if (!str_to_llong(optarg, 10, &breaker_retry_ms)
+                || breaker_retry_ms <= 0
+                || breaker_retry_ms > LEDD_BREAKER_RETRY_MAX) {
+                VLOG_FATAL("--breaker-retry: invalid value %s", optarg);
+            }
+            break;
+
+        case OPT_RECONFIGURE_BUDGET:
+            if (!str_to_llong(optarg, 10, &reconfigure_budget_ms)
+                || reconfigure_budget_ms < 0) {
+                VLOG_FATAL("--reconfigure-budget: invalid value %s", optarg);
+            }
+            break;
+
+        case OPT_LED_CLASS_ROOT:
+            led_class_root = optarg;
+            break;
+
+        case OPT_LAZY_ACTIVATION:
+            lazy_activation = true;
+            break;
+
+        case OPT_SHARD:
+            if (!optarg[0] || strspn(optarg, "abcdefghijklmnopqrstuvwxyz"
+                                     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                     "0123456789_-") != strlen(optarg)) {
+                VLOG_FATAL("--shard: invalid name %s", optarg);
+            }
+            shard_name = optarg;
+            break;
+
+        case OPT_RECORD:
+            record_path = optarg;
+            break;
+
+        case OPT_NO_STATIC_TABLES:
+            static_tables_enabled = false;
+            break;
+
+        case OPT_RULES:
+            rules_path = optarg;
+            break;
+
+        case OPT_BUS_LOCK_DIR:
+            bus_lock_dir = optarg;
+            break;
+
+        case OPT_NO_BUS_LOCK:
+            bus_lock_enabled = false;
+            break;
+
+        case OPT_SUBSCRIBE_SOCKET:
+            subscribe_path = optarg;
+            break;
+
+        case OPT_HW_PROXY:
+            hw_backend = &ledd_proxy_backend;
+            hw_proxy_path = optarg ? optarg : LEDD_PROXY_DEFAULT_PATH;
+            break;
+
+        case OPT_SHARD_SUBSYSTEMS: {
+            char *list = xstrdup(optarg);
+            char *save_ptr = NULL;
+            char *name;
+
+            for (name = strtok_r(list, ",", &save_ptr); name != NULL;
+                 name = strtok_r(NULL, ",", &save_ptr)) {
+                sset_add(&shard_subsystems, name);
+            }
+            free(list);
+            break;
+        }
+
+        case OPT_SHARDS: {
+            char *list = xstrdup(optarg);
+            char *save_ptr = NULL;
+            char *name;
+
+            for (name = strtok_r(list, ",", &save_ptr); name != NULL;
+                 name = strtok_r(NULL, ",", &save_ptr)) {
+                sset_add(&shard_peers, name);
+            }
+            free(list);
+            break;
+        }
+
         VLOG_OPTION_HANDLERS
         DAEMON_OPTION_HANDLERS
         STREAM_SSL_OPTION_HANDLERS
@@ -428,6 +4205,20 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
     }
     free(short_options);
 
+    if (shard_name) {
+        if (sset_is_empty(&shard_subsystems)) {
+            VLOG_FATAL("--shard requires --shard-subsystems");
+        }
+        if (!sset_contains(&shard_peers, shard_name)) {
+            VLOG_FATAL("--shard requires --shards, listing all the shards "
+                       "including %s", shard_name);
+        }
+        daemon_name = xasprintf("%s-%s", NAME_IN_DAEMON_TABLE, shard_name);
+    } else if (!sset_is_empty(&shard_subsystems) ||
+               !sset_is_empty(&shard_peers)) {
+        VLOG_FATAL("--shard-subsystems and --shards require --shard");
+    }
+
     argc -= optind;
     argv += optind;
 
@@ -460,13 +4251,268 @@ ledd_unmark_subsystems(void)
 {
     struct shash_node *node;
 
-    SHASH_FOR_EACH(node, &subsystem_data) {
-        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
-        subsystem->marked = false;
-    }
-} /* ledd_unmark_subsystems() */
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
+        subsystem->marked = false;
+    }
+} /* ledd_unmark_subsystems() */
+
+
+
+/* ************ RULES ************ */
+
+/* the columns the fault-LED rules can watch */
+static const struct ledd_rule_column rule_columns[] = {
+    { "fan:status", &ovsrec_table_fan, &ovsrec_fan_col_status },
+    { "power_supply:status", &ovsrec_table_power_supply,
+      &ovsrec_power_supply_col_status },
+    { "temp_sensor:status", &ovsrec_table_temp_sensor,
+      &ovsrec_temp_sensor_col_status },
+    { "temp_sensor:fan_state", &ovsrec_table_temp_sensor,
+      &ovsrec_temp_sensor_col_fan_state },
+};
+
+/************************************************************************//**
+ * Function that sets up the fault-LED rules and loads those of a file (see
+ * --rules), if any, one per line (see ledd_rules_parse()). A rule that
+ * does not parse is logged and skipped.
+ ***************************************************************************/
+static void
+ledd_rules_load(const char *path)
+{
+    static const char *names[ARRAY_SIZE(rule_columns)];
+    struct ds line = DS_EMPTY_INITIALIZER;
+    int line_number = 0;
+    FILE *file;
+    size_t i;
+    int retval;
+
+    for (i = 0; i < ARRAY_SIZE(rule_columns); i++) {
+        names[i] = rule_columns[i].name;
+    }
+    retval = ledd_rules_init(&rules, names, ARRAY_SIZE(names),
+                             led_state_strings, LEDD_N_LED_STATES);
+    if (retval) {
+        VLOG_FATAL("unable to set up the rules (%s)", ovs_strerror(retval));
+    }
+    if (path == NULL) {
+        return;
+    }
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        VLOG_WARN("%s: open failed (%s)", path, ovs_strerror(errno));
+        return;
+    }
+
+    while (!ds_get_line(&line, file)) {
+        char error[LEDD_RULES_ERROR_LEN];
+
+        line_number++;
+        retval = ledd_rules_parse(&rules, ds_cstr(&line), LEDD_RULE_PRIORITY,
+                                  error, sizeof error);
+        if (retval == ENOMEM) {
+            out_of_memory();
+        } else if (retval) {
+            VLOG_WARN("%s:%d: %s", path, line_number, error);
+        }
+    }
+
+    VLOG_INFO("%s: %"PRIuSIZE" rules", path, rules.n_rules);
+
+    ds_destroy(&line);
+    fclose(file);
+} /* ledd_rules_load() */
+
+/* monitor (and track the changes of) the columns the rules watch */
+static void
+ledd_rules_register(void)
+{
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(rule_columns); i++) {
+        if (rules.inputs[i].used) {
+            ovsdb_idl_add_table(idl, rule_columns[i].table);
+            ovsdb_idl_add_column(idl, rule_columns[i].column);
+            ovsdb_idl_track_add_column(idl, rule_columns[i].column);
+        }
+    }
+} /* ledd_rules_register() */
+
+/* string value of a rule column in a row, NULL if it has none */
+static const char *
+ledd_rule_column_read(const struct ledd_rule_column *column,
+                      const struct ovsdb_idl_row *row)
+{
+    const struct ovsdb_datum *datum = ovsdb_idl_read(row, column->column);
+
+    return(datum->n ? datum->keys[0].string : NULL);
+} /* ledd_rule_column_read() */
+
+/* post or withdraw the request of a rule for its LED, if the LED is here
+   (it may be added later, see ledd_rules_led_added(), or belong to
+   another shard) */
+static void
+ledd_rule_apply(const struct ledd_rule *rule)
+{
+    struct locl_led *led = shash_find_data(&led_data, rule->led);
+
+    if (led == NULL) {
+        return;
+    }
+    if (rule->active) {
+        ledd_request_changed(led, ledd_led_post(led, rule->source,
+                                                rule->priority,
+                                                rule->state));
+    } else {
+        ledd_request_changed(led, ledd_led_withdraw(led, rule->source));
+    }
+} /* ledd_rule_apply() */
+
+/* post the requests of the active rules of an LED that was just added */
+static void
+ledd_rules_led_added(struct locl_led *led)
+{
+    size_t i;
+
+    for (i = 0; i < rules.n_rules; i++) {
+        const struct ledd_rule *rule = &rules.rules[i];
+
+        if (rule->active && !strcmp(rule->led, led->name)) {
+            ledd_led_post(led, rule->source, rule->priority, rule->state);
+        }
+    }
+} /* ledd_rules_led_added() */
+
+/* set the value of a row in a rule column, NULL for a deleted row */
+static void
+ledd_rules_set_idl_row(size_t input, const struct ovsdb_idl_row *row,
+                       const char *value)
+{
+    char key[UUID_LEN + 1];
+
+    snprintf(key, sizeof key, UUID_FMT, UUID_ARGS(&row->uuid));
+    if (ledd_rules_set_row(&rules, input, key, value)) {
+        out_of_memory();
+    }
+    ledd_stats.rule_rows++;
+} /* ledd_rules_set_idl_row() */
+
+/************************************************************************//**
+ * Function that evaluates the fault-LED rules.
+ *
+ * Logic:
+ *     - after a start or a reconnect, read every row of the watched
+ *       columns and count the matching rows of each rule from scratch
+ *     - else, only take the rows whose watched columns changed (IDL change
+ *       tracking), and update the counts of the rules watching them
+ *     - post or withdraw the request of each rule whose outcome changed
+ *
+ * The changes tracked are cleared on every run, so a run that resyncs
+ * does not take them again on the next one. The time spent is in
+ * ops-ledd/stats.
+ ***************************************************************************/
+static void
+ledd_rules_run(void)
+{
+    struct ledd_rule *rule;
+    long long int start;
+    bool changed = false;
+    size_t pos = 0;
+    size_t i;
+
+    if (rules.n_rules == 0) {
+        return;
+    }
+
+    start = time_usec();
+
+    for (i = 0; i < ARRAY_SIZE(rule_columns); i++) {
+        const struct ledd_rule_column *column = &rule_columns[i];
+        const struct ovsdb_idl_row *row;
+
+        if (!rules.inputs[i].used) {
+            continue;
+        }
+
+        if (rules_resync) {
+            ledd_rules_resync(&rules, i);
+            for (row = ovsdb_idl_first_row(idl, column->table); row;
+                 row = ovsdb_idl_next_row(row)) {
+                ledd_rules_set_idl_row(i, row,
+                                       ledd_rule_column_read(column, row));
+            }
+            changed = true;
+            continue;
+        }
+
+        for (row = ovsdb_idl_track_get_first(idl, column->table); row;
+             row = ovsdb_idl_track_get_next(row)) {
+            bool deleted = ovsdb_idl_row_get_seqno(row,
+                                                   OVSDB_IDL_CHANGE_DELETE);
+
+            ledd_rules_set_idl_row(i, row,
+                                   deleted ? NULL
+                                           : ledd_rule_column_read(column,
+                                                                   row));
+            changed = true;
+        }
+    }
+    ovsdb_idl_track_clear(idl);
+
+    if (!changed) {
+        return;
+    }
+    if (rules_resync) {
+        ledd_stats.rule_resyncs++;
+        rules_resync = false;
+    }
+
+    while ((rule = ledd_rules_next_change(&rules, &pos)) != NULL) {
+        VLOG_INFO("rule %s %s: %"PRIuSIZE" of %"PRIuSIZE" %s rows match",
+                  rule->name, rule->active ? "active" : "inactive",
+                  rule->n_match, rules.inputs[rule->input].n_rows,
+                  rules.inputs[rule->input].name);
+        ledd_stats.rule_changes++;
+        ledd_rule_apply(rule);
+    }
+
+    ledd_stats.rule_runs++;
+    start = time_usec() - start;
+    ledd_stats.rule_eval_us += start;
+    ledd_stats.rule_eval_max_us = MAX(ledd_stats.rule_eval_max_us, start);
+} /* ledd_rules_run() */
+
+/* ops-ledd/rules: show the rules and their match counts */
+static void
+ledd_unixctl_rules(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                   const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    size_t i, j;
+
+    for (i = 0; i < rules.n_rules; i++) {
+        const struct ledd_rule *rule = &rules.rules[i];
+        const struct ledd_rules_input *input = &rules.inputs[rule->input];
 
+        ds_put_format(&ds, "%s: %s %s if %s %s in {", rule->name, rule->led,
+                      ledd_state_to_string(rule->state),
+                      rule->all ? "all" : "any", input->name);
+        for (j = 0; j < rule->n_values; j++) {
+            ds_put_format(&ds, "%s%s", j ? "," : "", rule->values[j]);
+        }
+        ds_put_format(&ds, "}, priority %d\n", rule->priority);
+        ds_put_format(&ds, "\t%s, %"PRIuSIZE" of %"PRIuSIZE" rows match, "
+                      "fired %u times%s\n",
+                      rule->active ? "active" : "inactive", rule->n_match,
+                      input->n_rows, rule->fired,
+                      shash_find(&led_data, rule->led) ? ""
+                                                      : " (LED not here)");
+    }
 
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+} /* ledd_unixctl_rules() */
 
 /* ************ OVS  ******************** */
 
@@ -479,12 +4525,34 @@ ledd_init(const char *remote)
     /* initialize subsystems */
     init_subsystems();
 
+    /* simulated hardware has no bus to share, unless a test asks */
+    if (bus_lock_dir == NULL) {
+        if (hw_backend == &ledd_sim_backend) {
+            bus_lock_enabled = false;
+        }
+        bus_lock_dir = LEDD_BUSLOCK_DEFAULT_DIR;
+    }
+
+    /* the proxy takes the bus locks around its own accesses */
+    if (hw_backend == &ledd_proxy_backend) {
+        ledd_proxy_client_init(&hw_proxy, hw_proxy_path,
+                               ledd_proxy_write_done);
+        bus_lock_enabled = false;
+    }
+
     /* initialize the yaml handle */
     yaml_handle = yaml_new_config_handle();
 
     idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false, true);
     idl_seqno = ovsdb_idl_get_seqno(idl);
-    ovsdb_idl_set_lock(idl, "ops_ledd");
+    if (shard_name) {
+        char *lock = xasprintf("ops_ledd_%s", shard_name);
+
+        ovsdb_idl_set_lock(idl, lock);
+        free(lock);
+    } else {
+        ovsdb_idl_set_lock(idl, "ops_ledd");
+    }
     /* Commenting this out to allow read/write for state column. */
     /* ovsdb_idl_verify_write_only(idl); */
 
@@ -492,7 +4560,10 @@ ledd_init(const char *remote)
     ovsdb_idl_add_table(idl, &ovsrec_table_daemon);
     ovsdb_idl_add_column(idl, &ovsrec_daemon_col_name);
     ovsdb_idl_add_column(idl, &ovsrec_daemon_col_cur_hw);
-    ovsdb_idl_omit_alert(idl, &ovsrec_daemon_col_cur_hw);
+    if (shard_name == NULL) {
+        /* a shard waits for the cur_hw of the others */
+        ovsdb_idl_omit_alert(idl, &ovsrec_daemon_col_cur_hw);
+    }
 
     /* register interest in all led columns */
     ovsdb_idl_add_table(idl, &ovsrec_table_led);
@@ -512,30 +4583,100 @@ ledd_init(const char *remote)
     ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_hw_desc_dir);
     ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_leds);
     ovsdb_idl_omit_alert(idl, &ovsrec_subsystem_col_leds);
+    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_other_info);
+    ovsdb_idl_omit_alert(idl, &ovsrec_subsystem_col_other_info);
 
-    unixctl_command_register("ops-ledd/dump", "", 0, 0,
-                             ledd_unixctl_dump, NULL);
+    /* the fan, power supply and temperature columns of the rules */
+    ledd_rules_load(rules_path);
+    ledd_rules_register();
 
-    retval = event_log_init("LED");
+    ledd_unixctl_command_register("ops-ledd/dump",
+                                  "[--json] [subsystem] [led-glob]", 0, 3,
+                             ledd_unixctl_dump, NULL);
+    ledd_unixctl_command_register("ops-ledd/stats", "", 0, 0,
+                                  ledd_unixctl_stats, NULL);
+    ledd_unixctl_command_register("ops-ledd/profile", "[reset]", 0, 1,
+                                  ledd_unixctl_profile, NULL);
+    ledd_unixctl_command_register("ops-ledd/stall-threshold", "MS", 1, 1,
+                                  ledd_unixctl_stall_threshold, NULL);
+    ledd_unixctl_command_register("ops-ledd/hw-sim-fail",
+                                  "SUBSYSTEM DEVICE [off]", 2, 3,
+                                  ledd_unixctl_hw_sim_fail, NULL);
+    ledd_unixctl_command_register("ops-ledd/request",
+                                  "LED SOURCE PRIORITY STATE", 4, 4,
+                                  ledd_unixctl_request, NULL);
+    ledd_unixctl_command_register("ops-ledd/release", "LED SOURCE", 2, 2,
+                                  ledd_unixctl_release, NULL);
+    ledd_unixctl_command_register("ops-ledd/requests", "[led-glob]", 0, 1,
+                                  ledd_unixctl_requests, NULL);
+    ledd_unixctl_command_register("ops-ledd/breakers", "", 0, 0,
+                                  ledd_unixctl_breakers, NULL);
+    ledd_unixctl_command_register("ops-ledd/memory", "[subsystem]", 0, 1,
+                                  ledd_unixctl_memory, NULL);
+    ledd_unixctl_command_register("ops-ledd/record", "FILE|off", 1, 1,
+                                  ledd_unixctl_record, NULL);
+    ledd_unixctl_command_register("ops-ledd/set", "LED STATE [DURATION]", 2,
+                                  3, ledd_unixctl_set, NULL);
+    ledd_unixctl_command_register("ops-ledd/set-many",
+                                  "[--duration=S] LED=STATE...", 1, INT_MAX,
+                                  ledd_unixctl_set_many, NULL);
+    ledd_unixctl_command_register("ops-ledd/brightness",
+                                  "LED LEVEL [FADE_MS]", 2, 3,
+                                  ledd_unixctl_brightness, NULL);
+    ledd_unixctl_command_register("ops-ledd/color", "LED COLOR|default", 2,
+                                  2, ledd_unixctl_color, NULL);
+    ledd_unixctl_command_register("ops-ledd/rules", "", 0, 0,
+                                  ledd_unixctl_rules, NULL);
+    ledd_unixctl_command_register("ops-ledd/changes", "[EPOCH SEQ]", 0, 2,
+                                  ledd_unixctl_changes, NULL);
+
+    retval = ledd_changes_init(&changes, LEDD_CHANGES_CAPACITY_DEFAULT,
+                               time_wall_msec());
+    if (retval) {
+        VLOG_FATAL("unable to create the change ring (%s)",
+                   ovs_strerror(retval));
+    }
+    if (subscribe_path) {
+        char *name = xasprintf("punix:%s", subscribe_path);
 
-    if(retval < 0) {
-         VLOG_ERR("Event log initialization failed for LED");
+        retval = pstream_open(name, &subscribe_listener, DSCP_DEFAULT);
+        if (retval) {
+            VLOG_WARN("unable to listen on %s (%s)", subscribe_path,
+                      ovs_strerror(retval));
+        }
+        free(name);
     }
-} /* ledd_init() */
 
-struct ovsrec_led *
-lookup_led(const char *name)
-{
-    const struct ovsrec_led *led;
+    if (record_path) {
+        ledd_record_start(record_path);
+    }
 
-    OVSREC_LED_FOR_EACH(led, idl) {
-        if (strcmp(led->id, name) == 0) {
-            return((struct ovsrec_led *)led);
+    /* create the shared-memory LED state table */
+    if (led_table_path) {
+        if (!strcmp(led_table_path, LEDD_SHM_DEFAULT_PATH)) {
+            mkdir("/run/ops-ledd", 0755);
+            if (shard_name) {
+                /* one table per shard */
+                led_table_path = xasprintf("%s.%s", LEDD_SHM_DEFAULT_PATH,
+                                           shard_name);
+            }
+        }
+        retval = ledd_shm_create(&led_table, led_table_path,
+                                 LEDD_LED_TABLE_MIN_SIZE);
+        if (retval) {
+            VLOG_WARN("unable to create LED table %s (%s)",
+                      led_table_path, ovs_strerror(retval));
+        } else {
+            led_table_enabled = true;
         }
     }
 
-    return(NULL);
-} /* lookup_led() */
+    retval = event_log_init("LED");
+
+    if(retval < 0) {
+         VLOG_ERR("Event log initialization failed for LED");
+    }
+} /* ledd_init() */
 
 /************************************************************************//**
  * Function that looks to see if the user has
@@ -545,8 +4686,8 @@ lookup_led(const char *name)
  *   foreach LED in this subsystem
  *       find the matching entry in the LED table in ovsdb
  *       if the state has changed   (User requested a state change)
- *           set the LED to the new state
- *           update the LED status in ovsdb, if changed
+ *           post it as the "db" request for the LED
+ *           if the effective state changed, queue an interactive write
  *
  * Returns:  void
  ***************************************************************************/
@@ -574,35 +4715,25 @@ process_changes_in_subsys(struct locl_subsystem *subsys)
                 continue;
             }
 
-            /* If a new state has been written into the db, process it. */
-            if (led->state != ledd_state_to_enum(ovs_led->state)) {
-                enum ovsrec_led_status_e status;
-
+            /* If a new state has been written into the db, process it. A
+               state set by ops-ledd/set is kept until it is written back. */
+            if (!led->state_dirty &&
+                led->state != ledd_state_to_enum(ovs_led->state)) {
                 led->state = ledd_state_to_enum(ovs_led->state);
-
-                /* If we have a valid type, write to the LED */
-                if (ledd_get_led_type(subsys, led->yaml_led->type) !=
-                                        (YamlLedType *) NULL) {
-
-                    if (ledd_write_led(subsys, led)) {
-                        VLOG_DBG("ledd_write successful, %s",led->name);
-                        status = LED_STATUS_OK;
-                    } else {
-                        VLOG_WARN("ledd_write failed, %s",led->name);
-                        status = LED_STATUS_FAULT;
-                    }
-                } else {
-                    VLOG_WARN("Unable to write LED %s, led type %s unknown",
-                            led->name, led->yaml_led->type);
-                    status = LED_STATUS_FAULT;
+                ledd_record_led_state(led->name, ovs_led->state);
+
+                /* The db is one requester among others, only write the
+                   LED if the effective state changed. The write is
+                   interactive, so no bulk work can delay it, and its
+                   status is pushed by ledd_push_statuses(). */
+                if (ledd_led_post(led, LEDD_DB_SOURCE, LEDD_DB_PRIORITY,
+                                  led->state)) {
+                    ledd_led_schedule(led, LEDD_WRITE_INTERACTIVE);
                 }
+                ledd_led_refresh(led);
 
-                /* If there is a new status, push it to the db. */
-                if (ledd_status_to_enum(ovs_led->status) != status) {
-                    ovsrec_led_set_status(ovs_led,
-                         ledd_status_to_string(status));
-                    change_to_commit = true;
-                }
+                /* the same LED of the child subsystems follows */
+                ledd_led_fan_out(led, led->state, 0, false);
             }
         }
         subsys->marked = true;
@@ -610,6 +4741,223 @@ process_changes_in_subsys(struct locl_subsystem *subsys)
 
 } /* process_changes_in_subsys() */
 
+/************************************************************************//**
+ * Function that reads the LED-class settings of a subsystem from
+ * <dir>/LEDD_LED_CLASS_FILE, if the file exists. Each line is
+ *     <led name> <LED-class name> [<delay_on ms> <delay_off ms>]
+ * Empty lines and lines starting with '#' are ignored.
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_load_led_class(struct locl_subsystem *lsubsys, const char *dir)
+{
+    char *path = xasprintf("%s/%s", dir, LEDD_LED_CLASS_FILE);
+    struct ds line = DS_EMPTY_INITIALIZER;
+    int line_number = 0;
+    FILE *file;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        if (errno != ENOENT) {
+            VLOG_WARN("%s: open failed (%s)", path, ovs_strerror(errno));
+        }
+        free(path);
+        return;
+    }
+
+    while (!ds_get_line(&line, file)) {
+        struct ledd_led_class *led_class;
+        char led[64], name[64];
+        unsigned int delay_on = LEDD_SYSFS_DELAY_DEFAULT;
+        unsigned int delay_off = LEDD_SYSFS_DELAY_DEFAULT;
+        int n;
+
+        line_number++;
+        ds_chomp(&line, '\n');
+        if (ds_first(&line) == EOF || ds_first(&line) == '#') {
+            continue;
+        }
+
+        n = sscanf(ds_cstr(&line), "%63s %63s %u %u", led, name,
+                   &delay_on, &delay_off);
+        if ((n != 2 && n != 4) || !delay_on || !delay_off) {
+            VLOG_WARN("%s:%d: expected \"<led> <LED-class name> "
+                      "[<delay_on> <delay_off>]\"", path, line_number);
+            continue;
+        }
+        if (shash_find(&lsubsys->led_class, led)) {
+            VLOG_WARN("%s:%d: LED %s listed twice", path, line_number, led);
+            continue;
+        }
+
+        led_class = xmalloc(sizeof *led_class);
+        led_class->name = xstrdup(name);
+        led_class->delay_on = delay_on;
+        led_class->delay_off = delay_off;
+        shash_add(&lsubsys->led_class, led, led_class);
+    }
+
+    VLOG_DBG("subsystem %s: %"PRIuSIZE" LED-class LEDs", lsubsys->name,
+             shash_count(&lsubsys->led_class));
+
+    ds_destroy(&line);
+    fclose(file);
+    free(path);
+} /* ledd_load_led_class() */
+
+/* parse the "<name>=<value>[,...]" colors of a led-dim.conf line */
+static bool
+ledd_parse_colors(const char *s, struct ledd_led_dim *dim)
+{
+    char *copy = xstrdup(s);
+    char *save_ptr = NULL;
+    char *token;
+    size_t allocated = 0;
+    bool ok = true;
+
+    for (token = strtok_r(copy, ",", &save_ptr); token;
+         token = strtok_r(NULL, ",", &save_ptr)) {
+        char *eq = strchr(token, '=');
+        unsigned int value;
+
+        if (eq == NULL || eq == token || !str_to_uint(eq + 1, 0, &value)) {
+            ok = false;
+            break;
+        }
+        if (dim->n_colors >= allocated) {
+            dim->colors = x2nrealloc(dim->colors, &allocated,
+                                     sizeof *dim->colors);
+            dim->color_values = xrealloc(dim->color_values,
+                                         allocated *
+                                         sizeof *dim->color_values);
+        }
+        dim->colors[dim->n_colors] = xmemdup0(token, eq - token);
+        dim->color_values[dim->n_colors] = value;
+        dim->n_colors++;
+    }
+    free(copy);
+
+    return(ok && dim->n_colors > 0);
+} /* ledd_parse_colors() */
+
+/************************************************************************//**
+ * Function that reads the dimming and color settings of a subsystem from
+ * <dir>/LEDD_LED_DIM_FILE, if the file exists. Each line is
+ *     <led name> pwm <max level> [<fade ms>]
+ *     <led name> colors <name>=<value>[,<name>=<value>...]
+ * Empty lines and lines starting with '#' are ignored.
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_load_led_dim(struct locl_subsystem *lsubsys, const char *dir)
+{
+    char *path = xasprintf("%s/%s", dir, LEDD_LED_DIM_FILE);
+    struct ds line = DS_EMPTY_INITIALIZER;
+    int line_number = 0;
+    FILE *file;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        if (errno != ENOENT) {
+            VLOG_WARN("%s: open failed (%s)", path, ovs_strerror(errno));
+        }
+        free(path);
+        return;
+    }
+
+    while (!ds_get_line(&line, file)) {
+        struct ledd_led_dim *dim;
+        char led[64], kind[16], arg[256];
+        unsigned int fade_ms = 0;
+        int n;
+
+        line_number++;
+        ds_chomp(&line, '\n');
+        if (ds_first(&line) == EOF || ds_first(&line) == '#') {
+            continue;
+        }
+
+        dim = xzalloc(sizeof *dim);
+        n = sscanf(ds_cstr(&line), "%63s %15s %255s %u", led, kind, arg,
+                   &fade_ms);
+        if (n >= 3 && !strcmp(kind, "pwm")) {
+            if (!str_to_uint(arg, 0, &dim->pwm_max) || !dim->pwm_max) {
+                n = 0;
+            }
+            dim->fade_ms = fade_ms;
+        } else if (n == 3 && !strcmp(kind, "colors")) {
+            if (!ledd_parse_colors(arg, dim)) {
+                n = 0;
+            }
+        } else {
+            n = 0;
+        }
+        if (n == 0) {
+            VLOG_WARN("%s:%d: expected \"<led> pwm <max> [<fade ms>]\" or "
+                      "\"<led> colors <name>=<value>[,...]\"", path,
+                      line_number);
+            ledd_led_dim_free(dim);
+            continue;
+        }
+        if (shash_find(&lsubsys->led_dim, led)) {
+            VLOG_WARN("%s:%d: LED %s listed twice", path, line_number, led);
+            ledd_led_dim_free(dim);
+            continue;
+        }
+
+        shash_add(&lsubsys->led_dim, led, dim);
+    }
+
+    VLOG_DBG("subsystem %s: %"PRIuSIZE" dimmable or multicolor LEDs",
+             lsubsys->name, shash_count(&lsubsys->led_dim));
+
+    ds_destroy(&line);
+    fclose(file);
+    free(path);
+} /* ledd_load_led_dim() */
+
+/* once all LEDs of a subsystem are added, release the LED-class and
+   dimming settings that name no LED of the subsystem: nothing will look
+   them up again */
+static void
+ledd_led_class_compact(struct locl_subsystem *lsubsys)
+{
+    struct shash_node *node, *next;
+
+    SHASH_FOR_EACH_SAFE(node, next, &lsubsys->led_class) {
+        struct ledd_led_class *led_class = node->data;
+
+        if (shash_find(&lsubsys->subsystem_leds, node->name)) {
+            continue;
+        }
+        VLOG_WARN("subsystem %s: %s lists unknown LED %s", lsubsys->name,
+                  LEDD_LED_CLASS_FILE, node->name);
+
+        ledd_stats.compactions++;
+        ledd_stats.compacted_bytes += sizeof *led_class +
+                                      strlen(led_class->name) + 1 +
+                                      ledd_mem_node(node->name);
+        free(led_class->name);
+        free(led_class);
+        shash_delete(&lsubsys->led_class, node);
+    }
+    hmap_shrink(&lsubsys->led_class.map);
+
+    SHASH_FOR_EACH_SAFE(node, next, &lsubsys->led_dim) {
+        if (shash_find(&lsubsys->subsystem_leds, node->name)) {
+            continue;
+        }
+        VLOG_WARN("subsystem %s: %s lists unknown LED %s", lsubsys->name,
+                  LEDD_LED_DIM_FILE, node->name);
+
+        ledd_stats.compactions++;
+        ledd_led_dim_free(node->data);
+        shash_delete(&lsubsys->led_dim, node);
+    }
+} /* ledd_led_class_compact() */
+
 /************************************************************************//**
  * Function that creates a new locl_subsystem structure
  *     when a new subsystem is found in ovsdb, sets the LEDs to their
@@ -620,12 +4968,12 @@ process_changes_in_subsys(struct locl_subsystem *subsys)
  *      - tag the subsystem as "unmarked" and as IGNORE
  *      - extract the LED information for this subsys from the hw desc files.
  *        This includes names and types of LEDs, and their supported
- *        states and settings.
- *      - foreach valid led
- *          - write the default value to the LED
- *          - add the LED to the LED table (add to transaction)
- *      - tag the subsystem as "marked" and as OK
- *      - set change_to_commit = true  (transaction has changes to be pushed)
+ *        states and settings. With --lazy-activation the devices are not
+ *        parsed, and the subsystem is tagged as lazy. If a static table
+ *        matches the files, it is used instead of the LED file, and the
+ *        devices are only parsed for the i2c backend.
+ *      - tag the subsystem as "marked" and as ADDING: the LEDs are added
+ *        by ledd_add_leds()
  *
  * Returns:  void
  ***************************************************************************/
@@ -638,11 +4986,11 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys,
     int type_count;
     int idx;
     int led_count;
-    struct ovsrec_led **led_array;
     const char *dir;
     const YamlLedInfo *led_info;
 
     VLOG_DBG("Adding new subsystem %s", ovsrec_subsys->name);
+    ledd_record_subsys(true, ovsrec_subsys->name, ovsrec_subsys->hw_desc_dir);
 
     lsubsys = (struct locl_subsystem *)malloc(sizeof(struct locl_subsystem));
     memset(lsubsys, 0, sizeof(struct locl_subsystem));
@@ -652,10 +5000,13 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys,
     lsubsys->name = strdup(ovsrec_subsys->name);
     lsubsys->marked = false;
     lsubsys->subsys_status = LEDD_SUBSYS_STATUS_IGNORE;
-    lsubsys->parent_subsystem = NULL;  /* OPS_TODO: find parent subsystem */
+    lsubsys->parent_subsystem = NULL;  /* see ledd_link_subsystems() */
 
     shash_init(&lsubsys->subsystem_leds);
     shash_init(&lsubsys->subsystem_types);
+    shash_init(&lsubsys->type_values);
+    shash_init(&lsubsys->led_class);
+    shash_init(&lsubsys->led_dim);
 
     /* use a default if the hw_desc_dir has not been populated */
     dir = ovsrec_subsys->hw_desc_dir;
@@ -666,22 +5017,59 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys,
         return;
     }
 
-    /* since this is a new subsystem, load all of the hardware description
-       information about the LEDs (just for this subsystem).
-       parse LED and device data for subsystem */
-    rc = yaml_add_subsystem(yaml_handle, ovsrec_subsys->name, dir);
+    /* a static table generated at build time from the same files replaces
+       the LED file (see ledd_tables.h) */
+    lsubsys->tables = ledd_static_tables_find(ovsrec_subsys->name, dir);
 
-    if (rc != 0) {
-        VLOG_ERR("Error processing h/w description files for subsystem %s",
-                                    ovsrec_subsys->name);
-        return;
+    if (lsubsys->tables) {
+        VLOG_DBG("subsystem %s: using the static table", ovsrec_subsys->name);
+        ledd_stats.static_tables++;
+    } else {
+        /* since this is a new subsystem, load all of the hardware
+           description information about the LEDs (just for this
+           subsystem). parse LED and device data for subsystem */
+        rc = yaml_add_subsystem(yaml_handle, ovsrec_subsys->name, dir);
+
+        if (rc != 0) {
+            VLOG_ERR("Error processing h/w description files for subsystem "
+                     "%s", ovsrec_subsys->name);
+            return;
+        }
     }
 
-    rc = yaml_parse_devices(yaml_handle, ovsrec_subsys->name);
+    /* with --lazy-activation, the devices are parsed by
+       ledd_subsys_activate(), when an LED is first set to a state other
+       than off: only the LED file is needed to create the LED rows */
+    if (lazy_activation) {
+        lsubsys->lazy = true;
+        ledd_stats.lazy_deferred++;
+    } else {
+        rc = ledd_subsys_parse_devices(lsubsys);
 
-    if (rc != 0) {
-        VLOG_ERR("Unable to parse subsystem %s devices file (in %s)",
-                                ovsrec_subsys->name, dir);
+        if (rc != 0) {
+            VLOG_ERR("Unable to parse subsystem %s devices file (in %s)",
+                                    ovsrec_subsys->name, dir);
+            return;
+        }
+    }
+
+    ledd_load_led_class(lsubsys, dir);
+    ledd_load_led_dim(lsubsys, dir);
+
+    if (lsubsys->tables) {
+        lsubsys->num_types = lsubsys->tables->n_types;
+        lsubsys->num_leds = lsubsys->tables->n_leds;
+
+        for (idx = 0; idx < lsubsys->num_types; idx++) {
+            ledd_subsys_add_type(lsubsys, &lsubsys->tables->types[idx],
+                                 lsubsys->tables->values[idx], dir);
+        }
+
+        if (lsubsys->num_leds > 0 && lsubsys->num_types > 0) {
+            lsubsys->next_led = 0;
+            lsubsys->marked = true;
+            lsubsys->subsys_status = LEDD_SUBSYS_STATUS_ADDING;
+        }
         return;
     }
 
@@ -734,136 +5122,412 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys,
                 dir, led_count, lsubsys->num_leds);
         led_count = lsubsys->num_leds;
     }
-    else {
-        VLOG_DBG("There are %d LEDs in subsystem %s", led_count,
-                                 ovsrec_subsys->name);
+    else {
+        VLOG_DBG("There are %d LEDs in subsystem %s", led_count,
+                                 ovsrec_subsys->name);
+    }
+
+    /* Add the types to the locl_subsystem structure */
+    for (idx = 0; idx < (int) type_count; idx++) {
+        const YamlLedType *new_type;
+
+        new_type = yaml_get_led_type(yaml_handle, ovsrec_subsys->name, idx);
+
+        if (new_type == (YamlLedType *) NULL) {
+            VLOG_ERR("subsystem %s had error reading LED type",
+                     ovsrec_subsys->name);
+            continue;
+        }
+
+        ledd_subsys_add_type(lsubsys, new_type, NULL, dir);
+    }
+
+    /* The LEDs are added by ledd_add_leds(), possibly in several slices */
+    lsubsys->next_led = 0;
+    lsubsys->marked = true;
+    lsubsys->subsys_status = LEDD_SUBSYS_STATUS_ADDING;
+
+    return;
+} /* add_subsystem() */
+
+/* find the row of an LED added by an earlier slice, restoring it if it is
+   gone (e.g. the commit of that slice failed) */
+static struct ovsrec_led *
+ledd_led_row(struct locl_subsystem *lsubsys, const YamlLed *yaml_led,
+             const struct shash *led_index, struct ovsdb_idl_txn *txn)
+{
+    struct ovsrec_led *ovs_led;
+    struct locl_led *led;
+
+    led = shash_find_data(&lsubsys->subsystem_leds, yaml_led->name);
+    ovs_led = shash_find_data(led_index, led->name);
+    if (ovs_led == NULL) {
+        ovs_led = ovsrec_led_insert(txn);
+        ovsrec_led_set_id(ovs_led, led->name);
+        ovsrec_led_set_state(ovs_led, ledd_state_to_string(led->state));
+        ovsrec_led_set_status(ovs_led, ledd_status_to_string(led->status));
+        change_to_commit = true;
+    }
+
+    return(ovs_led);
+} /* ledd_led_row() */
+
+/************************************************************************//**
+ * Function that adds the LEDs of a new subsystem into the ovsdb led table
+ *     and sets them to their state. A subsystem with many LEDs is added in
+ *     several slices (see ledd_slice_expired()): the LEDs added by a slice
+ *     are committed with it, and the next slice resumes at next_led.
+ *
+ * Logic:
+ *      - foreach LED not yet added, until the slice expires
+ *          - if the LED row exists (warm start, or a resumed add), adopt its
+ *            state and status, else add the LED to the LED table with the
+ *            default state and the "uninitialized" status; rows are found
+ *            in led_index (see ledd_index_leds()), not by walking the table
+ *          - queue a bulk write of the LED, which reads the LED register
+ *            (once per register) and writes the LED only if the hardware
+ *            differs from the desired state (in a lazy subsystem, the
+ *            write is dropped while the LED is off)
+ *      - once all LEDs are added, set subsystem:leds and tag the subsystem
+ *        as OK
+ *      - set change_to_commit = true if anything changed in the db
+ *
+ * Returns:  True if all LEDs are added, False if the slice expired first
+ ***************************************************************************/
+static bool
+ledd_add_leds(struct locl_subsystem *lsubsys,
+              const struct ovsrec_subsystem *ovsrec_subsys,
+              const struct shash *led_index, struct ovsdb_idl_txn *txn)
+{
+    int idx;
+    int led_count = lsubsys->num_leds;
+    struct ovsrec_led **led_array;
+    bool leds_changed = false;
+
+    led_array = xcalloc(led_count, sizeof *led_array);
+
+    /* walk through LEDs and add them to DB, at least one per slice */
+    for (idx = lsubsys->next_led; idx < led_count; idx++) {
+        struct ovsrec_led *ovs_led;
+        char *led_name = NULL;
+        const YamlLed *led;
+        struct ledd_led_type *type;
+        struct locl_led *new_led;
+
+        led = ledd_subsys_led(lsubsys, idx);
+
+        VLOG_DBG("Adding LED %s in subsystem %s", led->name,
+                                        ovsrec_subsys->name);
+
+        /* Create the new locl led struct and initialize it. */
+        asprintf(&led_name, "%s-%s", ovsrec_subsys->name, led->name);
+        new_led = (struct locl_led *)xzalloc(sizeof(struct locl_led));
+        new_led->shm_slot = -1;
+        new_led->name = led_name;
+        new_led->subsystem = lsubsys;
+        new_led->yaml_led = led;
+        new_led->led_class = shash_find_data(&lsubsys->led_class, led->name);
+        new_led->dim = shash_find_data(&lsubsys->led_dim, led->name);
+        if (new_led->dim && (new_led->led_class || !led->led_access)) {
+            VLOG_WARN("subsystem %s: LED %s is not an i2c LED, %s ignored",
+                      lsubsys->name, led->name, LEDD_LED_DIM_FILE);
+            new_led->dim = NULL;
+        }
+        new_led->brightness = LEDD_RAMP_MAX;
+        new_led->color = -1;
+        new_led->state = LED_STATE_OFF;
+        new_led->effective_state = LED_STATE_OFF;
+        new_led->status = LED_STATUS_UNINITIALIZED;
+
+        type = shash_find_data(&lsubsys->type_values, led->type);
+        if (type) {
+            new_led->values = type->values;
+            new_led->type_id = type->type_id;
+        }
+
+        /* Add this new locl led to the led shash in subsystem shash */
+        shash_add(&lsubsys->subsystem_leds, led->name, (void *)new_led);
+        shash_add(&led_data, led_name, (void *)new_led);
+        if (!lsubsys->lazy) {
+            ledd_led_attach_breakers(lsubsys, new_led);
+        }
+
+        /* look for existing LED rows */
+        ovs_led = shash_find_data(led_index, led_name);
+
+        /* If it isn't in ovsdb, then add it. Otherwise this is a warm
+           start: adopt the state that is already in the db. */
+        if (ovs_led == NULL) {
+            ovs_led = ovsrec_led_insert(txn);
+
+            /* Add to ovsdb. */
+            ovsrec_led_set_id(ovs_led, led_name);
+            ovsrec_led_set_state(ovs_led,
+                    ledd_state_to_string(new_led->state));
+            ovsrec_led_set_status(ovs_led,
+                    ledd_status_to_string(new_led->status));
+            change_to_commit = true;
+        } else {
+            new_led->state = ledd_state_to_enum(ovs_led->state);
+            ledd_record_led_state(led_name, ovs_led->state);
+            new_led->status = ledd_status_to_enum(ovs_led->status);
+        }
+        ledd_led_post(new_led, LEDD_DB_SOURCE, LEDD_DB_PRIORITY,
+                      new_led->state);
+        ledd_rules_led_added(new_led);
+
+        /* Bring the LED to its state, skipping LEDs already there. This
+           is bulk work: interactive writes go first. The status is
+           pushed by ledd_push_statuses() once the LED is written. */
+        new_led->sched_sync = true;
+        ledd_led_schedule(new_led, LEDD_WRITE_BULK);
+        ledd_led_refresh(new_led);
+
+        led_array[idx] = ovs_led;
+
+        if (idx + 1 < led_count && ledd_slice_expired()) {
+            idx++;
+            break;
+        }
+    }
+
+    lsubsys->next_led = idx;
+
+    if (idx < led_count) {
+        VLOG_DBG("subsystem %s: %d of %d LEDs added, resuming in the next "
+                 "slice", ovsrec_subsys->name, idx, led_count);
+        free(led_array);
+        return(false);
+    }
+
+    /* The rows of the LEDs added by earlier slices were committed then. */
+    for (idx = 0; idx < led_count; idx++) {
+        if (led_array[idx] == NULL) {
+            led_array[idx] = ledd_led_row(lsubsys,
+                                          ledd_subsys_led(lsubsys, idx),
+                                          led_index, txn);
+        }
+        if (idx >= (int) ovsrec_subsys->n_leds ||
+            ovsrec_subsys->leds[idx] != led_array[idx]) {
+            leds_changed = true;
+        }
+    }
+
+    /* Push the data to the DB. */
+    if (leds_changed || ovsrec_subsys->n_leds != (size_t) led_count) {
+        ovsrec_subsystem_set_leds(ovsrec_subsys, led_array, led_count);
+        change_to_commit = true;
+    }
+
+    free(led_array);
+
+    ledd_led_class_compact(lsubsys);
+
+    /* Update the state of the locl_subsystem structure */
+    lsubsys->subsys_status = LEDD_SUBSYS_STATUS_OK;
+
+    return(true);
+} /* ledd_add_leds() */
+
+/* build a shash (by id) of all of the rows in the LED table */
+static void
+ledd_index_leds(struct shash *led_index)
+{
+    const struct ovsrec_led *ovs_led;
+
+    shash_init(led_index);
+    OVSREC_LED_FOR_EACH(ovs_led, idl) {
+        shash_add_once(led_index, ovs_led->id, ovs_led);
+    }
+} /* ledd_index_leds() */
+
+/************************************************************************//**
+ * Function that resynchronizes a known subsystem after the IDL reconnected
+ *     and the database was replayed.
+ *
+ * Logic:
+ *   compute the digest of the replayed LED rows of this subsystem
+ *   if it matches the local digest (and no row is missing)
+ *       nothing diverged, return without touching hw or the db
+ *   foreach LED in this subsystem
+ *       if the row is missing, recreate it from the local state/status
+ *       if the desired state differs, set the LED to the new state
+ *       if the status differs, push the local status to the db
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_resync_subsys(struct locl_subsystem *subsys,
+                   const struct ovsrec_subsystem *ovs_sub,
+                   const struct shash *led_index, struct ovsdb_idl_txn *txn)
+{
+    const struct ovsrec_led *ovs_led;
+    const struct ovsrec_led **led_array;
+    struct locl_led *led;
+    struct shash_node *node;
+    enum ovsrec_led_state_e state;
+    bool missing = false;
+    uint32_t digest = 0;
+    size_t n = 0;
+
+    subsys->marked = true;
+
+    if (subsys->subsys_status == LEDD_SUBSYS_STATUS_IGNORE) {
+        return;
+    }
+
+    SHASH_FOR_EACH(node, &(subsys->subsystem_leds)) {
+        led = (struct locl_led *)node->data;
+        ovs_led = shash_find_data(led_index, led->name);
+
+        if (ovs_led == NULL) {
+            missing = true;
+            break;
+        }
+        digest ^= ledd_led_digest(led->name,
+                                  ledd_state_to_enum(ovs_led->state),
+                                  ledd_status_to_enum(ovs_led->status));
     }
 
-    led_array = (struct ovsrec_led **)
-                xcalloc(led_count, sizeof(struct ovsrec_led *));
+    if (!missing && digest == subsys->digest &&
+        ovs_sub->n_leds == shash_count(&(subsys->subsystem_leds))) {
+        ledd_stats.resync_subsys_clean++;
+        return;
+    }
 
-    /* Add the types to the locl_subsystem structure */
-    for (idx = 0; idx < (int) type_count; idx++) {
-        size_t i;
-        bool found = false;
-        const YamlLedType *new_type;
+    VLOG_INFO("subsystem %s diverged from the db, resynchronizing",
+              subsys->name);
+    ledd_stats.resync_subsys_diverged++;
 
-        new_type = yaml_get_led_type(yaml_handle, ovsrec_subsys->name, idx);
+    led_array = xcalloc(shash_count(&(subsys->subsystem_leds)),
+                        sizeof *led_array);
 
-        if (new_type == (YamlLedType *) NULL) {
-            VLOG_ERR("subsystem %s had error reading LED type",
-                     ovsrec_subsys->name);
-            continue;
-        }
+    SHASH_FOR_EACH(node, &(subsys->subsystem_leds)) {
+        led = (struct locl_led *)node->data;
+        ovs_led = shash_find_data(led_index, led->name);
 
-        /* See if this is a type we know about. */
-        for (i = 0; i < sizeof(led_type_strings)/sizeof(const char *);
-                                                i++) {
-            if (strcmp(led_type_strings[i], new_type->type) == 0) {
-                found = true;
-                break;
+        if (ovs_led == NULL) {
+            /* The row is gone (e.g. the db was recreated), restore it. */
+            struct ovsrec_led *new_row = ovsrec_led_insert(txn);
+
+            ovsrec_led_set_id(new_row, led->name);
+            ovsrec_led_set_state(new_row, ledd_state_to_string(led->state));
+            ovsrec_led_set_status(new_row,
+                                  ledd_status_to_string(led->status));
+            ovs_led = new_row;
+            change_to_commit = true;
+            ledd_stats.resync_leds_diverged++;
+        } else {
+            state = ledd_state_to_enum(ovs_led->state);
+
+            if (state != led->state && !led->state_dirty) {
+                led->state = state;
+                ledd_record_led_state(led->name, ovs_led->state);
+                if (ledd_led_post(led, LEDD_DB_SOURCE, LEDD_DB_PRIORITY,
+                                  state)) {
+                    ledd_led_schedule(led, LEDD_WRITE_INTERACTIVE);
+                }
+                ledd_stats.resync_leds_diverged++;
             }
-        }
 
-        /* If we know about it, add it. */
-        if (found) {
-            shash_add(&(lsubsys->subsystem_types), new_type->type,
-                                    (void *)new_type);
-        } else {
-            VLOG_DBG("unknown type %s specified in %s", new_type->type, dir);
+            if (ledd_status_to_enum(ovs_led->status) != led->status) {
+                ovsrec_led_set_status(ovs_led,
+                                      ledd_status_to_string(led->status));
+                change_to_commit = true;
+                ledd_stats.resync_leds_diverged++;
+            }
+            ledd_led_refresh(led);
         }
+        led_array[n++] = ovs_led;
     }
 
-    /* walk through LEDs and add them to DB */
-    for (idx = 0; idx < led_count; idx++) {
-        struct ovsrec_led *ovs_led;
-        char *led_name = NULL;
-        const YamlLed *led;
-        struct locl_led *new_led;
-        YamlLedType *led_type;
-
-        led = yaml_get_led(yaml_handle, ovsrec_subsys->name, idx);
-
-        VLOG_DBG("Adding LED %s in subsystem %s", led->name,
-                                        ovsrec_subsys->name);
+    if (missing || ovs_sub->n_leds != n) {
+        ovsrec_subsystem_set_leds(ovs_sub,
+                                  (struct ovsrec_led **) led_array, n);
+        change_to_commit = true;
+    }
 
-        /* Create the new locl led struct and initialize it. */
-        asprintf(&led_name, "%s-%s", ovsrec_subsys->name, led->name);
-        new_led = (struct locl_led *)malloc(sizeof(struct locl_led));
-        new_led->name = led_name;
-        new_led->subsystem = lsubsys;
-        new_led->yaml_led = led;
-        new_led->state = LED_STATE_OFF;
-        new_led->status = LED_STATUS_OK;
+    free(led_array);
+} /* ledd_resync_subsys() */
 
-        led_type = ledd_get_led_type(lsubsys, led->type);
-        if (led_type == NULL) {
-            new_led->settings = (YamlLedTypeSettings *)NULL;
-            new_led->status = LED_STATUS_FAULT;
-        } else {
-            new_led->settings = &(led_type->settings);
-        }
+/************************************************************************//**
+ * Function that links each subsystem to its parent, named by the
+ * LEDD_PARENT_KEY key of its subsystem:other_info. A parent that is not
+ * loaded (e.g. owned by another shard), or that would make a cycle, is
+ * ignored. Called at the end of each reconfigure pass, after subsystems
+ * were added and removed.
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_link_subsystems(void)
+{
+    const struct ovsrec_subsystem *ovs_sub;
+    struct shash_node *node;
 
-        /* Add this new locl led to the led shash in subsystem shash */
-        shash_add(&lsubsys->subsystem_leds, led->name, (void *)new_led);
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsys = node->data;
 
-        /* look for existing LED rows */
-        ovs_led = lookup_led(led_name);
+        subsys->parent_subsystem = NULL;
+        subsys->has_children = false;
+    }
 
-        /* If it isn't in ovsdb, then add it. */
-        if (ovs_led == NULL) {
-            ovs_led = ovsrec_led_insert(txn);
+    OVSREC_SUBSYSTEM_FOR_EACH(ovs_sub, idl) {
+        struct locl_subsystem *subsys, *parent, *up;
+        const char *parent_name;
 
-            /* Add to ovsdb. */
-            ovsrec_led_set_id(ovs_led, led_name);
-            ovsrec_led_set_state(ovs_led,
-                    ledd_state_to_string(new_led->state));
+        subsys = shash_find_data(&subsystem_data, ovs_sub->name);
+        parent_name = smap_get(&ovs_sub->other_info, LEDD_PARENT_KEY);
+        if (subsys == NULL || parent_name == NULL) {
+            continue;
         }
 
-        /* Write the LED */
-        if (ledd_write_led(lsubsys, new_led)) {
-            VLOG_DBG("ledd_write successful, %s",led->name);
-            new_led->status = LED_STATUS_OK;
-        } else {
-            VLOG_WARN("ledd_write failed, %s",led->name);
-            new_led->status = LED_STATUS_FAULT;
+        parent = shash_find_data(&subsystem_data, parent_name);
+        for (up = parent; up != NULL && up != subsys;
+             up = up->parent_subsystem) {
+            continue;
         }
+        if (parent == NULL || up == subsys) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
 
-        /* Either way, set that status accordingly. */
-        ovsrec_led_set_status(ovs_led,
-                    ledd_status_to_string(new_led->status));
+            VLOG_WARN_RL(&rl, "subsystem %s: parent %s %s", subsys->name,
+                         parent_name, parent ? "makes a cycle, ignored"
+                                             : "not found");
+            continue;
+        }
 
-        led_array[idx] = ovs_led;
+        subsys->parent_subsystem = parent;
+        parent->has_children = true;
     }
-
-    /* Push the data to the DB. */
-    ovsrec_subsystem_set_leds(ovsrec_subsys, led_array, led_count);
-    change_to_commit = true;
-
-    free(led_array);
-
-    /* Update the state of the locl_subsystem structure */
-    lsubsys->marked = true;
-    lsubsys->subsys_status = LEDD_SUBSYS_STATUS_OK;
-
-    return;
-} /* add_subsystem() */
+} /* ledd_link_subsystems() */
 
 /************************************************************************//**
  * Function that looks for changes in the OVSDB that need
  *     to be processed, either new or removed subsystems or changed
  *     configuration data.
  *
+ *     A pass may run in several slices of at most --reconfigure-budget
+ *     ms, so that unixctl and lock handling are not held up by a large
+ *     pass. Each slice commits its own transaction. Row pointers are not
+ *     kept between slices, since the IDL may change in between.
+ *
  * Logic:
+ *     - if no pass is in progress, start one: unmark all subsystems so
+ *          removed subsystems can be detected (a reconnect restarts the
+ *          pass as a resync)
  *     - initialize empty transaction
- *     - unmark all subsystems so removed subsystems can be detected.
- *     - foreach subsystem in ovsdb
+ *     - foreach subsystem in ovsdb not yet done in this pass, until the
+ *          slice expires
  *        - if new_to_us, call add_subsystem
+ *        - if its LEDs are being added, call ledd_add_leds (resumable)
+ *        - else if the IDL reconnected, call ledd_resync_subsys
  *        - else call process_changes_in_subsys
- *     - if first_time_through_loop, set cur_hw_cfg = 1
+ *     - if the pass is done and first_time_through_loop, set cur_hw_cfg = 1
+ *          (so cur_hw = 1 means every LED row exists and has its initial
+ *          write queued)
  *     - if change_to_commit is true, submit the transaction
- *     - call ledd_remove_unmarked_subsystems to process (delete)
- *          any subsystems no longer in ovsdb
+ *     - if the pass is done, call ledd_remove_unmarked_subsystems to
+ *          process (delete) any subsystems no longer in ovsdb
  *
  * Returns:  void
  ***************************************************************************/
@@ -874,15 +5538,41 @@ ledd_reconfigure(void)
     const struct ovsrec_daemon *ovs_daemon;
     unsigned int new_idl_seqno = ovsdb_idl_get_seqno(idl);
     struct ovsdb_idl_txn *txn;
+    struct shash led_index;
+    bool indexed = false;
+    bool done = true;
 
     COVERAGE_INC(ledd_reconfigure);
 
-    if (new_idl_seqno == idl_seqno){
+    if (new_idl_seqno == idl_seqno && !pass_active) {
         return;
     }
 
-    /* Unmark all subsystems so we can tell if any have been removed. */
-    ledd_unmark_subsystems();
+    slice_deadline = time_usec() + reconfigure_budget_ms * 1000;
+
+    if (resync_pending) {
+        /* The db was replayed, every subsystem must be compared again */
+        if (!pass_resync) {
+            pass_resync_start = time_usec();
+        }
+        pass_resync = true;
+        resync_pending = false;
+        pass_active = false;
+    }
+
+    if (!pass_active) {
+        pass_active = true;
+        pass_seqno = new_idl_seqno;
+        sset_clear(&pass_done);
+
+        /* Unmark all subsystems so we can tell if any have been removed. */
+        ledd_unmark_subsystems();
+    }
+
+    if (pass_resync) {
+        ledd_index_leds(&led_index);
+        indexed = true;
+    }
 
     change_to_commit = false;
     txn = ovsdb_idl_txn_create(idl);
@@ -891,21 +5581,62 @@ ledd_reconfigure(void)
     OVSREC_SUBSYSTEM_FOR_EACH(ovs_sub, idl) {
         struct locl_subsystem *subsystem;
 
+        if (sset_contains(&pass_done, ovs_sub->name) ||
+            !ledd_shard_owns(ovs_sub->name)) {
+            continue;
+        }
+        if (!sset_is_empty(&pass_done) && ledd_slice_expired()) {
+            done = false;
+            break;
+        }
+
         subsystem = shash_find_data(&subsystem_data, ovs_sub->name);
 
         if (subsystem == NULL) {
             /* If the subsystem is new, add it */
             add_subsystem(ovs_sub, txn);
+            subsystem = shash_find_data(&subsystem_data, ovs_sub->name);
+        }
+
+        if (subsystem->subsys_status == LEDD_SUBSYS_STATUS_ADDING) {
+            /* Add its LEDs, or the ones left by the previous slice */
+            if (!indexed) {
+                ledd_index_leds(&led_index);
+                indexed = true;
+            }
+            if (!ledd_add_leds(subsystem, ovs_sub, &led_index, txn)) {
+                done = false;
+                break;
+            }
+        } else if (pass_resync) {
+            /* The db was replayed, only fix what diverged */
+            ledd_resync_subsys(subsystem, ovs_sub, &led_index, txn);
         } else {
             /* Else, look for any changes to process */
             process_changes_in_subsys(subsystem);
         }
+        sset_add(&pass_done, ovs_sub->name);
     }
 
-    idl_seqno = new_idl_seqno;
+    if (indexed) {
+        shash_destroy(&led_index);
+    }
 
-    /* Set cur_hw = 1 if this is first time through. */
-    if (!cur_hw_set) {
+    if (!done) {
+        ledd_stats.reconfigure_slices++;
+    } else {
+        pass_active = false;
+        idl_seqno = pass_seqno;
+        ledd_stats.reconfigure_passes++;
+    }
+
+    /* Set cur_hw = 1 if this is first time through; a shard also sets the
+       shared row once all the shards are through. */
+    if (done && shard_name) {
+        if (ledd_shard_report(txn)) {
+            change_to_commit = true;
+        }
+    } else if (done && !cur_hw_set) {
         OVSREC_DAEMON_FOR_EACH(ovs_daemon, idl) {
             if (strncmp(ovs_daemon->name, NAME_IN_DAEMON_TABLE,
                         strlen(NAME_IN_DAEMON_TABLE)) == 0) {
@@ -919,20 +5650,299 @@ ledd_reconfigure(void)
 
     /* If there are changes for ovsdb, submit the transaction. */
     if (change_to_commit) {
-        ovsdb_idl_txn_commit_block(txn);
+        ledd_commit_block(txn);
     }
     ovsdb_idl_txn_destroy(txn);
 
+    if (!done) {
+        return;
+    }
+
+    if (pass_resync) {
+        long long int elapsed = time_usec() - pass_resync_start;
+
+        pass_resync = false;
+        ledd_stats.resyncs++;
+        ledd_stats.resync_last_us = elapsed;
+        ledd_stats.resync_total_us += elapsed;
+        if (elapsed > ledd_stats.resync_max_us) {
+            ledd_stats.resync_max_us = elapsed;
+        }
+        VLOG_INFO("resync after reconnect took %lld us", elapsed);
+    }
+
     /* For any missing subsystems (no longer there), remove them. */
     ledd_remove_unmarked_subsystems();
+    ledd_link_subsystems();
+    sset_clear(&pass_done);
 
 } /* ledd_reconfigure() */
 
+/************************************************************************//**
+ * Function that ends the write-back transaction of ledd_push_statuses().
+ * On success, the states are counted as written back. Else the LEDs are
+ * marked again, to retry on the next iteration, except for a state that
+ * another client changed in the db since the write-back started (the
+ * verify failed): the newer db state is taken by the next reconfigure
+ * pass instead of being overwritten.
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_push_statuses_done(enum ovsdb_idl_txn_status status)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    const struct ovsrec_led *ovs_led;
+    struct shash_node *node;
+    bool ok = (status == TXN_SUCCESS || status == TXN_UNCHANGED);
+
+    ledd_record_commit(status, status_txn_start);
+    ovsdb_idl_txn_destroy(status_txn);
+    status_txn = NULL;
+
+    if (!ok) {
+        ledd_stats.writeback_retries++;
+        VLOG_DBG_RL(&rl, "LED write-back failed (%s), will retry",
+                    ovsdb_idl_txn_status_to_string(status));
+    }
+
+    OVSREC_LED_FOR_EACH(ovs_led, idl) {
+        struct locl_led *led = shash_find_data(&led_data, ovs_led->id);
+
+        if (led == NULL || !led->state_pushing) {
+            continue;
+        }
+        if (ok) {
+            ledd_stats.written_back++;
+        } else if (led->state_dirty) {
+            /* set again while in flight, the next push has it */
+        } else if (ledd_state_to_enum(ovs_led->state) !=
+                   led->state_verified) {
+            ledd_stats.writeback_superseded++;
+        } else {
+            led->state_dirty = true;
+            state_dirty = true;
+        }
+    }
+
+    SHASH_FOR_EACH(node, &led_data) {
+        struct locl_led *led = node->data;
+
+        if (led->status_pushing && !ok) {
+            led->status_dirty = true;
+            status_dirty = true;
+        }
+        led->status_pushing = false;
+        led->state_pushing = false;
+    }
+} /* ledd_push_statuses_done() */
+
+/************************************************************************//**
+ * Function that pushes to the db the status of the LEDs that were written
+ * outside of ledd_reconfigure() (e.g. after an ops-ledd/request), and the
+ * state of the LEDs set by ops-ledd/set (write-behind).
+ *
+ * The transaction is committed without blocking: a busy ovsdb-server
+ * does not stall the main loop (nor the next ops-ledd/set). While it is
+ * in flight, each call moves it on; LEDs changed meanwhile are pushed by
+ * the next transaction. A state is verified, so that a newer write to
+ * led:state by another client fails the transaction instead of being
+ * overwritten.
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_push_statuses(void)
+{
+    const struct ovsrec_led *ovs_led;
+    enum ovsdb_idl_txn_status status;
+    struct shash_node *node;
+    bool changed = false;
+
+    if (status_txn) {
+        status = ovsdb_idl_txn_commit(status_txn);
+        if (status != TXN_INCOMPLETE) {
+            ledd_push_statuses_done(status);
+        }
+        return;
+    }
+
+    if ((!status_dirty && !state_dirty) || summary_txn) {
+        return;
+    }
+
+    status_txn = ovsdb_idl_txn_create(idl);
+    status_txn_start = time_usec();
+
+    OVSREC_LED_FOR_EACH(ovs_led, idl) {
+        struct locl_led *led = shash_find_data(&led_data, ovs_led->id);
+
+        if (led && led->status_dirty &&
+            ledd_status_to_enum(ovs_led->status) != led->status) {
+            ovsrec_led_set_status(ovs_led, ledd_status_to_string(led->status));
+            led->status_pushing = true;
+            changed = true;
+        }
+        if (led && led->state_dirty &&
+            ledd_state_to_enum(ovs_led->state) != led->state) {
+            led->state_verified = ledd_state_to_enum(ovs_led->state);
+            ovsrec_led_verify_state(ovs_led);
+            ovsrec_led_set_state(ovs_led, ledd_state_to_string(led->state));
+            led->state_pushing = true;
+            changed = true;
+        }
+    }
+
+    SHASH_FOR_EACH(node, &led_data) {
+        struct locl_led *led = node->data;
+
+        led->status_dirty = false;
+        led->state_dirty = false;
+    }
+    status_dirty = false;
+    state_dirty = false;
+
+    status = changed ? ovsdb_idl_txn_commit(status_txn) : TXN_UNCHANGED;
+    if (status != TXN_INCOMPLETE) {
+        ledd_push_statuses_done(status);
+    }
+} /* ledd_push_statuses() */
+
+/************************************************************************//**
+ * Function that ends the transaction of ledd_publish_summaries(). If it
+ * failed, the counts it held are marked again, to retry at the next
+ * publish.
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_publish_summaries_done(enum ovsdb_idl_txn_status status)
+{
+    struct shash_node *node;
+    bool ok = (status == TXN_SUCCESS || status == TXN_UNCHANGED);
+
+    ledd_record_commit(status, summary_txn_start);
+    ovsdb_idl_txn_destroy(summary_txn);
+    summary_txn = NULL;
+
+    if (!ok) {
+        VLOG_DBG("LED summary commit failed (%s), will retry",
+                 ovsdb_idl_txn_status_to_string(status));
+    }
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsys = node->data;
+
+        if (subsys->summary_pushing && !ok) {
+            subsys->summary_dirty = true;
+            summary_dirty = true;
+        }
+        subsys->summary_pushing = false;
+    }
+} /* ledd_publish_summaries_done() */
+
+/************************************************************************//**
+ * Function that publishes the LED summary counts of every subsystem whose
+ *     counts changed, so that "show system led summary" does not have to
+ *     walk the LED table.
+ *
+ * The transaction is committed without blocking, as in
+ * ledd_push_statuses(): while it is in flight, each call moves it on, and
+ * counts changed meanwhile are published by the next transaction.
+ *
+ * Logic:
+ *     - do nothing if no count changed, if the last publish was less
+ *       than LEDD_SUMMARY_INTERVAL_MS ago (bounds the extra db traffic),
+ *       or if the write-back of ledd_push_statuses() is in flight
+ *     - foreach changed subsystem
+ *         - set the led_* keys in subsystem:other_info (other keys are
+ *           kept, the column is verified against concurrent writers)
+ *     - commit, and mark the counts again if the commit failed
+ *
+ * Returns:  void
+ ***************************************************************************/
+static void
+ledd_publish_summaries(void)
+{
+    const struct ovsrec_subsystem *ovs_sub;
+    struct locl_subsystem *subsys;
+    enum ovsdb_idl_txn_status status;
+    long long int now = time_msec();
+    bool changed = false;
+    size_t i;
+
+    if (summary_txn) {
+        status = ovsdb_idl_txn_commit(summary_txn);
+        if (status != TXN_INCOMPLETE) {
+            ledd_publish_summaries_done(status);
+        }
+        return;
+    }
+
+    if (!summary_dirty || now < summary_next_publish || status_txn) {
+        return;
+    }
+
+    summary_txn = ovsdb_idl_txn_create(idl);
+    summary_txn_start = time_usec();
+
+    OVSREC_SUBSYSTEM_FOR_EACH(ovs_sub, idl) {
+        struct smap other_info;
+        char key[32];
+        char value[16];
+
+        subsys = shash_find_data(&subsystem_data, ovs_sub->name);
+        if (subsys == NULL || !subsys->summary_dirty) {
+            continue;
+        }
+
+        smap_clone(&other_info, &ovs_sub->other_info);
+        for (i = 0; i < LEDD_N_LED_STATES; i++) {
+            snprintf(key, sizeof key, "leds_%s", led_state_strings[i]);
+            snprintf(value, sizeof value, "%d", subsys->state_count[i]);
+            smap_replace(&other_info, key, value);
+        }
+        for (i = 0; i < LEDD_N_LED_STATUSES; i++) {
+            snprintf(key, sizeof key, "leds_%s", led_status_strings[i]);
+            snprintf(value, sizeof value, "%d", subsys->status_count[i]);
+            smap_replace(&other_info, key, value);
+        }
+        snprintf(value, sizeof value, "%"PRIuSIZE,
+                 shash_count(&subsys->subsystem_leds));
+        smap_replace(&other_info, "leds_total", value);
+
+        ovsrec_subsystem_verify_other_info(ovs_sub);
+        ovsrec_subsystem_set_other_info(ovs_sub, &other_info);
+        smap_destroy(&other_info);
+
+        subsys->summary_dirty = false;
+        subsys->summary_pushing = true;
+        changed = true;
+    }
+    summary_dirty = false;
+    summary_next_publish = now + LEDD_SUMMARY_INTERVAL_MS;
+
+    status = changed ? ovsdb_idl_txn_commit(summary_txn) : TXN_UNCHANGED;
+    if (status != TXN_INCOMPLETE) {
+        ledd_publish_summaries_done(status);
+    }
+} /* ledd_publish_summaries() */
+
 static void
 ledd_run(void)
 {
     ovsdb_idl_run(idl);
 
+    /* The lock is dropped whenever the session to ovsdb-server is lost, so
+       if we have already programmed LEDs, the replayed db must be
+       reconciled with what we know once the lock is back. */
+    if (!ovsdb_idl_has_lock(idl) && !shash_is_empty(&subsystem_data)) {
+        resync_pending = true;
+    }
+    if (!ovsdb_idl_has_lock(idl)) {
+        rules_resync = true;
+    }
+
     if (ovsdb_idl_is_lock_contended(idl)) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
 
@@ -944,7 +5954,22 @@ ledd_run(void)
         return;
     }
 
-    ledd_reconfigure();
+    /* moves an LED write-back or a summary publish in flight on; the
+       passes that write to the db wait until they complete */
+    ledd_push_statuses();
+    ledd_publish_summaries();
+    if (status_txn == NULL && summary_txn == NULL) {
+        ledd_reconfigure();
+    }
+    ledd_rules_run();
+    ledd_breaker_run();
+    ledd_set_run();
+    ledd_ramp_run();
+    ledd_sched_run();
+    ledd_publish_summaries();
+    ledd_push_statuses();
+    ledd_record_run();
+    ledd_buses_release();
 
     daemonize_complete();
     vlog_enable_async();
@@ -955,6 +5980,46 @@ static void
 ledd_wait(void)
 {
     ovsdb_idl_wait(idl);
+
+    /* an unfinished reconfigure pass, or queued LED writes, resume on the
+       next iteration */
+    if (pass_active || ledd_sched_busy()) {
+        poll_immediate_wake();
+    }
+
+    /* statuses changed by ops-ledd/request, and states set by
+       ops-ledd/set, are pushed on the next pass, once the write-back in
+       flight (if any) completes */
+    if (status_txn) {
+        ovsdb_idl_txn_wait(status_txn);
+    } else if (summary_txn) {
+        ovsdb_idl_txn_wait(summary_txn);
+    } else if (status_dirty || state_dirty) {
+        poll_immediate_wake();
+    }
+
+    if (!shash_is_empty(&timed_sets)) {
+        ledd_timer_wait_until(ledd_set_next_expiry());
+    }
+
+    if (breaker_probe_pending) {
+        ledd_timer_wait_until(ledd_breaker_next_probe());
+    }
+
+    if (!shash_is_empty(&ramps)) {
+        ledd_timer_wait_until(ramp_next_tick);
+    }
+
+    /* a publish waiting for the write-back is woken by its completion */
+    if (summary_dirty && summary_txn == NULL && status_txn == NULL) {
+        ledd_timer_wait_until(summary_next_publish);
+    }
+
+    if (trace_enabled) {
+        ledd_timer_wait_until(trace_next_flush);
+    }
+
+    ledd_subscribers_wait();
 } /* ledd_wait() */
 
 /* ************ MAIN ******************** */
@@ -969,6 +6034,10 @@ main(int argc, char *argv[])
 
     set_program_name(argv[0]);
 
+    ledd_profile.stall_threshold_ms = LEDD_STALL_THRESHOLD_DEFAULT;
+    ledd_profile.timer_deadline = LLONG_MAX;
+    ledd_profile_reset();
+
     proctitle_init(argc, argv);
     remote = parse_options(argc, argv, &unixctl_path);
     fatal_ignore_sigpipe();
@@ -981,25 +6050,87 @@ main(int argc, char *argv[])
     if (retval) {
         exit(EXIT_FAILURE);
     }
-    unixctl_command_register("exit", "", 0, 0, ledd_exit, &exiting);
+    ledd_unixctl_command_register("exit", "", 0, 0, ledd_exit, &exiting);
 
     ledd_init(remote);
     free(remote);
 
     exiting = false;
     while (!exiting) {
+        unsigned int seqno = ovsdb_idl_get_seqno(idl);
+        unsigned int unixctl_calls = ledd_profile.unixctl_calls;
+        unsigned int hw_writes = ledd_stats.hw_writes;
+        bool timer_fired = time_msec() >= ledd_profile.timer_deadline;
+        long long int start;
+
+        ledd_profile.timer_deadline = LLONG_MAX;
+
+        start = time_usec();
         ledd_run();
+        ledd_profile_phase(LEDD_PHASE_RUN, start, hw_writes);
+
+        memory_run();
+        if (memory_should_report()) {
+            struct simap usage;
+
+            simap_init(&usage);
+            ledd_get_memory_usage(&usage);
+            memory_report(&usage);
+            simap_destroy(&usage);
+        }
+
+        start = time_usec();
         unixctl_server_run(unixctl);
+        ledd_profile_phase(LEDD_PHASE_UNIXCTL, start, hw_writes);
+
+        /* after the changes of ledd_run() and of the unixctl commands */
+        ledd_subscribers_run();
+
+        /* Attribute the wakeup that started this iteration. */
+        if (ovsdb_idl_get_seqno(idl) != seqno) {
+            ledd_profile.last_wakeup = LEDD_WAKEUP_IDL;
+        } else if (ledd_profile.unixctl_calls != unixctl_calls) {
+            ledd_profile.last_wakeup = LEDD_WAKEUP_UNIXCTL;
+        } else if (timer_fired) {
+            ledd_profile.last_wakeup = LEDD_WAKEUP_TIMER;
+        } else {
+            ledd_profile.last_wakeup = LEDD_WAKEUP_OTHER;
+        }
+        ledd_profile.wakeups[ledd_profile.last_wakeup]++;
 
         ledd_wait();
         unixctl_server_wait(unixctl);
+        memory_wait();
         if (exiting) {
             poll_immediate_wake();
         }
+
+        start = time_usec();
         poll_block();
+        ledd_profile_phase(LEDD_PHASE_POLL, start, hw_writes);
     }
 
+    if (status_txn) {
+        ovsdb_idl_txn_destroy(status_txn);
+    }
+    if (summary_txn) {
+        ovsdb_idl_txn_destroy(summary_txn);
+    }
     ovsdb_idl_destroy(idl);
+    if (trace_enabled) {
+        ledd_trace_close(&trace);
+    }
+    if (led_table_enabled) {
+        ledd_shm_close(&led_table);
+    }
+    while (n_subscribers > 0) {
+        ledd_subscriber_close(subscribers[--n_subscribers]);
+    }
+    pstream_close(subscribe_listener);
+    ledd_changes_destroy(&changes);
+    if (hw_backend == &ledd_proxy_backend) {
+        ledd_proxy_client_destroy(&hw_proxy);
+    }
     unixctl_server_destroy(unixctl);
 
     return 0;
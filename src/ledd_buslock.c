@@ -0,0 +1,212 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Source file for the cooperative platform bus lock
+ *
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "ledd_buslock.h"
+
+/* first and longest sleep between two tries of a contended lock */
+#define LEDD_BUSLOCK_BACKOFF_MIN_US 50
+#define LEDD_BUSLOCK_BACKOFF_MAX_US 1000
+
+static long long int
+ledd_buslock_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return((long long int) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+} /* ledd_buslock_now_us() */
+
+/* create a directory and its parents, as other daemons may not have */
+static int
+ledd_buslock_mkdirs(const char *dir)
+{
+    char *path = strdup(dir);
+    char *p;
+    int error = 0;
+
+    if (path == NULL) {
+        return(ENOMEM);
+    }
+    for (p = path + 1; ; p++) {
+        if (*p == '/' || *p == '\0') {
+            char c = *p;
+
+            *p = '\0';
+            if (mkdir(path, 0755) && errno != EEXIST) {
+                error = errno;
+                break;
+            }
+            *p = c;
+            if (c == '\0') {
+                break;
+            }
+        }
+    }
+    free(path);
+
+    return(error);
+} /* ledd_buslock_mkdirs() */
+
+/************************************************************************//**
+ * Function that sets up the lock of a bus: the lock file is
+ * <dir>/<bus>.lock, and it is opened (created if needed) on the first
+ * acquire.
+ *
+ * Returns: 0 on success, else an errno value (the directory could not be
+ *          created)
+ ***************************************************************************/
+int
+ledd_buslock_init(struct ledd_buslock *lock, const char *dir,
+                  const char *bus)
+{
+    size_t len = strlen(dir);
+    char *p;
+
+    memset(lock, 0, sizeof *lock);
+    lock->fd = -1;
+
+    lock->path = malloc(len + 1 + strlen(bus) + sizeof ".lock");
+    if (lock->path == NULL) {
+        return(ENOMEM);
+    }
+    sprintf(lock->path, "%s/%s.lock", dir, bus);
+    for (p = lock->path + len + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '_';
+        }
+    }
+
+    return(ledd_buslock_mkdirs(dir));
+} /* ledd_buslock_init() */
+
+/************************************************************************//**
+ * Function that takes the lock of a bus, waiting at most timeout_ms for
+ * another process to release it. Taking a lock already held by the caller
+ * does nothing, so a batch of accesses takes it once.
+ *
+ * Returns: 0 if the lock is held, ETIMEDOUT if it was not released in
+ *          time, else an errno value
+ ***************************************************************************/
+int
+ledd_buslock_acquire(struct ledd_buslock *lock, long long int timeout_ms)
+{
+    long long int start, now, wait;
+    useconds_t backoff = LEDD_BUSLOCK_BACKOFF_MIN_US;
+    bool contended = false;
+
+    if (lock->held) {
+        return(0);
+    }
+
+    if (lock->fd < 0) {
+        lock->fd = open(lock->path, O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (lock->fd < 0) {
+            return(errno);
+        }
+    }
+
+    start = ledd_buslock_now_us();
+    for (;;) {
+        if (!flock(lock->fd, LOCK_EX | LOCK_NB)) {
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EWOULDBLOCK) {
+            return(errno);
+        }
+
+        contended = true;
+        now = ledd_buslock_now_us();
+        if (now - start >= timeout_ms * 1000) {
+            lock->timeouts++;
+            return(ETIMEDOUT);
+        }
+        usleep(backoff);
+        if (backoff < LEDD_BUSLOCK_BACKOFF_MAX_US) {
+            backoff *= 2;
+        }
+    }
+
+    now = ledd_buslock_now_us();
+    wait = now - start;
+    lock->held = true;
+    lock->acquired_us = now;
+    lock->acquisitions++;
+    if (contended) {
+        lock->contended++;
+    }
+    lock->wait_total_us += wait;
+    if (wait > lock->wait_max_us) {
+        lock->wait_max_us = wait;
+    }
+
+    return(0);
+} /* ledd_buslock_acquire() */
+
+/* release the lock of a bus, if held */
+void
+ledd_buslock_release(struct ledd_buslock *lock)
+{
+    long long int hold;
+
+    if (!lock->held) {
+        return;
+    }
+
+    flock(lock->fd, LOCK_UN);
+    lock->held = false;
+
+    hold = ledd_buslock_now_us() - lock->acquired_us;
+    lock->hold_total_us += hold;
+    if (hold > lock->hold_max_us) {
+        lock->hold_max_us = hold;
+    }
+} /* ledd_buslock_release() */
+
+/* release the lock of a bus and close its file */
+void
+ledd_buslock_destroy(struct ledd_buslock *lock)
+{
+    ledd_buslock_release(lock);
+    if (lock->fd >= 0) {
+        close(lock->fd);
+        lock->fd = -1;
+    }
+    free(lock->path);
+    lock->path = NULL;
+} /* ledd_buslock_destroy() */
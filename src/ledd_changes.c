@@ -0,0 +1,134 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Source file for the ring buffer of LED changes
+ *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ledd_changes.h"
+
+/************************************************************************//**
+ * Function that sets up an empty ring of "capacity" changes. The epoch
+ * must differ between instances (e.g. the start time of the daemon).
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+int
+ledd_changes_init(struct ledd_changes *changes, size_t capacity,
+                  uint64_t epoch)
+{
+    memset(changes, 0, sizeof *changes);
+    if (capacity == 0) {
+        return(EINVAL);
+    }
+
+    changes->ring = calloc(capacity, sizeof *changes->ring);
+    if (changes->ring == NULL) {
+        return(ENOMEM);
+    }
+    changes->capacity = capacity;
+    changes->epoch = epoch;
+
+    return(0);
+} /* ledd_changes_init() */
+
+void
+ledd_changes_destroy(struct ledd_changes *changes)
+{
+    free(changes->ring);
+    changes->ring = NULL;
+    changes->capacity = 0;
+} /* ledd_changes_destroy() */
+
+/* the slot of the next change, overwriting the oldest once the ring is
+   full */
+static struct ledd_change *
+ledd_changes_next(struct ledd_changes *changes, const char *id,
+                  int64_t time_ms)
+{
+    uint64_t seq = ++changes->last_seq;
+    struct ledd_change *change = &changes->ring[seq % changes->capacity];
+
+    memset(change, 0, sizeof *change);
+    change->seq = seq;
+    change->time_ms = time_ms;
+    snprintf(change->id, sizeof change->id, "%s", id);
+
+    return(change);
+} /* ledd_changes_next() */
+
+/* add a change of the state or status of an LED, returns its sequence
+   number */
+uint64_t
+ledd_changes_add(struct ledd_changes *changes, const char *id,
+                 const char *state, const char *status, int64_t time_ms)
+{
+    struct ledd_change *change = ledd_changes_next(changes, id, time_ms);
+
+    snprintf(change->state, sizeof change->state, "%s", state);
+    snprintf(change->status, sizeof change->status, "%s", status);
+
+    return(change->seq);
+} /* ledd_changes_add() */
+
+/* add the removal of an LED, returns its sequence number */
+uint64_t
+ledd_changes_remove(struct ledd_changes *changes, const char *id,
+                    int64_t time_ms)
+{
+    struct ledd_change *change = ledd_changes_next(changes, id, time_ms);
+
+    change->removed = true;
+
+    return(change->seq);
+} /* ledd_changes_remove() */
+
+/************************************************************************//**
+ * Function that tells whether a subscriber that has seen the changes up
+ * to "cursor" of "epoch" can catch up from the ring: all the changes
+ * after its cursor must still be in it.
+ *
+ * Returns: True if the changes after cursor can be replayed, False if the
+ *          subscriber needs a snapshot
+ ***************************************************************************/
+bool
+ledd_changes_can_resume(const struct ledd_changes *changes, uint64_t epoch,
+                        uint64_t cursor)
+{
+    return(epoch == changes->epoch && cursor <= changes->last_seq &&
+           changes->last_seq - cursor <= changes->capacity);
+} /* ledd_changes_can_resume() */
+
+/* the change with sequence number seq, NULL if it is not in the ring */
+const struct ledd_change *
+ledd_changes_get(const struct ledd_changes *changes, uint64_t seq)
+{
+    if (seq == 0 || seq > changes->last_seq ||
+        changes->last_seq - seq >= changes->capacity) {
+        return(NULL);
+    }
+
+    return(&changes->ring[seq % changes->capacity]);
+} /* ledd_changes_get() */
@@ -0,0 +1,388 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * LED register access proxy (see ledd_proxy.h)
+ *
+ * ops-ledd-hwproxy runs where the i2c devices are, and does the register
+ * operations of an ops-ledd started with --hw-proxy (e.g. in a container
+ * without /dev/i2c). The devices of each subsystem are read from its
+ * hardware description directory, as ops-ledd does. With --sim, the
+ * registers are simulated instead, for testing without hardware.
+ *
+ * The proxy takes the platform bus lock of a device (see ledd_buslock.h)
+ * for each batch of requests, in place of ops-ledd.
+ *
+ *     usage: ops-ledd-hwproxy [OPTIONS] [SOCKET]
+ *          --hw-desc=SUBSYSTEM:DIR  serve SUBSYSTEM, described in DIR
+ *                                  (repeat for each subsystem)
+ *          --sim[=DELAY_US]        simulate the registers, each access
+ *                                  taking DELAY_US
+ *          --bus-lock-dir=DIR      take the platform bus locks in DIR
+ *                                  (default: /run/ops-platform/bus)
+ *          --no-bus-lock           do not take the platform bus locks
+ *          --detach, --pidfile[=FILE]  daemon options
+ *          -h, --help              display this help message
+ *
+ *     SOCKET defaults to /run/ops-ledd/hwproxy.sock.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "command-line.h"
+#include "daemon.h"
+#include "fatal-signal.h"
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+
+#include "config-yaml.h"
+
+#include "ledd_buslock.h"
+#include "ledd_proxy.h"
+
+VLOG_DEFINE_THIS_MODULE(ops_ledd_hwproxy);
+
+static YamlConfigHandle yaml_handle;
+static struct shash subsystems = SHASH_INITIALIZER(&subsystems);
+static bool sim = false;                /*!< --sim */
+static unsigned int sim_delay_us;       /*!< --sim=DELAY_US */
+static struct shash sim_regs = SHASH_INITIALIZER(&sim_regs);
+
+/* platform bus, as struct ledd_bus in ops-ledd */
+struct hwproxy_bus {
+    bool timed_out;                     /*!< The wait of this batch timed
+                                             out, do not wait again */
+    struct ledd_buslock lock;           /*!< Lock of the bus */
+};
+
+/* platform buses by name, their locks held until the end of a batch */
+static const char *bus_lock_dir = LEDD_BUSLOCK_DEFAULT_DIR;
+static bool bus_lock_enabled = true;
+static struct shash buses = SHASH_INITIALIZER(&buses);
+
+static volatile sig_atomic_t stop = 0;
+
+static void
+usage(void)
+{
+    printf("%s: LED register access proxy for ops-ledd\n"
+           "usage: %s [OPTIONS] [SOCKET]\n"
+           "where SOCKET is the Unix socket of the proxy\n"
+           "      (default: \"%s\").\n"
+           "  --hw-desc=SUBSYSTEM:DIR  serve SUBSYSTEM, described in DIR\n"
+           "                          (repeat for each subsystem)\n"
+           "  --sim[=DELAY_US]        simulate the registers, each access\n"
+           "                          taking DELAY_US\n"
+           "  --bus-lock-dir=DIR      take the platform bus locks in DIR\n"
+           "                          (default: %s)\n"
+           "  --no-bus-lock           do not take the platform bus locks\n"
+           "  -h, --help              display this help message\n",
+           program_name, program_name, LEDD_PROXY_DEFAULT_PATH,
+           LEDD_BUSLOCK_DEFAULT_DIR);
+    daemon_usage();
+    vlog_usage();
+    exit(EXIT_SUCCESS);
+} /* usage() */
+
+/* take the lock of the bus of a device for the rest of the batch; after a
+   wait timed out, the batch goes on without waiting for that bus again */
+static void
+hwproxy_bus_take(const char *subsys, const char *device)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    const YamlDevice *dev;
+    struct hwproxy_bus *bus;
+    int error;
+
+    if (!bus_lock_enabled) {
+        return;
+    }
+    dev = yaml_find_device(yaml_handle, subsys, device);
+    if (dev == NULL || dev->bus == NULL) {
+        return;
+    }
+
+    bus = shash_find_data(&buses, dev->bus);
+    if (bus == NULL) {
+        bus = xzalloc(sizeof *bus);
+        error = ledd_buslock_init(&bus->lock, bus_lock_dir, dev->bus);
+        if (error) {
+            VLOG_WARN_RL(&rl, "bus %s: unable to create %s (%s)", dev->bus,
+                         bus_lock_dir, ovs_strerror(error));
+        }
+        shash_add(&buses, dev->bus, bus);
+    }
+
+    if (!bus->lock.held && !bus->timed_out) {
+        error = ledd_buslock_acquire(&bus->lock,
+                                     LEDD_BUSLOCK_TIMEOUT_DEFAULT);
+        if (error) {
+            VLOG_WARN_RL(&rl, "bus %s: lock not taken (%s)", dev->bus,
+                         ovs_strerror(error));
+            bus->timed_out = true;
+        }
+    }
+    if (bus->lock.held) {
+        bus->lock.accesses++;
+    }
+} /* hwproxy_bus_take() */
+
+/* release the bus locks at the end of a batch */
+static void
+hwproxy_batch_end(void *aux OVS_UNUSED)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &buses) {
+        struct hwproxy_bus *bus = node->data;
+
+        ledd_buslock_release(&bus->lock);
+        bus->timed_out = false;
+    }
+} /* hwproxy_batch_end() */
+
+/* a client held its batch, and the bus locks, too long */
+static void
+hwproxy_batch_timeout(void *aux OVS_UNUSED, long long int held_ms)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+    VLOG_WARN_RL(&rl, "client batch open for %lld ms, disconnecting the "
+                 "client to release the bus locks", held_ms);
+} /* hwproxy_batch_timeout() */
+
+static int
+hwproxy_i2c_op(void *aux OVS_UNUSED, const struct ledd_proxy_req *req,
+               uint32_t *value)
+{
+    i2c_bit_op op;
+    int rc;
+
+    if (!shash_find(&subsystems, req->subsys)) {
+        return(ENOENT);
+    }
+
+    memset(&op, 0, sizeof op);
+    op.device = CONST_CAST(char *, req->device);
+    op.register_address = req->register_address;
+    op.register_size = req->register_size;
+    op.bit_mask = req->bit_mask;
+
+    hwproxy_bus_take(req->subsys, req->device);
+    if (req->op == LEDD_PROXY_WRITE) {
+        rc = i2c_reg_write(yaml_handle, req->subsys, &op, req->value);
+    } else {
+        rc = i2c_reg_read(yaml_handle, req->subsys, &op, value);
+    }
+
+    return(rc ? EIO : 0);
+} /* hwproxy_i2c_op() */
+
+/* simulated registers by "subsystem/device@address", as ops-ledd --hw-sim */
+static int
+hwproxy_sim_op(void *aux OVS_UNUSED, const struct ledd_proxy_req *req,
+               uint32_t *value)
+{
+    uint32_t *reg;
+    char *key;
+
+    if (sim_delay_us) {
+        usleep(sim_delay_us);
+    }
+
+    key = xasprintf("%s/%s@%x", req->subsys, req->device,
+                    req->register_address);
+    reg = shash_find_data(&sim_regs, key);
+    if (reg == NULL) {
+        reg = xzalloc(sizeof *reg);
+        shash_add_nocopy(&sim_regs, key, reg);
+    } else {
+        free(key);
+    }
+
+    if (req->op == LEDD_PROXY_WRITE) {
+        *reg = (*reg & ~req->bit_mask) | (req->value & req->bit_mask);
+    } else {
+        *value = *reg & req->bit_mask;
+    }
+
+    return(0);
+} /* hwproxy_sim_op() */
+
+/* load the devices of SUBSYSTEM:DIR */
+static void
+hwproxy_add_subsystem(const char *arg)
+{
+    const char *colon = strchr(arg, ':');
+    char *name;
+
+    if (colon == NULL || colon == arg || !colon[1]) {
+        VLOG_FATAL("--hw-desc: expected SUBSYSTEM:DIR, got %s", arg);
+    }
+    name = xmemdup0(arg, colon - arg);
+
+    if (yaml_add_subsystem(yaml_handle, name, colon + 1) ||
+        yaml_parse_devices(yaml_handle, name)) {
+        VLOG_FATAL("unable to read the devices of subsystem %s in %s",
+                   name, colon + 1);
+    }
+    shash_add_once(&subsystems, name, NULL);
+    free(name);
+} /* hwproxy_add_subsystem() */
+
+static void
+hwproxy_stop(int sig OVS_UNUSED)
+{
+    stop = 1;
+} /* hwproxy_stop() */
+
+static const char *
+parse_options(int argc, char *argv[])
+{
+    enum {
+        OPT_HW_DESC = UCHAR_MAX + 1,
+        OPT_SIM,
+        OPT_BUS_LOCK_DIR,
+        OPT_NO_BUS_LOCK,
+        VLOG_OPTION_ENUMS,
+        DAEMON_OPTION_ENUMS,
+    };
+    static const struct option long_options[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"hw-desc", required_argument, NULL, OPT_HW_DESC},
+        {"sim", optional_argument, NULL, OPT_SIM},
+        {"bus-lock-dir", required_argument, NULL, OPT_BUS_LOCK_DIR},
+        {"no-bus-lock", no_argument, NULL, OPT_NO_BUS_LOCK},
+        DAEMON_LONG_OPTIONS,
+        VLOG_LONG_OPTIONS,
+        {NULL, 0, NULL, 0},
+    };
+    char *short_options = long_options_to_short_options(long_options);
+
+    yaml_handle = yaml_new_config_handle();
+
+    for (;;) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            usage();
+
+        case OPT_HW_DESC:
+            hwproxy_add_subsystem(optarg);
+            break;
+
+        case OPT_SIM:
+            sim = true;
+            if (optarg && !str_to_uint(optarg, 10, &sim_delay_us)) {
+                VLOG_FATAL("--sim: invalid delay %s", optarg);
+            }
+            break;
+
+        case OPT_BUS_LOCK_DIR:
+            bus_lock_dir = optarg;
+            break;
+
+        case OPT_NO_BUS_LOCK:
+            bus_lock_enabled = false;
+            break;
+
+        VLOG_OPTION_HANDLERS
+        DAEMON_OPTION_HANDLERS
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+    free(short_options);
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc > 1) {
+        VLOG_FATAL("at most one socket is accepted; use --help for usage");
+    }
+    if (!sim && shash_is_empty(&subsystems)) {
+        VLOG_FATAL("no subsystem to serve: use --hw-desc or --sim");
+    }
+
+    return(argc == 1 ? argv[0] : LEDD_PROXY_DEFAULT_PATH);
+} /* parse_options() */
+
+int
+main(int argc, char *argv[])
+{
+    struct ledd_proxy_handler handler;
+    struct shash_node *node;
+    const char *path;
+    int error;
+    int fd;
+
+    set_program_name(argv[0]);
+    path = parse_options(argc, argv);
+    fatal_ignore_sigpipe();
+
+    if (!strcmp(path, LEDD_PROXY_DEFAULT_PATH)) {
+        mkdir("/run/ops-ledd", 0755);
+    }
+    fd = ledd_proxy_listen(path);
+    if (fd < 0) {
+        VLOG_FATAL("%s: unable to listen (%s)", path, ovs_strerror(-fd));
+    }
+
+    daemonize_start();
+    signal(SIGTERM, hwproxy_stop);
+    signal(SIGINT, hwproxy_stop);
+    daemonize_complete();
+    VLOG_INFO("serving %s (%s)", path, sim ? "simulated registers" : "i2c");
+
+    handler.op = sim ? hwproxy_sim_op : hwproxy_i2c_op;
+    handler.batch_end = sim ? NULL : hwproxy_batch_end;
+    handler.batch_timeout = hwproxy_batch_timeout;
+    handler.aux = NULL;
+    error = ledd_proxy_serve(fd, &handler, &stop);
+
+    close(fd);
+    unlink(path);
+    SHASH_FOR_EACH(node, &buses) {
+        struct hwproxy_bus *bus = node->data;
+
+        ledd_buslock_destroy(&bus->lock);
+    }
+    if (error) {
+        VLOG_FATAL("%s: %s", path, ovs_strerror(error));
+    }
+
+    return(0);
+} /* main() */
@@ -0,0 +1,597 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Source file for the LED register access proxy
+ *
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "ledd_proxy.h"
+
+/* requests of a client that the proxy has read but not yet handled */
+struct ledd_proxy_conn {
+    int fd;                             /* connection, or -1 */
+    bool in_batch;                      /* a request came since the END */
+    long long int batch_start;          /* ledd_proxy_now_us() of the
+                                           first request of the batch */
+    size_t len;                         /* bytes in buf */
+    struct ledd_proxy_req buf[LEDD_PROXY_BATCH_MAX];
+    struct ledd_proxy_rsp rsps[LEDD_PROXY_BATCH_MAX];
+};
+
+static long long int
+ledd_proxy_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return((long long int) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+} /* ledd_proxy_now_us() */
+
+/* fill a unix socket address, ENAMETOOLONG if the path does not fit */
+static int
+ledd_proxy_addr(const char *path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr->sun_path) {
+        return(ENAMETOOLONG);
+    }
+    strcpy(addr->sun_path, path);
+
+    return(0);
+} /* ledd_proxy_addr() */
+
+/* send or receive exactly n bytes, within the socket timeouts */
+static int
+ledd_proxy_xfer(int fd, void *buf, size_t n, bool send_)
+{
+    char *p = buf;
+
+    while (n > 0) {
+        ssize_t retval = send_ ? send(fd, p, n, MSG_NOSIGNAL)
+                               : recv(fd, p, n, 0);
+
+        if (retval < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return(errno == EAGAIN || errno == EWOULDBLOCK ? ETIMEDOUT
+                                                           : errno);
+        } else if (retval == 0) {
+            return(ECONNRESET);
+        }
+        p += retval;
+        n -= retval;
+    }
+
+    return(0);
+} /* ledd_proxy_xfer() */
+
+/* ************ CLIENT ************ */
+
+#define LEDD_PROXY_PIPELINE_MAX 1024 /* requests in flight */
+
+/************************************************************************//**
+ * Function that sets up the client end of the proxy at "path". The
+ * connection is made by the first round trip, and made again after a
+ * failure. "done" gets the result of each staged write.
+ ***************************************************************************/
+void
+ledd_proxy_client_init(struct ledd_proxy_client *client, const char *path,
+                       ledd_proxy_done_cb *done)
+{
+    memset(client, 0, sizeof *client);
+    client->path = strdup(path);
+    client->fd = -1;
+    client->next_seq = 1;
+    client->done = done;
+} /* ledd_proxy_client_init() */
+
+static void
+ledd_proxy_disconnect(struct ledd_proxy_client *client)
+{
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+} /* ledd_proxy_disconnect() */
+
+/* the staged requests are dropped without calling "done" */
+void
+ledd_proxy_client_destroy(struct ledd_proxy_client *client)
+{
+    ledd_proxy_disconnect(client);
+    free(client->path);
+    free(client->reqs);
+    free(client->aux);
+    free(client->rsps);
+    memset(client, 0, sizeof *client);
+    client->fd = -1;
+} /* ledd_proxy_client_destroy() */
+
+static int
+ledd_proxy_connect(struct ledd_proxy_client *client)
+{
+    struct timeval tv = { LEDD_PROXY_TIMEOUT_MS / 1000,
+                          (LEDD_PROXY_TIMEOUT_MS % 1000) * 1000 };
+    struct sockaddr_un addr;
+    int error;
+    int fd;
+
+    if (client->fd >= 0) {
+        return(0);
+    }
+    if (client->path == NULL) {
+        return(ENOMEM);
+    }
+    error = ledd_proxy_addr(client->path, &addr);
+    if (error) {
+        return(error);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return(errno);
+    }
+    if (connect(fd, (struct sockaddr *) &addr, sizeof addr)) {
+        error = errno;
+        close(fd);
+        return(error);
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+
+    client->fd = fd;
+    client->reconnects++;
+
+    return(0);
+} /* ledd_proxy_connect() */
+
+/* add a request to the batch */
+static int
+ledd_proxy_stage(struct ledd_proxy_client *client, const char *subsys,
+                 const struct ledd_proxy_req *op, enum ledd_proxy_opcode code,
+                 uint32_t value, void *aux)
+{
+    struct ledd_proxy_req *req;
+
+    if (strlen(subsys) >= LEDD_PROXY_NAME_LEN ||
+        strnlen(op->device, LEDD_PROXY_NAME_LEN) >= LEDD_PROXY_NAME_LEN) {
+        return(ENAMETOOLONG);
+    }
+
+    if (client->n_reqs >= client->allocated) {
+        size_t allocated = client->allocated ? 2 * client->allocated : 16;
+        struct ledd_proxy_req *reqs;
+        struct ledd_proxy_rsp *rsps;
+        void **auxes;
+
+        reqs = realloc(client->reqs, allocated * sizeof *reqs);
+        if (reqs == NULL) {
+            return(ENOMEM);
+        }
+        client->reqs = reqs;
+        rsps = realloc(client->rsps, allocated * sizeof *rsps);
+        if (rsps == NULL) {
+            return(ENOMEM);
+        }
+        client->rsps = rsps;
+        auxes = realloc(client->aux, allocated * sizeof *auxes);
+        if (auxes == NULL) {
+            return(ENOMEM);
+        }
+        client->aux = auxes;
+        client->allocated = allocated;
+    }
+
+    req = &client->reqs[client->n_reqs];
+    *req = *op;
+    req->seq = client->next_seq++;
+    req->op = code;
+    req->value = value;
+    memset(req->subsys, 0, sizeof req->subsys);
+    strcpy(req->subsys, subsys);
+    client->aux[client->n_reqs] = aux;
+    client->n_reqs++;
+
+    return(0);
+} /* ledd_proxy_stage() */
+
+/************************************************************************//**
+ * Function that sends the staged requests in one go, and reads all their
+ * responses: one round trip (per LEDD_PROXY_PIPELINE_MAX requests).
+ * "done" is called with the result of each write; the result of a read
+ * (the last request) is returned in *read_errorp and *valuep.
+ *
+ * Returns: 0, or the error of the connection (which every request got)
+ ***************************************************************************/
+static int
+ledd_proxy_round_trip(struct ledd_proxy_client *client, int *read_errorp,
+                      uint32_t *valuep)
+{
+    size_t n = client->n_reqs;
+    size_t n_ops = n && client->reqs[n - 1].op == LEDD_PROXY_END ? n - 1 : n;
+    long long int start, rtt;
+    bool mismatch = false;
+    int error;
+    size_t i;
+
+    start = ledd_proxy_now_us();
+    error = ledd_proxy_connect(client);
+
+    /* a huge batch goes in slices, so that neither end fills the socket
+       buffers while the other is still sending */
+    for (i = 0; !error && i < n; i += LEDD_PROXY_PIPELINE_MAX) {
+        size_t slice = n - i < LEDD_PROXY_PIPELINE_MAX
+                       ? n - i : LEDD_PROXY_PIPELINE_MAX;
+
+        error = ledd_proxy_xfer(client->fd, &client->reqs[i],
+                                slice * sizeof *client->reqs, true);
+        if (!error) {
+            error = ledd_proxy_xfer(client->fd, &client->rsps[i],
+                                    slice * sizeof *client->rsps, false);
+        }
+    }
+
+    if (!error) {
+        rtt = ledd_proxy_now_us() - start;
+        client->round_trips++;
+        client->rtt_total_us += rtt;
+        if (rtt > client->rtt_max_us) {
+            client->rtt_max_us = rtt;
+        }
+        if (n_ops > client->batch_max) {
+            client->batch_max = n_ops;
+        }
+    }
+    client->requests += n_ops;
+
+    /* the staged requests are done: "done" may stage new ones */
+    client->n_reqs = 0;
+    for (i = 0; i < n; i++) {
+        const struct ledd_proxy_req *req = &client->reqs[i];
+        const struct ledd_proxy_rsp *rsp = &client->rsps[i];
+        int result = error;
+
+        if (!result && rsp->seq != req->seq) {
+            mismatch = true;
+        }
+        if (!result) {
+            result = mismatch ? EPROTO : rsp->error;
+        }
+        if (result) {
+            client->failures++;
+        }
+
+        if (req->op == LEDD_PROXY_READ) {
+            *read_errorp = result;
+            *valuep = result ? 0 : rsp->value;
+        } else if (req->op == LEDD_PROXY_WRITE && client->done) {
+            client->done(client->aux[i], result);
+        }
+    }
+
+    if (error || mismatch) {
+        /* the proxy ends the batch of a lost connection */
+        ledd_proxy_disconnect(client);
+        client->batch_open = false;
+    }
+
+    return(error ? error : mismatch ? EPROTO : 0);
+} /* ledd_proxy_round_trip() */
+
+/* stage a write of the masked register of op->device: its result goes to
+   "done" with aux when the batch is committed */
+int
+ledd_proxy_write(struct ledd_proxy_client *client, const char *subsys,
+                 const struct ledd_proxy_req *op, uint32_t value, void *aux)
+{
+    return(ledd_proxy_stage(client, subsys, op, LEDD_PROXY_WRITE, value,
+                            aux));
+} /* ledd_proxy_write() */
+
+/* read the masked register of op->device, in one round trip with the
+   staged writes */
+int
+ledd_proxy_read(struct ledd_proxy_client *client, const char *subsys,
+                const struct ledd_proxy_req *op, uint32_t *value)
+{
+    int read_error = 0;
+    int error;
+
+    error = ledd_proxy_stage(client, subsys, op, LEDD_PROXY_READ, 0, NULL);
+    if (error) {
+        return(error);
+    }
+    client->batch_open = true;
+    ledd_proxy_round_trip(client, &read_error, value);
+
+    return(read_error);
+} /* ledd_proxy_read() */
+
+/* send the staged writes and the end of the batch, see
+   ledd_proxy_round_trip() */
+int
+ledd_proxy_commit(struct ledd_proxy_client *client)
+{
+    struct ledd_proxy_req end;
+    int read_error;
+    uint32_t value;
+    int error;
+
+    if (client->n_reqs == 0 && !client->batch_open) {
+        return(0);
+    }
+
+    memset(&end, 0, sizeof end);
+    error = ledd_proxy_stage(client, "", &end, LEDD_PROXY_END, 0, NULL);
+    if (error) {
+        return(error);
+    }
+    client->batch_open = false;
+
+    return(ledd_proxy_round_trip(client, &read_error, &value));
+} /* ledd_proxy_commit() */
+
+/* ************ PROXY ************ */
+
+/************************************************************************//**
+ * Function that creates the listening socket of a proxy at "path",
+ * replacing a socket left by a previous proxy.
+ *
+ * Returns: the socket, else a negative errno value
+ ***************************************************************************/
+int
+ledd_proxy_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int error;
+    int fd;
+
+    error = ledd_proxy_addr(path, &addr);
+    if (error) {
+        return(-error);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return(-errno);
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof addr) ||
+        listen(fd, LEDD_PROXY_MAX_CLIENTS)) {
+        error = errno;
+        close(fd);
+        return(-error);
+    }
+
+    return(fd);
+} /* ledd_proxy_listen() */
+
+/* the batch of a client ended: the last one calls batch_end */
+static void
+ledd_proxy_batch_done(struct ledd_proxy_conn *conn,
+                      const struct ledd_proxy_handler *handler,
+                      int *n_batchesp)
+{
+    if (!conn->in_batch) {
+        return;
+    }
+    conn->in_batch = false;
+    if (--*n_batchesp == 0 && handler->batch_end) {
+        handler->batch_end(handler->aux);
+    }
+} /* ledd_proxy_batch_done() */
+
+/************************************************************************//**
+ * Function that handles the requests read from a client in one go, and
+ * sends their responses in one go. A partial request is kept for the
+ * next read. *n_batchesp counts the clients in a batch.
+ *
+ * Returns: False if the connection must be closed
+ ***************************************************************************/
+static bool
+ledd_proxy_serve_conn(struct ledd_proxy_conn *conn,
+                      const struct ledd_proxy_handler *handler,
+                      int *n_batchesp)
+{
+    size_t n, i;
+    ssize_t retval;
+
+    retval = recv(conn->fd, (char *) conn->buf + conn->len,
+                  sizeof conn->buf - conn->len, 0);
+    if (retval < 0) {
+        return(errno == EINTR || errno == EAGAIN);
+    } else if (retval == 0) {
+        return(false);
+    }
+    conn->len += retval;
+
+    n = conn->len / sizeof *conn->buf;
+    for (i = 0; i < n; i++) {
+        struct ledd_proxy_req *req = &conn->buf[i];
+        struct ledd_proxy_rsp *rsp = &conn->rsps[i];
+
+        memset(rsp, 0, sizeof *rsp);
+        rsp->seq = req->seq;
+        req->subsys[LEDD_PROXY_NAME_LEN - 1] = '\0';
+        req->device[LEDD_PROXY_NAME_LEN - 1] = '\0';
+        if (req->op == LEDD_PROXY_END) {
+            ledd_proxy_batch_done(conn, handler, n_batchesp);
+        } else if (req->op != LEDD_PROXY_READ &&
+                   req->op != LEDD_PROXY_WRITE) {
+            rsp->error = EINVAL;
+        } else {
+            if (!conn->in_batch) {
+                conn->in_batch = true;
+                conn->batch_start = ledd_proxy_now_us();
+                ++*n_batchesp;
+            }
+            rsp->error = handler->op(handler->aux, req, &rsp->value);
+        }
+    }
+
+    conn->len -= n * sizeof *conn->buf;
+    memmove(conn->buf, &conn->buf[n], conn->len);
+
+    return(ledd_proxy_xfer(conn->fd, conn->rsps, n * sizeof *conn->rsps,
+                           true) == 0);
+} /* ledd_proxy_serve_conn() */
+
+/************************************************************************//**
+ * Function that aborts the batches held open for more than
+ * LEDD_PROXY_BATCH_TIMEOUT_MS: the client is disconnected, which ends its
+ * batch (its next requests fail, and it reconnects).
+ *
+ * Returns: the time until the next batch expires (ms), at most 1000
+ ***************************************************************************/
+static int
+ledd_proxy_expire_batches(struct ledd_proxy_conn *conns,
+                          const struct ledd_proxy_handler *handler,
+                          int *n_batchesp)
+{
+    long long int now = ledd_proxy_now_us();
+    int timeout = 1000;
+    int i;
+
+    for (i = 0; i < LEDD_PROXY_MAX_CLIENTS; i++) {
+        struct ledd_proxy_conn *conn = &conns[i];
+        long long int left;
+
+        if (conn->fd < 0 || !conn->in_batch) {
+            continue;
+        }
+        left = conn->batch_start + LEDD_PROXY_BATCH_TIMEOUT_MS * 1000LL - now;
+        if (left > 0) {
+            if ((left + 999) / 1000 < timeout) {
+                timeout = (left + 999) / 1000;
+            }
+            continue;
+        }
+
+        if (handler->batch_timeout) {
+            handler->batch_timeout(handler->aux,
+                                   (now - conn->batch_start) / 1000);
+        }
+        ledd_proxy_batch_done(conn, handler, n_batchesp);
+        close(conn->fd);
+        conn->fd = -1;
+    }
+
+    return(timeout);
+} /* ledd_proxy_expire_batches() */
+
+/************************************************************************//**
+ * Function that serves the clients of a proxy until *stop is set (stop
+ * may be NULL). Up to LEDD_PROXY_MAX_CLIENTS clients are served; the
+ * batches of the clients end together, see struct ledd_proxy_handler, and
+ * a batch held open too long is aborted.
+ *
+ * Returns: 0 once stopped, else an errno value
+ ***************************************************************************/
+int
+ledd_proxy_serve(int listen_fd, const struct ledd_proxy_handler *handler,
+                 volatile sig_atomic_t *stop)
+{
+    struct pollfd fds[1 + LEDD_PROXY_MAX_CLIENTS];
+    struct ledd_proxy_conn *conns;
+    int n_batches = 0;
+    int error = 0;
+    int i;
+
+    conns = calloc(LEDD_PROXY_MAX_CLIENTS, sizeof *conns);
+    if (conns == NULL) {
+        return(ENOMEM);
+    }
+    for (i = 0; i < LEDD_PROXY_MAX_CLIENTS; i++) {
+        conns[i].fd = -1;
+    }
+
+    while (stop == NULL || !*stop) {
+        int timeout = ledd_proxy_expire_batches(conns, handler, &n_batches);
+
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (i = 0; i < LEDD_PROXY_MAX_CLIENTS; i++) {
+            fds[1 + i].fd = conns[i].fd;
+            fds[1 + i].events = POLLIN;
+            fds[1 + i].revents = 0;
+        }
+
+        /* wake up now and then to look at *stop, and when a batch
+           expires */
+        if (poll(fds, 1 + LEDD_PROXY_MAX_CLIENTS, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = errno;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+
+            for (i = 0; fd >= 0 && i < LEDD_PROXY_MAX_CLIENTS; i++) {
+                if (conns[i].fd < 0) {
+                    conns[i].fd = fd;
+                    conns[i].len = 0;
+                    conns[i].in_batch = false;
+                    fd = -1;
+                }
+            }
+            if (fd >= 0) {
+                /* too many clients */
+                close(fd);
+            }
+        }
+
+        for (i = 0; i < LEDD_PROXY_MAX_CLIENTS; i++) {
+            if (fds[1 + i].fd >= 0 && fds[1 + i].revents &&
+                !ledd_proxy_serve_conn(&conns[i], handler, &n_batches)) {
+                ledd_proxy_batch_done(&conns[i], handler, &n_batches);
+                close(conns[i].fd);
+                conns[i].fd = -1;
+            }
+        }
+    }
+
+    for (i = 0; i < LEDD_PROXY_MAX_CLIENTS; i++) {
+        if (conns[i].fd >= 0) {
+            ledd_proxy_batch_done(&conns[i], handler, &n_batches);
+            close(conns[i].fd);
+        }
+    }
+    free(conns);
+
+    return(error);
+} /* ledd_proxy_serve() */
@@ -0,0 +1,481 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Replay of an ops-ledd trace (see ledd_trace.h)
+ *
+ * The Subsystem and LED state changes of the trace are applied to the db,
+ * with the timing of the trace or as fast as the db takes them, so that an
+ * ops-ledd running against this db (normally with --hw-sim, and --record
+ * to trace the replay) goes through the recorded workload. The LED writes
+ * and commits of the trace are what the recorded ops-ledd did: compare
+ * them with --stats on both traces.
+ *
+ *     usage: ops-ledd-replay [OPTIONS] TRACE [DATABASE]
+ *          --stats                 print the statistics of TRACE and exit
+ *          --max-speed             apply the changes without waiting
+ *          --speed=FACTOR          replay FACTOR times faster (default: 1)
+ *          --hw-desc-dir=DIR       use DIR/<subsystem> as hw_desc_dir
+ *          --timeout=S             wait at most S for an LED row
+ *                                  (default: 10)
+ *          -h, --help              display this help message
+ *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "command-line.h"
+#include "dirs.h"
+#include "ovsdb-idl.h"
+#include "poll-loop.h"
+#include "shash.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "vswitch-idl.h"
+
+#include "ledd_trace.h"
+
+VLOG_DEFINE_THIS_MODULE(ops_ledd_replay);
+
+static bool stats_only = false;         /*!< --stats */
+static double speed = 1.0;              /*!< 0 for --max-speed */
+static const char *hw_desc_dir = NULL;  /*!< --hw-desc-dir */
+static long long int row_timeout_ms = 10000; /*!< --timeout */
+
+/************************************************************************//**
+ * STRUCT used to collect the latencies of one kind of operation.
+ ***************************************************************************/
+struct replay_latency {
+    uint32_t *us;                       /*!< Latencies */
+    size_t n;                           /*!< Number of latencies */
+    size_t allocated;                   /*!< Allocated latencies */
+    size_t failures;                    /*!< Operations that failed */
+};
+
+static void
+usage(void)
+{
+    printf("%s: replay an ops-ledd trace\n"
+           "usage: %s [OPTIONS] TRACE [DATABASE]\n"
+           "where DATABASE is a socket on which ovsdb-server is listening\n"
+           "      (default: \"unix:%s/db.sock\").\n"
+           "  --stats                 print the statistics of TRACE and exit\n"
+           "  --max-speed             apply the changes without waiting\n"
+           "  --speed=FACTOR          replay FACTOR times faster (default: 1)\n"
+           "  --hw-desc-dir=DIR       use DIR/<subsystem> as hw_desc_dir\n"
+           "  --timeout=S             wait at most S for an LED row\n"
+           "                          (default: 10)\n"
+           "  -h, --help              display this help message\n",
+           program_name, program_name, ovs_rundir());
+    exit(EXIT_SUCCESS);
+} /* usage() */
+
+static void
+replay_latency_add(struct replay_latency *lat, uint32_t us, bool failed)
+{
+    if (lat->n >= lat->allocated) {
+        lat->us = x2nrealloc(lat->us, &lat->allocated, sizeof *lat->us);
+    }
+    lat->us[lat->n++] = us;
+    if (failed) {
+        lat->failures++;
+    }
+} /* replay_latency_add() */
+
+static int
+replay_compare_u32(const void *a_, const void *b_)
+{
+    uint32_t a = *(const uint32_t *) a_;
+    uint32_t b = *(const uint32_t *) b_;
+
+    return(a < b ? -1 : a > b);
+} /* replay_compare_u32() */
+
+/* print the count, failures and p50/p99/max latency of an operation */
+static void
+replay_latency_print(const char *name, struct replay_latency *lat)
+{
+    if (!lat->n) {
+        printf("%s: none\n", name);
+        return;
+    }
+    qsort(lat->us, lat->n, sizeof *lat->us, replay_compare_u32);
+    printf("%s: %"PRIuSIZE" (%"PRIuSIZE" failed), latency p50 %"PRIu32
+           " us, p99 %"PRIu32" us, max %"PRIu32" us\n", name, lat->n,
+           lat->failures, lat->us[lat->n / 2], lat->us[lat->n * 99 / 100],
+           lat->us[lat->n - 1]);
+} /* replay_latency_print() */
+
+/************************************************************************//**
+ * Function that prints the statistics of a trace: the number of records
+ * of each type, and the latency of the LED writes and of the commits.
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+static int
+replay_stats(const char *path)
+{
+    struct replay_latency writes = { NULL, 0, 0, 0 };
+    struct replay_latency commits = { NULL, 0, 0, 0 };
+    unsigned long long n[LEDD_TRACE_N_TYPES] = { 0 };
+    struct ledd_trace_record rec;
+    struct ledd_trace trace;
+    long long int start;
+    long long int end = 0;
+    int error;
+
+    error = ledd_trace_open(&trace, path, &start);
+    if (error) {
+        return(error);
+    }
+
+    while ((error = ledd_trace_read(&trace, &rec)) == 0) {
+        n[rec.type]++;
+        end = rec.time_us;
+        if (rec.type == LEDD_TRACE_HW_WRITE) {
+            replay_latency_add(&writes, rec.latency_us, rec.error != 0);
+        } else if (rec.type == LEDD_TRACE_COMMIT) {
+            replay_latency_add(&commits, rec.latency_us,
+                               rec.error != TXN_SUCCESS &&
+                               rec.error != TXN_UNCHANGED);
+        }
+    }
+    ledd_trace_close(&trace);
+    if (error != EOF) {
+        VLOG_WARN("%s: corrupted record after %llu records", path,
+                  trace.records);
+    }
+
+    printf("%s: %llu records over %.3f s\n", path, trace.records,
+           end / 1e6);
+    printf("subsystems added: %llu, removed: %llu\n",
+           n[LEDD_TRACE_SUBSYS_ADD], n[LEDD_TRACE_SUBSYS_DEL]);
+    printf("LED state changes: %llu\n", n[LEDD_TRACE_LED_STATE]);
+    replay_latency_print("LED writes", &writes);
+    replay_latency_print("commits", &commits);
+
+    free(writes.us);
+    free(commits.us);
+
+    return(0);
+} /* replay_stats() */
+
+/* run the IDL until the time (time_msec()) "until" */
+static void
+replay_wait_until(struct ovsdb_idl *idl, long long int until)
+{
+    while (time_msec() < until) {
+        ovsdb_idl_run(idl);
+        ovsdb_idl_wait(idl);
+        poll_timer_wait_until(until);
+        poll_block();
+    }
+    ovsdb_idl_run(idl);
+} /* replay_wait_until() */
+
+static const struct ovsrec_subsystem *
+replay_find_subsystem(struct ovsdb_idl *idl, const char *name)
+{
+    const struct ovsrec_subsystem *row;
+
+    OVSREC_SUBSYSTEM_FOR_EACH(row, idl) {
+        if (!strcmp(row->name, name)) {
+            return(row);
+        }
+    }
+
+    return(NULL);
+} /* replay_find_subsystem() */
+
+/************************************************************************//**
+ * Function that finds the row of an LED, waiting up to --timeout for
+ * ops-ledd to create it (the LED rows of a subsystem are created by
+ * ops-ledd once the subsystem is added). The index of the LED rows is
+ * rebuilt when the replica changed.
+ *
+ * Returns: the row, or NULL if it did not appear
+ ***************************************************************************/
+static const struct ovsrec_led *
+replay_find_led(struct ovsdb_idl *idl, struct shash *index,
+                unsigned int *index_seqno, const char *id)
+{
+    long long int deadline = time_msec() + row_timeout_ms;
+
+    for (;;) {
+        if (*index_seqno != ovsdb_idl_get_seqno(idl)) {
+            const struct ovsrec_led *row;
+
+            shash_clear(index);
+            OVSREC_LED_FOR_EACH(row, idl) {
+                shash_replace(index, row->id, row);
+            }
+            *index_seqno = ovsdb_idl_get_seqno(idl);
+        }
+        if (shash_find(index, id) || time_msec() >= deadline) {
+            return(shash_find_data(index, id));
+        }
+
+        ovsdb_idl_wait(idl);
+        poll_timer_wait_until(deadline);
+        poll_block();
+        ovsdb_idl_run(idl);
+    }
+} /* replay_find_led() */
+
+/************************************************************************//**
+ * Function that applies the Subsystem and LED state changes of a trace to
+ * the db, each one in its own transaction.
+ *
+ * Logic:
+ *     - wait for the replica of the db
+ *     - foreach record
+ *         - unless --max-speed, wait until its time (scaled by --speed)
+ *         - subsystem added: insert the Subsystem row, or set its
+ *           hw_desc_dir if it exists
+ *         - subsystem removed: delete the Subsystem row
+ *         - LED state: set led:state, once ops-ledd created the row
+ *         - LED write, commit: skipped, they are ops-ledd's own work
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+static int
+replay(const char *path, const char *remote)
+{
+    struct ledd_trace_record rec;
+    struct ledd_trace trace;
+    struct ovsdb_idl *idl;
+    struct shash index = SHASH_INITIALIZER(&index);
+    unsigned int index_seqno = 0;
+    unsigned long long applied = 0;
+    unsigned long long missing = 0;
+    unsigned long long failed = 0;
+    long long int end_us = 0;
+    long long int start;
+    long long int t0;
+    int error;
+
+    error = ledd_trace_open(&trace, path, &start);
+    if (error) {
+        return(error);
+    }
+
+    idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false, true);
+    ovsdb_idl_add_table(idl, &ovsrec_table_subsystem);
+    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_name);
+    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_hw_desc_dir);
+    ovsdb_idl_add_table(idl, &ovsrec_table_led);
+    ovsdb_idl_add_column(idl, &ovsrec_led_col_id);
+    ovsdb_idl_add_column(idl, &ovsrec_led_col_state);
+
+    while (!ovsdb_idl_has_ever_connected(idl)) {
+        ovsdb_idl_run(idl);
+        ovsdb_idl_wait(idl);
+        poll_block();
+    }
+
+    t0 = time_msec();
+    while ((error = ledd_trace_read(&trace, &rec)) == 0) {
+        const struct ovsrec_subsystem *ovs_sub;
+        const struct ovsrec_led *ovs_led;
+        struct ovsdb_idl_txn *txn;
+        enum ovsdb_idl_txn_status status;
+        char *dir;
+
+        if (rec.type != LEDD_TRACE_SUBSYS_ADD &&
+            rec.type != LEDD_TRACE_SUBSYS_DEL &&
+            rec.type != LEDD_TRACE_LED_STATE) {
+            continue;
+        }
+        end_us = rec.time_us;
+
+        if (speed > 0) {
+            replay_wait_until(idl, t0 + (long long int) (rec.time_us /
+                                                          1000 / speed));
+        } else {
+            ovsdb_idl_run(idl);
+        }
+
+        txn = ovsdb_idl_txn_create(idl);
+        switch (rec.type) {
+        case LEDD_TRACE_SUBSYS_ADD:
+            dir = hw_desc_dir ? xasprintf("%s/%s", hw_desc_dir, rec.name)
+                              : xstrdup(rec.text);
+            ovs_sub = replay_find_subsystem(idl, rec.name);
+            if (ovs_sub == NULL) {
+                struct ovsrec_subsystem *row = ovsrec_subsystem_insert(txn);
+
+                ovsrec_subsystem_set_name(row, rec.name);
+                ovs_sub = row;
+            }
+            ovsrec_subsystem_set_hw_desc_dir(ovs_sub, dir);
+            free(dir);
+            break;
+
+        case LEDD_TRACE_SUBSYS_DEL:
+            ovs_sub = replay_find_subsystem(idl, rec.name);
+            if (ovs_sub) {
+                ovsrec_subsystem_delete(ovs_sub);
+            }
+            break;
+
+        case LEDD_TRACE_LED_STATE:
+        default:
+            ovs_led = replay_find_led(idl, &index, &index_seqno, rec.name);
+            if (ovs_led == NULL) {
+                VLOG_WARN("LED %s: no row after %lld ms, change skipped",
+                          rec.name, row_timeout_ms);
+                missing++;
+                break;
+            }
+            ovsrec_led_set_state(ovs_led, rec.text);
+            break;
+        }
+
+        status = ovsdb_idl_txn_commit_block(txn);
+        ovsdb_idl_txn_destroy(txn);
+        if (status == TXN_SUCCESS || status == TXN_UNCHANGED) {
+            applied++;
+        } else {
+            VLOG_WARN("change %llu: commit failed (%s)", trace.records,
+                      ovsdb_idl_txn_status_to_string(status));
+            failed++;
+        }
+    }
+    ledd_trace_close(&trace);
+
+    printf("%llu changes applied in %.3f s (trace: %.3f s), %llu without "
+           "an LED row, %llu failed\n", applied, (time_msec() - t0) / 1e3,
+           end_us / 1e6, missing, failed);
+
+    shash_destroy(&index);
+    ovsdb_idl_destroy(idl);
+
+    return(error == EOF ? 0 : error);
+} /* replay() */
+
+static char *
+parse_options(int argc, char *argv[], const char **tracep)
+{
+    enum {
+        OPT_STATS = UCHAR_MAX + 1,
+        OPT_MAX_SPEED,
+        OPT_SPEED,
+        OPT_HW_DESC_DIR,
+        OPT_TIMEOUT,
+    };
+    static const struct option long_options[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"stats", no_argument, NULL, OPT_STATS},
+        {"max-speed", no_argument, NULL, OPT_MAX_SPEED},
+        {"speed", required_argument, NULL, OPT_SPEED},
+        {"hw-desc-dir", required_argument, NULL, OPT_HW_DESC_DIR},
+        {"timeout", required_argument, NULL, OPT_TIMEOUT},
+        {NULL, 0, NULL, 0},
+    };
+    char *short_options = long_options_to_short_options(long_options);
+    double timeout;
+
+    for (;;) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            usage();
+
+        case OPT_STATS:
+            stats_only = true;
+            break;
+
+        case OPT_MAX_SPEED:
+            speed = 0;
+            break;
+
+        case OPT_SPEED:
+            if (!str_to_double(optarg, &speed) || speed <= 0) {
+                VLOG_FATAL("--speed: invalid value %s", optarg);
+            }
+            break;
+
+        case OPT_HW_DESC_DIR:
+            hw_desc_dir = optarg;
+            break;
+
+        case OPT_TIMEOUT:
+            if (!str_to_double(optarg, &timeout) || timeout < 0) {
+                VLOG_FATAL("--timeout: invalid value %s", optarg);
+            }
+            row_timeout_ms = timeout * 1000;
+            break;
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+    free(short_options);
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || argc > 2) {
+        VLOG_FATAL("a trace and at most one database are accepted; "
+                   "use --help for usage");
+    }
+    *tracep = argv[0];
+
+    return(argc == 2 ? xstrdup(argv[1])
+                     : xasprintf("unix:%s/db.sock", ovs_rundir()));
+} /* parse_options() */
+
+int
+main(int argc, char *argv[])
+{
+    const char *path;
+    char *remote;
+    int error;
+
+    set_program_name(argv[0]);
+    remote = parse_options(argc, argv, &path);
+
+    if (stats_only) {
+        error = replay_stats(path);
+    } else {
+        ovsrec_init();
+        error = replay(path, remote);
+    }
+    free(remote);
+
+    if (error) {
+        VLOG_FATAL("%s: %s", path, error == EINVAL ? "not an ops-ledd trace"
+                                                   : ovs_strerror(error));
+    }
+
+    return(0);
+} /* main() */
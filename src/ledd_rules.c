@@ -0,0 +1,559 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Source file for the parsing and matching of the fault-LED rules
+ *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ledd_rules.h"
+
+#define LEDD_RULES_N_FIELDS     7     /* Fields of a line, with priority */
+
+/************************************************************************//**
+ * Function that sets up the rules, with none yet. "inputs" are the names
+ * of the columns the rules can watch and "states" the names of the states
+ * they can request; both must outlive the rules.
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+int
+ledd_rules_init(struct ledd_rules *rules, const char *const *inputs,
+                size_t n_inputs, const char *const *states, size_t n_states)
+{
+    size_t i;
+
+    memset(rules, 0, sizeof *rules);
+    rules->inputs = calloc(n_inputs ? n_inputs : 1, sizeof *rules->inputs);
+    if (rules->inputs == NULL) {
+        return(ENOMEM);
+    }
+    for (i = 0; i < n_inputs; i++) {
+        rules->inputs[i].name = inputs[i];
+    }
+    rules->n_inputs = n_inputs;
+    rules->states = states;
+    rules->n_states = n_states;
+
+    return(0);
+} /* ledd_rules_init() */
+
+/* forget all the rows of an input */
+static void
+ledd_rules_clear_rows(struct ledd_rules_input *input)
+{
+    size_t i;
+
+    for (i = 0; i < input->n_buckets; i++) {
+        struct ledd_rules_row *row = input->buckets[i];
+
+        while (row) {
+            struct ledd_rules_row *next = row->next;
+
+            free(row->key);
+            free(row->value);
+            free(row);
+            row = next;
+        }
+        input->buckets[i] = NULL;
+    }
+    input->n_rows = 0;
+} /* ledd_rules_clear_rows() */
+
+void
+ledd_rules_destroy(struct ledd_rules *rules)
+{
+    size_t i, j;
+
+    for (i = 0; i < rules->n_rules; i++) {
+        struct ledd_rule *rule = &rules->rules[i];
+
+        for (j = 0; j < rule->n_values; j++) {
+            free(rule->values[j]);
+        }
+        free(rule->values);
+        free(rule->name);
+        free(rule->source);
+        free(rule->led);
+    }
+    free(rules->rules);
+
+    for (i = 0; i < rules->n_inputs; i++) {
+        ledd_rules_clear_rows(&rules->inputs[i]);
+        free(rules->inputs[i].buckets);
+    }
+    free(rules->inputs);
+
+    memset(rules, 0, sizeof *rules);
+} /* ledd_rules_destroy() */
+
+/* true if a value (NULL: no value) is one of the values of a rule */
+static bool
+ledd_rule_matches(const struct ledd_rule *rule, const char *value)
+{
+    size_t i;
+
+    if (value == NULL) {
+        return(false);
+    }
+    for (i = 0; i < rule->n_values; i++) {
+        if (!strcmp(rule->values[i], value)) {
+            return(true);
+        }
+    }
+
+    return(false);
+} /* ledd_rule_matches() */
+
+/* format a parse error, always returns EINVAL */
+static int
+ledd_rules_error(char *error, size_t error_size, const char *format, ...)
+{
+    va_list args;
+
+    if (error && error_size) {
+        va_start(args, format);
+        vsnprintf(error, error_size, format, args);
+        va_end(args);
+    }
+
+    return(EINVAL);
+} /* ledd_rules_error() */
+
+/* split the comma-separated values of a rule, skipping empty ones */
+static int
+ledd_rules_split_values(struct ledd_rule *rule, char *values)
+{
+    char *save_ptr = NULL;
+    char *value;
+
+    for (value = strtok_r(values, ",", &save_ptr); value != NULL;
+         value = strtok_r(NULL, ",", &save_ptr)) {
+        char **new_values;
+        size_t i;
+
+        for (i = 0; i < rule->n_values; i++) {
+            if (!strcmp(rule->values[i], value)) {
+                break;
+            }
+        }
+        if (i < rule->n_values) {
+            continue;
+        }
+
+        new_values = realloc(rule->values,
+                             (rule->n_values + 1) * sizeof *rule->values);
+        if (new_values == NULL) {
+            return(ENOMEM);
+        }
+        rule->values = new_values;
+        rule->values[rule->n_values] = strdup(value);
+        if (rule->values[rule->n_values] == NULL) {
+            return(ENOMEM);
+        }
+        rule->n_values++;
+    }
+
+    return(0);
+} /* ledd_rules_split_values() */
+
+/************************************************************************//**
+ * Function that parses one line of the rules file and adds its rule:
+ *     <name> <led> <state> any|all <input> <value>[,...] [<priority>]
+ * The priority is default_priority when the line has none. Empty lines
+ * and lines starting with '#' are skipped, and so is a '#' comment after
+ * the fields.
+ *
+ * Returns: 0 if the line was added or skipped, EEXIST if a rule of that
+ *          name is already defined, EINVAL if the line does not parse (or
+ *          ENOMEM); error (if not NULL) then tells why
+ ***************************************************************************/
+int
+ledd_rules_parse(struct ledd_rules *rules, const char *line,
+                 int default_priority, char *error, size_t error_size)
+{
+    char *fields[LEDD_RULES_N_FIELDS];
+    char *save_ptr = NULL;
+    struct ledd_rule rule;
+    size_t n_fields = 0;
+    size_t input;
+    size_t i;
+    char *copy;
+    char *field;
+    int retval;
+
+    copy = strdup(line);
+    if (copy == NULL) {
+        return(ENOMEM);
+    }
+    for (field = strtok_r(copy, " \t\r\n", &save_ptr);
+         field != NULL && field[0] != '#';
+         field = strtok_r(NULL, " \t\r\n", &save_ptr)) {
+        if (n_fields == LEDD_RULES_N_FIELDS) {
+            retval = ledd_rules_error(error, error_size,
+                                      "unexpected \"%s\" after the priority",
+                                      field);
+            free(copy);
+            return(retval);
+        }
+        fields[n_fields++] = field;
+    }
+    if (n_fields == 0) {
+        free(copy);
+        return(0);
+    }
+
+    memset(&rule, 0, sizeof rule);
+    rule.priority = default_priority;
+    if (n_fields < LEDD_RULES_N_FIELDS - 1
+        || (strcmp(fields[3], "any") && strcmp(fields[3], "all"))) {
+        free(copy);
+        return(ledd_rules_error(error, error_size,
+                                "expected \"<name> <led> <state> any|all "
+                                "<table>:<column> <value>[,...] "
+                                "[<priority>]\""));
+    }
+    if (n_fields == LEDD_RULES_N_FIELDS) {
+        char *end;
+        long priority;
+
+        errno = 0;
+        priority = strtol(fields[6], &end, 10);
+        if (errno || *end || end == fields[6]
+            || priority < INT_MIN || priority > INT_MAX) {
+            retval = ledd_rules_error(error, error_size,
+                                      "invalid priority %s", fields[6]);
+            free(copy);
+            return(retval);
+        }
+        rule.priority = (int) priority;
+    }
+
+    for (i = 0; i < rules->n_states; i++) {
+        if (!strcmp(rules->states[i], fields[2])) {
+            break;
+        }
+    }
+    if (i == rules->n_states) {
+        retval = ledd_rules_error(error, error_size, "invalid state %s",
+                                  fields[2]);
+        free(copy);
+        return(retval);
+    }
+    rule.state = (unsigned int) i;
+
+    for (input = 0; input < rules->n_inputs; input++) {
+        if (!strcmp(rules->inputs[input].name, fields[4])) {
+            break;
+        }
+    }
+    if (input == rules->n_inputs) {
+        retval = ledd_rules_error(error, error_size, "%s cannot be watched",
+                                  fields[4]);
+        free(copy);
+        return(retval);
+    }
+    rule.input = input;
+
+    for (i = 0; i < rules->n_rules; i++) {
+        if (!strcmp(rules->rules[i].name, fields[0])) {
+            ledd_rules_error(error, error_size, "rule %s defined twice",
+                             fields[0]);
+            free(copy);
+            return(EEXIST);
+        }
+    }
+
+    rule.all = !strcmp(fields[3], "all");
+    rule.name = strdup(fields[0]);
+    rule.led = strdup(fields[1]);
+    rule.source = malloc(strlen("rule:") + strlen(fields[0]) + 1);
+    retval = (rule.name && rule.led && rule.source) ? 0 : ENOMEM;
+    if (!retval) {
+        sprintf(rule.source, "rule:%s", fields[0]);
+        retval = ledd_rules_split_values(&rule, fields[5]);
+    }
+    if (!retval && rule.n_values == 0) {
+        retval = ledd_rules_error(error, error_size, "rule %s has no values",
+                                  fields[0]);
+    }
+    if (!retval && rules->n_rules == rules->allocated_rules) {
+        size_t allocated = rules->allocated_rules ?
+                           2 * rules->allocated_rules : 4;
+        struct ledd_rule *new_rules;
+
+        new_rules = realloc(rules->rules, allocated * sizeof *new_rules);
+        if (new_rules) {
+            rules->rules = new_rules;
+            rules->allocated_rules = allocated;
+        } else {
+            retval = ENOMEM;
+        }
+    }
+    free(copy);
+
+    if (retval) {
+        for (i = 0; i < rule.n_values; i++) {
+            free(rule.values[i]);
+        }
+        free(rule.values);
+        free(rule.name);
+        free(rule.led);
+        free(rule.source);
+        return(retval);
+    }
+
+    /* the rows already known count for the new rule */
+    for (i = 0; i < rules->inputs[input].n_buckets; i++) {
+        const struct ledd_rules_row *row;
+
+        for (row = rules->inputs[input].buckets[i]; row; row = row->next) {
+            rule.n_match += ledd_rule_matches(&rule, row->value);
+        }
+    }
+    rule.dirty = true;
+    rules->rules[rules->n_rules++] = rule;
+    rules->inputs[input].used = true;
+
+    return(0);
+} /* ledd_rules_parse() */
+
+/* FNV-1a hash of a row key */
+static uint32_t
+ledd_rules_hash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; *key; key++) {
+        hash = (hash ^ (unsigned char) *key) * 16777619u;
+    }
+
+    return(hash);
+} /* ledd_rules_hash() */
+
+/* the row of an input by key, as the link that points to it */
+static struct ledd_rules_row **
+ledd_rules_find_row(struct ledd_rules_input *input, const char *key)
+{
+    struct ledd_rules_row **rowp;
+
+    if (input->n_buckets == 0) {
+        return(NULL);
+    }
+    rowp = &input->buckets[ledd_rules_hash(key) & (input->n_buckets - 1)];
+    for (; *rowp; rowp = &(*rowp)->next) {
+        if (!strcmp((*rowp)->key, key)) {
+            return(rowp);
+        }
+    }
+
+    return(NULL);
+} /* ledd_rules_find_row() */
+
+/* make room for one more row in an input, keeping at most one row per
+   bucket on average */
+static int
+ledd_rules_reserve_row(struct ledd_rules_input *input)
+{
+    struct ledd_rules_row **buckets;
+    size_t n_buckets;
+    size_t i;
+
+    if (input->n_rows < input->n_buckets) {
+        return(0);
+    }
+
+    n_buckets = input->n_buckets ? 2 * input->n_buckets : 16;
+    buckets = calloc(n_buckets, sizeof *buckets);
+    if (buckets == NULL) {
+        return(ENOMEM);
+    }
+    for (i = 0; i < input->n_buckets; i++) {
+        struct ledd_rules_row *row = input->buckets[i];
+
+        while (row) {
+            struct ledd_rules_row *next = row->next;
+            size_t bucket = ledd_rules_hash(row->key) & (n_buckets - 1);
+
+            row->next = buckets[bucket];
+            buckets[bucket] = row;
+            row = next;
+        }
+    }
+    free(input->buckets);
+    input->buckets = buckets;
+    input->n_buckets = n_buckets;
+
+    return(0);
+} /* ledd_rules_reserve_row() */
+
+/* record that a row of an input changed from old to new (NULL: no row or
+   no value) in the match counts of the rules that watch it; the rules of
+   an "all" input also depend on the number of rows */
+static void
+ledd_rules_row_changed(struct ledd_rules *rules, size_t input,
+                       const char *old, const char *new)
+{
+    size_t i;
+
+    for (i = 0; i < rules->n_rules; i++) {
+        struct ledd_rule *rule = &rules->rules[i];
+        bool was = ledd_rule_matches(rule, old);
+        bool is = ledd_rule_matches(rule, new);
+
+        if (rule->input != input) {
+            continue;
+        }
+        if (was != is) {
+            if (is) {
+                rule->n_match++;
+            } else {
+                rule->n_match--;
+            }
+            rule->dirty = true;
+        } else if (rule->all && (old == NULL) != (new == NULL)) {
+            rule->dirty = true;
+        }
+    }
+} /* ledd_rules_row_changed() */
+
+/************************************************************************//**
+ * Function that sets the value of the row "key" of an input, NULL for a
+ * deleted row or a row without a value, and updates the match counts of
+ * the rules that watch the input.
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+int
+ledd_rules_set_row(struct ledd_rules *rules, size_t input, const char *key,
+                   const char *value)
+{
+    struct ledd_rules_input *in = &rules->inputs[input];
+    struct ledd_rules_row **rowp = ledd_rules_find_row(in, key);
+    struct ledd_rules_row *row = rowp ? *rowp : NULL;
+    char *copy;
+
+    if (row && value && !strcmp(row->value, value)) {
+        return(0);
+    }
+    if (row == NULL && value == NULL) {
+        return(0);
+    }
+
+    if (value == NULL) {
+        ledd_rules_row_changed(rules, input, row->value, NULL);
+        *rowp = row->next;
+        free(row->key);
+        free(row->value);
+        free(row);
+        in->n_rows--;
+        return(0);
+    }
+
+    copy = strdup(value);
+    if (copy == NULL) {
+        return(ENOMEM);
+    }
+    if (row) {
+        ledd_rules_row_changed(rules, input, row->value, copy);
+        free(row->value);
+        row->value = copy;
+        return(0);
+    }
+
+    row = calloc(1, sizeof *row);
+    if (row == NULL || ledd_rules_reserve_row(in)
+        || (row->key = strdup(key)) == NULL) {
+        free(row);
+        free(copy);
+        return(ENOMEM);
+    }
+    row->value = copy;
+    rowp = &in->buckets[ledd_rules_hash(key) & (in->n_buckets - 1)];
+    row->next = *rowp;
+    *rowp = row;
+    in->n_rows++;
+    ledd_rules_row_changed(rules, input, NULL, copy);
+
+    return(0);
+} /* ledd_rules_set_row() */
+
+/************************************************************************//**
+ * Function that forgets all the rows of an input before they are set again
+ * from scratch (after a reconnect, when the changes in between are not
+ * known): the match counts of its rules restart from 0, and the rules are
+ * evaluated again by the next ledd_rules_next_change().
+ ***************************************************************************/
+void
+ledd_rules_resync(struct ledd_rules *rules, size_t input)
+{
+    size_t i;
+
+    ledd_rules_clear_rows(&rules->inputs[input]);
+    for (i = 0; i < rules->n_rules; i++) {
+        if (rules->rules[i].input == input) {
+            rules->rules[i].n_match = 0;
+            rules->rules[i].dirty = true;
+        }
+    }
+} /* ledd_rules_resync() */
+
+/************************************************************************//**
+ * Function that evaluates the rules whose counts changed, from *pos (start
+ * at 0), and returns the next one that became active or inactive. Its
+ * "active" is then the new outcome, for the caller to post or withdraw the
+ * request of the rule.
+ *
+ * Returns: the rule, or NULL when there is no other change
+ ***************************************************************************/
+struct ledd_rule *
+ledd_rules_next_change(struct ledd_rules *rules, size_t *pos)
+{
+    while (*pos < rules->n_rules) {
+        struct ledd_rule *rule = &rules->rules[(*pos)++];
+        size_t n_rows = rules->inputs[rule->input].n_rows;
+        bool active;
+
+        if (!rule->dirty) {
+            continue;
+        }
+        rule->dirty = false;
+
+        active = rule->all ? n_rows && rule->n_match == n_rows
+                           : rule->n_match > 0;
+        if (active == rule->active) {
+            continue;
+        }
+        rule->active = active;
+        if (active) {
+            rule->fired++;
+        }
+        return(rule);
+    }
+
+    return(NULL);
+} /* ledd_rules_next_change() */
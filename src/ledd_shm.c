@@ -0,0 +1,437 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Source file for the shared-memory LED state table
+ *
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ledd_shm.h"
+
+/* size of a table file with the given number of slots */
+static size_t
+ledd_shm_size(uint32_t capacity)
+{
+    return(sizeof(struct ledd_shm_header) +
+           (size_t) capacity * sizeof(struct ledd_shm_entry));
+} /* ledd_shm_size() */
+
+/************************************************************************//**
+ * Function that creates and maps a new, empty table in "<path>.tmp". The
+ * table is not visible to readers until ledd_shm_publish() is called.
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+static int
+ledd_shm_make(struct ledd_shm *shm, const char *path, uint32_t capacity)
+{
+    char *tmp = NULL;
+    void *map;
+    size_t size = ledd_shm_size(capacity);
+    int error = 0;
+    int fd;
+
+    if (asprintf(&tmp, "%s.tmp", path) < 0) {
+        return(ENOMEM);
+    }
+
+    fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = errno;
+        free(tmp);
+        return(error);
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        error = errno;
+        goto out;
+    }
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        error = errno;
+        goto out;
+    }
+
+    memset(shm, 0, sizeof *shm);
+    shm->path = strdup(path);
+    shm->size = size;
+    shm->capacity = capacity;
+    shm->header = map;
+    shm->entries = (struct ledd_shm_entry *) (shm->header + 1);
+    shm->writable = true;
+
+    shm->header->magic = LEDD_SHM_MAGIC;
+    shm->header->version = LEDD_SHM_VERSION;
+    shm->header->entry_size = sizeof(struct ledd_shm_entry);
+    shm->header->capacity = capacity;
+    shm->header->writer_pid = getpid();
+
+out:
+    if (error) {
+        unlink(tmp);
+    }
+    close(fd);
+    free(tmp);
+    return(error);
+} /* ledd_shm_make() */
+
+/* make a table created by ledd_shm_make() visible to readers */
+static int
+ledd_shm_publish(struct ledd_shm *shm)
+{
+    char *tmp = NULL;
+    int error = 0;
+
+    if (asprintf(&tmp, "%s.tmp", shm->path) < 0) {
+        return(ENOMEM);
+    }
+    if (rename(tmp, shm->path) < 0) {
+        error = errno;
+        unlink(tmp);
+    }
+    free(tmp);
+
+    return(error);
+} /* ledd_shm_publish() */
+
+/* release the mapping and the private data of a table */
+static void
+ledd_shm_unmap(struct ledd_shm *shm)
+{
+    if (shm->header) {
+        munmap(shm->header, shm->size);
+    }
+    free(shm->path);
+    free(shm->free_slots);
+    memset(shm, 0, sizeof *shm);
+} /* ledd_shm_unmap() */
+
+/************************************************************************//**
+ * Function that creates the table at "path" with room for "capacity" LEDs,
+ * replacing any table left by a previous writer.
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+int
+ledd_shm_create(struct ledd_shm *shm, const char *path, uint32_t capacity)
+{
+    int error;
+
+    error = ledd_shm_make(shm, path, capacity);
+    if (error) {
+        return(error);
+    }
+
+    error = ledd_shm_publish(shm);
+    if (error) {
+        ledd_shm_unmap(shm);
+    }
+
+    return(error);
+} /* ledd_shm_create() */
+
+/************************************************************************//**
+ * Function that replaces the table by a larger copy.
+ *
+ * Logic:
+ *     - create the new table next to the current one
+ *     - copy the header counters, all of the slots and the free list
+ *     - carry an open batch over: the new table starts with the odd
+ *       sequence number and the depth, so that ledd_shm_write_end()
+ *       closes the batch on it
+ *     - rename the new table over the current one
+ *     - flag the current table as superseded, so readers reopen
+ *
+ * Returns: 0 on success, else an errno value (the table is unchanged)
+ ***************************************************************************/
+int
+ledd_shm_grow(struct ledd_shm *shm, uint32_t capacity)
+{
+    struct ledd_shm new_shm;
+    int error;
+
+    if (capacity <= shm->capacity) {
+        return(EINVAL);
+    }
+
+    error = ledd_shm_make(&new_shm, shm->path, capacity);
+    if (error) {
+        return(error);
+    }
+
+    new_shm.header->n_entries = shm->header->n_entries;
+    new_shm.header->seq = shm->header->seq;
+    new_shm.depth = shm->depth;
+    memcpy(new_shm.entries, shm->entries,
+           (size_t) shm->capacity * sizeof(struct ledd_shm_entry));
+
+    error = ledd_shm_publish(&new_shm);
+    if (error) {
+        ledd_shm_unmap(&new_shm);
+        return(error);
+    }
+
+    new_shm.free_slots = shm->free_slots;
+    new_shm.n_free = shm->n_free;
+    shm->free_slots = NULL;
+
+    __atomic_store_n(&shm->header->superseded, 1, __ATOMIC_RELEASE);
+    ledd_shm_unmap(shm);
+    *shm = new_shm;
+
+    return(0);
+} /* ledd_shm_grow() */
+
+/************************************************************************//**
+ * Function that starts a batch of updates. Readers retry until the
+ * outermost batch has ended, so batches should be kept short.
+ ***************************************************************************/
+void
+ledd_shm_write_begin(struct ledd_shm *shm)
+{
+    if (shm->depth++ == 0) {
+        uint32_t seq = shm->header->seq;
+
+        __atomic_store_n(&shm->header->seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+} /* ledd_shm_write_begin() */
+
+/* end a batch of updates started by ledd_shm_write_begin() */
+void
+ledd_shm_write_end(struct ledd_shm *shm)
+{
+    if (--shm->depth == 0) {
+        uint32_t seq = shm->header->seq;
+
+        __atomic_store_n(&shm->header->seq, seq + 1, __ATOMIC_RELEASE);
+    }
+} /* ledd_shm_write_end() */
+
+/************************************************************************//**
+ * Function that reserves a slot for a new LED.
+ *
+ * Returns: the slot index, or -1 if the table is full (see ledd_shm_grow)
+ ***************************************************************************/
+int
+ledd_shm_alloc(struct ledd_shm *shm)
+{
+    int slot;
+
+    if (shm->n_free) {
+        return((int) shm->free_slots[--shm->n_free]);
+    }
+
+    if (shm->header->n_entries >= shm->capacity) {
+        return(-1);
+    }
+
+    ledd_shm_write_begin(shm);
+    slot = (int) shm->header->n_entries++;
+    ledd_shm_write_end(shm);
+
+    return(slot);
+} /* ledd_shm_alloc() */
+
+/* release the slot of an LED that no longer exists */
+void
+ledd_shm_free(struct ledd_shm *shm, int slot)
+{
+    uint32_t *free_slots;
+
+    if (slot < 0 || (uint32_t) slot >= shm->capacity) {
+        return;
+    }
+
+    ledd_shm_write_begin(shm);
+    shm->entries[slot].in_use = 0;
+    ledd_shm_write_end(shm);
+
+    free_slots = realloc(shm->free_slots,
+                         (shm->n_free + 1) * sizeof *free_slots);
+    if (free_slots) {
+        free_slots[shm->n_free++] = (uint32_t) slot;
+        shm->free_slots = free_slots;
+    }
+} /* ledd_shm_free() */
+
+/* update the slot of an LED in place */
+void
+ledd_shm_set(struct ledd_shm *shm, int slot, const char *id,
+             const char *state, const char *hw_state,
+             const char *status, int64_t last_change)
+{
+    struct ledd_shm_entry *entry;
+
+    if (slot < 0 || (uint32_t) slot >= shm->capacity) {
+        return;
+    }
+    entry = &shm->entries[slot];
+
+    ledd_shm_write_begin(shm);
+    snprintf(entry->id, sizeof entry->id, "%s", id);
+    snprintf(entry->state, sizeof entry->state, "%s", state);
+    snprintf(entry->hw_state, sizeof entry->hw_state, "%s", hw_state);
+    snprintf(entry->status, sizeof entry->status, "%s", status);
+    entry->last_change = last_change;
+    entry->in_use = 1;
+    ledd_shm_write_end(shm);
+} /* ledd_shm_set() */
+
+/************************************************************************//**
+ * Function that maps the table at "path" read-only.
+ *
+ * Returns: 0 on success, else an errno value (EPROTO for a table with an
+ *          unknown layout)
+ ***************************************************************************/
+int
+ledd_shm_open(struct ledd_shm *shm, const char *path)
+{
+    const struct ledd_shm_header *header;
+    struct stat st;
+    void *map;
+    int error = 0;
+    int fd;
+
+    memset(shm, 0, sizeof *shm);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return(errno);
+    }
+
+    if (fstat(fd, &st) < 0) {
+        error = errno;
+        close(fd);
+        return(error);
+    }
+    if ((size_t) st.st_size < sizeof *header) {
+        close(fd);
+        return(EPROTO);
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return(errno);
+    }
+
+    header = map;
+    if (header->magic != LEDD_SHM_MAGIC ||
+        header->version != LEDD_SHM_VERSION ||
+        header->entry_size != sizeof(struct ledd_shm_entry) ||
+        ledd_shm_size(header->capacity) > (size_t) st.st_size) {
+        munmap(map, st.st_size);
+        return(EPROTO);
+    }
+
+    shm->path = strdup(path);
+    shm->size = st.st_size;
+    shm->capacity = header->capacity;
+    shm->header = map;
+    shm->entries = (struct ledd_shm_entry *) (shm->header + 1);
+    shm->writable = false;
+
+    return(0);
+} /* ledd_shm_open() */
+
+/************************************************************************//**
+ * Function that takes a consistent snapshot of the LEDs in the table.
+ *
+ * Logic:
+ *     - read the sequence number, retry while a write is in progress
+ *     - copy the used slots into "entries" (at most "max")
+ *     - read the sequence number again, retry if it changed
+ *
+ * Returns: 0 on success ("n" is set), ESTALE if the table was replaced
+ *          (reopen it), or EAGAIN if the writer kept it busy
+ ***************************************************************************/
+int
+ledd_shm_snapshot(const struct ledd_shm *shm,
+                  struct ledd_shm_entry *entries, uint32_t max,
+                  uint32_t *n)
+{
+    const struct ledd_shm_header *header = shm->header;
+    uint32_t seq1, seq2;
+    uint32_t count, used, i;
+    int tries;
+
+    for (tries = 0; tries < LEDD_SHM_MAX_TRIES; tries++) {
+        if (__atomic_load_n(&header->superseded, __ATOMIC_ACQUIRE)) {
+            return(ESTALE);
+        }
+
+        seq1 = __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+        if (seq1 & 1) {
+            sched_yield();
+            continue;
+        }
+
+        count = __atomic_load_n(&header->n_entries, __ATOMIC_RELAXED);
+        if (count > shm->capacity) {
+            count = shm->capacity;
+        }
+
+        used = 0;
+        for (i = 0; i < count && used < max; i++) {
+            if (shm->entries[i].in_use) {
+                memcpy(&entries[used++], &shm->entries[i], sizeof *entries);
+            }
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&header->seq, __ATOMIC_RELAXED);
+        if (seq1 == seq2) {
+            *n = used;
+            return(0);
+        }
+    }
+
+    return(EAGAIN);
+} /* ledd_shm_snapshot() */
+
+/************************************************************************//**
+ * Function that releases a table. When the writer closes the table, it is
+ * flagged as superseded and removed, so readers do not report stale data.
+ ***************************************************************************/
+void
+ledd_shm_close(struct ledd_shm *shm)
+{
+    if (shm->header == NULL) {
+        return;
+    }
+
+    if (shm->writable) {
+        __atomic_store_n(&shm->header->superseded, 1, __ATOMIC_RELEASE);
+        unlink(shm->path);
+    }
+    ledd_shm_unmap(shm);
+} /* ledd_shm_close() */
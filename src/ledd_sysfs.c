@@ -0,0 +1,402 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Source file for the Linux LED-class (sysfs) LED backend
+ *
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ledd_sysfs.h"
+
+/* open attribute "attr" of an LED, returns the fd or -1 (errno is set) */
+static int
+ledd_sysfs_open_attr(const struct ledd_sysfs_led *led, const char *attr,
+                     int flags)
+{
+    char *path = NULL;
+    int fd;
+
+    if (asprintf(&path, "%s/%s", led->dir, attr) < 0) {
+        errno = ENOMEM;
+        return(-1);
+    }
+    fd = open(path, flags | O_CLOEXEC);
+    free(path);
+
+    return(fd);
+} /* ledd_sysfs_open_attr() */
+
+/* read an attribute from its start, without the trailing newline */
+static int
+ledd_sysfs_read_fd(int fd, char *buf, size_t size)
+{
+    ssize_t n;
+
+    n = pread(fd, buf, size - 1, 0);
+    if (n < 0) {
+        return(errno);
+    }
+    while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' ')) {
+        n--;
+    }
+    buf[n] = '\0';
+
+    return(0);
+} /* ledd_sysfs_read_fd() */
+
+/* read an unsigned attribute */
+static int
+ledd_sysfs_read_uint(int fd, unsigned int *value)
+{
+    char buf[32];
+    int error;
+
+    error = ledd_sysfs_read_fd(fd, buf, sizeof buf);
+    if (!error && sscanf(buf, "%u", value) != 1) {
+        error = EINVAL;
+    }
+
+    return(error);
+} /* ledd_sysfs_read_uint() */
+
+/* write an attribute (from its start, as sysfs expects) */
+static int
+ledd_sysfs_write_fd(struct ledd_sysfs_led *led, int fd, const char *value)
+{
+    size_t len = strlen(value);
+
+    errno = 0;
+    if (pwrite(fd, value, len, 0) != (ssize_t) len) {
+        return(errno ? errno : EIO);
+    }
+    if (led->regular && ftruncate(fd, len) < 0) {
+        return(errno);
+    }
+    led->writes++;
+
+    return(0);
+} /* ledd_sysfs_write_fd() */
+
+/* write an unsigned attribute */
+static int
+ledd_sysfs_write_uint(struct ledd_sysfs_led *led, int fd, unsigned int value)
+{
+    char buf[16];
+
+    snprintf(buf, sizeof buf, "%u", value);
+    return(ledd_sysfs_write_fd(led, fd, buf));
+} /* ledd_sysfs_write_uint() */
+
+/* close the attributes of the timer trigger */
+static void
+ledd_sysfs_close_delays(struct ledd_sysfs_led *led)
+{
+    if (led->delay_on_fd >= 0) {
+        close(led->delay_on_fd);
+    }
+    if (led->delay_off_fd >= 0) {
+        close(led->delay_off_fd);
+    }
+    led->delay_on_fd = led->delay_off_fd = -1;
+} /* ledd_sysfs_close_delays() */
+
+/* open the attributes of the timer trigger, which only exist while the
+   trigger is selected */
+static int
+ledd_sysfs_open_delays(struct ledd_sysfs_led *led)
+{
+    if (led->delay_on_fd < 0) {
+        led->delay_on_fd = ledd_sysfs_open_attr(led, "delay_on", O_RDWR);
+    }
+    if (led->delay_off_fd < 0) {
+        led->delay_off_fd = ledd_sysfs_open_attr(led, "delay_off", O_RDWR);
+    }
+    if (led->delay_on_fd < 0 || led->delay_off_fd < 0) {
+        int error = errno;
+
+        ledd_sysfs_close_delays(led);
+        return(error);
+    }
+
+    return(0);
+} /* ledd_sysfs_open_delays() */
+
+/************************************************************************//**
+ * Function that reads the current mode of an LED, so that a batch does
+ * not rewrite an LED that is already in the staged mode (warm restart).
+ * The trigger attribute lists the triggers with the selected one in
+ * brackets; a fake tree may hold just the selected trigger.
+ ***************************************************************************/
+static void
+ledd_sysfs_probe(struct ledd_sysfs_led *led)
+{
+    char buf[1024];
+    char *trigger = buf;
+    char *end;
+    unsigned int brightness;
+
+    led->valid = false;
+
+    if (ledd_sysfs_read_fd(led->trigger_fd, buf, sizeof buf) != 0) {
+        return;
+    }
+    if ((trigger = strchr(buf, '[')) != NULL &&
+        (end = strchr(trigger, ']')) != NULL) {
+        trigger++;
+        *end = '\0';
+    } else {
+        trigger = buf;
+    }
+
+    if (strcmp(trigger, "timer") == 0) {
+        if (ledd_sysfs_open_delays(led) == 0 &&
+            ledd_sysfs_read_uint(led->delay_on_fd, &led->delay_on) == 0 &&
+            ledd_sysfs_read_uint(led->delay_off_fd, &led->delay_off) == 0) {
+            led->mode = LEDD_SYSFS_FLASH;
+            led->valid = true;
+        }
+    } else if (strcmp(trigger, "none") == 0) {
+        if (ledd_sysfs_read_uint(led->brightness_fd, &brightness) == 0) {
+            led->mode = brightness ? LEDD_SYSFS_ON : LEDD_SYSFS_OFF;
+            led->valid = true;
+        }
+    }
+} /* ledd_sysfs_probe() */
+
+/************************************************************************//**
+ * Function that opens the LED-class LED "name" under "root" and reads its
+ * current mode.
+ *
+ * Returns: 0 on success (*ledp is set), else an errno value
+ ***************************************************************************/
+int
+ledd_sysfs_open(const char *root, const char *name,
+                struct ledd_sysfs_led **ledp)
+{
+    struct ledd_sysfs_led *led;
+    struct stat st;
+    int fd;
+    int error;
+
+    *ledp = NULL;
+
+    led = calloc(1, sizeof *led);
+    if (led == NULL) {
+        return(ENOMEM);
+    }
+    led->brightness_fd = led->trigger_fd = -1;
+    led->delay_on_fd = led->delay_off_fd = -1;
+
+    if (asprintf(&led->dir, "%s/%s", root, name) < 0) {
+        free(led);
+        return(ENOMEM);
+    }
+
+    led->brightness_fd = ledd_sysfs_open_attr(led, "brightness", O_RDWR);
+    led->trigger_fd = ledd_sysfs_open_attr(led, "trigger", O_RDWR);
+    if (led->brightness_fd < 0 || led->trigger_fd < 0) {
+        error = errno;
+        ledd_sysfs_close(led);
+        return(error);
+    }
+
+    led->regular = (fstat(led->brightness_fd, &st) == 0 &&
+                    S_ISREG(st.st_mode));
+
+    led->max_brightness = 1;
+    fd = ledd_sysfs_open_attr(led, "max_brightness", O_RDONLY);
+    if (fd >= 0) {
+        if (ledd_sysfs_read_uint(fd, &led->max_brightness) != 0 ||
+            led->max_brightness == 0) {
+            led->max_brightness = 1;
+        }
+        close(fd);
+    }
+
+    ledd_sysfs_probe(led);
+
+    *ledp = led;
+    return(0);
+} /* ledd_sysfs_open() */
+
+/* close an LED opened by ledd_sysfs_open(), it must not be in a batch */
+void
+ledd_sysfs_close(struct ledd_sysfs_led *led)
+{
+    if (led == NULL) {
+        return;
+    }
+    ledd_sysfs_close_delays(led);
+    if (led->brightness_fd >= 0) {
+        close(led->brightness_fd);
+    }
+    if (led->trigger_fd >= 0) {
+        close(led->trigger_fd);
+    }
+    free(led->dir);
+    free(led);
+} /* ledd_sysfs_close() */
+
+/************************************************************************//**
+ * Function that stages a mode for an LED. Staging an LED again before the
+ * batch is committed replaces the staged mode.
+ *
+ * Returns: 0 on success, else an errno value (the LED is not staged)
+ ***************************************************************************/
+int
+ledd_sysfs_stage(struct ledd_sysfs_batch *batch, struct ledd_sysfs_led *led,
+                 enum ledd_sysfs_mode mode, unsigned int delay_on,
+                 unsigned int delay_off)
+{
+    if (!led->staged) {
+        if (batch->n >= batch->allocated) {
+            size_t allocated = batch->allocated ? 2 * batch->allocated : 16;
+            struct ledd_sysfs_led **leds;
+
+            leds = realloc(batch->leds, allocated * sizeof *leds);
+            if (leds == NULL) {
+                return(ENOMEM);
+            }
+            batch->leds = leds;
+            batch->allocated = allocated;
+        }
+        batch->leds[batch->n++] = led;
+        led->staged = true;
+    }
+
+    led->staged_mode = mode;
+    led->staged_on = delay_on;
+    led->staged_off = delay_off;
+
+    return(0);
+} /* ledd_sysfs_stage() */
+
+/************************************************************************//**
+ * Function that writes the staged mode of one LED.
+ *
+ * Logic:
+ *     - flashing: select the "timer" trigger (unless already selected),
+ *       then write delay_on and delay_off if they differ
+ *     - on/off: select the "none" trigger if another trigger may be
+ *       selected, then write the brightness if it differs
+ *     - if anything fails, forget the mode so that the next commit
+ *       rewrites every attribute
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+static int
+ledd_sysfs_apply(struct ledd_sysfs_led *led)
+{
+    bool force = !led->valid;
+    int error = 0;
+
+    if (led->staged_mode == LEDD_SYSFS_FLASH) {
+        if (force || led->mode != LEDD_SYSFS_FLASH) {
+            /* the kernel creates new delay attributes with the trigger */
+            ledd_sysfs_close_delays(led);
+            error = ledd_sysfs_write_fd(led, led->trigger_fd, "timer");
+            force = true;
+        }
+        if (!error) {
+            error = ledd_sysfs_open_delays(led);
+        }
+        if (!error && (force || led->delay_on != led->staged_on)) {
+            error = ledd_sysfs_write_uint(led, led->delay_on_fd,
+                                          led->staged_on);
+        }
+        if (!error && (force || led->delay_off != led->staged_off)) {
+            error = ledd_sysfs_write_uint(led, led->delay_off_fd,
+                                          led->staged_off);
+        }
+    } else {
+        if (force || led->mode == LEDD_SYSFS_FLASH) {
+            ledd_sysfs_close_delays(led);
+            error = ledd_sysfs_write_fd(led, led->trigger_fd, "none");
+            force = true;
+        }
+        if (!error && (force || led->mode != led->staged_mode)) {
+            error = ledd_sysfs_write_uint(led, led->brightness_fd,
+                        led->staged_mode == LEDD_SYSFS_ON ?
+                                    led->max_brightness : 0);
+        }
+    }
+
+    if (error) {
+        led->valid = false;
+        return(error);
+    }
+
+    led->valid = true;
+    led->mode = led->staged_mode;
+    led->delay_on = led->staged_on;
+    led->delay_off = led->staged_off;
+
+    return(0);
+} /* ledd_sysfs_apply() */
+
+/************************************************************************//**
+ * Function that writes every LED staged in a batch and empties the batch.
+ * "done" (if not NULL) is called for each LED once it is written, with
+ * led->error and led->written set.
+ *
+ * Returns: the number of LEDs that could not be written
+ ***************************************************************************/
+size_t
+ledd_sysfs_commit(struct ledd_sysfs_batch *batch,
+                  void (*done)(struct ledd_sysfs_led *led))
+{
+    size_t failures = 0;
+    size_t i;
+
+    for (i = 0; i < batch->n; i++) {
+        struct ledd_sysfs_led *led = batch->leds[i];
+        unsigned long long writes = led->writes;
+
+        led->staged = false;
+        led->error = ledd_sysfs_apply(led);
+        led->written = led->writes != writes;
+        if (led->error) {
+            failures++;
+        }
+        if (done) {
+            done(led);
+        }
+    }
+    batch->n = 0;
+
+    return(failures);
+} /* ledd_sysfs_commit() */
+
+/* free a batch, which must be empty */
+void
+ledd_sysfs_batch_destroy(struct ledd_sysfs_batch *batch)
+{
+    free(batch->leds);
+    batch->leds = NULL;
+    batch->n = batch->allocated = 0;
+} /* ledd_sysfs_batch_destroy() */
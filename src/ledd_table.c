@@ -0,0 +1,151 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Reader for the shared-memory LED state table published by ops-ledd
+ *
+ *     usage: ops-ledd-table [-f FILE] [-i SECONDS]
+ *          -f, --file=FILE         table to read
+ *                                  (default: /run/ops-ledd/led-table)
+ *          -i, --interval=SECONDS  print a snapshot every SECONDS
+ *          -h, --help              display this help message
+ *
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ledd_shm.h"
+
+static void
+usage(const char *name)
+{
+    printf("%s: print the LED state table published by ops-ledd\n"
+           "usage: %s [OPTIONS]\n"
+           "  -f, --file=FILE         table to read (default: %s)\n"
+           "  -i, --interval=SECONDS  print a snapshot every SECONDS\n"
+           "  -h, --help              display this help message\n",
+           name, name, LEDD_SHM_DEFAULT_PATH);
+    exit(EXIT_SUCCESS);
+} /* usage() */
+
+/* print one snapshot of the table */
+static void
+print_snapshot(const struct ledd_shm_entry *entries, uint32_t n)
+{
+    uint32_t i;
+
+    printf("%-24s%-10s%-10s%-15s%s\n",
+           "Name", "State", "HW state", "Status", "Last change");
+    printf("%s\n", "-------------------------------------------------------"
+                   "---------------------");
+
+    for (i = 0; i < n; i++) {
+        char when[32] = "never";
+
+        if (entries[i].last_change) {
+            time_t secs = entries[i].last_change / 1000;
+            struct tm tm;
+
+            gmtime_r(&secs, &tm);
+            strftime(when, sizeof when, "%Y-%m-%dT%H:%M:%SZ", &tm);
+        }
+        printf("%-24.*s%-10.*s%-10.*s%-15.*s%s\n",
+               LEDD_SHM_ID_LEN, entries[i].id,
+               LEDD_SHM_STATE_LEN, entries[i].state,
+               LEDD_SHM_STATE_LEN, entries[i].hw_state,
+               LEDD_SHM_STATE_LEN, entries[i].status, when);
+    }
+} /* print_snapshot() */
+
+int
+main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"file",     required_argument, NULL, 'f'},
+        {"interval", required_argument, NULL, 'i'},
+        {"help",     no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    const char *path = LEDD_SHM_DEFAULT_PATH;
+    struct ledd_shm_entry *entries = NULL;
+    struct ledd_shm shm;
+    unsigned int interval = 0;
+    uint32_t n;
+    int error;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "f:i:h", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'f':
+            path = optarg;
+            break;
+        case 'i':
+            interval = strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+            usage(argv[0]);
+        default:
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    error = ledd_shm_open(&shm, path);
+
+    for (;;) {
+        if (error == 0) {
+            entries = realloc(entries, shm.capacity * sizeof *entries);
+            error = ledd_shm_snapshot(&shm, entries, shm.capacity, &n);
+        }
+
+        if (error == ESTALE) {
+            /* ops-ledd grew or rewrote the table, pick up the new one */
+            ledd_shm_close(&shm);
+            error = ledd_shm_open(&shm, path);
+            continue;
+        } else if (error) {
+            fprintf(stderr, "%s: %s\n", path, strerror(error));
+            if (!interval) {
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            print_snapshot(entries, n);
+        }
+
+        if (!interval) {
+            break;
+        }
+        sleep(interval);
+        if (error) {
+            ledd_shm_close(&shm);
+            error = ledd_shm_open(&shm, path);
+        }
+    }
+
+    ledd_shm_close(&shm);
+    free(entries);
+
+    return(EXIT_SUCCESS);
+} /* main() */
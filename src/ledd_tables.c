@@ -0,0 +1,31 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Static LED tables of a build without LEDD_STATIC_TABLES: there is none,
+ * and every subsystem is parsed at run time. With LEDD_STATIC_TABLES, the
+ * tables generated by tools/ledd_gen_tables.py replace this file.
+ ***************************************************************************/
+
+#include <stddef.h>
+
+#include "ledd_tables.h"
+
+const struct ledd_static_subsys *const ledd_static_tables = NULL;
+const size_t ledd_n_static_tables = 0;
@@ -0,0 +1,362 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Source file for the ops-ledd trace (record and replay)
+ *
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ledd_trace.h"
+
+/* size of the stdio buffer of a writer: a trace is written in large
+   chunks, not once per record */
+#define LEDD_TRACE_BUFFER_SIZE  (64 * 1024)
+
+/************************************************************************//**
+ * Function that creates (or truncates) a trace file and writes its header.
+ * now_us is the monotonic time of the trace start, wall_ms its wall time.
+ *
+ * Returns: 0 on success, else an errno value
+ ***************************************************************************/
+int
+ledd_trace_create(struct ledd_trace *trace, const char *path,
+                  long long int now_us, long long int wall_ms)
+{
+    struct ledd_trace_header header;
+
+    memset(trace, 0, sizeof *trace);
+
+    trace->file = fopen(path, "we");
+    if (trace->file == NULL) {
+        return(errno);
+    }
+    setvbuf(trace->file, NULL, _IOFBF, LEDD_TRACE_BUFFER_SIZE);
+
+    memset(&header, 0, sizeof header);
+    header.magic = LEDD_TRACE_MAGIC;
+    header.version = LEDD_TRACE_VERSION;
+    header.start = wall_ms;
+    if (fwrite(&header, sizeof header, 1, trace->file) != 1) {
+        int error = errno ? errno : EIO;
+
+        fclose(trace->file);
+        trace->file = NULL;
+        return(error);
+    }
+
+    trace->writer = true;
+    trace->last_us = now_us;
+
+    return(0);
+} /* ledd_trace_create() */
+
+/* append a string to a payload, cut to LEDD_TRACE_STR_MAX */
+static size_t
+ledd_trace_put_str(uint8_t *payload, size_t len, const char *s)
+{
+    size_t n = s ? strlen(s) : 0;
+
+    if (n > LEDD_TRACE_STR_MAX) {
+        n = LEDD_TRACE_STR_MAX;
+    }
+    payload[len] = n;
+    if (n) {
+        memcpy(&payload[len + 1], s, n);
+    }
+
+    return(len + 1 + n);
+} /* ledd_trace_put_str() */
+
+/* append an integer to a payload */
+static size_t
+ledd_trace_put_u32(uint8_t *payload, size_t len, uint32_t value)
+{
+    memcpy(&payload[len], &value, sizeof value);
+
+    return(len + sizeof value);
+} /* ledd_trace_put_u32() */
+
+/* write one record; the first error is kept and later records dropped */
+static void
+ledd_trace_put(struct ledd_trace *trace, long long int now_us,
+               enum ledd_trace_type type, const uint8_t *payload, size_t len)
+{
+    struct ledd_trace_record_header rec;
+    long long int delta = now_us - trace->last_us;
+
+    if (trace->file == NULL || trace->error) {
+        return;
+    }
+
+    rec.delta_us = delta < 0 ? 0 : delta > UINT32_MAX ? UINT32_MAX : delta;
+    rec.type = type;
+    rec.reserved = 0;
+    rec.len = len;
+    trace->last_us = now_us;
+
+    if (fwrite(&rec, sizeof rec, 1, trace->file) != 1 ||
+        (len && fwrite(payload, len, 1, trace->file) != 1)) {
+        trace->error = errno ? errno : EIO;
+        return;
+    }
+    trace->records++;
+} /* ledd_trace_put() */
+
+/* record that a Subsystem row was added (with its hw_desc_dir) or removed */
+void
+ledd_trace_subsys(struct ledd_trace *trace, long long int now_us, bool add,
+                  const char *name, const char *dir)
+{
+    uint8_t payload[LEDD_TRACE_PAYLOAD_MAX];
+    size_t len;
+
+    len = ledd_trace_put_str(payload, 0, name);
+    if (add) {
+        len = ledd_trace_put_str(payload, len, dir);
+    }
+    ledd_trace_put(trace, now_us,
+                   add ? LEDD_TRACE_SUBSYS_ADD : LEDD_TRACE_SUBSYS_DEL,
+                   payload, len);
+} /* ledd_trace_subsys() */
+
+/* record an LED state read from the db */
+void
+ledd_trace_led_state(struct ledd_trace *trace, long long int now_us,
+                     const char *id, const char *state)
+{
+    uint8_t payload[LEDD_TRACE_PAYLOAD_MAX];
+    size_t len;
+
+    len = ledd_trace_put_str(payload, 0, id);
+    len = ledd_trace_put_str(payload, len, state);
+    ledd_trace_put(trace, now_us, LEDD_TRACE_LED_STATE, payload, len);
+} /* ledd_trace_led_state() */
+
+/* record an LED write: the value written, its errno and its duration */
+void
+ledd_trace_hw_write(struct ledd_trace *trace, long long int now_us,
+                    const char *id, uint32_t value, int error,
+                    long long int latency_us)
+{
+    uint8_t payload[LEDD_TRACE_PAYLOAD_MAX];
+    size_t len;
+
+    len = ledd_trace_put_str(payload, 0, id);
+    len = ledd_trace_put_u32(payload, len, value);
+    len = ledd_trace_put_u32(payload, len, error);
+    len = ledd_trace_put_u32(payload, len,
+                             latency_us > UINT32_MAX ? UINT32_MAX
+                                                     : latency_us);
+    ledd_trace_put(trace, now_us, LEDD_TRACE_HW_WRITE, payload, len);
+} /* ledd_trace_hw_write() */
+
+/* record a transaction commit: its status and its duration */
+void
+ledd_trace_commit(struct ledd_trace *trace, long long int now_us, int status,
+                  long long int latency_us)
+{
+    uint8_t payload[2 * sizeof(uint32_t)];
+    size_t len;
+
+    len = ledd_trace_put_u32(payload, 0, status);
+    len = ledd_trace_put_u32(payload, len,
+                             latency_us > UINT32_MAX ? UINT32_MAX
+                                                     : latency_us);
+    ledd_trace_put(trace, now_us, LEDD_TRACE_COMMIT, payload, len);
+} /* ledd_trace_commit() */
+
+/************************************************************************//**
+ * Function that writes the buffered records to the file.
+ *
+ * Returns: 0 on success, else the first error of the trace
+ ***************************************************************************/
+int
+ledd_trace_flush(struct ledd_trace *trace)
+{
+    if (trace->file && !trace->error && fflush(trace->file) != 0) {
+        trace->error = errno;
+    }
+
+    return(trace->error);
+} /* ledd_trace_flush() */
+
+/************************************************************************//**
+ * Function that opens a trace file for reading and checks its header.
+ *
+ * Returns: 0 on success (*startp is the wall ms of the trace start), else
+ *          an errno value (EINVAL if the file is not a trace)
+ ***************************************************************************/
+int
+ledd_trace_open(struct ledd_trace *trace, const char *path,
+                long long int *startp)
+{
+    struct ledd_trace_header header;
+
+    memset(trace, 0, sizeof *trace);
+
+    trace->file = fopen(path, "re");
+    if (trace->file == NULL) {
+        return(errno);
+    }
+
+    if (fread(&header, sizeof header, 1, trace->file) != 1 ||
+        header.magic != LEDD_TRACE_MAGIC ||
+        header.version != LEDD_TRACE_VERSION) {
+        fclose(trace->file);
+        trace->file = NULL;
+        return(EINVAL);
+    }
+
+    *startp = header.start;
+    return(0);
+} /* ledd_trace_open() */
+
+/* take a string from a payload into the reader's buffer */
+static const char *
+ledd_trace_get_str(struct ledd_trace *trace, const uint8_t *payload,
+                   size_t len, size_t *ofs, size_t *buf_ofs)
+{
+    char *s = &trace->buf[*buf_ofs];
+    size_t n;
+
+    if (*ofs >= len || *ofs + 1 + payload[*ofs] > len) {
+        return(NULL);
+    }
+    n = payload[*ofs];
+    memcpy(s, &payload[*ofs + 1], n);
+    s[n] = '\0';
+    *ofs += 1 + n;
+    *buf_ofs += n + 1;
+
+    return(s);
+} /* ledd_trace_get_str() */
+
+/* take an integer from a payload */
+static bool
+ledd_trace_get_u32(const uint8_t *payload, size_t len, size_t *ofs,
+                   uint32_t *value)
+{
+    if (*ofs + sizeof *value > len) {
+        return(false);
+    }
+    memcpy(value, &payload[*ofs], sizeof *value);
+    *ofs += sizeof *value;
+
+    return(true);
+} /* ledd_trace_get_u32() */
+
+/************************************************************************//**
+ * Function that reads the next record of a trace. Records of an unknown
+ * type are skipped, so that newer traces can be read.
+ *
+ * Returns: 0 if a record was read, EOF at the end of the trace (or at a
+ *          truncated last record), else EINVAL for a corrupted record
+ ***************************************************************************/
+int
+ledd_trace_read(struct ledd_trace *trace, struct ledd_trace_record *record)
+{
+    uint8_t payload[LEDD_TRACE_PAYLOAD_MAX];
+    struct ledd_trace_record_header rec;
+    size_t ofs = 0;
+    size_t buf_ofs = 0;
+    uint32_t u = 0;
+    bool ok;
+
+    for (;;) {
+        if (fread(&rec, sizeof rec, 1, trace->file) != 1) {
+            return(EOF);
+        }
+        if (rec.len > sizeof payload) {
+            return(EINVAL);
+        }
+        if (rec.len && fread(payload, rec.len, 1, trace->file) != 1) {
+            return(EOF);
+        }
+        trace->last_us += rec.delta_us;
+        if (rec.type > 0 && rec.type < LEDD_TRACE_N_TYPES) {
+            break;
+        }
+    }
+
+    memset(record, 0, sizeof *record);
+    record->type = rec.type;
+    record->time_us = trace->last_us;
+
+    switch (record->type) {
+    case LEDD_TRACE_SUBSYS_ADD:
+    case LEDD_TRACE_LED_STATE:
+        record->name = ledd_trace_get_str(trace, payload, rec.len, &ofs,
+                                          &buf_ofs);
+        record->text = ledd_trace_get_str(trace, payload, rec.len, &ofs,
+                                          &buf_ofs);
+        ok = record->name && record->text;
+        break;
+
+    case LEDD_TRACE_SUBSYS_DEL:
+        record->name = ledd_trace_get_str(trace, payload, rec.len, &ofs,
+                                          &buf_ofs);
+        ok = record->name != NULL;
+        break;
+
+    case LEDD_TRACE_HW_WRITE:
+        record->name = ledd_trace_get_str(trace, payload, rec.len, &ofs,
+                                          &buf_ofs);
+        ok = record->name &&
+             ledd_trace_get_u32(payload, rec.len, &ofs, &record->value) &&
+             ledd_trace_get_u32(payload, rec.len, &ofs, &u) &&
+             ledd_trace_get_u32(payload, rec.len, &ofs,
+                                &record->latency_us);
+        record->error = u;
+        break;
+
+    case LEDD_TRACE_COMMIT:
+        ok = ledd_trace_get_u32(payload, rec.len, &ofs, &u) &&
+             ledd_trace_get_u32(payload, rec.len, &ofs,
+                                &record->latency_us);
+        record->error = u;
+        break;
+
+    default:
+        ok = false;
+        break;
+    }
+
+    if (!ok) {
+        return(EINVAL);
+    }
+    trace->records++;
+
+    return(0);
+} /* ledd_trace_read() */
+
+/* close a trace; a writer's buffered records are written first */
+void
+ledd_trace_close(struct ledd_trace *trace)
+{
+    if (trace->file) {
+        fclose(trace->file);
+        trace->file = NULL;
+    }
+} /* ledd_trace_close() */
@@ -0,0 +1,246 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-ledd
+ *
+ * @file
+ * Source file for the ops-ledd LED type registry
+ *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+
+#include "ledd_types.h"
+
+#define ALL_STATES (LEDD_TYPE_STATE_BIT(LEDD_TYPE_FLASHING) |       \
+                    LEDD_TYPE_STATE_BIT(LEDD_TYPE_OFF) |            \
+                    LEDD_TYPE_STATE_BIT(LEDD_TYPE_ON))
+
+/* the value of each state the driver takes is its setting */
+int
+ledd_type_compute_settings(const struct ledd_type_driver *driver,
+                           const uint32_t settings[LEDD_TYPE_N_STATES],
+                           uint32_t values[LEDD_TYPE_N_STATES])
+{
+    unsigned int state;
+
+    for (state = 0; state < LEDD_TYPE_N_STATES; state++) {
+        values[state] = driver->states & LEDD_TYPE_STATE_BIT(state)
+                        ? settings[state] : 0;
+    }
+
+    return(0);
+} /* ledd_type_compute_settings() */
+
+/* the value of a state is looked up in the values of the type */
+bool
+ledd_type_value_table(const struct ledd_type_driver *driver,
+                      const uint32_t values[LEDD_TYPE_N_STATES],
+                      unsigned int state, uint32_t *valuep)
+{
+    if (state >= LEDD_TYPE_N_STATES ||
+        !(driver->states & LEDD_TYPE_STATE_BIT(state))) {
+        return(false);
+    }
+    *valuep = values[state];
+
+    return(true);
+} /* ledd_type_value_table() */
+
+/* an indicator (status, fan, psu, port, uid) must show something when on:
+   a type whose "on" value is its "off" value would hide what it reports */
+static int
+ledd_type_compute_indicator(const struct ledd_type_driver *driver,
+                            const uint32_t settings[LEDD_TYPE_N_STATES],
+                            uint32_t values[LEDD_TYPE_N_STATES])
+{
+    if (settings[LEDD_TYPE_ON] == settings[LEDD_TYPE_OFF]) {
+        return(EINVAL);
+    }
+
+    return(ledd_type_compute_settings(driver, settings, values));
+} /* ledd_type_compute_indicator() */
+
+/* a locator may only blink (it need not be lit when on), and on hardware
+   that cannot blink it is lit when flashing, so that it is still found */
+static int
+ledd_type_compute_loc(const struct ledd_type_driver *driver,
+                      const uint32_t settings[LEDD_TYPE_N_STATES],
+                      uint32_t values[LEDD_TYPE_N_STATES])
+{
+    ledd_type_compute_settings(driver, settings, values);
+    if (settings[LEDD_TYPE_FLASHING] == settings[LEDD_TYPE_OFF]) {
+        values[LEDD_TYPE_FLASHING] = settings[LEDD_TYPE_ON];
+    }
+
+    return(0);
+} /* ledd_type_compute_loc() */
+
+/* system status: flashing reports a fault, which must not look like the
+   healthy "on" */
+static int
+ledd_type_compute_status(const struct ledd_type_driver *driver,
+                         const uint32_t settings[LEDD_TYPE_N_STATES],
+                         uint32_t values[LEDD_TYPE_N_STATES])
+{
+    if (settings[LEDD_TYPE_FLASHING] == settings[LEDD_TYPE_ON]) {
+        return(EINVAL);
+    }
+
+    return(ledd_type_compute_indicator(driver, settings, values));
+} /* ledd_type_compute_status() */
+
+/* fan tray: flashing reports a failed fan, which must not look like the
+   "off" of an empty bay */
+static int
+ledd_type_compute_fan(const struct ledd_type_driver *driver,
+                      const uint32_t settings[LEDD_TYPE_N_STATES],
+                      uint32_t values[LEDD_TYPE_N_STATES])
+{
+    if (settings[LEDD_TYPE_FLASHING] == settings[LEDD_TYPE_OFF]) {
+        return(EINVAL);
+    }
+
+    return(ledd_type_compute_indicator(driver, settings, values));
+} /* ledd_type_compute_fan() */
+
+/* power supply: on is a good supply, off one without input power and
+   flashing a failed one; the three are told apart to pick the supply to
+   replace */
+static int
+ledd_type_compute_psu(const struct ledd_type_driver *driver,
+                      const uint32_t settings[LEDD_TYPE_N_STATES],
+                      uint32_t values[LEDD_TYPE_N_STATES])
+{
+    if (settings[LEDD_TYPE_FLASHING] == settings[LEDD_TYPE_ON] ||
+        settings[LEDD_TYPE_FLASHING] == settings[LEDD_TYPE_OFF]) {
+        return(EINVAL);
+    }
+
+    return(ledd_type_compute_indicator(driver, settings, values));
+} /* ledd_type_compute_psu() */
+
+/* locator: off, on, and flashing to be found in the rack */
+static const struct ledd_type_driver ledd_type_loc = {
+    "loc", ALL_STATES, ledd_type_compute_loc, ledd_type_value_table
+};
+
+/* system status */
+static const struct ledd_type_driver ledd_type_status = {
+    "status", ALL_STATES, ledd_type_compute_status, ledd_type_value_table
+};
+
+/* fan tray */
+static const struct ledd_type_driver ledd_type_fan = {
+    "fan", ALL_STATES, ledd_type_compute_fan, ledd_type_value_table
+};
+
+/* power supply */
+static const struct ledd_type_driver ledd_type_psu = {
+    "psu", ALL_STATES, ledd_type_compute_psu, ledd_type_value_table
+};
+
+/* port: off and on only, the activity blink is driven by the switch chip */
+static const struct ledd_type_driver ledd_type_port = {
+    "port",
+    LEDD_TYPE_STATE_BIT(LEDD_TYPE_OFF) | LEDD_TYPE_STATE_BIT(LEDD_TYPE_ON),
+    ledd_type_compute_indicator, ledd_type_value_table
+};
+
+/* unit identifier: lit on request from the management, which must show,
+   or flashing */
+static const struct ledd_type_driver ledd_type_uid = {
+    "uid", ALL_STATES, ledd_type_compute_indicator, ledd_type_value_table
+};
+
+/* the registry, indexed by type id; the built-in drivers come first */
+const struct ledd_type_driver *ledd_type_drivers[LEDD_TYPE_MAX] = {
+    &ledd_type_loc,
+    &ledd_type_status,
+    &ledd_type_fan,
+    &ledd_type_psu,
+    &ledd_type_port,
+    &ledd_type_uid,
+};
+unsigned int ledd_n_type_drivers = 6;
+
+/************************************************************************//**
+ * Function that looks up an LED type driver by name. This compares
+ * strings, so it is called when a type is loaded, not when an LED is
+ * written.
+ *
+ * Returns: the type id, or -1 if no driver has that name
+ ***************************************************************************/
+int
+ledd_type_find(const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < ledd_n_type_drivers; i++) {
+        if (!strcmp(ledd_type_drivers[i]->name, name)) {
+            return(i);
+        }
+    }
+
+    return(-1);
+} /* ledd_type_find() */
+
+/************************************************************************//**
+ * Function that adds an LED type driver to the registry. The driver must
+ * stay valid as long as the registry is used.
+ *
+ * Returns: the type id, else -EEXIST if a driver has that name, -ENOSPC
+ *          if the registry is full, or -EINVAL for an incomplete driver
+ ***************************************************************************/
+int
+ledd_type_register(const struct ledd_type_driver *driver)
+{
+    if (driver->name == NULL || driver->compute == NULL ||
+        driver->value == NULL || driver->states == 0 ||
+        driver->states & ~ALL_STATES) {
+        return(-EINVAL);
+    }
+    if (ledd_type_find(driver->name) >= 0) {
+        return(-EEXIST);
+    }
+    if (ledd_n_type_drivers == LEDD_TYPE_MAX) {
+        return(-ENOSPC);
+    }
+
+    ledd_type_drivers[ledd_n_type_drivers] = driver;
+
+    return(ledd_n_type_drivers++);
+} /* ledd_type_register() */
+
+/************************************************************************//**
+ * Function that computes the register value of each state of an LED type
+ * from its settings (the off/on/flashing values of led.yaml, indexed by
+ * state).
+ *
+ * Returns: 0 on success, else an errno value (the settings do not fit the
+ *          type, e.g. an indicator that cannot be lit)
+ ***************************************************************************/
+int
+ledd_type_compute(unsigned int type_id,
+                  const uint32_t settings[LEDD_TYPE_N_STATES],
+                  uint32_t values[LEDD_TYPE_N_STATES])
+{
+    const struct ledd_type_driver *driver = ledd_type_drivers[type_id];
+
+    return(driver->compute(driver, settings, values));
+} /* ledd_type_compute() */
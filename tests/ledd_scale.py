@@ -0,0 +1,597 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+#    Licensed under the Apache License, Version 2.0 (the "License"); you may
+#    not use this file except in compliance with the License. You may obtain
+#    a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+#    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+#    License for the specific language governing permissions and limitations
+#    under the License.
+
+"""
+End-to-end scale and latency test for ops-ledd.
+
+The harness starts a private ovsdb-server on a fresh database, generates
+hardware description files for thousands of LEDs and runs ops-ledd against
+them with simulated LED hardware (--hw-sim). A load generator then writes
+LED states at a fixed rate and measures:
+
+  * startup: time from starting ops-ledd until daemon:cur_hw is 1
+  * hw latency: time from the state write until the LED state table
+    (/run/ops-ledd/led-table, here in the work directory) reports the new
+    state in hardware
+  * commit latency: time from a state write that changes the LED status
+    (the simulated device is made to fail, or to work again, first) until
+    the new status is received from ovsdb-server
+  * ops-ledd CPU usage during the load, and its peak RSS
+  * memory: before the load, a subsystem of --memory-leds LEDs is added to
+    the running daemon, and the RSS growth is reported per 1000 LEDs, next
+    to ops-ledd's own count of the bytes it allocated for them
+    (ops-ledd/memory)
+
+With --direct-set, the load state changes are sent with ops-ledd/set
+instead of being written to the db, so that the hw latency is the latency
+of the direct path (ops-ledd writes the states back to the db).
+
+The test fails if a p99 latency, the startup time, the CPU usage, the RSS
+or the RSS per 1000 LEDs exceeds its threshold, or if a --baseline is given
+and a result regressed by more than --tolerance.
+
+    usage: ledd_scale.py [--leds N] [--rate N] [--duration S] ...
+
+The Subsystem and Daemon tables are assumed to be root tables, as in the
+OpenSwitch schema.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import mmap
+import os
+import random
+import shutil
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+SHM_HEADER = struct.Struct('=IIIIIIiI')
+SHM_ENTRY = struct.Struct('=64s16s16s16sqII')
+SHM_MAGIC = 0x4c454454
+
+STATES = ['on', 'off', 'flashing']
+SETTINGS = {'off': 0, 'on': 1, 'flashing': 2}
+PROBE_SUBSYSTEM = 'probe'
+MEMORY_SUBSYSTEM = 'memory'
+
+
+class JsonRpc(object):
+    """Minimal JSON-RPC client for ovsdb-server and unixctl sockets."""
+
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.buf = ''
+        self.next_id = 0
+        self.replies = {}
+        self.notify = None
+
+    def send(self, method, params):
+        self.next_id += 1
+        msg = {'method': method, 'params': params, 'id': self.next_id}
+        self.sock.sendall(json.dumps(msg).encode('utf-8'))
+        return self.next_id
+
+    def poll(self, timeout):
+        self.sock.settimeout(timeout)
+        try:
+            data = self.sock.recv(1 << 20)
+        except socket.timeout:
+            return
+        if not data:
+            raise IOError('connection closed')
+        self.buf += data.decode('utf-8')
+        decoder = json.JSONDecoder()
+        while self.buf:
+            self.buf = self.buf.lstrip()
+            try:
+                msg, end = decoder.raw_decode(self.buf)
+            except ValueError:
+                break
+            self.buf = self.buf[end:]
+            self.dispatch(msg)
+
+    def dispatch(self, msg):
+        if msg.get('method') == 'echo':
+            reply = {'result': msg['params'], 'error': None, 'id': msg['id']}
+            self.sock.sendall(json.dumps(reply).encode('utf-8'))
+        elif msg.get('method') is not None:
+            if self.notify:
+                self.notify(msg['method'], msg['params'])
+        else:
+            self.replies[msg['id']] = msg
+
+    def call(self, method, params, timeout=10.0):
+        rid = self.send(method, params)
+        deadline = time.time() + timeout
+        while rid not in self.replies:
+            if time.time() > deadline:
+                raise IOError('timeout waiting for %s' % method)
+            self.poll(0.1)
+        reply = self.replies.pop(rid)
+        if reply.get('error'):
+            raise IOError('%s failed: %s' % (method, reply['error']))
+        return reply['result']
+
+
+class LedTable(object):
+    """Reader for the shared-memory LED state table (see ledd_shm.h)."""
+
+    def __init__(self, path):
+        self.path = path
+        self.map = None
+        self.slots = {}
+
+    def open(self):
+        with open(self.path, 'rb') as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        header = SHM_HEADER.unpack_from(self.map, 0)
+        if header[0] != SHM_MAGIC or header[2] != SHM_ENTRY.size:
+            raise IOError('%s: not an LED table' % self.path)
+        self.capacity = header[3]
+        self.slots = {}
+
+    def _seq(self):
+        return SHM_HEADER.unpack_from(self.map, 0)[7]
+
+    def _superseded(self):
+        return SHM_HEADER.unpack_from(self.map, 0)[5]
+
+    def _entry(self, slot):
+        offset = SHM_HEADER.size + slot * SHM_ENTRY.size
+        fields = SHM_ENTRY.unpack_from(self.map, offset)
+        return (fields[0].rstrip(b'\0').decode(),
+                fields[2].rstrip(b'\0').decode(), fields[5])
+
+    def hw_state(self, led_id):
+        """Return the hw state of an LED, from a consistent read."""
+        while True:
+            if self.map is None or self._superseded():
+                self.open()
+            seq = self._seq()
+            if seq & 1:
+                continue
+            if led_id not in self.slots:
+                self._index()
+            slot = self.slots.get(led_id)
+            entry = self._entry(slot) if slot is not None else None
+            if self._seq() != seq:
+                continue
+            if entry is None or entry[0] != led_id or not entry[2]:
+                self.slots.pop(led_id, None)
+                return None
+            return entry[1]
+
+    def _index(self):
+        n = SHM_HEADER.unpack_from(self.map, 0)[4]
+        for slot in range(min(n, self.capacity)):
+            led_id, _, in_use = self._entry(slot)
+            if in_use:
+                self.slots[led_id] = slot
+
+
+def percentile(values, pct):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    k = int(round((len(values) - 1) * pct / 100.0))
+    return values[k]
+
+
+def proc_cpu_seconds(pid):
+    with open('/proc/%d/stat' % pid) as f:
+        fields = f.read().rsplit(')', 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / \
+        float(os.sysconf('SC_CLK_TCK'))
+
+
+def proc_rss_kb(pid):
+    with open('/proc/%d/status' % pid) as f:
+        for line in f:
+            if line.startswith('VmRSS:'):
+                return int(line.split()[1])
+    return 0
+
+
+def write_hw_desc(path, n_leds, device_per_led):
+    """Write devices.yaml and led.yaml for n_leds "loc" LEDs."""
+    os.makedirs(path)
+    n_devices = n_leds if device_per_led else 1
+    with open(os.path.join(path, 'devices.yaml'), 'w') as f:
+        f.write('---\ndevices:\n')
+        for d in range(n_devices):
+            f.write('  - name: dev%d\n'
+                    '    bus: i2c-0\n'
+                    '    dev_type: cpld\n'
+                    '    address: 0x%x\n' % (d, 0x10 + d % 0x60))
+    with open(os.path.join(path, 'led.yaml'), 'w') as f:
+        f.write('---\n'
+                'led_info:\n'
+                '  number_leds: %d\n'
+                '  number_types: 1\n'
+                'led_types:\n'
+                '  - type: loc\n'
+                '    settings:\n'
+                '      "off": 0x%x\n'
+                '      "on": 0x%x\n'
+                '      flashing: 0x%x\n'
+                'leds:\n' % (n_leds, SETTINGS['off'], SETTINGS['on'],
+                             SETTINGS['flashing']))
+        for i in range(n_leds):
+            f.write('  - name: led%d\n'
+                    '    type: loc\n'
+                    '    led_access:\n'
+                    '      device: dev%d\n'
+                    '      register_address: 0x%x\n'
+                    '      register_size: 1\n'
+                    '      bit_mask: 0x03\n'
+                    % (i, i if device_per_led else 0, i))
+
+
+class Harness(object):
+
+    def __init__(self, args):
+        self.args = args
+        self.workdir = tempfile.mkdtemp(prefix='ledd-scale-')
+        self.procs = []
+        self.db_name = json.load(open(args.schema))['name']
+        self.db_sock = os.path.join(self.workdir, 'db.sock')
+        self.ctl_sock = os.path.join(self.workdir, 'ops-ledd.ctl')
+        self.table = os.path.join(self.workdir, 'led-table')
+
+    def start(self, cmd):
+        log = open(os.path.join(self.workdir,
+                                os.path.basename(cmd[0]) + '.out'), 'w')
+        proc = subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT)
+        self.procs.append(proc)
+        return proc
+
+    def wait_for(self, path, timeout=10.0):
+        deadline = time.time() + timeout
+        while not os.path.exists(path):
+            if time.time() > deadline:
+                raise IOError('%s did not appear' % path)
+            time.sleep(0.01)
+
+    def transact(self, rpc, *ops):
+        result = rpc.call('transact', [self.db_name] + list(ops))
+        for r in result:
+            if r and 'error' in r:
+                raise IOError('transaction failed: %s' % r)
+        return result
+
+    def setup(self):
+        args = self.args
+        db = os.path.join(self.workdir, 'db')
+        subprocess.check_call([args.ovsdb_tool, 'create', db, args.schema])
+        self.start([args.ovsdb_server, db, '--remote=punix:' + self.db_sock,
+                    '--unixctl=' + os.path.join(self.workdir, 'db.ctl'),
+                    '--no-chdir'])
+        self.wait_for(self.db_sock)
+        self.db = JsonRpc(self.db_sock)
+
+        # the load LEDs are spread over the load subsystems, and the probe
+        # subsystem has one device per LED so that their failures are
+        # independent
+        per_subsys = args.leds // args.subsystems
+        ops = [{'op': 'insert', 'table': 'Daemon',
+                'row': {'name': 'ops-ledd'}}]
+        for s in range(args.subsystems):
+            name = 'sub%d' % s
+            path = os.path.join(self.workdir, 'hw', name)
+            write_hw_desc(path, per_subsys, False)
+            ops.append({'op': 'insert', 'table': 'Subsystem',
+                        'row': {'name': name, 'hw_desc_dir': path}})
+        path = os.path.join(self.workdir, 'hw', PROBE_SUBSYSTEM)
+        write_hw_desc(path, args.probes, True)
+        ops.append({'op': 'insert', 'table': 'Subsystem',
+                    'row': {'name': PROBE_SUBSYSTEM, 'hw_desc_dir': path}})
+        self.transact(self.db, *ops)
+
+        self.load_leds = ['sub%d-led%d' % (s, i)
+                          for s in range(args.subsystems)
+                          for i in range(per_subsys)]
+        self.probe_leds = ['%s-led%d' % (PROBE_SUBSYSTEM, i)
+                           for i in range(args.probes)]
+
+    def start_ledd(self):
+        args = self.args
+        cmd = [args.ledd, 'unix:' + self.db_sock,
+               '--unixctl=' + self.ctl_sock,
+               '--led-table=' + self.table,
+               '--hw-sim=%d' % args.hw_delay_us,
+               '--log-file=' + os.path.join(self.workdir, 'ops-ledd.log'),
+               '-vconsole:off', '--no-chdir']
+        if args.lazy_activation:
+            cmd.append('--lazy-activation')
+        t0 = time.time()
+        self.ledd = self.start(cmd)
+        deadline = t0 + args.max_startup_s
+        while True:
+            rows = self.transact(self.db, {
+                'op': 'select', 'table': 'Daemon',
+                'where': [['name', '==', 'ops-ledd']],
+                'columns': ['cur_hw']})[0]['rows']
+            if rows and rows[0]['cur_hw'] == 1:
+                break
+            if time.time() > deadline or self.ledd.poll() is not None:
+                raise IOError('ops-ledd did not set cur_hw')
+            time.sleep(0.05)
+        self.startup_s = time.time() - t0
+        self.wait_for(self.ctl_sock)
+        self.ctl = JsonRpc(self.ctl_sock)
+
+    def measure_memory(self):
+        """Add a subsystem of --memory-leds LEDs to the running daemon and
+        return the RSS growth and ops-ledd's own count per 1000 LEDs."""
+        args = self.args
+        path = os.path.join(self.workdir, 'hw', MEMORY_SUBSYSTEM)
+        write_hw_desc(path, args.memory_leds, False)
+
+        rss0 = proc_rss_kb(self.ledd.pid)
+        self.transact(self.db, {
+            'op': 'insert', 'table': 'Subsystem',
+            'row': {'name': MEMORY_SUBSYSTEM, 'hw_desc_dir': path}})
+
+        # subsystem:leds is set once every LED row exists
+        deadline = time.time() + args.max_startup_s
+        while True:
+            rows = self.transact(self.db, {
+                'op': 'select', 'table': 'Subsystem',
+                'where': [['name', '==', MEMORY_SUBSYSTEM]],
+                'columns': ['leds']})[0]['rows']
+            leds = rows[0]['leds'] if rows else ['set', []]
+            n = len(leds[1]) if leds[0] == 'set' else 1
+            if n == args.memory_leds:
+                break
+            if time.time() > deadline or self.ledd.poll() is not None:
+                raise IOError('ops-ledd did not add the %s subsystem'
+                              % MEMORY_SUBSYSTEM)
+            time.sleep(0.05)
+        rss1 = proc_rss_kb(self.ledd.pid)
+
+        # "subsystem LEDs leds requests LED-class hw-desc total"
+        report = self.ctl.call('ops-ledd/memory', [MEMORY_SUBSYSTEM])
+        ledd_bytes = int(report.splitlines()[-1].split()[-1])
+
+        return {
+            'rss_per_1000_leds_kb': round((rss1 - rss0) * 1000.0 /
+                                          args.memory_leds, 1),
+            'ledd_per_1000_leds_kb': round(ledd_bytes * 1000.0 / 1024 /
+                                           args.memory_leds, 1),
+        }
+
+    def run_load(self):
+        args = self.args
+        led_table = LedTable(self.table)
+        states = {}
+        fail = {}
+        pending_hw = {}
+        pending_status = {}
+        hw_latency = []
+        commit_latency = []
+        status_by_uuid = {}
+
+        def on_update(method, params):
+            if method != 'update':
+                return
+            now = time.time()
+            for uuid, change in params[1].get('LED', {}).items():
+                new = change.get('new')
+                if new is None:
+                    continue
+                led_id = new.get('id', status_by_uuid.get(uuid))
+                status_by_uuid[uuid] = led_id
+                probe = pending_status.get(led_id)
+                if probe and new.get('status') == probe[1]:
+                    commit_latency.append(now - probe[0])
+                    del pending_status[led_id]
+
+        self.db.notify = on_update
+        initial = self.db.call('monitor', [self.db_name, 'leds', {
+            'LED': {'columns': ['id', 'state', 'status']}}])
+        for uuid, change in initial.get('LED', {}).items():
+            status_by_uuid[uuid] = change['new']['id']
+            states[change['new']['id']] = change['new']['state']
+
+        cpu0 = proc_cpu_seconds(self.ledd.pid)
+        rss = proc_rss_kb(self.ledd.pid)
+        t_start = time.time()
+        t_next = t_start
+        n_changes = 0
+        while time.time() - t_start < args.duration:
+            now = time.time()
+            if now >= t_next:
+                t_next += 1.0 / args.rate
+                n_changes += 1
+                if random.random() < args.fault_ratio:
+                    led_id = random.choice(self.probe_leds)
+                    if led_id in pending_status:
+                        continue
+                    dev = 'dev' + led_id.rsplit('led', 1)[1]
+                    fail[led_id] = not fail.get(led_id, False)
+                    self.ctl.call('ops-ledd/hw-sim-fail', [
+                        PROBE_SUBSYSTEM, dev] +
+                        ([] if fail[led_id] else ['off']))
+                    expect = 'fault' if fail[led_id] else 'ok'
+                else:
+                    led_id = random.choice(self.load_leds)
+                    if led_id in pending_hw:
+                        continue
+                    expect = None
+                state = random.choice([st for st in STATES
+                                       if st != states.get(led_id)])
+                states[led_id] = state
+                t0 = time.time()
+                if args.direct_set and not expect:
+                    self.ctl.send('ops-ledd/set', [led_id, state])
+                else:
+                    self.db.send('transact', [self.db_name, {
+                        'op': 'update', 'table': 'LED',
+                        'where': [['id', '==', led_id]],
+                        'row': {'state': state}}])
+                if expect:
+                    pending_status[led_id] = (t0, expect)
+                else:
+                    pending_hw[led_id] = (t0, state)
+
+            self.db.poll(0.001)
+            self.db.replies.clear()
+            if args.direct_set:
+                self.ctl.poll(0.0001)
+                self.ctl.replies.clear()
+            for led_id, (t0, state) in list(pending_hw.items()):
+                if led_table.hw_state(led_id) == state:
+                    hw_latency.append(time.time() - t0)
+                    del pending_hw[led_id]
+            rss = max(rss, proc_rss_kb(self.ledd.pid))
+
+        # let the last changes land
+        deadline = time.time() + 5
+        while (pending_hw or pending_status) and time.time() < deadline:
+            self.db.poll(0.01)
+            for led_id, (t0, state) in list(pending_hw.items()):
+                if led_table.hw_state(led_id) == state:
+                    hw_latency.append(time.time() - t0)
+                    del pending_hw[led_id]
+
+        elapsed = time.time() - t_start
+        cpu = proc_cpu_seconds(self.ledd.pid) - cpu0
+        return {
+            'leds': args.leds + args.probes + args.memory_leds,
+            'changes': n_changes,
+            'startup_s': round(self.startup_s, 3),
+            'hw_p50_ms': round(percentile(hw_latency, 50) * 1000, 3),
+            'hw_p99_ms': round(percentile(hw_latency, 99) * 1000, 3),
+            'commit_p50_ms': round(percentile(commit_latency, 50) * 1000, 3),
+            'commit_p99_ms': round(percentile(commit_latency, 99) * 1000, 3),
+            'lost_hw': len(pending_hw),
+            'lost_commits': len(pending_status),
+            'cpu_pct': round(100.0 * cpu / elapsed, 2),
+            'rss_kb': rss,
+        }
+
+    def stop(self):
+        for proc in reversed(self.procs):
+            if proc.poll() is None:
+                proc.terminate()
+                proc.wait()
+        if self.args.keep:
+            print('work directory: %s' % self.workdir)
+        else:
+            shutil.rmtree(self.workdir, ignore_errors=True)
+
+
+def check(args, result):
+    failures = []
+    limits = [('hw_p99_ms', args.max_hw_p99_ms),
+              ('commit_p99_ms', args.max_commit_p99_ms),
+              ('startup_s', args.max_startup_s),
+              ('cpu_pct', args.max_cpu_pct),
+              ('rss_kb', args.max_rss_kb),
+              ('rss_per_1000_leds_kb', args.max_rss_per_1000_leds_kb)]
+    for key, limit in limits:
+        if result[key] > limit:
+            failures.append('%s %s exceeds %s' % (key, result[key], limit))
+    for key in ('lost_hw', 'lost_commits'):
+        if result[key]:
+            failures.append('%s: %d changes never completed'
+                            % (key, result[key]))
+
+    if args.baseline and os.path.exists(args.baseline):
+        baseline = json.load(open(args.baseline))
+        for key, _ in limits:
+            if key in baseline and baseline[key] > 0 and \
+                    result[key] > baseline[key] * (1 + args.tolerance):
+                failures.append('%s regressed: %s, baseline %s'
+                                % (key, result[key], baseline[key]))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='ops-ledd end-to-end scale and latency test')
+    parser.add_argument('--leds', type=int, default=4000,
+                        help='number of load LEDs')
+    parser.add_argument('--subsystems', type=int, default=8,
+                        help='number of subsystems for the load LEDs')
+    parser.add_argument('--probes', type=int, default=64,
+                        help='number of LEDs used to probe status commits')
+    parser.add_argument('--memory-leds', type=int, default=1000,
+                        help='LEDs added to measure the RSS per 1000 LEDs')
+    parser.add_argument('--rate', type=float, default=200,
+                        help='LED state changes per second')
+    parser.add_argument('--duration', type=float, default=20,
+                        help='seconds of load')
+    parser.add_argument('--fault-ratio', type=float, default=0.05,
+                        help='fraction of changes that flip an LED status')
+    parser.add_argument('--hw-delay-us', type=int, default=0,
+                        help='simulated delay of each register access')
+    parser.add_argument('--lazy-activation', action='store_true',
+                        help='run ops-ledd with --lazy-activation')
+    parser.add_argument('--direct-set', action='store_true',
+                        help='send the load changes with ops-ledd/set')
+    parser.add_argument('--ledd', default='ops-ledd')
+    parser.add_argument('--ovsdb-server', default='ovsdb-server')
+    parser.add_argument('--ovsdb-tool', default='ovsdb-tool')
+    parser.add_argument('--schema',
+                        default='/usr/share/openvswitch/vswitch.ovsschema')
+    parser.add_argument('--max-hw-p99-ms', type=float, default=50)
+    parser.add_argument('--max-commit-p99-ms', type=float, default=100)
+    parser.add_argument('--max-startup-s', type=float, default=30)
+    parser.add_argument('--max-cpu-pct', type=float, default=50)
+    parser.add_argument('--max-rss-kb', type=int, default=128 * 1024)
+    parser.add_argument('--max-rss-per-1000-leds-kb', type=float,
+                        default=2048)
+    parser.add_argument('--baseline',
+                        help='JSON results of a previous run to compare to')
+    parser.add_argument('--tolerance', type=float, default=0.25,
+                        help='allowed regression against the baseline')
+    parser.add_argument('--save', help='write the results to this file')
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the work directory')
+    args = parser.parse_args()
+
+    harness = Harness(args)
+    try:
+        harness.setup()
+        harness.start_ledd()
+        memory = harness.measure_memory()
+        result = harness.run_load()
+        result.update(memory)
+    finally:
+        harness.stop()
+
+    print(json.dumps(result, indent=2, sort_keys=True))
+    if args.save:
+        with open(args.save, 'w') as f:
+            json.dump(result, f, indent=2, sort_keys=True)
+
+    failures = check(args, result)
+    for failure in failures:
+        print('FAIL: %s' % failure)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
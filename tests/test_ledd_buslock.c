@@ -0,0 +1,224 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Multi-process contention test for the cooperative bus lock.
+ *
+ * Several processes, standing for the platform daemons, each do batches
+ * of "accesses" to the same bus under its lock. A counter in shared
+ * memory checks that no two processes are ever inside a batch at once.
+ * Each process reports the wait and hold times of its lock, and the test
+ * prints them. The test then checks that a wait times out while another
+ * process holds the lock, and that the lock of a process that dies is
+ * released.
+ *
+ *     usage: test_ledd_buslock [PROCESSES]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "ledd_buslock.h"
+
+#define BATCHES         200     /* batches per process */
+#define ACCESSES        8       /* accesses per batch */
+#define ACCESS_US       20      /* duration of an access */
+#define MAX_PROCS       16
+
+/* shared between the processes */
+struct shared {
+    volatile int inside;                /* processes inside a batch */
+    volatile int overlaps;              /* batches that saw another one */
+    struct ledd_buslock locks[MAX_PROCS]; /* each process' lock stats */
+};
+
+static char dir[] = "/tmp/ledd_buslock.XXXXXX";
+static int failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+static void
+remove_file(const char *name)
+{
+    char path[sizeof dir + 32];
+
+    snprintf(path, sizeof path, "%s/%s", dir, name);
+    unlink(path);
+}
+
+/* one platform daemon: batches of accesses to bus "i2c-1" */
+static int
+daemon_proc(struct shared *shared, int id)
+{
+    struct ledd_buslock lock;
+    int batch, i;
+
+    if (ledd_buslock_init(&lock, dir, "i2c-1")) {
+        return(EXIT_FAILURE);
+    }
+    for (batch = 0; batch < BATCHES; batch++) {
+        if (ledd_buslock_acquire(&lock, 10000)) {
+            return(EXIT_FAILURE);
+        }
+        if (__sync_add_and_fetch(&shared->inside, 1) != 1) {
+            __sync_add_and_fetch(&shared->overlaps, 1);
+        }
+        for (i = 0; i < ACCESSES; i++) {
+            usleep(ACCESS_US);
+            lock.accesses++;
+        }
+        __sync_sub_and_fetch(&shared->inside, 1);
+        ledd_buslock_release(&lock);
+
+        /* time between batches, so that the others get in */
+        usleep(ACCESS_US * (1 + id % 3));
+    }
+    shared->locks[id] = lock;
+    ledd_buslock_destroy(&lock);
+
+    return(EXIT_SUCCESS);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int n_procs = argc > 1 ? atoi(argv[1]) : 4;
+    unsigned long long acquisitions = 0, contended = 0, wait = 0, hold = 0;
+    unsigned long long wait_max = 0, hold_max = 0;
+    struct ledd_buslock lock;
+    struct shared *shared;
+    pid_t pids[MAX_PROCS];
+    pid_t pid;
+    int status;
+    int i;
+
+    if (n_procs < 2 || n_procs > MAX_PROCS) {
+        fprintf(stderr, "usage: %s [PROCESSES (2-%d)]\n", argv[0],
+                MAX_PROCS);
+        return(EXIT_FAILURE);
+    }
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return(EXIT_FAILURE);
+    }
+    shared = mmap(NULL, sizeof *shared, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return(EXIT_FAILURE);
+    }
+    memset(shared, 0, sizeof *shared);
+
+    /* contention: the batches must never overlap */
+    for (i = 0; i < n_procs; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            _exit(daemon_proc(shared, i));
+        }
+        CHECK(pids[i] > 0);
+    }
+    for (i = 0; i < n_procs; i++) {
+        CHECK(waitpid(pids[i], &status, 0) == pids[i] &&
+              WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    CHECK(shared->overlaps == 0);
+
+    for (i = 0; i < n_procs; i++) {
+        const struct ledd_buslock *l = &shared->locks[i];
+
+        CHECK(l->acquisitions == BATCHES);
+        CHECK(l->accesses == BATCHES * ACCESSES);
+        acquisitions += l->acquisitions;
+        contended += l->contended;
+        wait += l->wait_total_us;
+        hold += l->hold_total_us;
+        if (l->wait_max_us > wait_max) {
+            wait_max = l->wait_max_us;
+        }
+        if (l->hold_max_us > hold_max) {
+            hold_max = l->hold_max_us;
+        }
+    }
+    printf("%d processes, %llu batches of %d accesses, %llu contended\n",
+           n_procs, acquisitions, ACCESSES, contended);
+    printf("wait: avg %llu us, max %llu us\n",
+           acquisitions ? wait / acquisitions : 0, wait_max);
+    printf("hold: avg %llu us, max %llu us\n",
+           acquisitions ? hold / acquisitions : 0, hold_max);
+
+    /* a wait is bounded while another process holds the lock */
+    CHECK(ledd_buslock_init(&lock, dir, "i2c-1") == 0);
+    CHECK(ledd_buslock_acquire(&lock, 1000) == 0);
+    pid = fork();
+    if (pid == 0) {
+        struct ledd_buslock other;
+
+        ledd_buslock_init(&other, dir, "i2c-1");
+        _exit(ledd_buslock_acquire(&other, 20) == ETIMEDOUT &&
+              other.timeouts == 1 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+          WEXITSTATUS(status) == EXIT_SUCCESS);
+    CHECK(ledd_buslock_acquire(&lock, 0) == 0);  /* already held */
+    CHECK(lock.acquisitions == 1);
+    ledd_buslock_destroy(&lock);
+
+    /* the lock of a process that dies is released */
+    pid = fork();
+    if (pid == 0) {
+        struct ledd_buslock dying;
+
+        ledd_buslock_init(&dying, dir, "i2c-1");
+        _exit(ledd_buslock_acquire(&dying, 1000) ? EXIT_FAILURE
+                                                 : EXIT_SUCCESS);
+    }
+    CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+          WEXITSTATUS(status) == EXIT_SUCCESS);
+    CHECK(ledd_buslock_init(&lock, dir, "i2c-1") == 0);
+    CHECK(ledd_buslock_acquire(&lock, 0) == 0);
+    CHECK(lock.contended == 0);
+    ledd_buslock_destroy(&lock);
+
+    /* a '/' in a bus name does not make a subdirectory */
+    CHECK(ledd_buslock_init(&lock, dir, "/dev/i2c-2") == 0);
+    CHECK(strcmp(strrchr(lock.path, '/'), "/_dev_i2c-2.lock") == 0);
+    CHECK(ledd_buslock_acquire(&lock, 0) == 0);
+    ledd_buslock_destroy(&lock);
+
+    remove_file("i2c-1.lock");
+    remove_file("_dev_i2c-2.lock");
+    rmdir(dir);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return(EXIT_FAILURE);
+    }
+    printf("ok\n");
+    return(EXIT_SUCCESS);
+}
@@ -0,0 +1,137 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Test of the ring buffer of LED changes.
+ *
+ * Changes must get consecutive sequence numbers from 1. A subscriber
+ * whose cursor is within the ring must get back exactly the changes it
+ * missed, in order, including after the ring wrapped. A cursor older than
+ * the ring, ahead of the last change, or of another epoch must need a
+ * snapshot.
+ *
+ *     usage: test_ledd_changes
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ledd_changes.h"
+
+#define CAPACITY 8
+#define EPOCH    1234
+
+static int failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+/* a subscriber at "cursor" replays the changes it missed */
+static void
+check_resume(const struct ledd_changes *changes, uint64_t cursor)
+{
+    uint64_t seq;
+
+    CHECK(ledd_changes_can_resume(changes, EPOCH, cursor));
+    for (seq = cursor + 1; seq <= changes->last_seq; seq++) {
+        const struct ledd_change *change = ledd_changes_get(changes, seq);
+        char id[32];
+
+        CHECK(change && change->seq == seq);
+        if (change) {
+            snprintf(id, sizeof id, "led-%llu", (unsigned long long) seq);
+            CHECK(!strcmp(change->id, id));
+            CHECK(change->time_ms == (int64_t) seq * 10);
+        }
+    }
+}
+
+int
+main(void)
+{
+    struct ledd_changes changes;
+    const struct ledd_change *change;
+    char id[LEDD_CHANGES_ID_LEN + 16];
+    uint64_t seq;
+
+    CHECK(ledd_changes_init(&changes, 0, EPOCH) != 0);
+    CHECK(ledd_changes_init(&changes, CAPACITY, EPOCH) == 0);
+
+    /* nothing happened yet: a new subscriber at 0 is up to date */
+    CHECK(changes.last_seq == 0);
+    CHECK(ledd_changes_can_resume(&changes, EPOCH, 0));
+    CHECK(ledd_changes_get(&changes, 0) == NULL);
+    CHECK(ledd_changes_get(&changes, 1) == NULL);
+
+    for (seq = 1; seq <= 5; seq++) {
+        snprintf(id, sizeof id, "led-%llu", (unsigned long long) seq);
+        CHECK(ledd_changes_add(&changes, id, "on", "ok", seq * 10) == seq);
+    }
+    check_resume(&changes, 0);
+    check_resume(&changes, 3);
+    check_resume(&changes, 5);
+
+    /* wrap the ring: only the last CAPACITY changes are kept */
+    for (; seq <= 3 * CAPACITY + 3; seq++) {
+        snprintf(id, sizeof id, "led-%llu", (unsigned long long) seq);
+        if (seq % 4) {
+            CHECK(ledd_changes_add(&changes, id, "flashing", "fault",
+                                   seq * 10) == seq);
+        } else {
+            CHECK(ledd_changes_remove(&changes, id, seq * 10) == seq);
+        }
+    }
+    CHECK(changes.last_seq == 3 * CAPACITY + 3);
+    check_resume(&changes, changes.last_seq - CAPACITY);
+    check_resume(&changes, changes.last_seq - 1);
+    CHECK(!ledd_changes_can_resume(&changes, EPOCH,
+                                   changes.last_seq - CAPACITY - 1));
+    CHECK(!ledd_changes_can_resume(&changes, EPOCH, 3));
+    CHECK(ledd_changes_get(&changes, changes.last_seq - CAPACITY) == NULL);
+
+    change = ledd_changes_get(&changes, 3 * CAPACITY);
+    CHECK(change && change->removed && !change->state[0]);
+    change = ledd_changes_get(&changes, 3 * CAPACITY + 1);
+    CHECK(change && !change->removed && !strcmp(change->state, "flashing") &&
+          !strcmp(change->status, "fault"));
+
+    /* a cursor ahead of the ring, or of another instance, is not ours */
+    CHECK(!ledd_changes_can_resume(&changes, EPOCH, changes.last_seq + 1));
+    CHECK(!ledd_changes_can_resume(&changes, EPOCH + 1, changes.last_seq));
+
+    /* a long id is cut, not overflowed */
+    memset(id, 'x', sizeof id - 1);
+    id[sizeof id - 1] = '\0';
+    seq = ledd_changes_add(&changes, id, "off", "ok", 0);
+    change = ledd_changes_get(&changes, seq);
+    CHECK(change && strlen(change->id) == LEDD_CHANGES_ID_LEN - 1);
+
+    ledd_changes_destroy(&changes);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return(EXIT_FAILURE);
+    }
+    printf("ok\n");
+    return(EXIT_SUCCESS);
+}
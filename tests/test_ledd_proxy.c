@@ -0,0 +1,406 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Test and throughput benchmark of the LED register access proxy.
+ *
+ * A proxy backed by simulated registers runs in a child process. The test
+ * checks that writes and reads go through, that a read sees the writes
+ * staged before it, that the error of a device comes back to the write
+ * that failed, that a batch with reads in between ends once (at the
+ * commit), that a client that hangs in a batch is disconnected once the
+ * batch times out, which ends the batch, and that every staged write
+ * fails when the proxy is gone.
+ *
+ * It then does WRITES register writes three ways and prints their rate:
+ * directly on the simulated registers, through the proxy with one round
+ * trip per write, and through the proxy with BATCH writes per round trip.
+ * ACCESS_US simulates the time of a bus access (default: 0, which
+ * measures the cost of the proxy itself).
+ *
+ *     usage: test_ledd_proxy [WRITES [BATCH [ACCESS_US]]]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "ledd_proxy.h"
+
+#define N_REGS  256
+
+static uint32_t regs[N_REGS];
+static unsigned int access_us;
+static char dir[] = "/tmp/ledd_proxy.XXXXXX";
+static char path[sizeof dir + 16];
+static uint32_t batch_ends;             /* batch_end calls, in the proxy */
+static uint32_t batch_timeouts;         /* batch_timeout calls, likewise */
+static int failures;
+
+/* results of the staged writes */
+static unsigned long long done_ok, done_failed;
+static int last_error;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+static long long int
+now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return((long long int) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/* simulated registers: device "fail" does not answer, device "batches"
+   reads the number of batches ended, and device "timeouts" the number of
+   batches aborted */
+static int
+sim_op(void *aux, const struct ledd_proxy_req *req, uint32_t *value)
+{
+    uint32_t *reg = &regs[req->register_address % N_REGS];
+
+    (void) aux;
+    if (access_us) {
+        usleep(access_us);
+    }
+    if (!strcmp(req->device, "fail")) {
+        return(EIO);
+    }
+    if (!strcmp(req->device, "batches")) {
+        *value = batch_ends;
+        return(0);
+    }
+    if (!strcmp(req->device, "timeouts")) {
+        *value = batch_timeouts;
+        return(0);
+    }
+    if (req->op == LEDD_PROXY_WRITE) {
+        *reg = (*reg & ~req->bit_mask) | (req->value & req->bit_mask);
+    } else {
+        *value = *reg & req->bit_mask;
+    }
+
+    return(0);
+}
+
+static void
+batch_end(void *aux)
+{
+    (void) aux;
+    batch_ends++;
+}
+
+static void
+batch_timeout(void *aux, long long int held_ms)
+{
+    (void) aux;
+    (void) held_ms;
+    batch_timeouts++;
+}
+
+static void
+done(void *aux, int error)
+{
+    (void) aux;
+    if (error) {
+        done_failed++;
+        last_error = error;
+    } else {
+        done_ok++;
+    }
+}
+
+static pid_t
+start_proxy(void)
+{
+    struct ledd_proxy_handler handler = {
+        sim_op, batch_end, batch_timeout, NULL
+    };
+    int fd = ledd_proxy_listen(path);
+    pid_t pid;
+
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(-fd));
+        exit(EXIT_FAILURE);
+    }
+    pid = fork();
+    if (pid == 0) {
+        _exit(ledd_proxy_serve(fd, &handler, NULL) ? EXIT_FAILURE
+                                                   : EXIT_SUCCESS);
+    }
+    close(fd);
+
+    return(pid);
+}
+
+static void
+stop_proxy(pid_t pid)
+{
+    int status;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+}
+
+/* a client that sends one write of a batch, and then hangs */
+static int
+hang_in_batch(void)
+{
+    struct ledd_proxy_req req;
+    struct ledd_proxy_rsp rsp;
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof addr.sun_path, "%s", path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof addr) < 0) {
+        return(-1);
+    }
+
+    memset(&req, 0, sizeof req);
+    req.op = LEDD_PROXY_WRITE;
+    req.register_size = 1;
+    req.bit_mask = 0xff;
+    snprintf(req.device, sizeof req.device, "cpld");
+    if (send(fd, &req, sizeof req, 0) != sizeof req ||
+        recv(fd, &rsp, sizeof rsp, MSG_WAITALL) != sizeof rsp) {
+        close(fd);
+        return(-1);
+    }
+
+    return(fd);
+}
+
+static struct ledd_proxy_req
+reg_op(const char *device, uint32_t address, uint32_t bit_mask)
+{
+    struct ledd_proxy_req op;
+
+    memset(&op, 0, sizeof op);
+    snprintf(op.device, sizeof op.device, "%s", device);
+    op.register_address = address;
+    op.register_size = 1;
+    op.bit_mask = bit_mask;
+
+    return(op);
+}
+
+static void
+report(const char *what, int n, long long int us,
+       const struct ledd_proxy_client *client)
+{
+    printf("%-26s %8.0f writes/s", what, us ? n * 1e6 / us : 0.0);
+    if (client) {
+        printf(" (%llu round trips, max batch %zu, avg rtt %llu us)",
+               client->round_trips, client->batch_max,
+               client->round_trips ? client->rtt_total_us /
+                                     client->round_trips : 0);
+    }
+    printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    int n_writes = argc > 1 ? atoi(argv[1]) : 20000;
+    int batch = argc > 2 ? atoi(argv[2]) : 64;
+    struct ledd_proxy_client client;
+    struct ledd_proxy_req op;
+    char label[64];
+    long long int start;
+    uint32_t start_ends;
+    uint32_t value;
+    pid_t pid;
+    int fd;
+    int i;
+
+    access_us = argc > 3 ? atoi(argv[3]) : 0;
+    if (n_writes <= 0 || batch <= 0) {
+        fprintf(stderr, "usage: %s [WRITES [BATCH [ACCESS_US]]]\n",
+                argv[0]);
+        return(EXIT_FAILURE);
+    }
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return(EXIT_FAILURE);
+    }
+    snprintf(path, sizeof path, "%s/proxy.sock", dir);
+    pid = start_proxy();
+    ledd_proxy_client_init(&client, path, done);
+
+    /* a write, then a read of the same register */
+    op = reg_op("cpld", 0x10, 0x0f);
+    CHECK(ledd_proxy_write(&client, "base", &op, 0x35, NULL) == 0);
+    CHECK(ledd_proxy_commit(&client) == 0);
+    CHECK(done_ok == 1 && done_failed == 0);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 && value == 5);
+    CHECK(client.round_trips == 2);
+
+    /* a read sees the writes staged before it, in the same round trip */
+    CHECK(ledd_proxy_write(&client, "base", &op, 0x7, NULL) == 0);
+    op = reg_op("cpld", 0x10, 0xf0);
+    CHECK(ledd_proxy_write(&client, "base", &op, 0xa0, NULL) == 0);
+    op = reg_op("cpld", 0x10, 0xff);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 &&
+          value == 0xa7);
+    CHECK(client.round_trips == 3 && done_ok == 3);
+
+    /* the error of a device comes back to its write only */
+    op = reg_op("fail", 0x20, 0xff);
+    CHECK(ledd_proxy_write(&client, "base", &op, 1, NULL) == 0);
+    op = reg_op("cpld", 0x20, 0xff);
+    CHECK(ledd_proxy_write(&client, "base", &op, 1, NULL) == 0);
+    CHECK(ledd_proxy_commit(&client) == 0);
+    CHECK(done_ok == 4 && done_failed == 1 && last_error == EIO);
+    CHECK(ledd_proxy_commit(&client) == 0);  /* nothing staged */
+    CHECK(client.round_trips == 4);
+
+    /* a batch ends at its commit, not at the reads in between */
+    op = reg_op("batches", 0, 0xffffffff);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0);
+    CHECK(ledd_proxy_commit(&client) == 0);
+    CHECK(ledd_proxy_read(&client, "base", &op, &start_ends) == 0);
+    op = reg_op("cpld", 0x30, 0xff);
+    CHECK(ledd_proxy_write(&client, "base", &op, 1, NULL) == 0);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 && value == 1);
+    CHECK(ledd_proxy_write(&client, "base", &op, 2, NULL) == 0);
+    CHECK(ledd_proxy_commit(&client) == 0);
+    op = reg_op("batches", 0, 0xffffffff);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 &&
+          value == start_ends + 1);
+    CHECK(ledd_proxy_commit(&client) == 0);
+    CHECK(ledd_proxy_commit(&client) == 0);  /* no batch open */
+
+    /* a client hung in a batch is disconnected once the batch times out,
+       and its batch ends (the other clients' batches do not wait) */
+    op = reg_op("batches", 0, 0xffffffff);
+    CHECK(ledd_proxy_read(&client, "base", &op, &start_ends) == 0);
+    CHECK(ledd_proxy_commit(&client) == 0);
+    start = now_us();
+    fd = hang_in_batch();
+    CHECK(fd >= 0);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 &&
+          value == start_ends + 1);
+    CHECK(ledd_proxy_commit(&client) == 0);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 &&
+          value == start_ends + 1);     /* still held by the hung client */
+    CHECK(ledd_proxy_commit(&client) == 0);
+    if (fd >= 0) {
+        char c;
+
+        CHECK(recv(fd, &c, 1, 0) == 0);  /* disconnected */
+        CHECK(now_us() - start >= LEDD_PROXY_BATCH_TIMEOUT_MS * 1000LL);
+        close(fd);
+    }
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 &&
+          value == start_ends + 2);
+    CHECK(ledd_proxy_commit(&client) == 0);
+    op = reg_op("timeouts", 0, 0xffffffff);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 && value == 1);
+    CHECK(ledd_proxy_commit(&client) == 0);
+
+    /* a name that does not fit is refused */
+    CHECK(ledd_proxy_write(&client, "a-subsystem-name-that-is-too-long",
+                           &op, 1, NULL) == ENAMETOOLONG);
+
+    /* benchmark: direct, one write per round trip, pipelined */
+    op = reg_op("cpld", 0, 0xff);
+    start = now_us();
+    for (i = 0; i < n_writes; i++) {
+        struct ledd_proxy_req req = op;
+
+        req.op = LEDD_PROXY_WRITE;
+        req.register_address = i % N_REGS;
+        req.value = i;
+        sim_op(NULL, &req, &value);
+    }
+    report("direct:", n_writes, now_us() - start, NULL);
+
+    ledd_proxy_client_destroy(&client);
+    ledd_proxy_client_init(&client, path, done);
+    done_ok = 0;
+    start = now_us();
+    for (i = 0; i < n_writes; i++) {
+        op.register_address = i % N_REGS;
+        ledd_proxy_write(&client, "base", &op, i, NULL);
+        ledd_proxy_commit(&client);
+    }
+    report("proxy, 1 per round trip:", n_writes, now_us() - start, &client);
+    CHECK(done_ok == (unsigned long long) n_writes);
+    CHECK(client.round_trips == (unsigned long long) n_writes);
+
+    ledd_proxy_client_destroy(&client);
+    ledd_proxy_client_init(&client, path, done);
+    done_ok = 0;
+    start = now_us();
+    for (i = 0; i < n_writes; i++) {
+        op.register_address = i % N_REGS;
+        ledd_proxy_write(&client, "base", &op, i, NULL);
+        if ((i + 1) % batch == 0) {
+            ledd_proxy_commit(&client);
+        }
+    }
+    ledd_proxy_commit(&client);
+    snprintf(label, sizeof label, "proxy, %d per round trip:", batch);
+    report(label, n_writes, now_us() - start, &client);
+    CHECK(done_ok == (unsigned long long) n_writes);
+    CHECK(client.round_trips ==
+          (unsigned long long) (n_writes + batch - 1) / batch);
+
+    /* the last writes are in the registers of the proxy */
+    op = reg_op("cpld", (n_writes - 1) % N_REGS, 0xff);
+    CHECK(ledd_proxy_read(&client, "base", &op, &value) == 0 &&
+          value == ((uint32_t) n_writes - 1) % 256);
+
+    /* without a proxy, every staged write fails */
+    stop_proxy(pid);
+    unlink(path);
+    done_failed = 0;
+    CHECK(ledd_proxy_write(&client, "base", &op, 1, NULL) == 0);
+    CHECK(ledd_proxy_write(&client, "base", &op, 2, NULL) == 0);
+    CHECK(ledd_proxy_commit(&client) != 0);
+    CHECK(done_failed == 2);
+    CHECK(ledd_proxy_commit(&client) == 0);
+
+    ledd_proxy_client_destroy(&client);
+    rmdir(dir);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return(EXIT_FAILURE);
+    }
+    printf("ok\n");
+    return(EXIT_SUCCESS);
+}
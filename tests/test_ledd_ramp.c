@@ -0,0 +1,113 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Test of the brightness ramps of PWM-dimmable LEDs.
+ *
+ * The gamma table must start at 0, end at full scale and never decrease.
+ * The PWM levels must keep a dimmed LED lit, and must fit the register
+ * field of the LED. Ramps up and down must move monotonically from their
+ * start to their end in the given time, and a ramp of no length must end
+ * at once.
+ *
+ *     usage: test_ledd_ramp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ledd_ramp.h"
+
+static int failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+/* a ramp moves monotonically from "from" to "to" in duration_ms */
+static void
+check_ramp(unsigned int from, unsigned int to, long long int duration_ms)
+{
+    struct ledd_ramp ramp;
+    unsigned int prev = from;
+    long long int t;
+    bool done = false;
+
+    ledd_ramp_start(&ramp, from, to, 1000, duration_ms);
+    CHECK(ledd_ramp_at(&ramp, 999, &done) == from && !done);
+
+    for (t = 1000; !done; t += LEDD_RAMP_TICK_MS) {
+        unsigned int b = ledd_ramp_at(&ramp, t, &done);
+
+        CHECK(from <= to ? b >= prev && b <= to : b <= prev && b >= to);
+        prev = b;
+        CHECK(t <= 1000 + duration_ms + LEDD_RAMP_TICK_MS);
+    }
+    CHECK(prev == to);
+    CHECK(t - LEDD_RAMP_TICK_MS >= 1000 + duration_ms);
+}
+
+int
+main(void)
+{
+    bool done;
+    struct ledd_ramp ramp;
+    unsigned int b;
+
+    CHECK(ledd_gamma[0] == 0);
+    CHECK(ledd_gamma[LEDD_RAMP_MAX] == 65535);
+    for (b = 1; b <= LEDD_RAMP_MAX; b++) {
+        CHECK(ledd_gamma[b] >= ledd_gamma[b - 1]);
+    }
+    /* half the brightness is much less than half the duty cycle */
+    CHECK(ledd_gamma[LEDD_RAMP_MAX / 2] < 65535 / 4);
+
+    CHECK(ledd_ramp_level(0, 255) == 0);
+    CHECK(ledd_ramp_level(LEDD_RAMP_MAX, 255) == 255);
+    CHECK(ledd_ramp_level(LEDD_RAMP_MAX + 10, 15) == 15);
+    CHECK(ledd_ramp_level(1, 15) == 1);
+    for (b = 1; b <= LEDD_RAMP_MAX; b++) {
+        CHECK(ledd_ramp_level(b, 7) >= ledd_ramp_level(b - 1, 7));
+    }
+
+    CHECK(ledd_ramp_field(0x5, 0xf0) == 0x50);
+    CHECK(ledd_ramp_field(0x1f, 0xf0) == 0xf0);
+    CHECK(ledd_ramp_field(0x3, 0x0c) == 0x0c);
+    CHECK(ledd_ramp_field(0x7, 0) == 0x7);
+
+    check_ramp(0, LEDD_RAMP_MAX, 500);
+    check_ramp(LEDD_RAMP_MAX, 0, 500);
+    check_ramp(40, 200, 1000);
+    check_ramp(100, 100, 300);
+    check_ramp(0, LEDD_RAMP_MAX, 0);
+
+    /* the position comes from the time: a late tick catches up */
+    ledd_ramp_start(&ramp, 0, 200, 0, 1000);
+    CHECK(ledd_ramp_at(&ramp, 500, &done) == 100 && !done);
+    CHECK(ledd_ramp_at(&ramp, 5000, &done) == 200 && done);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return(EXIT_FAILURE);
+    }
+    printf("ok\n");
+    return(EXIT_SUCCESS);
+}
@@ -0,0 +1,270 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Test of the parsing and matching of the fault-LED rules.
+ *
+ * A malformed line must be refused with a reason and add no rule, and a
+ * rule name must not be defined twice. "any" rules must hold while one
+ * row matches and "all" rules while every row with a value does (and not
+ * on an empty table), including when a row that does not match goes away.
+ * Rules that overlap (same input, same LED) must be counted on their own
+ * and keep their priorities. After a resync the counts must be those of
+ * the rows set again, whatever they were before.
+ *
+ *     usage: test_ledd_rules
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ledd_rules.h"
+
+#define PRIORITY 110
+
+enum { FAN, PSU };
+
+static const char *const inputs[] = { "fan:status", "power_supply:status" };
+static const char *const states[] = { "flashing", "off", "on" };
+
+static int failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+/* parse a line that must be refused with "retval", and add no rule */
+static void
+check_refused(struct ledd_rules *rules, const char *line, int retval,
+              const char *reason)
+{
+    char error[LEDD_RULES_ERROR_LEN] = "";
+    size_t n_rules = rules->n_rules;
+
+    CHECK(ledd_rules_parse(rules, line, PRIORITY, error,
+                           sizeof error) == retval);
+    CHECK(rules->n_rules == n_rules);
+    if (!strstr(error, reason)) {
+        fprintf(stderr, "\"%s\": error \"%s\", expected \"%s\"\n", line,
+                error, reason);
+        failures++;
+    }
+}
+
+/* parse a line that must be taken */
+static void
+check_parsed(struct ledd_rules *rules, const char *line)
+{
+    char error[LEDD_RULES_ERROR_LEN] = "";
+
+    if (ledd_rules_parse(rules, line, PRIORITY, error, sizeof error)) {
+        fprintf(stderr, "\"%s\": %s\n", line, error);
+        failures++;
+    }
+}
+
+/* the rule named "name" */
+static struct ledd_rule *
+find_rule(struct ledd_rules *rules, const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < rules->n_rules; i++) {
+        if (!strcmp(rules->rules[i].name, name)) {
+            return(&rules->rules[i]);
+        }
+    }
+
+    return(NULL);
+}
+
+/* evaluate the rules, returns the number of rules that changed */
+static size_t
+evaluate(struct ledd_rules *rules)
+{
+    size_t pos = 0;
+    size_t n = 0;
+
+    while (ledd_rules_next_change(rules, &pos)) {
+        n++;
+    }
+
+    return(n);
+}
+
+int
+main(void)
+{
+    struct ledd_rules rules;
+    struct ledd_rule *any, *all, *crit, *psu;
+    char key[32];
+    int i;
+
+    CHECK(ledd_rules_init(&rules, inputs, 2, states, 3) == 0);
+
+    /* comments and empty lines add nothing */
+    check_parsed(&rules, "");
+    check_parsed(&rules, "   \t");
+    check_parsed(&rules, "# fan-fault base-fan flashing any fan:status x");
+    CHECK(rules.n_rules == 0);
+
+    /* malformed lines */
+    check_refused(&rules, "fan-fault base-fan flashing any fan:status",
+                  EINVAL, "expected");
+    check_refused(&rules, "fan-fault base-fan flashing most fan:status fault",
+                  EINVAL, "expected");
+    check_refused(&rules, "fan-fault base-fan blinking any fan:status fault",
+                  EINVAL, "invalid state blinking");
+    check_refused(&rules, "fan-fault base-fan flashing any fan:speed fault",
+                  EINVAL, "fan:speed cannot be watched");
+    check_refused(&rules, "fan-fault base-fan flashing any fan:status fault "
+                  "10x", EINVAL, "invalid priority 10x");
+    check_refused(&rules, "fan-fault base-fan flashing any fan:status fault "
+                  "99999999999", EINVAL, "invalid priority");
+    check_refused(&rules, "fan-fault base-fan flashing any fan:status fault "
+                  "10 20", EINVAL, "unexpected \"20\"");
+    check_refused(&rules, "fan-fault base-fan flashing any fan:status ,,",
+                  EINVAL, "no values");
+    CHECK(!rules.inputs[FAN].used && !rules.inputs[PSU].used);
+
+    /* good lines, the default or the given priority, a trailing comment */
+    check_parsed(&rules, "fan-any base-fan flashing any fan:status "
+                 "fault,fault,failed");
+    check_parsed(&rules, "fan-all base-fan off all fan:status fault 120");
+    check_parsed(&rules, "  fan-crit\tbase-fan on any fan:status failed 130"
+                 "  # overlaps fan-any");
+    check_parsed(&rules, "psu-fault base-psu flashing any power_supply:status "
+                 "fault_input,fault_output -5");
+    check_refused(&rules, "fan-any base-fan on any fan:status ok", EEXIST,
+                  "rule fan-any defined twice");
+    CHECK(rules.n_rules == 4);
+    CHECK(rules.inputs[FAN].used && rules.inputs[PSU].used);
+
+    any = find_rule(&rules, "fan-any");
+    all = find_rule(&rules, "fan-all");
+    crit = find_rule(&rules, "fan-crit");
+    psu = find_rule(&rules, "psu-fault");
+    CHECK(any && all && crit && psu);
+    if (!any || !all || !crit || !psu) {
+        return(EXIT_FAILURE);
+    }
+    CHECK(!strcmp(any->source, "rule:fan-any"));
+    CHECK(!strcmp(any->led, "base-fan"));
+    CHECK(any->state == 0 && all->state == 1 && crit->state == 2);
+    CHECK(!any->all && all->all);
+    CHECK(any->input == FAN && psu->input == PSU);
+    CHECK(any->n_values == 2);
+    CHECK(any->priority == PRIORITY && all->priority == 120);
+    CHECK(crit->priority == 130 && psu->priority == -5);
+
+    /* nothing holds on empty tables ("all" neither) */
+    evaluate(&rules);
+    CHECK(!any->active && !all->active && !crit->active && !psu->active);
+
+    /* three fans, one fails: the overlapping "any" rules both hold */
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-1", "ok") == 0);
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-2", "ok") == 0);
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-3", "ok") == 0);
+    CHECK(evaluate(&rules) == 0);
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-2", "failed") == 0);
+    CHECK(evaluate(&rules) == 2);
+    CHECK(any->active && crit->active && !all->active && !psu->active);
+    CHECK(any->n_match == 1 && crit->n_match == 1 && all->n_match == 0);
+
+    /* failed -> fault: fan-any still holds, fan-crit no longer */
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-2", "fault") == 0);
+    CHECK(evaluate(&rules) == 1);
+    CHECK(any->active && !crit->active && any->fired == 1);
+    CHECK(crit->fired == 1);
+
+    /* the same value again changes nothing */
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-2", "fault") == 0);
+    CHECK(evaluate(&rules) == 0);
+
+    /* "all": every fan at fault, then one that was not goes away */
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-1", "fault") == 0);
+    CHECK(evaluate(&rules) == 0);
+    CHECK(all->n_match == 2 && !all->active);
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-3", NULL) == 0);
+    CHECK(evaluate(&rules) == 1);
+    CHECK(all->active && rules.inputs[FAN].n_rows == 2);
+
+    /* a row without a value is not counted; a new one that does not match
+       breaks "all" */
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-4", NULL) == 0);
+    CHECK(evaluate(&rules) == 0 && rules.inputs[FAN].n_rows == 2);
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-4", "ok") == 0);
+    CHECK(evaluate(&rules) == 1 && !all->active && any->active);
+
+    /* the other input is apart */
+    CHECK(ledd_rules_set_row(&rules, PSU, "fan-1", "fault_output") == 0);
+    CHECK(evaluate(&rules) == 1 && psu->active && psu->n_match == 1);
+    CHECK(any->n_match == 2);
+
+    /* many rows: the rows are found again after the table grew */
+    for (i = 0; i < 1000; i++) {
+        snprintf(key, sizeof key, "fan-%d", 100 + i);
+        CHECK(ledd_rules_set_row(&rules, FAN, key, i % 2 ? "fault" : "ok")
+              == 0);
+    }
+    CHECK(rules.inputs[FAN].n_rows == 1003 && any->n_match == 502);
+    for (i = 0; i < 1000; i++) {
+        snprintf(key, sizeof key, "fan-%d", 100 + i);
+        CHECK(ledd_rules_set_row(&rules, FAN, key, NULL) == 0);
+    }
+    CHECK(rules.inputs[FAN].n_rows == 3 && any->n_match == 2);
+    evaluate(&rules);
+
+    /* resync (the lock was lost): while away, fan-1 and fan-2 came back to
+       ok and were deleted, fan-5 appeared; the counts are those of the rows
+       set again, not the stale ones */
+    ledd_rules_resync(&rules, FAN);
+    CHECK(rules.inputs[FAN].n_rows == 0);
+    CHECK(any->n_match == 0 && all->n_match == 0 && crit->n_match == 0);
+    CHECK(psu->n_match == 1 && psu->active);
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-4", "ok") == 0);
+    CHECK(ledd_rules_set_row(&rules, FAN, "fan-5", "ok") == 0);
+    CHECK(evaluate(&rules) == 1);
+    CHECK(!any->active && !all->active && !crit->active && psu->active);
+    CHECK(any->n_match == 0 && rules.inputs[FAN].n_rows == 2);
+
+    /* an unchanged outcome across a resync is not a change */
+    ledd_rules_resync(&rules, PSU);
+    CHECK(ledd_rules_set_row(&rules, PSU, "psu-1", "fault_input") == 0);
+    CHECK(evaluate(&rules) == 0 && psu->active && psu->fired == 1);
+
+    /* a rule added after rows are known counts them */
+    check_parsed(&rules, "fan-ok base-fan on all fan:status ok");
+    CHECK(rules.n_rules == 5);
+    CHECK(evaluate(&rules) == 1);
+    CHECK(rules.rules[4].active && rules.rules[4].n_match == 2);
+
+    ledd_rules_destroy(&rules);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return(EXIT_FAILURE);
+    }
+    printf("ok\n");
+    return(EXIT_SUCCESS);
+}
@@ -0,0 +1,204 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Concurrency stress test for the shared-memory LED state table.
+ *
+ * A writer process rewrites every LED in batches, stamping all fields of
+ * all entries with the same generation number, and grows the table half
+ * way through, inside a batch. It yields between generations so that the
+ * readers run on a single CPU too. Several reader processes take snapshots
+ * as fast as they can and check that every snapshot holds a single
+ * generation, i.e. that no reader ever sees a torn entry or a half-applied
+ * batch; a reader that never got a snapshot fails.
+ *
+ *     usage: test_ledd_shm_stress [SECONDS]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ledd_shm.h"
+
+#define N_LEDS      512
+#define N_READERS   4
+
+static volatile sig_atomic_t stop;
+
+static void
+on_alarm(int sig)
+{
+    (void) sig;
+    stop = 1;
+}
+
+static int
+writer(const char *path, int seconds)
+{
+    struct ledd_shm shm;
+    unsigned long gen;
+    time_t start = time(NULL);
+    bool grown = false;
+    int slots[N_LEDS];
+    int i;
+
+    if (ledd_shm_create(&shm, path, N_LEDS / 2)) {
+        perror("ledd_shm_create");
+        return(1);
+    }
+
+    for (i = 0; i < N_LEDS / 2; i++) {
+        slots[i] = ledd_shm_alloc(&shm);
+    }
+
+    for (gen = 1; time(NULL) - start < seconds; gen++) {
+        char value[LEDD_SHM_STATE_LEN];
+        char id[LEDD_SHM_ID_LEN];
+        int n = grown ? N_LEDS : N_LEDS / 2;
+
+        ledd_shm_write_begin(&shm);
+        if (!grown && time(NULL) - start >= seconds / 2) {
+            if (ledd_shm_grow(&shm, N_LEDS)) {
+                perror("ledd_shm_grow");
+                return(1);
+            }
+            for (i = N_LEDS / 2; i < N_LEDS; i++) {
+                slots[i] = ledd_shm_alloc(&shm);
+            }
+            grown = true;
+            n = N_LEDS;
+        }
+
+        snprintf(value, sizeof value, "%lu", gen);
+        for (i = 0; i < n; i++) {
+            snprintf(id, sizeof id, "led-%d", i);
+            ledd_shm_set(&shm, slots[i], id, value, value, value, gen);
+        }
+        ledd_shm_write_end(&shm);
+        sched_yield();
+    }
+
+    printf("writer: %lu generations\n", gen - 1);
+    ledd_shm_close(&shm);
+    return(0);
+}
+
+static int
+reader(const char *path, int id)
+{
+    static struct ledd_shm_entry entries[N_LEDS];
+    unsigned long snapshots = 0, busy = 0, reopened = 0;
+    struct ledd_shm shm;
+    uint32_t n, i;
+    int error;
+
+    while ((error = ledd_shm_open(&shm, path)) != 0) {
+        if (stop) {
+            return(1);
+        }
+        usleep(1000);
+    }
+
+    while (!stop) {
+        error = ledd_shm_snapshot(&shm, entries, N_LEDS, &n);
+        if (error == ESTALE) {
+            ledd_shm_close(&shm);
+            while (ledd_shm_open(&shm, path) != 0 && !stop) {
+                usleep(100);
+            }
+            reopened++;
+            continue;
+        } else if (error == EAGAIN) {
+            busy++;
+            continue;
+        } else if (error) {
+            fprintf(stderr, "reader %d: %s\n", id, strerror(error));
+            return(1);
+        }
+
+        for (i = 0; i < n; i++) {
+            if (strcmp(entries[i].state, entries[0].state) ||
+                strcmp(entries[i].hw_state, entries[0].state) ||
+                strcmp(entries[i].status, entries[0].state) ||
+                entries[i].last_change != entries[0].last_change) {
+                fprintf(stderr, "reader %d: inconsistent snapshot, "
+                        "entry %u (%s) has %s/%s/%s/%lld, entry 0 has %s\n",
+                        id, i, entries[i].id, entries[i].state,
+                        entries[i].hw_state, entries[i].status,
+                        (long long) entries[i].last_change,
+                        entries[0].state);
+                return(1);
+            }
+        }
+        snapshots++;
+    }
+
+    printf("reader %d: %lu snapshots, %lu busy, %lu reopened\n",
+           id, snapshots, busy, reopened);
+    ledd_shm_close(&shm);
+    if (snapshots == 0) {
+        fprintf(stderr, "reader %d: no consistent snapshot\n", id);
+        return(1);
+    }
+    return(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    char path[] = "/tmp/ledd-shm-stress-XXXXXX";
+    pid_t readers[N_READERS];
+    int seconds = (argc > 1) ? atoi(argv[1]) : 4;
+    int status, failed = 0;
+    int fd, i;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return(1);
+    }
+    close(fd);
+    unlink(path);
+
+    for (i = 0; i < N_READERS; i++) {
+        readers[i] = fork();
+        if (readers[i] == 0) {
+            signal(SIGALRM, on_alarm);
+            alarm(seconds + 1);
+            exit(reader(path, i));
+        }
+    }
+
+    failed |= writer(path, seconds);
+
+    for (i = 0; i < N_READERS; i++) {
+        if (waitpid(readers[i], &status, 0) < 0 ||
+            !WIFEXITED(status) || WEXITSTATUS(status)) {
+            failed = 1;
+        }
+    }
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return(failed);
+}
@@ -0,0 +1,202 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Test of the LED-class (sysfs) backend against a fake sysfs tree.
+ *
+ * The tree is built in a temporary directory with regular files for the
+ * LED attributes. The test checks the values written for each mode, that
+ * a burst of changes to one LED is merged into a single batch entry, that
+ * unchanged attributes are not rewritten, and that a warm open (an LED
+ * already flashing) does not rewrite anything.
+ *
+ *     usage: test_ledd_sysfs
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ledd_sysfs.h"
+
+static char root[] = "/tmp/ledd_sysfs.XXXXXX";
+static int failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+static void
+put(const char *led, const char *attr, const char *value)
+{
+    char path[256];
+    FILE *file;
+
+    snprintf(path, sizeof path, "%s/%s", root, led);
+    mkdir(path, 0755);
+    snprintf(path, sizeof path, "%s/%s/%s", root, led, attr);
+    file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    fputs(value, file);
+    fclose(file);
+}
+
+static const char *
+get(const char *led, const char *attr)
+{
+    static char buf[256];
+    char path[256];
+    FILE *file;
+    size_t n;
+
+    snprintf(path, sizeof path, "%s/%s/%s", root, led, attr);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return("");
+    }
+    n = fread(buf, 1, sizeof buf - 1, file);
+    buf[n] = '\0';
+    fclose(file);
+
+    return(buf);
+}
+
+static void
+make_led(const char *led, const char *trigger, const char *brightness)
+{
+    put(led, "brightness", brightness);
+    put(led, "max_brightness", "255\n");
+    put(led, "trigger", trigger);
+    put(led, "delay_on", "500\n");
+    put(led, "delay_off", "500\n");
+}
+
+static int n_done;
+
+static void
+done(struct ledd_sysfs_led *led)
+{
+    (void) led;
+    n_done++;
+}
+
+int
+main(void)
+{
+    struct ledd_sysfs_batch batch = { NULL, 0, 0 };
+    struct ledd_sysfs_led *loc, *warm, *missing;
+    unsigned long long writes;
+    char cmd[64];
+
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp");
+        return(EXIT_FAILURE);
+    }
+
+    make_led("loc", "none rfkill0 [heartbeat] timer\n", "0\n");
+    make_led("warm", "none rfkill0 [timer] heartbeat\n", "255\n");
+
+    /* opening */
+    CHECK(ledd_sysfs_open(root, "missing", &missing) == ENOENT);
+    CHECK(missing == NULL);
+    CHECK(ledd_sysfs_open(root, "loc", &loc) == 0);
+    CHECK(loc->max_brightness == 255);
+    CHECK(!loc->valid);                 /* heartbeat: not a known mode */
+
+    /* a burst of changes is one batch entry, only the last one counts */
+    CHECK(ledd_sysfs_stage(&batch, loc, LEDD_SYSFS_FLASH, 100, 100) == 0);
+    CHECK(ledd_sysfs_stage(&batch, loc, LEDD_SYSFS_OFF, 0, 0) == 0);
+    CHECK(ledd_sysfs_stage(&batch, loc, LEDD_SYSFS_ON, 0, 0) == 0);
+    CHECK(batch.n == 1);
+    CHECK(ledd_sysfs_commit(&batch, done) == 0);
+    CHECK(n_done == 1);
+    CHECK(batch.n == 0);
+    CHECK(strcmp(get("loc", "trigger"), "none") == 0);
+    CHECK(strcmp(get("loc", "brightness"), "255") == 0);
+    CHECK(loc->valid && loc->mode == LEDD_SYSFS_ON);
+    CHECK(loc->written);
+
+    /* unchanged: nothing is written */
+    writes = loc->writes;
+    ledd_sysfs_stage(&batch, loc, LEDD_SYSFS_ON, 0, 0);
+    CHECK(ledd_sysfs_commit(&batch, NULL) == 0);
+    CHECK(loc->writes == writes);
+    CHECK(!loc->written);
+
+    /* flashing uses the kernel timer trigger */
+    ledd_sysfs_stage(&batch, loc, LEDD_SYSFS_FLASH, 250, 750);
+    CHECK(ledd_sysfs_commit(&batch, NULL) == 0);
+    CHECK(strcmp(get("loc", "trigger"), "timer") == 0);
+    CHECK(strcmp(get("loc", "delay_on"), "250") == 0);
+    CHECK(strcmp(get("loc", "delay_off"), "750") == 0);
+
+    /* only the delay that changed is written */
+    writes = loc->writes;
+    ledd_sysfs_stage(&batch, loc, LEDD_SYSFS_FLASH, 250, 250);
+    CHECK(ledd_sysfs_commit(&batch, NULL) == 0);
+    CHECK(loc->writes == writes + 1);
+    CHECK(strcmp(get("loc", "delay_off"), "250") == 0);
+
+    /* off removes the trigger */
+    ledd_sysfs_stage(&batch, loc, LEDD_SYSFS_OFF, 0, 0);
+    CHECK(ledd_sysfs_commit(&batch, NULL) == 0);
+    CHECK(strcmp(get("loc", "trigger"), "none") == 0);
+    CHECK(strcmp(get("loc", "brightness"), "0") == 0);
+
+    /* warm open: an LED already flashing is not rewritten */
+    CHECK(ledd_sysfs_open(root, "warm", &warm) == 0);
+    CHECK(warm->valid && warm->mode == LEDD_SYSFS_FLASH);
+    ledd_sysfs_stage(&batch, warm, LEDD_SYSFS_FLASH, 500, 500);
+    CHECK(ledd_sysfs_commit(&batch, NULL) == 0);
+    CHECK(warm->writes == 0);
+    CHECK(!warm->written);
+
+    /* a failed write is reported and forces a full rewrite later */
+    snprintf(cmd, sizeof cmd, "%s/loc/delay_on", root);
+    unlink(cmd);
+    ledd_sysfs_stage(&batch, loc, LEDD_SYSFS_FLASH, 500, 500);
+    CHECK(ledd_sysfs_commit(&batch, NULL) == 1);
+    CHECK(loc->error == ENOENT);
+    CHECK(!loc->valid);
+
+    ledd_sysfs_close(loc);
+    ledd_sysfs_close(warm);
+    ledd_sysfs_batch_destroy(&batch);
+
+    snprintf(cmd, sizeof cmd, "rm -rf %s", root);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "unable to remove %s\n", root);
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return(EXIT_FAILURE);
+    }
+    printf("ok\n");
+    return(EXIT_SUCCESS);
+}
@@ -0,0 +1,158 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Test of the ops-ledd trace format.
+ *
+ * A trace with every record type is written and read back: the fields and
+ * the record times must match. The test then checks that a trace cut in
+ * the middle of a record reads as ending before it, that strings longer
+ * than LEDD_TRACE_STR_MAX are cut, and that a file that is not a trace is
+ * refused.
+ *
+ *     usage: test_ledd_trace
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ledd_trace.h"
+
+static char path[] = "/tmp/ledd_trace.XXXXXX";
+static int failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+static void
+write_trace(void)
+{
+    struct ledd_trace trace;
+    char long_id[400];
+
+    memset(long_id, 'x', sizeof long_id - 1);
+    long_id[sizeof long_id - 1] = '\0';
+
+    CHECK(ledd_trace_create(&trace, path, 1000, 1460000000000LL) == 0);
+    ledd_trace_subsys(&trace, 1000, true, "base", "/etc/hw/base");
+    ledd_trace_led_state(&trace, 1500, "base-loc", "flashing");
+    ledd_trace_hw_write(&trace, 1600, "base-loc", 0x2, 0, 120);
+    ledd_trace_hw_write(&trace, 1700, "base-loc", 0x1, EIO, 5000);
+    ledd_trace_commit(&trace, 2000, 7, 300);
+    ledd_trace_led_state(&trace, 2000, long_id, "on");
+    ledd_trace_subsys(&trace, 5000000000LL, false, "base", NULL);
+    CHECK(trace.records == 7);
+    CHECK(ledd_trace_flush(&trace) == 0);
+    ledd_trace_close(&trace);
+}
+
+int
+main(void)
+{
+    struct ledd_trace_record rec;
+    struct ledd_trace trace;
+    long long int start;
+    FILE *file;
+    long size;
+    int fd;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return(EXIT_FAILURE);
+    }
+    close(fd);
+
+    /* round trip */
+    write_trace();
+    CHECK(ledd_trace_open(&trace, path, &start) == 0);
+    CHECK(start == 1460000000000LL);
+
+    CHECK(ledd_trace_read(&trace, &rec) == 0);
+    CHECK(rec.type == LEDD_TRACE_SUBSYS_ADD && rec.time_us == 0);
+    CHECK(!strcmp(rec.name, "base") && !strcmp(rec.text, "/etc/hw/base"));
+
+    CHECK(ledd_trace_read(&trace, &rec) == 0);
+    CHECK(rec.type == LEDD_TRACE_LED_STATE && rec.time_us == 500);
+    CHECK(!strcmp(rec.name, "base-loc") && !strcmp(rec.text, "flashing"));
+
+    CHECK(ledd_trace_read(&trace, &rec) == 0);
+    CHECK(rec.type == LEDD_TRACE_HW_WRITE && rec.time_us == 600);
+    CHECK(rec.value == 0x2 && rec.error == 0 && rec.latency_us == 120);
+
+    CHECK(ledd_trace_read(&trace, &rec) == 0);
+    CHECK(rec.type == LEDD_TRACE_HW_WRITE && rec.error == EIO);
+    CHECK(rec.latency_us == 5000);
+
+    CHECK(ledd_trace_read(&trace, &rec) == 0);
+    CHECK(rec.type == LEDD_TRACE_COMMIT && rec.time_us == 1000);
+    CHECK(rec.error == 7 && rec.latency_us == 300);
+
+    /* long strings are cut */
+    CHECK(ledd_trace_read(&trace, &rec) == 0);
+    CHECK(strlen(rec.name) == LEDD_TRACE_STR_MAX);
+    CHECK(!strcmp(rec.text, "on"));
+
+    /* a gap longer than the delta field saturates */
+    CHECK(ledd_trace_read(&trace, &rec) == 0);
+    CHECK(rec.type == LEDD_TRACE_SUBSYS_DEL && !strcmp(rec.name, "base"));
+    CHECK(rec.time_us == 1000 + (long long) UINT32_MAX);
+
+    CHECK(ledd_trace_read(&trace, &rec) == EOF);
+    CHECK(trace.records == 7);
+    ledd_trace_close(&trace);
+
+    /* a truncated last record is the end of the trace */
+    file = fopen(path, "r+");
+    CHECK(file != NULL);
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    CHECK(ftruncate(fileno(file), size - 2) == 0);
+    fclose(file);
+
+    CHECK(ledd_trace_open(&trace, path, &start) == 0);
+    while (ledd_trace_read(&trace, &rec) == 0) {
+        continue;
+    }
+    CHECK(trace.records == 6);
+    ledd_trace_close(&trace);
+
+    /* not a trace */
+    file = fopen(path, "w");
+    CHECK(file != NULL);
+    fputs("not a trace, but long enough for a header\n", file);
+    fclose(file);
+    CHECK(ledd_trace_open(&trace, path, &start) == EINVAL);
+
+    unlink(path);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return(EXIT_FAILURE);
+    }
+    printf("ok\n");
+    return(EXIT_SUCCESS);
+}
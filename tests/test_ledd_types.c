@@ -0,0 +1,194 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ */
+
+/*
+ * Test of the ops-ledd LED type registry.
+ *
+ * Each built-in type is looked up and its values computed from a set of
+ * settings: the states it takes must give their setting, the others must
+ * be refused. The test then checks the rules of each type (an indicator
+ * that cannot be lit, a fault that cannot be told apart, a locator that
+ * cannot blink), and registers a driver of its own: a duplicate name, an
+ * incomplete driver and a full registry must be refused.
+ *
+ *     usage: test_ledd_types
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ledd_types.h"
+
+static int failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+/* settings of a type: flashing 0x3, off 0x0, on 0x1 */
+static const uint32_t settings[LEDD_TYPE_N_STATES] = {
+    [LEDD_TYPE_FLASHING] = 0x3, [LEDD_TYPE_OFF] = 0x0, [LEDD_TYPE_ON] = 0x1
+};
+
+/* a type whose "on" value is its "off" value */
+static const uint32_t unlit[LEDD_TYPE_N_STATES] = {
+    [LEDD_TYPE_FLASHING] = 0x2, [LEDD_TYPE_OFF] = 0x0, [LEDD_TYPE_ON] = 0x0
+};
+
+/* a type that cannot blink: "flashing" is "off" */
+static const uint32_t steady[LEDD_TYPE_N_STATES] = {
+    [LEDD_TYPE_FLASHING] = 0x0, [LEDD_TYPE_OFF] = 0x0, [LEDD_TYPE_ON] = 0x1
+};
+
+/* a type whose "flashing" value is its "on" value */
+static const uint32_t flat[LEDD_TYPE_N_STATES] = {
+    [LEDD_TYPE_FLASHING] = 0x1, [LEDD_TYPE_OFF] = 0x0, [LEDD_TYPE_ON] = 0x1
+};
+
+/* a bicolor LED: "on" is green, and "flashing" amber whatever the
+   settings say */
+static int
+compute_bicolor(const struct ledd_type_driver *driver,
+                const uint32_t in[LEDD_TYPE_N_STATES],
+                uint32_t values[LEDD_TYPE_N_STATES])
+{
+    ledd_type_compute_settings(driver, in, values);
+    values[LEDD_TYPE_FLASHING] = 0x10;
+
+    return(0);
+}
+
+static const struct ledd_type_driver bicolor = {
+    "bicolor",
+    LEDD_TYPE_STATE_BIT(LEDD_TYPE_OFF) | LEDD_TYPE_STATE_BIT(LEDD_TYPE_ON) |
+    LEDD_TYPE_STATE_BIT(LEDD_TYPE_FLASHING),
+    compute_bicolor, ledd_type_value_table
+};
+
+static void
+check_type(const char *name, bool flashing)
+{
+    uint32_t values[LEDD_TYPE_N_STATES];
+    uint32_t value;
+    int id;
+
+    id = ledd_type_find(name);
+    CHECK(id >= 0);
+    if (id < 0) {
+        return;
+    }
+    CHECK(!strcmp(ledd_type_drivers[id]->name, name));
+    CHECK(ledd_type_compute(id, settings, values) == 0);
+
+    CHECK(ledd_type_value(id, values, LEDD_TYPE_OFF, &value) && value == 0);
+    CHECK(ledd_type_value(id, values, LEDD_TYPE_ON, &value) && value == 1);
+    CHECK(ledd_type_takes(id, LEDD_TYPE_FLASHING) == flashing);
+    value = 0xff;
+    CHECK(ledd_type_value(id, values, LEDD_TYPE_FLASHING, &value) == flashing);
+    CHECK(value == (flashing ? 0x3 : 0xff));
+    CHECK(!ledd_type_value(id, values, LEDD_TYPE_N_STATES, &value));
+}
+
+int
+main(void)
+{
+    struct ledd_type_driver incomplete;
+    uint32_t values[LEDD_TYPE_N_STATES];
+    uint32_t value;
+    unsigned int n;
+    int id;
+
+    check_type("loc", true);
+    check_type("status", true);
+    check_type("fan", true);
+    check_type("psu", true);
+    check_type("port", false);
+    check_type("uid", true);
+    CHECK(ledd_type_find("LOC") < 0);
+    CHECK(ledd_type_find("") < 0);
+
+    /* indicators must be visible, the locator need not */
+    CHECK(ledd_type_compute(ledd_type_find("status"), unlit, values) ==
+          EINVAL);
+    CHECK(ledd_type_compute(ledd_type_find("port"), unlit, values) == EINVAL);
+    CHECK(ledd_type_compute(ledd_type_find("uid"), unlit, values) == EINVAL);
+    CHECK(ledd_type_compute(ledd_type_find("loc"), unlit, values) == 0);
+
+    /* a locator that cannot blink is lit when flashing */
+    CHECK(ledd_type_compute(ledd_type_find("loc"), steady, values) == 0);
+    CHECK(ledd_type_value(ledd_type_find("loc"), values, LEDD_TYPE_FLASHING,
+                          &value) && value == 0x1);
+
+    /* a fault must not look healthy, a failed fan not look absent, and a
+       supply must tell all three apart */
+    CHECK(ledd_type_compute(ledd_type_find("status"), flat, values) ==
+          EINVAL);
+    CHECK(ledd_type_compute(ledd_type_find("status"), steady, values) == 0);
+    CHECK(ledd_type_compute(ledd_type_find("fan"), steady, values) == EINVAL);
+    CHECK(ledd_type_compute(ledd_type_find("fan"), flat, values) == 0);
+    CHECK(ledd_type_compute(ledd_type_find("psu"), flat, values) == EINVAL);
+    CHECK(ledd_type_compute(ledd_type_find("psu"), steady, values) ==
+          EINVAL);
+
+    /* a driver of our own */
+    n = ledd_n_type_drivers;
+    id = ledd_type_register(&bicolor);
+    CHECK(id == (int) n);
+    CHECK(ledd_type_find("bicolor") == id);
+    CHECK(ledd_type_compute(id, settings, values) == 0);
+    CHECK(ledd_type_value(id, values, LEDD_TYPE_FLASHING, &value) &&
+          value == 0x10);
+    CHECK(ledd_type_register(&bicolor) == -EEXIST);
+
+    incomplete = bicolor;
+    incomplete.name = "incomplete";
+    incomplete.value = NULL;
+    CHECK(ledd_type_register(&incomplete) == -EINVAL);
+    incomplete.value = ledd_type_value_table;
+    incomplete.states = 0;
+    CHECK(ledd_type_register(&incomplete) == -EINVAL);
+
+    /* fill the registry: the same driver under many names */
+    while (ledd_n_type_drivers < LEDD_TYPE_MAX) {
+        static char names[LEDD_TYPE_MAX][16];
+        static struct ledd_type_driver drivers[LEDD_TYPE_MAX];
+        unsigned int i = ledd_n_type_drivers;
+
+        drivers[i] = bicolor;
+        snprintf(names[i], sizeof names[i], "extra%u", i);
+        drivers[i].name = names[i];
+        CHECK(ledd_type_register(&drivers[i]) == (int) i);
+        if (ledd_n_type_drivers == i) {
+            break;
+        }
+    }
+    incomplete.states = bicolor.states;
+    CHECK(ledd_type_register(&incomplete) == -ENOSPC);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return(EXIT_FAILURE);
+    }
+    printf("ok\n");
+    return(EXIT_SUCCESS);
+}
@@ -0,0 +1,198 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+#    Licensed under the Apache License, Version 2.0 (the "License"); you may
+#    not use this file except in compliance with the License. You may obtain
+#    a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+#    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+#    License for the specific language governing permissions and limitations
+#    under the License.
+
+"""
+Generate the static LED tables of ops-ledd (see include/ledd_tables.h).
+
+For each NAME=DIR argument, the hardware description files of subsystem
+NAME in DIR (devices.yaml and led.yaml) are compiled into C tables: the
+LEDs with their register operations, the LED types with the register value
+of each state, and the devices (sorted by name) with their bus. The tables
+carry a digest of the files, so that ops-ledd only uses them while the
+files on the target are the ones they were generated from. DIR is the
+hw_desc_dir of the subsystem on the target; with --root, the files are
+read from ROOT/DIR (e.g. the image's root filesystem).
+
+    usage: ledd_gen_tables.py [--root=ROOT] -o OUTPUT NAME=DIR...
+"""
+
+import argparse
+import os
+import sys
+
+import yaml
+
+DEVICES_FILE = 'devices.yaml'
+LED_FILE = 'led.yaml'
+
+# the LED states, and the enum ovsrec_led_state_e of each
+STATES = (('off', 'LED_STATE_OFF'), ('on', 'LED_STATE_ON'),
+          ('flashing', 'LED_STATE_FLASHING'))
+
+# fields of an i2c_bit_op that are set from led_access
+ACCESS_FIELDS = ('register_address', 'register_size', 'bit_mask')
+
+
+def digest(paths):
+    """FNV-1a (32 bits) of the contents of paths, see ledd_hw_desc_digest().
+    A missing file adds nothing."""
+    h = 0x811c9dc5
+    for path in paths:
+        try:
+            with open(path, 'rb') as f:
+                data = bytearray(f.read())
+        except IOError:
+            continue
+        for b in data:
+            h = ((h ^ b) * 0x01000193) & 0xffffffff
+    return h
+
+
+def c_str(s):
+    """C string literal of s."""
+    out = []
+    for c in str(s):
+        if c in '"\\':
+            out.append('\\' + c)
+        elif ' ' <= c <= '~':
+            out.append(c)
+        else:
+            out.append('\\%03o' % (ord(c) & 0xff))
+    return '"%s"' % ''.join(out)
+
+
+def load(path):
+    with open(path) as f:
+        return yaml.safe_load(f) or {}
+
+
+# keys of each state in the settings: "off" and "on" are booleans in YAML
+# unless they are quoted. A type may have no setting for a state it does
+# not take (e.g. "flashing" for a port LED), its value is then 0.
+SETTINGS_KEYS = {'off': ('off', False), 'on': ('on', True),
+                 'flashing': ('flashing',)}
+
+
+def settings_value(settings, state):
+    for key in SETTINGS_KEYS[state]:
+        if key in settings:
+            return int(settings[key])
+    return 0
+
+
+def gen_subsystem(out, idx, name, hw_desc_dir, root):
+    path = os.path.join(root, hw_desc_dir.lstrip('/')) if root \
+        else hw_desc_dir
+    devices = load(os.path.join(path, DEVICES_FILE)).get('devices')
+    leds_file = load(os.path.join(path, LED_FILE))
+    types = leds_file.get('led_types') or []
+    leds = leds_file.get('leds') or []
+    devices = sorted(devices or [], key=lambda d: str(d['name']))
+    p = 't%d' % idx
+
+    out.write('/* subsystem %s, from %s */\n' % (name, hw_desc_dir))
+
+    out.write('static i2c_bit_op %s_ops[] = {\n' % p)
+    for led in leds:
+        access = led.get('led_access') or {}
+        fields = ['.device = %s' % c_str(access.get('device', ''))]
+        for field in ACCESS_FIELDS:
+            if field in access:
+                fields.append('.%s = 0x%x' % (field, int(access[field])))
+        out.write('    { %s },\n' % ', '.join(fields))
+    out.write('};\n\n')
+
+    out.write('static YamlLed %s_leds[] = {\n' % p)
+    for i, led in enumerate(leds):
+        out.write('    { .name = %s, .type = %s, .led_access = &%s_ops[%d] '
+                  '},\n' % (c_str(led['name']), c_str(led['type']), p, i))
+    out.write('};\n\n')
+
+    out.write('static YamlLedType %s_types[] = {\n' % p)
+    for t in types:
+        settings = t.get('settings') or {}
+        out.write('    { .type = %s, .settings = { %s } },\n' % (
+            c_str(t['type']),
+            ', '.join('.%s = 0x%x' % (s, settings_value(settings, s))
+                      for s, _ in STATES)))
+    out.write('};\n\n')
+
+    out.write('static const uint32_t %s_values[][LEDD_TABLES_N_STATES] = {\n'
+              % p)
+    for t in types:
+        settings = t.get('settings') or {}
+        out.write('    { %s },\n' % ', '.join(
+            '[%s] = 0x%x' % (e, settings_value(settings, s))
+            for s, e in STATES))
+    out.write('};\n\n')
+
+    out.write('static const struct ledd_static_device %s_devices[] = {\n'
+              % p)
+    for d in devices:
+        out.write('    { %s, %s },\n' % (
+            c_str(d['name']), c_str(d['bus']) if d.get('bus') else 'NULL'))
+    out.write('};\n\n')
+
+    return ('    { %s, %s, 0x%08x,\n'
+            '      %d, %s_leds, %d, %s_types, %s_values, %d, %s_devices },\n'
+            % (c_str(name), c_str(hw_desc_dir),
+               digest([os.path.join(path, DEVICES_FILE),
+                       os.path.join(path, LED_FILE)]),
+               len(leds), p, len(types), p, p, len(devices), p))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[1])
+    parser.add_argument('-o', '--output', required=True)
+    parser.add_argument('--root', default='')
+    parser.add_argument('subsystems', nargs='+', metavar='NAME=DIR')
+    args = parser.parse_args()
+
+    entries = []
+    tmp = args.output + '.tmp'
+    with open(tmp, 'w') as out:
+        out.write('/* Generated by ledd_gen_tables.py, do not edit. */\n\n'
+                  '#include <stddef.h>\n'
+                  '#include <stdint.h>\n\n'
+                  '#include "config-yaml.h"\n'
+                  '#include "vswitch-idl.h"\n\n'
+                  '#include "ledd_tables.h"\n\n')
+        for idx, arg in enumerate(args.subsystems):
+            name, sep, hw_desc_dir = arg.partition('=')
+            if not sep or not name or not hw_desc_dir:
+                parser.error('%s: expected NAME=DIR' % arg)
+            try:
+                entries.append(gen_subsystem(out, idx, name, hw_desc_dir,
+                                             args.root))
+            except (IOError, KeyError, TypeError, ValueError,
+                    yaml.YAMLError) as e:
+                sys.stderr.write('%s: %s: %s\n' % (sys.argv[0], arg, e))
+                os.unlink(tmp)
+                return 1
+        out.write('static const struct ledd_static_subsys tables[] = {\n')
+        out.write(''.join(entries))
+        out.write('};\n\n'
+                  'const struct ledd_static_subsys *const ledd_static_tables '
+                  '= tables;\n'
+                  'const size_t ledd_n_static_tables = %d;\n' % len(entries))
+    os.rename(tmp, args.output)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())